@@ -0,0 +1,124 @@
+/**
+ * @file cancelacion.h
+ * @brief Cancelación del comando en curso con Ctrl+C.
+ *
+ * El manejador de SIGINT de la shell no puede hacer casi nada de forma
+ * segura: solo marca una bandera atómica y escribe un byte en un pipe
+ * propio (self-pipe). Los bucles largos (lectura por bloques, conteo,
+ * sumas, recorridos de directorios, ordenamiento) consultan la bandera con
+ * cancelacion_solicitada(), que es una lectura atómica sin candados; los
+ * comandos que esperan eventos en poll() (vigilar, leer -f) incluyen
+ * cancelacion_fd() entre sus descriptores y despiertan al instante.
+ *
+ * La bandera es del proceso: Ctrl+C llega a todo el grupo de procesos de
+ * la terminal, así que detiene también a los hilos de `paralelo` y a los
+ * programas externos que lanzó.
+ *
+ * Un comando también se cancela cuando supera los límites de `limite`
+ * (LimiteComando). Esos límites son del hilo que ejecuta el comando (y de
+ * los hilos de trabajo que este cree), no del proceso: en `paralelo`, la
+ * línea que se pasa de tiempo se detiene sin afectar a las demás. El plazo
+ * se compara con el reloj monotónico (vDSO, sin llamada al sistema) en los
+ * mismos puntos donde se consulta la bandera, y además vence un timerfd
+ * para despertar a los comandos que esperan en poll(); no hace falta un
+ * hilo vigilante.
+ */
+
+#ifndef CANCELACION_H
+#define CANCELACION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Pide cancelar el comando en curso.
+ *
+ * Es async-signal-safe: se puede llamar desde un manejador de señales.
+ */
+void cancelacion_solicitar(void);
+
+/**
+ * @brief 1 si se pidió cancelar desde el último cancelacion_reiniciar(),
+ *        o si el comando del hilo actual superó su límite.
+ */
+int cancelacion_solicitada(void);
+
+/**
+ * @brief Descriptor que se vuelve legible al pedir la cancelación.
+ *
+ * Sirve para esperarla en poll() junto con otros descriptores.
+ * @return El extremo de lectura del pipe, o -1 si no se pudo crear.
+ */
+int cancelacion_fd(void);
+
+/** @brief Olvida una cancelación anterior (antes de cada comando). */
+void cancelacion_reiniciar(void);
+
+/* =============================================================================
+ * Límites de tiempo y memoria por comando (`limite`)
+ * ========================================================================== */
+
+/** @brief Por qué un límite detuvo el comando. */
+typedef enum {
+    LIMITE_NINGUNO = 0,
+    LIMITE_TIEMPO,     /**< Venció el plazo */
+    LIMITE_MEMORIA     /**< Se pidió más memoria que el presupuesto */
+} MotivoLimite;
+
+/** @brief Límites activos de un comando (vive en la pila de quien lo ejecuta). */
+typedef struct LimiteComando {
+    int64_t plazo_ns;               /**< Fin del plazo (CLOCK_MONOTONIC); 0 = sin plazo */
+    size_t memoria_max;             /**< Presupuesto en bytes; 0 = sin límite */
+    size_t memoria_usada;           /**< Reservado ahora (atómico) */
+    int motivo;                     /**< MotivoLimite (atómico) */
+    int fd_plazo;                   /**< timerfd que vence con el plazo, o -1 */
+    struct LimiteComando *anterior; /**< Límite exterior (comandos anidados) */
+} LimiteComando;
+
+/**
+ * @brief Activa un límite en el hilo actual.
+ *
+ * Si ya había uno, el nuevo queda anidado: el plazo efectivo es el más
+ * cercano y la memoria se descuenta de los dos presupuestos.
+ *
+ * @param ms Plazo en milisegundos (0 = sin plazo).
+ * @param bytes Presupuesto de memoria (0 = sin límite).
+ */
+void limite_comenzar(LimiteComando *l, uint64_t ms, size_t bytes);
+
+/** @brief Desactiva el límite y restaura el anterior. */
+void limite_terminar(LimiteComando *l);
+
+/** @brief Motivo por el que el límite detuvo el comando (LIMITE_NINGUNO si no). */
+MotivoLimite limite_motivo(LimiteComando *l);
+
+/** @brief Límite del hilo actual (NULL si no hay). */
+LimiteComando *limite_actual(void);
+
+/**
+ * @brief Hace que el hilo actual obedezca el límite 'l'.
+ *
+ * Lo usan los hilos de trabajo (hilos.c, `paralelo`) al empezar, con el
+ * límite del hilo que los creó.
+ */
+void limite_heredar(LimiteComando *l);
+
+/** @brief timerfd del plazo del hilo actual, para poll(); -1 si no hay. */
+int limite_fd(void);
+
+/**
+ * @brief Descuenta 'bytes' del presupuesto del hilo actual.
+ *
+ * Para los búferes que crecen con la entrada (bloque de `ordenar`, líneas
+ * largas de `buscar`). Si no alcanza, no descuenta nada, marca el límite
+ * como LIMITE_MEMORIA (el comando se cancela) y devuelve -1.
+ */
+int limite_cargar(size_t bytes);
+
+/** @brief Devuelve al presupuesto lo que se cargó con limite_cargar(). */
+void limite_descargar(size_t bytes);
+
+/** @brief Bytes que aún se pueden cargar (SIZE_MAX si no hay límite). */
+size_t limite_memoria_libre(void);
+
+#endif /* CANCELACION_H */
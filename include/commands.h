@@ -49,6 +49,63 @@ void cmd_buscar(char **args);
  */
 void cmd_prompt(char **args);
 
+/** @brief Cuenta líneas, palabras y bytes de archivos (wc). */
+void cmd_contar(char **args);
+
+/** @brief Calcula sumas de verificación (CRC32C/XXH64) y verifica manifiestos. */
+void cmd_checksum(char **args);
+
+/** @brief Muestra el espacio ocupado por árboles de directorios (du). */
+void cmd_uso(char **args);
+
+/** @brief Vigila cambios en archivos y reacciona (inotify/fanotify). */
+void cmd_vigilar(char **args);
+
+/** @brief Crea o actualiza el índice de trigramas de un directorio */
+void cmd_indexar(char **args);
+
+/** @brief Ordena las líneas de archivos con memoria acotada (sort externo) */
+void cmd_ordenar(char **args);
+
+/** @brief Ejecuta una lista de comandos en paralelo con la salida en orden */
+void cmd_paralelo(char **args);
+
+/** @brief Mide el tiempo y los recursos de un comando */
+void cmd_medir(char **args);
+
+/** @brief Comando limite: ejecuta un comando con tiempo y memoria máximos */
+void cmd_limite(char **args);
+
+/** @brief Comando memoria: estadísticas del rastreo de asignaciones (MEM_*) */
+void cmd_memoria(char **args);
+
+/** @brief Comando cd: cambia el directorio de trabajo de la sesión */
+void cmd_cd(char **args);
+
+/** @brief Comando pwd: muestra el directorio de trabajo de la sesión */
+void cmd_pwd(char **args);
+
+/** @brief Comando pushd: guarda el directorio actual y cambia a otro */
+void cmd_pushd(char **args);
+
+/** @brief Comando popd: vuelve al último directorio guardado con pushd */
+void cmd_popd(char **args);
+
+/** @brief Comando dirs: muestra la pila de directorios */
+void cmd_dirs(char **args);
+
+/** @brief Comando alias: lista o define atajos de comandos */
+void cmd_alias(char **args);
+
+/** @brief Comando export: lista o define variables de la sesión */
+void cmd_export(char **args);
+
+/** @brief Compara dos archivos y muestra sus diferencias en formato unificado (diff -u) */
+void cmd_comparar(char **args);
+
+/** @brief Reemplaza un texto en archivos (temporal + rename, en paralelo) */
+void cmd_reemplazar(char **args);
+
 // --- Utilidades del Registro de Comandos ---
 
 /** @brief Retorna el número total de comandos registrados. */
@@ -0,0 +1,144 @@
+/**
+ * @file configuracion.h
+ * @brief Archivo de inicio `~/.eafitosrc` (alias, variables y prompt).
+ *
+ * Formato, una directiva por línea ('#' inicia un comentario):
+ *
+ *     prompt <texto>
+ *     alias <nombre>=<comando> [argumentos...]
+ *     export <NOMBRE>=<valor>
+ *
+ * El resultado del parseo se guarda en una instantánea binaria junto al
+ * archivo (`~/.eafitosrc.cache`), identificada por el mtime, el tamaño y
+ * el inodo del rc. Los arranques siguientes solo proyectan la instantánea
+ * con mmap() y la validan (cabecera y CRC32C): los alias se buscan
+ * directamente en ella, con búsqueda binaria sobre la tabla ordenada, sin
+ * copiarlos ni volver a parsear el rc. Si el rc tiene errores no se guarda
+ * instantánea, para que los avisos se vean en cada arranque.
+ *
+ * Las variables del rc no se escriben en el entorno del proceso: son los
+ * valores iniciales de todas las sesiones, y cada sesión puede taparlos con
+ * el comando `export` sin afectar a las demás (ver variable_obtener()).
+ */
+
+#ifndef CONFIGURACION_H
+#define CONFIGURACION_H
+
+#include <stddef.h>
+#include "shell.h"
+
+/** @brief Variable de entorno con la ruta del rc (vacía: no cargar ninguno). */
+#define RC_ENV "EAFITOS_RC"
+
+/** @brief Nombre del rc dentro de $HOME. */
+#define RC_ARCHIVO ".eafitosrc"
+
+/** @brief Sufijo de la instantánea (se guarda junto al rc). */
+#define RC_SUFIJO_INSTANTANEA ".cache"
+
+/** @brief De dónde salió la configuración. */
+typedef enum {
+    RC_SIN_ARCHIVO = 0,     /**< No hay rc (o está desactivado) */
+    RC_DESDE_INSTANTANEA,   /**< Instantánea válida proyectada con mmap() */
+    RC_PARSEADO             /**< Se parseó el rc (y se guardó la instantánea si se pudo) */
+} OrigenConfiguracion;
+
+/**
+ * @brief Carga el rc al arrancar: define los alias y las variables
+ *        iniciales de las sesiones y cambia el prompt de 'sesion'.
+ *
+ * Debe llamarse antes de crear hilos (los alias del rc no se protegen con
+ * candados porque no cambian después).
+ *
+ * @param ruta Ruta del rc, o NULL para $EAFITOS_RC o ~/.eafitosrc.
+ * @param sesion Sesión que recibe el prompt, o NULL para ignorarlo.
+ */
+OrigenConfiguracion configuracion_cargar(const char *ruta, ContextoSesion *sesion);
+
+/**
+ * @brief Expande args[0] si es un alias (un solo nivel).
+ *
+ * @return Arreglo nuevo terminado en NULL con los tokens del alias seguidos
+ *         de args[1..]; todo va en un único bloque que se libera con free().
+ *         NULL si args[0] no es un alias (o no hubo memoria).
+ */
+char **alias_expandir(char *const *args);
+
+/** @brief 1 si 'nombre' es un alias. */
+int alias_existe(const char *nombre);
+
+/**
+ * @brief Define (o redefine) un alias en la sesión en curso.
+ *
+ * El alias vive en sesion_actual (no lo ven las demás sesiones del proceso)
+ * y se libera con ella en sesion_cerrar().
+ * @param tokens Comando y argumentos, terminados en NULL.
+ * @return 0 si se definió, -1 si no hubo memoria.
+ */
+int alias_definir(const char *nombre, char *const *tokens);
+
+/**
+ * @brief Copia los alias de sesión de 'origen' a 'destino' (trabajos de `paralelo`).
+ * @return 0, o -1 si no hubo memoria (lo copiado queda en 'destino').
+ */
+int alias_copiar(ContextoSesion *destino, const ContextoSesion *origen);
+
+/** @brief Libera los alias de sesión de 'sesion' (lo llama sesion_cerrar()). */
+void alias_liberar(ContextoSesion *sesion);
+
+/**
+ * @brief Valor de una variable en la sesión en curso.
+ *
+ * Busca en las variables de la sesión (`export`), luego en las del rc y
+ * por último en el entorno del proceso.
+ *
+ * @return El valor (válido hasta que la sesión lo redefina), o NULL.
+ */
+const char *variable_obtener(const char *nombre);
+
+/**
+ * @brief Define (o redefine) una variable en la sesión en curso.
+ *
+ * Como los alias, la variable vive en sesion_actual: las demás sesiones del
+ * proceso no la ven.
+ * @return 0; -1 con errno EINVAL si el nombre no es válido o ENOMEM.
+ */
+int variable_definir(const char *nombre, const char *valor);
+
+/**
+ * @brief Copia las variables de sesión de 'origen' a 'destino' (trabajos de `paralelo`).
+ * @return 0, o -1 si no hubo memoria (lo copiado queda en 'destino').
+ */
+int variables_copiar(ContextoSesion *destino, const ContextoSesion *origen);
+
+/** @brief Libera las variables de sesión de 'sesion' (lo llama sesion_cerrar()). */
+void variables_liberar(ContextoSesion *sesion);
+
+/**
+ * @brief Entorno para un programa lanzado desde la sesión en curso: el del
+ *        proceso con las variables del rc y las de la sesión encima.
+ *
+ * Se arma antes de fork(): en el hijo de un proceso con hilos no se puede
+ * reservar memoria.
+ *
+ * @return Arreglo terminado en NULL, en un único bloque que se libera con
+ *         free(); NULL si no hubo memoria.
+ */
+char **variables_entorno(void);
+
+/**
+ * @brief Recorre las variables del rc y de la sesión (las de la sesión
+ *        tapan a las del rc), cada nombre una sola vez.
+ */
+void variables_recorrer(void (*fn)(const char *nombre, const char *valor, void *usuario),
+                        void *usuario);
+
+/**
+ * @brief Recorre los alias en orden alfabético.
+ *
+ * 'tokens' son 'n' cadenas consecutivas, cada una terminada en '\0'.
+ */
+void alias_recorrer(void (*fn)(const char *nombre, const char *tokens, size_t n, void *usuario),
+                    void *usuario);
+
+#endif /* CONFIGURACION_H */
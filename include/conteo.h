@@ -0,0 +1,43 @@
+/**
+ * @file conteo.h
+ * @brief Conteo de líneas, palabras y bytes con instrucciones SIMD.
+ *
+ * Base del comando `contar`. Procesa 64 bytes por iteración con SSE2
+ * (o AVX2 si la CPU lo soporta): compara todos los bytes a la vez contra
+ * '\n' y los espacios en blanco, y cuenta bits con popcount.
+ */
+
+#ifndef CONTEO_H
+#define CONTEO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Resultado de un conteo (se pueden sumar bloques independientes). */
+typedef struct {
+    uint64_t lineas;    /**< Número de '\n' */
+    uint64_t palabras;  /**< Secuencias de caracteres que no son espacio */
+    uint64_t bytes;     /**< Bytes procesados */
+} Conteo;
+
+/**
+ * @brief Cuenta líneas, palabras y bytes de un bloque y los suma a 'c'.
+ *
+ * Un bloque puede ser un trozo de un archivo más grande: 'previo_espacio'
+ * indica si el byte anterior al bloque era un espacio (o si es el inicio),
+ * para no contar dos veces una palabra partida entre bloques.
+ *
+ * @param datos Bytes a contar.
+ * @param n Número de bytes.
+ * @param previo_espacio 1 si el byte anterior es espacio o no existe.
+ * @param c Acumulador donde se suman los resultados.
+ * @return 1 si el último byte del bloque es espacio (para el bloque siguiente).
+ */
+int contar_bloque(const unsigned char *datos, size_t n, int previo_espacio, Conteo *c);
+
+/** @brief Indica si un byte es espacio en blanco (como isspace() en locale "C"). */
+static inline int es_espacio(unsigned char b) {
+    return b == ' ' || (b >= '\t' && b <= '\r');
+}
+
+#endif /* CONTEO_H */
@@ -0,0 +1,58 @@
+/**
+ * @file diferencias.h
+ * @brief Diferencias entre dos textos en formato unificado (base de `comparar`).
+ *
+ * Pasos:
+ *  1. Se descartan el prefijo y el sufijo comunes comparando bytes con
+ *     memcmp() por bloques, sin partir en líneas (lo que cuesta un archivo
+ *     casi igual es leerlo una vez).
+ *  2. La parte central se recorre por ventanas de unas 16 mil líneas de
+ *     cada lado. Antes de cada ventana se saltan con memcmp() las líneas
+ *     iguales; las de la ventana se hashean con XXH64 y se numeran con una
+ *     tabla hash (dos líneas iguales reciben el mismo número), así el
+ *     algoritmo compara enteros de 32 bits y nunca vuelve a los bytes.
+ *  3. Las líneas que no aparecen en el otro lado son cambios seguros; las
+ *     demás pasan por Myers en espacio lineal (la "serpiente del medio",
+ *     avanzando desde los dos extremos y dividiendo el problema en dos).
+ *  4. Se confirman los cambios hasta la última línea única (una sola vez en
+ *     cada lado) que coincide, y desde ahí sigue la ventana siguiente. Si
+ *     no hay ninguna, la ventana crece hasta un millón de líneas.
+ *
+ * La memoria depende del tamaño de la ventana (decenas de bytes por línea
+ * de la ventana y por línea distinta), no de los archivos ni de la
+ * distancia entre la primera y la última diferencia. El parche siempre es
+ * correcto; solo con bloques insertados o borrados de más de un millón de
+ * líneas puede no ser el más corto.
+ */
+
+#ifndef DIFERENCIAS_H
+#define DIFERENCIAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** @brief Líneas de contexto alrededor de cada cambio (como `diff -u`). */
+#define DIFERENCIAS_CONTEXTO 3
+
+/** @brief Totales de una comparación. */
+typedef struct {
+    uint64_t borradas;    /**< Líneas solo en el primer texto */
+    uint64_t agregadas;   /**< Líneas solo en el segundo texto */
+    uint64_t bloques;     /**< Bloques `@@ ... @@` escritos */
+} ResumenDiferencias;
+
+/**
+ * @brief Escribe en 'salida' las diferencias de 'a' a 'b' en formato unificado.
+ *
+ * @param nombre_a, nombre_b Nombres para las cabeceras `---` y `+++`.
+ * @param salida Destino, o NULL para calcular solo el resumen.
+ * @param color 1 = colorear las líneas (terminal), 0 = texto plano (parche).
+ * @return 0 si son iguales, 1 si difieren, -1 con errno (ENOMEM, ECANCELED
+ *         con Ctrl+C o por `limite`).
+ */
+int diferencias_unificadas(const unsigned char *a, size_t na, const char *nombre_a,
+                           const unsigned char *b, size_t nb, const char *nombre_b,
+                           int contexto, FILE *salida, int color, ResumenDiferencias *r);
+
+#endif /* DIFERENCIAS_H */
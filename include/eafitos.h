@@ -0,0 +1,56 @@
+/**
+ * @file eafitos.h
+ * @brief API pública de libeafitos: la shell como biblioteca embebible.
+ *
+ * Permite ejecutar los comandos de EAFITos dentro de otro programa sin
+ * lanzar un proceso por petición. Cada contexto es una sesión
+ * independiente (prompt, estado de 'salir', ...).
+ *
+ * Reglas de uso entre hilos:
+ *  - Se pueden crear tantos contextos como se quiera y usarlos desde
+ *    hilos distintos al mismo tiempo.
+ *  - Un mismo contexto no debe usarse desde dos hilos a la vez.
+ *
+ * @code
+ * eafitos_ctx *ctx = eafitos_create();
+ * eafitos_exec(ctx, "calc 2 * 21", STDOUT_FILENO);
+ * eafitos_destroy(ctx);
+ * @endcode
+ *
+ * Compilar con: make lib  (genera build/libeafitos.a y build/libeafitos.so)
+ */
+
+#ifndef EAFITOS_H
+#define EAFITOS_H
+
+/** @brief Contexto opaco de una sesión (es un ContextoSesion, ver shell.h). */
+typedef struct ContextoSesion eafitos_ctx;
+
+/**
+ * @brief Crea una sesión nueva con los valores por defecto.
+ * @return El contexto, o NULL si no hubo memoria.
+ */
+eafitos_ctx *eafitos_create(void);
+
+/**
+ * @brief Ejecuta una línea de comandos en la sesión indicada.
+ *
+ * La salida del comando y sus mensajes de error se escriben en out_fd
+ * (que no se cierra), salvo que la línea los redirija con `2>`. Los
+ * comandos que piden confirmación leen EOF y cancelan la operación.
+ *
+ * @param ctx Sesión creada con eafitos_create().
+ * @param linea Línea a ejecutar (p. ej. "buscar hola notas.txt").
+ * @param out_fd Descriptor donde escribir la salida.
+ * @return 0 si la sesión sigue activa, 1 si la línea ejecutó 'salir',
+ *         -1 si hubo un error (argumentos inválidos o sin memoria).
+ */
+int eafitos_exec(eafitos_ctx *ctx, const char *linea, int out_fd);
+
+/**
+ * @brief Libera una sesión creada con eafitos_create().
+ * @param ctx Contexto a liberar (puede ser NULL).
+ */
+void eafitos_destroy(eafitos_ctx *ctx);
+
+#endif /* EAFITOS_H */
@@ -0,0 +1,72 @@
+/**
+ * @file expresion.h
+ * @brief Expresiones regulares con DFA perezoso (base de `buscar -e`).
+ *
+ * El patrón se compila a un NFA de Thompson y los estados del DFA se
+ * construyen solo cuando la entrada los necesita, guardándolos en una caché
+ * de tamaño acotado (si se llena, se vacía y se sigue). Cada byte de la
+ * entrada cuesta una consulta a la tabla de transiciones, así que el tiempo
+ * es lineal en la entrada: no hay retroceso y ningún patrón puede provocar
+ * tiempos exponenciales.
+ *
+ * Sintaxis (similar a ERE de POSIX): literales, `.`, `[...]` y `[^...]`
+ * con rangos, `*`, `+`, `?`, `{m}`, `{m,}`, `{m,n}`, `|`, `(...)`, `^`, `$`
+ * y los escapes `\d \D \w \W \s \S \t \n`.
+ *
+ * Además se extrae el literal más largo que toda coincidencia debe
+ * contener; las líneas que no lo contienen se descartan con
+ * buscar_subcadena() (SIMD) sin pasar por el DFA.
+ */
+
+#ifndef EXPRESION_H
+#define EXPRESION_H
+
+#include <stddef.h>
+
+/** @brief Expresión compilada (opaca). No es segura entre hilos. */
+typedef struct Expresion Expresion;
+
+/** @brief Patrones compilados de una sesión (ver expresion_de_cache()). */
+typedef struct CacheExpresiones CacheExpresiones;
+
+/**
+ * @brief Compila un patrón.
+ * @param patron Expresión regular.
+ * @param error Recibe el motivo si el patrón no es válido.
+ * @param tam_error Tamaño de 'error'.
+ * @return La expresión, o NULL si el patrón no es válido o no hubo memoria.
+ */
+Expresion *expresion_compilar(const char *patron, char *error, size_t tam_error);
+
+/**
+ * @brief Indica si la expresión aparece en una línea (sin '\n').
+ * @return 1 si hay coincidencia, 0 si no.
+ */
+int expresion_coincide(Expresion *re, const char *linea, size_t n);
+
+/**
+ * @brief Literal que toda coincidencia contiene.
+ * @param len Recibe su longitud (0 si no hay ninguno).
+ * @return El literal (no terminado en '\0'), o NULL.
+ */
+const char *expresion_literal(const Expresion *re, size_t *len);
+
+/** @brief Libera una expresión compilada. */
+void expresion_liberar(Expresion *re);
+
+/**
+ * @brief Devuelve el patrón compilado, reutilizando el de la caché si ya se usó.
+ *
+ * La expresión devuelta (con los estados del DFA que ya construyó)
+ * pertenece a la caché: no se debe liberar.
+ *
+ * @param cache Caché de la sesión (se crea en el primer uso).
+ * @return La expresión, o NULL con el motivo en 'error'.
+ */
+Expresion *expresion_de_cache(CacheExpresiones **cache, const char *patron,
+                              char *error, size_t tam_error);
+
+/** @brief Libera la caché y todas sus expresiones. */
+void expresion_cache_liberar(CacheExpresiones *cache);
+
+#endif /* EXPRESION_H */
@@ -0,0 +1,127 @@
+/**
+ * @file formato.h
+ * @brief Salida estructurada (JSON / TSV) de los comandos.
+ *
+ * Con `--formato json|tsv` (al iniciar la shell o en cualquier comando)
+ * los comandos no dibujan cajas, colores ni iconos: emiten registros, uno
+ * por línea, a través de este serializador.
+ *
+ *  - json: un objeto compacto por línea (JSON Lines).
+ *  - tsv:  valores separados por tabuladores; antes del primer registro,
+ *          y cada vez que cambian las claves, una línea con los nombres.
+ *          La barra invertida, el tabulador y los saltos de línea de los
+ *          valores se escriben como \\, \t, \n y \r.
+ *
+ * Los comandos que producen datos (listar, leer, buscar, contar, calc,
+ * tiempo, uso, checksum) arman sus registros con registro_abrir() /
+ * registro_*() / registro_cerrar(). Para el resto, el despachador cambia
+ * la salida de la sesión por un flujo que convierte cada línea de texto en
+ * un registro {"mensaje": ...} (o "error", "aviso", "uso" según su
+ * etiqueta), sin secuencias ANSI ni caracteres de dibujo.
+ */
+
+#ifndef FORMATO_H
+#define FORMATO_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/** @brief Formatos de salida de una sesión. */
+typedef enum {
+    FORMATO_TEXTO = 0,   /**< Texto con colores (por defecto) */
+    FORMATO_JSON,        /**< JSON Lines */
+    FORMATO_TSV          /**< Valores separados por tabuladores */
+} FormatoSalida;
+
+/**
+ * @brief Traduce "texto", "json" o "tsv".
+ * @return El formato, o -1 si el nombre no es válido.
+ */
+int formato_desde_nombre(const char *nombre);
+
+/**
+ * @brief Formato de las sesiones nuevas y de la sesión actual (`--formato`
+ *        al iniciar la shell).
+ */
+void formato_establecer_global(FormatoSalida f);
+
+/** @brief Formato con el que empiezan las sesiones nuevas. */
+FormatoSalida formato_global(void);
+
+/** @brief 1 si la sesión actual emite registros en lugar de texto. */
+int formato_estructurado(void);
+
+/**
+ * @brief Quita de 'args' la opción `--formato X` (o `--formato=X`).
+ *
+ * @param args Tokens de parsear_linea(); se compactan en el lugar.
+ * @return El formato pedido, -1 si no había opción, -2 (con un mensaje)
+ *         si el valor falta o no es válido.
+ */
+int formato_separar_opcion(char **args);
+
+/**
+ * @brief Prepara la salida de un comando en modo estructurado.
+ *
+ * Cambia la salida de la sesión por un flujo que convierte el texto en
+ * registros; los registros se escriben en la salida anterior. Los errores
+ * de la sesión se convierten igual y siguen yendo a su propio stream. Si
+ * la salida ya es uno de estos flujos (un comando que ejecuta otro), no
+ * hace nada.
+ *
+ * @return El flujo a cerrar con formato_terminar_comando(), o NULL.
+ */
+FILE *formato_comenzar_comando(void);
+
+/**
+ * @brief Cierra el flujo de formato_comenzar_comando() y restaura la salida
+ *        y los errores.
+ * @param mensajes Valor devuelto por formato_comenzar_comando() (NULL: nada).
+ */
+void formato_terminar_comando(FILE *mensajes);
+
+/**
+ * @brief Stream donde se escriben los registros (la salida real).
+ *
+ * Sirve para reenviar registros ya serializados (p. ej. los de los
+ * trabajos de `paralelo`) sin que se conviertan otra vez en mensajes.
+ */
+FILE *formato_destino(void);
+
+/**
+ * @brief TSV: escribir la cabecera antes de cada registro (no solo cuando
+ *        cambia), para que la salida se pueda reenviar con formato_reenviar().
+ *
+ * Lo usa trabajo_ejecutar(): cada trabajo de `paralelo` se serializa por
+ * separado y al unirlos hay que comparar con la cabecera ya escrita.
+ */
+void formato_cabeceras_repetidas(int activar);
+
+/**
+ * @brief Escribe en formato_destino() registros ya serializados en otro hilo.
+ *
+ * En JSON se copian tal cual; en TSV se esperan pares cabecera/valores
+ * (ver formato_cabeceras_repetidas()) y solo se escriben las cabeceras
+ * que cambian.
+ */
+void formato_reenviar(const char *datos, size_t len);
+
+/** @brief Empieza un registro. */
+void registro_abrir(void);
+
+/** @brief Añade un campo de texto. */
+void registro_texto(const char *clave, const char *valor);
+
+/** @brief Añade un campo de texto de 'len' bytes (puede no terminar en '\0'). */
+void registro_texto_n(const char *clave, const char *valor, size_t len);
+
+/** @brief Añade un campo entero. */
+void registro_entero(const char *clave, long long valor);
+
+/** @brief Añade un campo real (null en JSON si no es finito). */
+void registro_real(const char *clave, double valor);
+
+/** @brief Termina el registro y lo escribe en formato_destino(). */
+void registro_cerrar(void);
+
+#endif /* FORMATO_H */
@@ -0,0 +1,59 @@
+/**
+ * @file grabacion.h
+ * @brief Grabación de sesiones (`--grabar`) y su reproducción (`--reproducir`).
+ *
+ * Al grabar, cada línea que ejecuta la sesión interactiva queda en el
+ * archivo con el instante en que se leyó, lo que tardó, lo que el comando
+ * leyó como respuesta (confirmaciones s/n) y el XXH64 y el tamaño de su
+ * salida (con sus mensajes de error). Al reproducir, las líneas se ejecutan en una sesión nueva sin
+ * mostrar su salida (solo se calcula su XXH64) y se compara con lo grabado:
+ * sirve como carga reproducible y como prueba de regresión.
+ *
+ * Formato (texto, una línea por comando; '\\', '\\t', '\\n' y '\\r'
+ * escapados dentro de los campos):
+ *
+ *     # eafitos-grabacion 1 <formato de la sesión>
+ *     <t_ns>\t<duracion_ns>\t<xxh64>\t<bytes>\t<linea>\t<entrada>
+ */
+
+#ifndef GRABACION_H
+#define GRABACION_H
+
+/** @brief Primera línea de todo archivo de grabación. */
+#define GRABACION_CABECERA "# eafitos-grabacion 1"
+
+/** @brief Diferencias que se detallan al reproducir (el resto solo se cuenta). */
+#define GRABACION_MAX_DIFERENCIAS 10
+
+/**
+ * @brief Empieza a grabar la sesión interactiva en 'ruta' (la trunca).
+ * @return 0 si se abrió el archivo, -1 (con errno) si no.
+ */
+int grabacion_iniciar(const char *ruta);
+
+/**
+ * @brief Antes de ejecutar una línea: la guarda y empieza a capturar la
+ *        salida y la entrada de la sesión actual. No hace nada si no se
+ *        está grabando.
+ *
+ * Se llama antes de parsear, porque el parser modifica la línea.
+ */
+void grabacion_comenzar_linea(const char *linea);
+
+/** @brief Después de ejecutar la línea: escribe su registro. */
+void grabacion_terminar_linea(void);
+
+/** @brief Termina la grabación y cierra el archivo. */
+void grabacion_cerrar(void);
+
+/**
+ * @brief Reproduce una grabación en una sesión nueva e informa el resultado.
+ *
+ * @param ruta Archivo producido con --grabar.
+ * @param al_ritmo 1 = respetar los tiempos grabados; 0 = lo más rápido posible.
+ * @return 0 si todas las salidas coinciden, 1 si alguna difiere, 2 si la
+ *         grabación no se pudo leer.
+ */
+int grabacion_reproducir(const char *ruta, int al_ritmo);
+
+#endif /* GRABACION_H */
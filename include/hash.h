@@ -0,0 +1,62 @@
+/**
+ * @file hash.h
+ * @brief Sumas de verificación rápidas (no criptográficas): CRC32C y XXH64.
+ *
+ * Base del comando `checksum`.
+ *  - CRC32C (polinomio Castagnoli) usa la instrucción crc32 de SSE4.2 si la
+ *    CPU la tiene, y una tabla "slicing-by-8" si no.
+ *  - XXH64 es el hash de 64 bits de xxHash, limitado por el ancho de banda
+ *    de memoria incluso sin SIMD.
+ *
+ * Ambos se pueden calcular por partes con un estado incremental, y los CRC
+ * de trozos independientes se pueden combinar (crc32c_combinar), lo que
+ * permite repartir un archivo grande entre varios hilos.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Actualiza un CRC32C con más datos.
+ *
+ * Se empieza con crc = 0 y se encadenan las llamadas:
+ * crc32c(crc32c(0, a, na), b, nb) == crc32c(0, a||b, na+nb).
+ */
+uint32_t crc32c(uint32_t crc, const void *datos, size_t n);
+
+/**
+ * @brief Combina CRC32C(A) y CRC32C(B) en CRC32C(A||B) sin releer A ni B.
+ * @param crc_a CRC del primer trozo.
+ * @param crc_b CRC del segundo trozo.
+ * @param long_b Longitud en bytes del segundo trozo.
+ */
+uint32_t crc32c_combinar(uint32_t crc_a, uint32_t crc_b, uint64_t long_b);
+
+/** @brief Indica si crc32c() usa la instrucción de hardware (SSE4.2). */
+int crc32c_usa_hardware(void);
+
+/** @brief Estado incremental de XXH64. */
+typedef struct {
+    uint64_t total;          /**< Bytes procesados */
+    uint64_t v[4];           /**< Acumuladores de las 4 franjas */
+    unsigned char resto[32]; /**< Bytes pendientes de un bloque incompleto */
+    size_t n_resto;          /**< Bytes válidos en resto */
+    uint64_t semilla;
+} EstadoXXH64;
+
+/** @brief Inicia un estado XXH64 con la semilla indicada. */
+void xxh64_iniciar(EstadoXXH64 *e, uint64_t semilla);
+
+/** @brief Añade datos al estado. */
+void xxh64_actualizar(EstadoXXH64 *e, const void *datos, size_t n);
+
+/** @brief Devuelve el hash de todo lo añadido (no modifica el estado). */
+uint64_t xxh64_final(const EstadoXXH64 *e);
+
+/** @brief XXH64 de un bloque completo en una sola llamada. */
+uint64_t xxh64(const void *datos, size_t n, uint64_t semilla);
+
+#endif /* HASH_H */
@@ -29,6 +29,12 @@ extern CommandHelp tabla_ayuda[];
 /** @brief Número de entradas en la tabla (calculado en help.c). */
 extern int num_ayudas;
 
+/**
+ * @brief Imprime una entrada de ayuda con el formato estándar de la shell.
+ * @param h Entrada a mostrar (de tabla_ayuda[] o de un plugin).
+ */
+void imprimir_ayuda(const CommandHelp *h);
+
 /**
  * @brief Busca y muestra la ayuda detallada de un comando específico.
  * @param nombre Nombre del comando a buscar.
@@ -0,0 +1,84 @@
+/**
+ * @file hilos.h
+ * @brief Ejecución de tareas en paralelo sobre todos los núcleos.
+ *
+ * Reparte n tareas independientes entre un grupo de hilos. Cada hilo toma
+ * la siguiente tarea libre de un contador atómico, de modo que las tareas
+ * lentas no dejan núcleos ociosos.
+ */
+
+#ifndef HILOS_H
+#define HILOS_H
+
+#include <stddef.h>
+
+/**
+ * @brief Función que ejecuta la tarea número 'indice'.
+ * @param indice Tarea a ejecutar (0 <= indice < n_tareas).
+ * @param datos Puntero compartido pasado a ejecutar_en_paralelo().
+ */
+typedef void (*FuncionTarea)(size_t indice, void *datos);
+
+/**
+ * @brief Número de hilos a usar por defecto (núcleos en línea, mínimo 1).
+ *
+ * Se puede limitar con la variable de entorno EAFITOS_HILOS.
+ */
+int hilos_disponibles(void);
+
+/**
+ * @brief Ejecuta fn(0..n_tareas-1) repartido entre varios hilos.
+ *
+ * El hilo que llama también trabaja. Retorna cuando todas las tareas
+ * terminaron. Las tareas no deben imprimir: cada una deja su resultado en
+ * 'datos' y el llamador lo muestra al final, en orden.
+ *
+ * @param n_tareas Número de tareas.
+ * @param max_hilos Hilos a usar (<= 0: hilos_disponibles()).
+ * @param fn Función de cada tarea.
+ * @param datos Puntero compartido entre todas las tareas.
+ */
+void ejecutar_en_paralelo(size_t n_tareas, int max_hilos, FuncionTarea fn, void *datos);
+
+/* =============================================================================
+ * Grupo con robo de trabajo (tareas que generan más tareas)
+ * ========================================================================== */
+
+/** @brief Grupo de hilos con una cola por hilo (opaco). */
+typedef struct GrupoRobo GrupoRobo;
+
+/**
+ * @brief Función que procesa una tarea; puede encolar más con grupo_encolar().
+ * @param tarea Puntero a la tarea (lo que se pasó a grupo_encolar).
+ * @param grupo Grupo al que pertenece, para encolar subtareas.
+ * @param datos Puntero compartido pasado a ejecutar_con_robo().
+ */
+typedef void (*FuncionRobo)(void *tarea, GrupoRobo *grupo, void *datos);
+
+/**
+ * @brief Ejecuta tareas que pueden generar otras, hasta que no quede ninguna.
+ *
+ * Pensado para recorridos de árboles (p. ej. directorios) cuyo tamaño no se
+ * conoce de antemano. Cada hilo toma primero las tareas más recientes de su
+ * propia cola (recorrido en profundidad, buena localidad) y, cuando se le
+ * acaban, roba las más antiguas de la cola de otro hilo (que suelen ser los
+ * subárboles más grandes).
+ *
+ * @param iniciales Tareas con las que se empieza.
+ * @param n Número de tareas iniciales.
+ * @param max_hilos Hilos a usar (<= 0: hilos_disponibles()).
+ * @param fn Función de cada tarea.
+ * @param datos Puntero compartido entre todas las tareas.
+ */
+void ejecutar_con_robo(void *const *iniciales, size_t n, int max_hilos,
+                       FuncionRobo fn, void *datos);
+
+/**
+ * @brief Encola una nueva tarea en la cola del hilo que la genera.
+ *
+ * Solo se debe llamar desde una FuncionRobo del mismo grupo.
+ * @return 0 si se encoló, -1 si no hubo memoria.
+ */
+int grupo_encolar(GrupoRobo *grupo, void *tarea);
+
+#endif /* HILOS_H */
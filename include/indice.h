@@ -0,0 +1,89 @@
+/**
+ * @file indice.h
+ * @brief Índice de trigramas en disco para acelerar `buscar`.
+ *
+ * `indexar <dir>` guarda en <dir>/.eafitos_indice, para cada secuencia de
+ * 3 bytes (trigrama) presente en los archivos del árbol, la lista de
+ * archivos que la contienen. Un texto de 3 o más bytes solo puede estar en
+ * los archivos que contienen TODOS sus trigramas, así que `buscar` lee
+ * solo esos candidatos en lugar de todo el árbol.
+ *
+ * Formato (little-endian, pensado para mmap()):
+ *   Cabecera | Archivos[n] | Trigramas[m] | Listas | Nombres
+ *  - Archivos: tamaño, mtime y nombre (relativo a <dir>), ordenados por nombre.
+ *  - Trigramas: ordenados, cada uno con el desplazamiento de su lista.
+ *  - Listas: números de archivo crecientes, guardados como diferencias con
+ *    el anterior en varint (1 byte para diferencias < 128).
+ *
+ * Reindexar solo vuelve a leer los archivos cuyo tamaño o mtime cambió;
+ * los demás recuperan sus trigramas del índice anterior.
+ */
+
+#ifndef INDICE_H
+#define INDICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Nombre del archivo de índice dentro del directorio indexado. */
+#define INDICE_NOMBRE ".eafitos_indice"
+
+/** @brief Índice abierto (mapeado en memoria). */
+typedef struct Indice Indice;
+
+/** @brief Resumen de una construcción del índice. */
+typedef struct {
+    size_t archivos;      /**< Archivos en el índice nuevo */
+    size_t reutilizados;  /**< Sin cambios: trigramas tomados del índice anterior */
+    size_t escaneados;    /**< Nuevos o modificados: leídos de disco */
+    size_t eliminados;    /**< Estaban en el índice anterior y ya no existen */
+    size_t trigramas;     /**< Trigramas distintos */
+    uint64_t bytes;       /**< Tamaño del archivo de índice */
+} ResumenIndice;
+
+/**
+ * @brief Crea o actualiza el índice de un directorio.
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param dir Directorio a indexar (recursivamente).
+ * @param resumen Si no es NULL, recibe las estadísticas.
+ * @return 0 si se escribió el índice, -1 con errno si hubo un error
+ *         (ECANCELED con Ctrl+C: el índice anterior queda intacto).
+ */
+int indice_construir(int dir_fd, const char *dir, ResumenIndice *resumen);
+
+/**
+ * @brief Abre el índice de un directorio, si existe y es válido.
+ * @return El índice, o NULL si no hay índice (o está dañado).
+ */
+Indice *indice_abrir(int dir_fd, const char *dir);
+
+/** @brief Libera un índice abierto. */
+void indice_cerrar(Indice *ix);
+
+/** @brief Número de archivos del índice. */
+size_t indice_n_archivos(const Indice *ix);
+
+/**
+ * @brief Busca un archivo por su ruta relativa al directorio indexado.
+ * @return Su número en el índice, o -1 si no está.
+ */
+long indice_buscar_archivo(const Indice *ix, const char *relativa);
+
+/**
+ * @brief Indica si el archivo no cambió desde que se indexó.
+ * @return 1 si el tamaño y el mtime coinciden, 0 si no.
+ */
+int indice_vigente(const Indice *ix, long archivo, uint64_t tam, int64_t mtime_ns);
+
+/**
+ * @brief Marca los archivos que pueden contener un texto.
+ *
+ * @param texto Texto buscado.
+ * @param len Longitud del texto (se necesitan al menos 3 bytes).
+ * @param marcas Arreglo de indice_n_archivos() bytes: 1 = candidato.
+ * @return 0 si se marcaron candidatos; -1 si el texto es demasiado corto
+ *         para filtrar (todos son candidatos).
+ */
+int indice_candidatos(const Indice *ix, const char *texto, size_t len, unsigned char *marcas);
+
+#endif /* INDICE_H */
@@ -0,0 +1,71 @@
+/**
+ * @file lectura_lotes.h
+ * @brief Lectura de muchos archivos en lotes (io_uring con respaldo POSIX).
+ *
+ * Cuando un comando recorre muchos archivos pequeños (p. ej. `leer a b c`
+ * o `buscar -r`), el costo dominante no es el ancho de banda sino las
+ * llamadas al sistema: open + read + close por archivo. Este módulo envía
+ * las aperturas, lecturas y cierres de hasta LOTE_MAX_ARCHIVOS archivos
+ * en unas pocas llamadas a io_uring_enter(), leyendo sobre buffers
+ * registrados en el kernel.
+ *
+ * Si io_uring no está disponible (kernel antiguo, seccomp, o la variable
+ * de entorno EAFITOS_SIN_IO_URING definida), se usa un bucle normal de
+ * openat/read/close con exactamente la misma interfaz.
+ */
+
+#ifndef LECTURA_LOTES_H
+#define LECTURA_LOTES_H
+
+#include <stddef.h>
+
+/** @brief Archivos que se abren y leen juntos en cada lote. */
+#define LOTE_MAX_ARCHIVOS 64
+
+/** @brief Tamaño del buffer registrado de cada archivo del lote. */
+#define LOTE_TAM_BUFFER (64 * 1024)
+
+/**
+ * @brief Un bloque de datos entregado al callback.
+ *
+ * Para cada archivo, en el orden en que se pidieron, el callback recibe
+ * cero o más bloques con fin == 0 y luego exactamente uno con fin == 1
+ * (que también puede traer datos). Si el archivo no se pudo abrir o leer,
+ * se recibe un único bloque con error != 0 y fin == 1.
+ */
+typedef struct {
+    size_t indice;       /**< Posición del archivo en el arreglo de rutas */
+    const char *ruta;    /**< Ruta tal como se pidió */
+    const char *datos;   /**< Datos leídos (válidos solo durante el callback) */
+    size_t longitud;     /**< Bytes en datos */
+    int error;           /**< 0, o el errno de la operación que falló */
+    int fin;             /**< 1 en la última llamada para este archivo */
+} BloqueArchivo;
+
+/**
+ * @brief Callback invocado por cada bloque leído.
+ * @return 0 para continuar, distinto de 0 para detener toda la lectura.
+ */
+typedef int (*FuncionBloque)(const BloqueArchivo *bloque, void *usuario);
+
+/**
+ * @brief Lee una lista de archivos y entrega su contenido por bloques.
+ *
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param rutas Arreglo de rutas a leer.
+ * @param n Número de rutas.
+ * @param fn Callback para cada bloque (se llama en orden de archivo).
+ * @param usuario Puntero que se pasa tal cual al callback.
+ * @return 0 si se recorrieron todos los archivos, 1 si el callback detuvo
+ *         la lectura o se pidió cancelar (ver cancelacion.h).
+ */
+int leer_archivos_en_lote(int dir_fd, const char *const *rutas, size_t n,
+                          FuncionBloque fn, void *usuario);
+
+/**
+ * @brief Indica si este proceso puede usar io_uring.
+ * @return 1 si el backend io_uring está disponible, 0 si se usa el respaldo.
+ */
+int lectura_lotes_usa_io_uring(void);
+
+#endif /* LECTURA_LOTES_H */
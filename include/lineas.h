@@ -0,0 +1,50 @@
+/**
+ * @file lineas.h
+ * @brief Primeras y últimas líneas de un archivo (base de `leer -n/-t/-f`).
+ *
+ * Las últimas N líneas se localizan leyendo el archivo hacia atrás desde
+ * el final en bloques de LINEAS_BLOQUE bytes, así que el costo depende del
+ * tamaño de esas líneas y no del archivo: mostrar el final de un registro
+ * de muchos GB solo lee unos pocos KB.
+ */
+
+#ifndef LINEAS_H
+#define LINEAS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/** @brief Tamaño de cada lectura (bytes). */
+#define LINEAS_BLOQUE 65536
+
+/**
+ * @brief Busca dónde empiezan las últimas 'n' líneas de un archivo regular.
+ *
+ * Un '\n' final no cuenta como una línea vacía más.
+ *
+ * @param fd Descriptor abierto para lectura (se usa pread, no se mueve).
+ * @param tam Tamaño del archivo.
+ * @param n Número de líneas.
+ * @return Desplazamiento de la primera de esas líneas (0 si el archivo
+ *         tiene 'n' líneas o menos), o -1 con errno si falló una lectura.
+ */
+off_t lineas_desde_final(int fd, off_t tam, uint64_t n);
+
+/**
+ * @brief Copia las primeras 'n' líneas de un descriptor en 'salida'.
+ *
+ * Deja de leer en cuanto encuentra el n-ésimo '\n'. Sirve también para
+ * tuberías y otros descriptores sin posición.
+ *
+ * @return 0 si todo salió bien, -1 con errno si falló una lectura.
+ */
+int lineas_copiar_primeras(int fd, uint64_t n, FILE *salida);
+
+/**
+ * @brief Copia desde el desplazamiento 'desde' hasta el final actual.
+ * @return El desplazamiento donde terminó (el nuevo final), o -1 con errno.
+ */
+off_t lineas_copiar_desde(int fd, off_t desde, FILE *salida);
+
+#endif /* LINEAS_H */
@@ -0,0 +1,64 @@
+/**
+ * @file medicion.h
+ * @brief Tiempo, recursos y contadores de hardware de un comando (`medir`).
+ *
+ * medicion_comenzar() toma el reloj monotónico y getrusage() y abre tres
+ * contadores con perf_event_open (ciclos, instrucciones y fallos de caché)
+ * para el hilo que llama, heredables por los hilos y procesos que cree
+ * mientras dura la medición; así se cuentan también los hilos de trabajo
+ * de un comando paralelo y el programa externo que se lance. Los
+ * contadores se limitan al espacio de usuario, lo que permite usarlos sin
+ * privilegios con perf_event_paranoid <= 2. Si el sistema no los permite
+ * (contenedores, paranoid 3), la medición sigue sin ellos.
+ */
+
+#ifndef MEDICION_H
+#define MEDICION_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+
+/** @brief Contadores de hardware que se intentan abrir. */
+#define MEDICION_CONTADORES 3
+
+/** @brief Resultado de una medición. */
+typedef struct {
+    double real;                 /**< Tiempo transcurrido (s) */
+    double usuario;              /**< Tiempo de CPU en modo usuario (s) */
+    double sistema;              /**< Tiempo de CPU en el kernel (s) */
+    long rss_max_kb;             /**< Memoria residente máxima (KB); -1 = no disponible */
+    int memoria_del_proceso;     /**< 1 si rss_max_kb es el pico de toda la shell */
+    long fallos_menores;         /**< Fallos de página sin E/S */
+    long fallos_mayores;         /**< Fallos de página con E/S */
+    long cambios_voluntarios;    /**< Cambios de contexto al bloquearse */
+    long cambios_involuntarios;  /**< Cambios de contexto por expropiación */
+    int hay_contadores;          /**< 1 si los tres contadores son válidos */
+    uint64_t ciclos;
+    uint64_t instrucciones;
+    uint64_t fallos_cache;
+} Medicion;
+
+/** @brief Estado entre medicion_comenzar() y medicion_terminar(). */
+typedef struct {
+    struct timespec inicio;
+    struct rusage uso;
+    int fds[MEDICION_CONTADORES];   /**< -1 si el contador no se pudo abrir */
+} Cronometro;
+
+/** @brief Empieza a medir (abre y activa los contadores). */
+void medicion_comenzar(Cronometro *c);
+
+/**
+ * @brief Termina la medición y cierra los contadores.
+ *
+ * @param hijo Recursos de un programa externo (de wait4()), o NULL para
+ *             usar la diferencia de getrusage(RUSAGE_SELF): todo el
+ *             proceso, porque los comandos paralelos usan varios hilos.
+ *             La memoria máxima es entonces la del proceso, no un
+ *             delta, y se marca con memoria_del_proceso.
+ * @param m Recibe el resultado.
+ */
+void medicion_terminar(Cronometro *c, const struct rusage *hijo, Medicion *m);
+
+#endif /* MEDICION_H */
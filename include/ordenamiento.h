@@ -0,0 +1,66 @@
+/**
+ * @file ordenamiento.h
+ * @brief Ordenamiento externo de líneas con memoria acotada (base de `ordenar`).
+ *
+ * Las líneas se leen en un único bloque de memoria del tamaño indicado.
+ * Cuando se llena, el bloque se ordena en paralelo (un trozo por hilo) y se
+ * escribe como una "corrida" ordenada en un archivo temporal. Al final las
+ * corridas se mezclan con un árbol de perdedores: cada línea de salida
+ * cuesta log2(k) comparaciones entre k corridas. Si hay más corridas de las
+ * que se pueden mezclar a la vez, se mezclan por grupos en varias pasadas.
+ *
+ * La memoria usada no depende del tamaño de la entrada, solo del
+ * presupuesto (y de la línea más larga).
+ */
+
+#ifndef ORDENAMIENTO_H
+#define ORDENAMIENTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** @brief Presupuesto de memoria por defecto (MB). */
+#define ORDEN_MEMORIA_MB 64
+
+/** @brief Opciones de ordenamiento. */
+typedef struct {
+    int numerico;     /**< -n: compara el valor numérico de la clave */
+    int inverso;      /**< -r: orden descendente */
+    int unico;        /**< -u: una sola línea por clave */
+    int campo;        /**< -k: la clave empieza en este campo (1 = línea completa) */
+    size_t memoria;   /**< Presupuesto en bytes */
+} OpcionesOrden;
+
+/** @brief Estadísticas de una ejecución. */
+typedef struct {
+    uint64_t lineas;  /**< Líneas leídas */
+    size_t corridas;  /**< Corridas escritas a disco (0 si todo cupo en memoria) */
+    int pasadas;      /**< Pasadas de mezcla */
+} ResumenOrden;
+
+/**
+ * @brief Ordena las líneas de varios archivos.
+ *
+ * La salida se abre después de leer toda la entrada, así que puede ser uno
+ * de los archivos de entrada.
+ *
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param rutas Archivos de entrada.
+ * @param n Número de archivos.
+ * @param entrada Si n es 0, descriptor del que se leen las líneas (el `<`
+ *        de la shell); se lee hasta el final y no se cierra.
+ * @param op Opciones.
+ * @param ruta_salida Archivo de salida, o NULL para escribir en 'salida'.
+ * @param salida Stream de salida si ruta_salida es NULL.
+ * @param resumen Si no es NULL, recibe las estadísticas.
+ * @param ruta_error Si hay un error de un archivo, recibe su ruta.
+ * @return 0 si todo salió bien; -1 con errno si hubo un error
+ *         (E2BIG: una línea no cabe en el presupuesto de memoria;
+ *         ECANCELED: se pidió cancelar con Ctrl+C).
+ */
+int ordenar_archivos(int dir_fd, const char *const *rutas, size_t n, int entrada,
+                     const OpcionesOrden *op, const char *ruta_salida, FILE *salida,
+                     ResumenOrden *resumen, const char **ruta_error);
+
+#endif /* ORDENAMIENTO_H */
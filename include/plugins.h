@@ -0,0 +1,96 @@
+/**
+ * @file plugins.h
+ * @brief ABI de plugins de comandos para EAFITos.
+ *
+ * Un plugin es una biblioteca compartida (.so) que exporta una estructura
+ * PluginComando con la función del comando y su ayuda detallada.
+ *
+ * Los plugins se declaran en un índice de texto (`plugins.idx`) dentro del
+ * directorio de plugins. Al arrancar solo se lee ese índice; cada .so se
+ * carga con dlopen() la primera vez que su comando se ejecuta (o se pide su
+ * ayuda). Así el tiempo de arranque no crece con el número de plugins.
+ *
+ * Formato de cada línea del índice (los '#' inician comentarios):
+ *
+ *     <comando> <archivo.so> <simbolo> <descripción corta...>
+ *
+ * La ruta del .so es relativa al directorio del índice.
+ *
+ * Igual que los comandos internos, un plugin debe escribir a través de la
+ * sesión: imprimir() (o salida_sesion()) para la salida, imprimir_error()
+ * (o errores_sesion()) para los errores y el uso, y leer respuestas de
+ * entrada_sesion(). Con printf() o stdout directamente, la salida iría a
+ * la terminal del servidor en vez de al cliente y se escaparía de
+ * `paralelo`, de las redirecciones y de `--grabar`.
+ */
+
+#ifndef PLUGINS_H
+#define PLUGINS_H
+
+#include "help.h"
+
+/** @brief Versión actual del ABI. Un plugin con otra versión es rechazado. */
+#define EAFITOS_PLUGIN_ABI 1
+
+/** @brief Nombre del archivo de índice dentro del directorio de plugins. */
+#define PLUGINS_INDICE "plugins.idx"
+
+/** @brief Variable de entorno que permite cambiar el directorio de plugins. */
+#define PLUGINS_ENV_DIR "EAFITOS_PLUGINS"
+
+/**
+ * @brief Descriptor que cada plugin exporta bajo el símbolo del índice.
+ *
+ * Ejemplo dentro del plugin:
+ * @code
+ * const PluginComando plugin_saludo = {
+ *     EAFITOS_PLUGIN_ABI, "saludo", cmd_saludo,
+ *     { "saludo", "Saluda.", "saludo [nombre]", "saludo Ana", "Sin notas." }
+ * };
+ * @endcode
+ */
+typedef struct {
+    int abi;                       /**< Debe ser EAFITOS_PLUGIN_ABI */
+    const char *nombre;            /**< Nombre del comando (igual al del índice) */
+    void (*funcion)(char **args);  /**< Implementación, misma firma que cmd_* (escribe con imprimir()) */
+    CommandHelp ayuda;             /**< Ayuda detallada para 'ayuda <comando>' */
+} PluginComando;
+
+/**
+ * @brief Lee el índice de plugins (sin cargar ningún .so).
+ *
+ * Descarta antes el registro anterior (como plugins_liberar()), así que
+ * llamarla de nuevo relee el índice sin duplicar comandos.
+ *
+ * @param directorio Directorio del índice, o NULL para usar
+ *        $EAFITOS_PLUGINS o, en su defecto, ~/.eafitos/plugins.
+ * @return Número de plugins registrados (0 si no hay índice).
+ */
+int plugins_inicializar(const char *directorio);
+
+/**
+ * @brief Ejecuta un comando de plugin, cargándolo si es la primera vez.
+ * @param args Argumentos; args[0] es el nombre del comando.
+ * @return 1 si el comando pertenece a un plugin, 0 si no existe.
+ */
+int plugins_ejecutar(char **args);
+
+/**
+ * @brief Indica si un nombre corresponde a un plugin del índice (sin cargarlo).
+ * @return 1 si existe, 0 si no.
+ */
+int plugins_existe(const char *nombre);
+
+/**
+ * @brief Muestra la ayuda detallada de un comando de plugin.
+ * @return 1 si fue encontrado, 0 si no existe.
+ */
+int plugins_mostrar_ayuda(const char *nombre);
+
+/** @brief Imprime la sección de plugins de la ayuda general (si hay alguno). */
+void plugins_listar(void);
+
+/** @brief Descarga los plugins cargados y libera el índice. */
+void plugins_liberar(void);
+
+#endif /* PLUGINS_H */
@@ -0,0 +1,47 @@
+/**
+ * @file reemplazo.h
+ * @brief Reemplazo de una cadena en un archivo con escritura atómica (base de `reemplazar`).
+ *
+ * El archivo se mapea y las apariciones se localizan con buscar_subcadena()
+ * (el mismo motor SIMD de `buscar`). Si no hay ninguna, el archivo no se
+ * toca. Si las hay, el resultado se escribe con writev() directamente desde
+ * el mapa (los tramos sin cambios no se copian) a un temporal en el mismo
+ * directorio, que se sincroniza con fdatasync() y sustituye al original con
+ * rename(): quien lea el archivo ve el contenido viejo o el nuevo completo,
+ * nunca uno a medias, aunque el proceso muera en el camino.
+ */
+
+#ifndef REEMPLAZO_H
+#define REEMPLAZO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** @brief Prefijo del temporal (oculto) que se crea junto al archivo. */
+#define REEMPLAZO_PREFIJO_TEMPORAL ".reemplazar-"
+
+/** @brief Resultado de reemplazar en un archivo. */
+typedef struct {
+    uint64_t reemplazos;   /**< Apariciones reemplazadas */
+    int reescrito;         /**< 1 si el archivo se sustituyó por la versión nueva */
+} ResultadoReemplazo;
+
+/**
+ * @brief Reemplaza todas las apariciones (sin solapamiento, de izquierda a
+ *        derecha) de 'buscar' por 'reemplazo' en el archivo 'ruta'.
+ *
+ * Conserva los permisos (y, si se puede, el dueño) del original. Si el
+ * reemplazo es igual a lo buscado, cuenta las apariciones sin reescribir.
+ *
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param m Longitud de 'buscar' (mayor que 0).
+ * @param r Longitud de 'reemplazo' (puede ser 0: borrar).
+ * @return 0, o -1 con errno (EISDIR, ELOOP para enlaces simbólicos,
+ *         ECANCELED con Ctrl+C, o el error de E/S); el original queda intacto.
+ */
+int reemplazar_en_archivo(int dir_fd, const char *ruta,
+                          const char *buscar, size_t m,
+                          const char *reemplazo, size_t r,
+                          ResultadoReemplazo *res);
+
+#endif /* REEMPLAZO_H */
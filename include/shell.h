@@ -9,6 +9,8 @@
 #ifndef SHELL_H
 #define SHELL_H
 
+#include <stdio.h>  /* FILE */
+
 // Tamaño máximo del buffer de entrada (aunque getline maneja dinámicamente)
 #define MAX_CMD_INPUT 1024
 
@@ -18,13 +20,131 @@
 // Longitud máxima del texto del prompt personalizable
 #define MAX_PROMPT_LEN 64
 
+// Prompt con el que arranca toda sesión nueva
+#define PROMPT_POR_DEFECTO "EAFITos"
+
+/**
+ * @brief Estado propio de una sesión de la shell.
+ *
+ * Todo lo que antes era global al proceso (como el prompt) vive aquí, de
+ * modo que un mismo proceso pueda atender varias sesiones independientes
+ * (ver servidor.c y la biblioteca libeafitos en eafitos.c). Los comandos
+ * acceden a la sesión en curso mediante `sesion_actual`.
+ */
+typedef struct ContextoSesion {
+    char prompt[MAX_PROMPT_LEN]; /**< Texto del prompt (comando 'prompt') */
+    int activa;                  /**< 1 mientras la sesión sigue abierta; 'salir' la pone en 0 */
+    int dir_fd;                  /**< Directorio de trabajo (fd abierto o AT_FDCWD) */
+    FILE *salida;                /**< Destino de la salida de los comandos (NULL = stdout) */
+    FILE *entrada;               /**< Origen de respuestas a confirmaciones (NULL = stdin) */
+    FILE *errores;               /**< Destino de los errores, p. ej. de `2>` (NULL = stderr) */
+    struct CacheExpresiones *expresiones; /**< Patrones compilados de 'buscar -e' (ver expresion.h) */
+    int formato;                 /**< FORMATO_TEXTO, FORMATO_JSON o FORMATO_TSV (ver formato.h) */
+    char *directorio;            /**< Ruta canónica de dir_fd (caché; NULL = aún no calculada) */
+    char *directorio_anterior;   /**< Directorio antes del último cambio (`cd -`) */
+    char **pila_dirs;            /**< Directorios guardados por pushd (el último es la cima) */
+    size_t n_pila;               /**< Entradas en pila_dirs */
+    struct AliasSesion *alias;   /**< Alias definidos con `alias` en esta sesión (ver configuracion.h) */
+    size_t n_alias;              /**< Entradas en alias */
+    struct VariableSesion *variables; /**< Variables definidas con `export` en esta sesión */
+    size_t n_variables;          /**< Entradas en variables */
+} ContextoSesion;
+
 /**
- * @brief Texto del prompt personalizable (definido en shell_loop.c).
+ * @brief Sesión sobre la que actúan los comandos (definida en sesion.c).
  *
- * Puede modificarse en tiempo de ejecución con el comando 'prompt'.
- * Valor por defecto: "EAFITos".
+ * Es una variable por hilo (_Thread_local): cada hilo que ejecuta comandos
+ * apunta a su propia sesión, por lo que varios hilos pueden ejecutar
+ * comandos de sesiones distintas al mismo tiempo. En el hilo principal del
+ * modo interactivo apunta a la única sesión del proceso.
  */
-extern char prompt_personalizado[MAX_PROMPT_LEN];
+extern _Thread_local ContextoSesion *sesion_actual;
+
+/**
+ * @brief Stream donde los comandos deben escribir su salida.
+ * @return sesion_actual->salida, o stdout si la sesión no define una.
+ */
+FILE *salida_sesion(void);
+
+/**
+ * @brief Stream de donde los comandos leen respuestas (confirmaciones s/n).
+ * @return sesion_actual->entrada, o stdin si la sesión no define una.
+ */
+FILE *entrada_sesion(void);
+
+/**
+ * @brief Datos para los comandos que leen archivos y no recibieron ninguno.
+ *
+ * `contar`, `ordenar` y `buscar` sin archivos leen de aquí
+ * (`contar < a.txt`). Sin `<` no hay datos: la terminal o el script que
+ * alimenta a la shell no se consumen como entrada de un comando.
+ *
+ * @return El stream del `<` del comando en curso, o NULL si no hubo `<`.
+ */
+FILE *entrada_redirigida(void);
+
+/**
+ * @brief Stream de errores de la sesión (lo que iría a stderr).
+ *
+ * `2>` lo cambia solo para la sesión que ejecuta el comando; el
+ * descriptor 2 del proceso no se toca.
+ *
+ * @return sesion_actual->errores, o stderr si la sesión no define uno.
+ */
+FILE *errores_sesion(void);
+
+/**
+ * @brief printf() sobre la salida de la sesión actual.
+ *
+ * Todos los comandos deben imprimir con esta función (y no con printf)
+ * para que su salida llegue a la sesión que los ejecutó.
+ */
+int imprimir(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief printf() sobre el stream de errores de la sesión actual.
+ *
+ * Los mensajes de error, de uso y los avisos de los comandos van aquí
+ * (y no a imprimir()), para que `2>` los separe de la salida.
+ */
+int imprimir_error(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Inicializa una sesión con los valores por defecto.
+ *
+ * El directorio de trabajo inicial es el directorio actual del proceso.
+ *
+ * @param sesion Sesión a inicializar.
+ * @return 0 si todo salió bien, -1 si hubo un error.
+ */
+int sesion_iniciar(ContextoSesion *sesion);
+
+/**
+ * @brief Libera los recursos de una sesión (no libera la estructura).
+ * @param sesion Sesión a cerrar.
+ */
+void sesion_cerrar(ContextoSesion *sesion);
+
+/**
+ * @brief Cambia el directorio de trabajo de la sesión (no el del proceso).
+ *
+ * Abre 'ruta' relativa al directorio actual de la sesión y cambia dir_fd
+ * por el nuevo descriptor; los comandos lo usan con openat(), fstatat(),
+ * etc. La ruta canónica se calcula aquí, una vez por cambio.
+ *
+ * @return 0 si se cambió, -1 (con errno) si no se pudo abrir.
+ */
+int sesion_cambiar_directorio(ContextoSesion *sesion, const char *ruta);
+
+/**
+ * @brief Ruta canónica del directorio de trabajo de la sesión.
+ *
+ * Sale de la caché; solo la primera consulta de una sesión que sigue en el
+ * directorio del proceso llama a getcwd().
+ *
+ * @return La ruta (propiedad de la sesión), o NULL si no se pudo obtener.
+ */
+const char *sesion_directorio(ContextoSesion *sesion);
 
 /**
  * @brief Inicia el bucle principal de la shell.
@@ -32,23 +152,95 @@ extern char prompt_personalizado[MAX_PROMPT_LEN];
  */
 void loop_shell();
 
+/** @brief Hilos que ejecutan comandos en cada proceso trabajador del servidor. */
+#define SERVIDOR_HILOS 8
+
+/** @brief Clientes con líneas listas que esperan hilo en la cola de un trabajador. */
+#define SERVIDOR_COLA 64
+
+/**
+ * @brief Modo servidor: atiende sesiones concurrentes por un socket Unix.
+ *
+ * Usa un conjunto de procesos trabajadores, cada uno con su propio bucle
+ * epoll y un grupo fijo de SERVIDOR_HILOS hilos; cada cliente conectado
+ * obtiene su propio ContextoSesion.
+ *
+ * @param ruta_socket Ruta del socket Unix a crear.
+ * @param n_trabajadores Número de procesos trabajadores (<= 0: uno por CPU).
+ * @return 0 al terminar normalmente, 1 si no se pudo iniciar.
+ */
+int servidor_ejecutar(const char *ruta_socket, int n_trabajadores);
+
 /**
  * @brief Lee una línea de la entrada estándar.
- * @return char* Puntero a la cadena leída (debe ser liberada con free).
+ * @return char* Puntero a la cadena leída (debe ser liberada con free),
+ *         o NULL al llegar a EOF (Ctrl+D) o si ocurre un error de lectura.
  */
 char *leer_linea(void);
 
+/**
+ * @brief Lee una línea en un buffer que se reutiliza entre llamadas.
+ * @param buffer Buffer de getline() (NULL la primera vez); lo libera el llamador.
+ * @param capacidad Tamaño de 'buffer' (0 la primera vez).
+ * @return *buffer, o NULL en EOF o error.
+ */
+char *leer_linea_en(char **buffer, size_t *capacidad);
+
 /**
  * @brief Parsea una línea cruda en un arreglo de tokens.
  * @param linea Cadena de entrada.
- * @return char** Arreglo de cadenas terminado en NULL.
+ * @return char** Arreglo de cadenas terminado en NULL (se libera con
+ *         MEM_FREE), o NULL si no hubo memoria.
  */
 char **parsear_linea(char *linea);
 
+/**
+ * @brief Parsea una línea en un arreglo de tokens que se reutiliza.
+ * @param tokens Arreglo (NULL la primera vez); crece solo si hace falta y se
+ *               libera con MEM_FREE.
+ * @param capacidad Punteros que caben en 'tokens' (0 la primera vez).
+ * @return *tokens, o NULL si no hubo memoria.
+ */
+char **parsear_linea_en(char *linea, char ***tokens, size_t *capacidad);
+
+/**
+ * @brief Redirecciones de una línea (`<`, `>`, `>>`, `2>`, `2>>`, `&>`).
+ *
+ * Las rutas apuntan a los tokens de la línea parseada. Con `&>` la salida
+ * y los errores van al mismo archivo y 'errores' queda igual a 'salida'.
+ */
+typedef struct {
+    const char *entrada;   /**< Archivo de `<`, o NULL */
+    const char *salida;    /**< Archivo de `>`, `>>` o `&>`, o NULL */
+    const char *errores;   /**< Archivo de `2>`, `2>>` o `&>`, o NULL */
+    int anexar_salida;     /**< 1 con `>>` */
+    int anexar_errores;    /**< 1 con `2>>` */
+} Redirecciones;
+
+/**
+ * @brief Quita de 'args' los operadores de redirección y sus archivos.
+ *
+ * El archivo puede ir separado (`> out.txt`) o pegado (`>out.txt`). Un
+ * token con otro '<' o '>' tras el operador (`<div>`) es texto, y una
+ * barra inicial (`\>`) hace literal al operador.
+ * 'args' se compacta en el lugar y sigue terminado en NULL.
+ *
+ * @param args Tokens de parsear_linea().
+ * @param r Recibe las redirecciones encontradas.
+ * @return 0 si la sintaxis es válida, -1 (con un mensaje) si falta un archivo.
+ */
+int separar_redirecciones(char **args, Redirecciones *r);
+
 /**
  * @brief Orquesta la ejecución de un comando dado sus argumentos.
  * @param args Lista de argumentos.
  */
 void ejecutar(char **args);
 
+/**
+ * @brief Indica si un nombre es un comando de la shell (integrado, plugin o alias).
+ * @return 1 si lo es, 0 si no.
+ */
+int comando_registrado(const char *nombre);
+
 #endif
@@ -0,0 +1,26 @@
+/**
+ * @file subcadena.h
+ * @brief Búsqueda SIMD de una subcadena dentro de un bloque de bytes.
+ *
+ * Compara 16 (SSE2) o 32 (AVX2) posiciones a la vez contra el primer y el
+ * último byte de la aguja y solo verifica con memcmp() las posiciones donde
+ * ambos coinciden. Con agujas poco frecuentes en el texto, casi todo el
+ * tiempo se pasa en las comparaciones vectoriales.
+ */
+
+#ifndef SUBCADENA_H
+#define SUBCADENA_H
+
+#include <stddef.h>
+
+/**
+ * @brief Busca la primera aparición de 'aguja' en 'texto'.
+ * @param texto Bytes donde buscar.
+ * @param n Longitud de 'texto'.
+ * @param aguja Bytes a buscar.
+ * @param m Longitud de 'aguja' (0 coincide al inicio).
+ * @return Puntero a la primera aparición, o NULL si no está.
+ */
+const char *buscar_subcadena(const char *texto, size_t n, const char *aguja, size_t m);
+
+#endif /* SUBCADENA_H */
@@ -0,0 +1,62 @@
+/**
+ * @file trabajos.h
+ * @brief Ejecución de una línea de comando con la salida capturada.
+ *
+ * Base de `paralelo`. Los comandos de la shell se ejecutan en el hilo que
+ * llama, sobre una sesión propia (copia del prompt y del directorio de la
+ * sesión de origen) cuya salida va a un buffer en memoria; así varios
+ * hilos pueden ejecutar comandos a la vez sin mezclar su salida. Cualquier
+ * otro nombre se lanza como programa externo con posix_spawnp(), con su
+ * salida y sus errores redirigidos a un archivo anónimo en memoria
+ * (memfd) que se lee al terminar. Las redirecciones (<, >, >>, 2>, &>)
+ * se respetan en ambos casos y sus rutas se resuelven en el directorio de
+ * la sesión.
+ */
+
+#ifndef TRABAJOS_H
+#define TRABAJOS_H
+
+#include <stddef.h>
+#include <sys/resource.h>
+#include "shell.h"
+
+/** @brief Código de salida cuando el programa no se pudo lanzar (como en sh). */
+#define TRABAJO_NO_ENCONTRADO 127
+
+/** @brief Resultado de un trabajo. */
+typedef struct {
+    char *salida;   /**< Salida capturada (malloc; liberar con free) */
+    size_t len;     /**< Bytes de 'salida' */
+    int codigo;     /**< Código de salida (comandos de la shell: siempre 0;
+                         128+N si el programa terminó por la señal N) */
+    int externo;    /**< 1 si se lanzó un programa externo */
+} ResultadoTrabajo;
+
+/**
+ * @brief Ejecuta una línea y captura su salida.
+ *
+ * Es seguro llamarla desde varios hilos a la vez.
+ *
+ * @param linea Línea de comando (no se modifica).
+ * @param origen Sesión de la que se heredan el prompt y el directorio.
+ * @param r Recibe el resultado.
+ * @return 0 si se ejecutó (aunque haya fallado), -1 si no hubo memoria.
+ */
+int trabajo_ejecutar(const char *linea, const ContextoSesion *origen, ResultadoTrabajo *r);
+
+/**
+ * @brief Lanza un programa externo en el directorio de la sesión actual y
+ *        espera a que termine.
+ *
+ * La salida (y los errores) se copian a la salida de la sesión al
+ * terminar. Respeta las redirecciones que queden en 'args'.
+ *
+ * @param args Programa y argumentos (se modifican al quitar redirecciones).
+ * @param uso Si no es NULL, recibe los recursos que consumió el programa.
+ *            ru_maxrss queda en -1 si no se puede distinguir de la
+ *            memoria de la shell (ver trabajos.c).
+ * @return Código de salida (TRABAJO_NO_ENCONTRADO si no se pudo lanzar).
+ */
+int trabajo_externo(char **args, struct rusage *uso);
+
+#endif /* TRABAJOS_H */
@@ -1,6 +1,129 @@
+/**
+ * @file utils.h
+ * @brief Utilidades compartidas por varios comandos.
+ */
+
 #ifndef UTILS_H
 #define UTILS_H
 
-// Placeholder for future utilities
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Lista dinámica de rutas (cadenas propias, liberadas con lista_rutas_liberar).
+ */
+typedef struct {
+    char **rutas;      /**< Arreglo de rutas */
+    size_t n;          /**< Rutas almacenadas */
+    size_t capacidad;  /**< Tamaño reservado del arreglo */
+} ListaRutas;
+
+/**
+ * @brief Añade una copia de la ruta al final de la lista.
+ * @return 0 si se añadió, -1 si no hubo memoria.
+ */
+int lista_rutas_agregar(ListaRutas *lista, const char *ruta);
+
+/** @brief Libera todas las rutas y deja la lista vacía. */
+void lista_rutas_liberar(ListaRutas *lista);
+
+/**
+ * @brief Agrega a la lista los archivos regulares bajo una ruta.
+ *
+ * Si la ruta es un archivo se agrega tal cual; si es un directorio se
+ * recorre recursivamente (sin seguir enlaces simbólicos a directorios),
+ * con un solo descriptor abierto a la vez. Las rutas que no caben en
+ * PATH_MAX se omiten con un aviso en errores_sesion().
+ *
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param ruta Archivo o directorio de partida.
+ * @param lista Lista donde se agregan las rutas encontradas.
+ * @return 0 si la ruta existe, -1 si no se pudo abrir.
+ */
+int recolectar_archivos(int dir_fd, const char *ruta, ListaRutas *lista);
+
+/* =============================================================================
+ * Rastreo de memoria (opcional)
+ * =============================================================================
+ *
+ * Con `make RASTREO_MEMORIA=1` (define EAFITOS_RASTREO_MEMORIA) las macros
+ * MEM_* pasan por memory_manager.c, que antepone a cada bloque una cabecera
+ * con su tamaño y su sitio de llamada (__FILE__:__LINE__) y lleva, por
+ * sitio, cuántas llamadas y bytes hubo, cuántos bloques siguen vivos y el
+ * pico. Al salir del programa se listan los bloques que no se liberaron.
+ * Sin la opción, las macros son malloc/calloc/realloc/strdup/free y no
+ * queda nada del rastreo en el código que las usa.
+ *
+ * Un bloque reservado con MEM_* se libera con MEM_FREE (y viceversa): con
+ * el rastreo activo, free() sobre él rompería el heap.
+ */
+
+#ifdef EAFITOS_RASTREO_MEMORIA
+#define MEM_MALLOC(n)       mem_malloc_rastreado((n), __FILE__, __LINE__)
+#define MEM_CALLOC(n, tam)  mem_calloc_rastreado((n), (tam), __FILE__, __LINE__)
+#define MEM_REALLOC(p, n)   mem_realloc_rastreado((p), (n), __FILE__, __LINE__)
+#define MEM_STRDUP(s)       mem_strdup_rastreado((s), __FILE__, __LINE__)
+#define MEM_FREE(p)         mem_free_rastreado(p)
+#else
+#define MEM_MALLOC(n)       malloc(n)
+#define MEM_CALLOC(n, tam)  calloc((n), (tam))
+#define MEM_REALLOC(p, n)   realloc((p), (n))
+#define MEM_STRDUP(s)       strdup(s)
+#define MEM_FREE(p)         free(p)
+#endif
 
+/** @brief 1 si las macros MEM_* rastrean (compilado con RASTREO_MEMORIA=1). */
+#ifdef EAFITOS_RASTREO_MEMORIA
+#define MEMORIA_RASTREADA 1
+#else
+#define MEMORIA_RASTREADA 0
 #endif
+
+/** @brief Totales del rastreo. */
+typedef struct {
+    size_t asignaciones;   /**< Llamadas que reservaron (malloc, calloc, realloc, strdup) */
+    size_t liberaciones;   /**< Bloques liberados */
+    size_t bytes_totales;  /**< Bytes pedidos en todas las asignaciones */
+    size_t bloques_vivos;  /**< Bloques sin liberar */
+    size_t bytes_vivos;    /**< Bytes sin liberar */
+    size_t pico_bytes;     /**< Máximo de bytes vivos a la vez */
+} EstadisticasMemoria;
+
+/** @brief Lo mismo, para un sitio de llamada. */
+typedef struct {
+    const char *archivo;
+    int linea;
+    EstadisticasMemoria e;
+} SitioMemoria;
+
+/* Destinos de las macros MEM_* con el rastreo activo; devuelven bloques
+ * alineados como los de malloc() */
+void *mem_malloc_rastreado(size_t n, const char *archivo, int linea);
+void *mem_calloc_rastreado(size_t n, size_t tam, const char *archivo, int linea);
+void *mem_realloc_rastreado(void *p, size_t n, const char *archivo, int linea);
+char *mem_strdup_rastreado(const char *s, const char *archivo, int linea);
+void mem_free_rastreado(void *p);
+
+/** @brief Totales desde que empezó el programa (todo 0 sin rastreo). */
+void memoria_estadisticas(EstadisticasMemoria *e);
+
+/**
+ * @brief Copia los sitios de llamada, de más a menos bytes vivos (y luego
+ *        de más a menos bytes totales).
+ *
+ * @param sitios Arreglo de salida, o NULL para solo contarlos.
+ * @param max Capacidad de 'sitios'.
+ * @return Número total de sitios con alguna asignación.
+ */
+size_t memoria_sitios(SitioMemoria *sitios, size_t max);
+
+/**
+ * @brief Escribe los bloques vivos (dirección, tamaño y sitio) en 'f'.
+ * @param max Máximo de bloques a listar (los demás solo se cuentan).
+ * @return Número de bloques vivos.
+ */
+size_t memoria_volcar_vivos(FILE *f, size_t max);
+
+#endif /* UTILS_H */
@@ -0,0 +1,60 @@
+/**
+ * @file vigilancia.h
+ * @brief Notificación de cambios en archivos (inotify / fanotify).
+ *
+ * Base del comando `vigilar`. El llamador espera sobre vigilancia_fd() con
+ * poll() y, cuando está listo, recoge los eventos con vigilancia_leer():
+ * no hay ningún sondeo periódico.
+ *
+ * Para vigilancias recursivas se intenta primero fanotify sobre todo el
+ * sistema de archivos (una sola marca, sin importar cuántos directorios
+ * haya), filtrando por la ruta vigilada. Requiere privilegios; si no se
+ * tienen, se usa inotify con una vigilancia por directorio, añadiendo las
+ * de los directorios que se crean después.
+ */
+
+#ifndef VIGILANCIA_H
+#define VIGILANCIA_H
+
+/** @brief Tipos de evento (se combinan con OR al agrupar). */
+#define EVENTO_CREADO     0x1
+#define EVENTO_MODIFICADO 0x2
+#define EVENTO_ELIMINADO  0x4
+#define EVENTO_MOVIDO     0x8
+
+/** @brief Vigilancia activa (opaca). */
+typedef struct Vigilancia Vigilancia;
+
+/**
+ * @brief Callback por cada evento recibido.
+ * @param ruta Ruta afectada (válida solo durante la llamada).
+ * @param tipo Uno de los EVENTO_*.
+ * @param usuario Puntero pasado a vigilancia_leer().
+ */
+typedef void (*FuncionEvento)(const char *ruta, int tipo, void *usuario);
+
+/**
+ * @brief Empieza a vigilar un archivo o directorio.
+ * @param dir_fd Directorio base para rutas relativas (o AT_FDCWD).
+ * @param ruta Archivo o directorio a vigilar.
+ * @param recursiva 1 para incluir todos los subdirectorios.
+ * @return La vigilancia, o NULL con errno si no se pudo crear.
+ */
+Vigilancia *vigilancia_crear(int dir_fd, const char *ruta, int recursiva);
+
+/** @brief Descriptor que se vuelve legible cuando hay eventos. */
+int vigilancia_fd(const Vigilancia *v);
+
+/** @brief Mecanismo en uso: "inotify" o "fanotify". */
+const char *vigilancia_mecanismo(const Vigilancia *v);
+
+/**
+ * @brief Lee todos los eventos pendientes sin bloquearse.
+ * @return Número de eventos entregados, o -1 si hubo un error de lectura.
+ */
+int vigilancia_leer(Vigilancia *v, FuncionEvento fn, void *usuario);
+
+/** @brief Deja de vigilar y libera los recursos. */
+void vigilancia_destruir(Vigilancia *v);
+
+#endif /* VIGILANCIA_H */
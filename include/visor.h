@@ -0,0 +1,98 @@
+/**
+ * @file visor.h
+ * @brief Navegación por archivos de cualquier tamaño (base de `leer -p`).
+ *
+ * El archivo nunca se carga completo: solo se mapea una ventana de
+ * VISOR_VENTANA bytes alrededor de la posición que se consulta, y se
+ * mueve cuando hace falta. Un hilo en segundo plano recorre el archivo y
+ * guarda el desplazamiento de una de cada 'paso' líneas (índice disperso);
+ * si el índice llega a VISOR_MAX_MARCAS entradas, se descarta una de cada
+ * dos y se duplica el paso. Así abrir el archivo es inmediato y la memoria
+ * usada no depende de su tamaño.
+ *
+ * Las posiciones son desplazamientos en bytes; las funciones que reciben
+ * el comienzo de una línea lo indican. Un Visor no es seguro entre hilos
+ * (salvo su propio hilo de indexado).
+ */
+
+#ifndef VISOR_H
+#define VISOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** @brief Tamaño de la ventana mapeada (bytes). */
+#define VISOR_VENTANA (4u << 20)
+
+/** @brief Máximo de entradas del índice disperso. */
+#define VISOR_MAX_MARCAS 65536
+
+/** @brief Archivo abierto para navegar (opaco). */
+typedef struct Visor Visor;
+
+/**
+ * @brief Abre un archivo regular y empieza a indexarlo en segundo plano.
+ * @param fd Descriptor abierto para lectura (el Visor no lo cierra).
+ * @param tam Tamaño del archivo.
+ * @return El visor, o NULL con errno.
+ */
+Visor *visor_abrir(int fd, off_t tam);
+
+/** @brief Detiene el indexado y libera el visor. */
+void visor_cerrar(Visor *v);
+
+/** @brief Tamaño del archivo. */
+off_t visor_tamano(const Visor *v);
+
+/**
+ * @brief Estado del índice.
+ * @param indexado Recibe cuántos bytes se han recorrido ya (puede ser NULL).
+ * @return Número total de líneas, o -1 si el índice aún no terminó.
+ */
+int64_t visor_total_lineas(Visor *v, off_t *indexado);
+
+/**
+ * @brief Número de línea (desde 1) que empieza en 'pos'.
+ * @return El número, o -1 si el índice todavía no llegó a esa posición.
+ */
+int64_t visor_numero_linea(Visor *v, off_t pos);
+
+/** @brief Comienzo de la línea que contiene 'pos'. */
+off_t visor_inicio_linea(Visor *v, off_t pos);
+
+/**
+ * @brief Comienzo de la línea siguiente a la que empieza en 'pos'.
+ * @return El desplazamiento, o -1 si 'pos' está en la última línea.
+ */
+off_t visor_siguiente(Visor *v, off_t pos);
+
+/** @brief Comienzo de la línea anterior (0 si 'pos' es la primera). */
+off_t visor_anterior(Visor *v, off_t pos);
+
+/**
+ * @brief Comienzo de la línea 'n' (desde 1), usando el índice disperso.
+ *
+ * Si el índice todavía no llega a esa línea, se cuenta desde su última
+ * marca. Si el archivo tiene menos líneas, devuelve la última.
+ */
+off_t visor_ir_linea(Visor *v, uint64_t n);
+
+/**
+ * @brief Copia una línea (sin '\n'), truncada a 'max' bytes.
+ * @param pos Comienzo de la línea.
+ * @return Bytes copiados.
+ */
+size_t visor_copiar_linea(Visor *v, off_t pos, char *buf, size_t max);
+
+/**
+ * @brief Busca un texto literal.
+ *
+ * @param desde Hacia adelante: la coincidencia debe empezar en 'desde' o
+ *        después. Hacia atrás: debe empezar antes de 'desde'.
+ * @param atras 1 para buscar hacia el principio del archivo.
+ * @return Comienzo de la línea que contiene la coincidencia, o -1.
+ */
+off_t visor_buscar(Visor *v, off_t desde, const char *texto, size_t len, int atras);
+
+#endif /* VISOR_H */
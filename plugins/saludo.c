@@ -0,0 +1,39 @@
+/**
+ * @file saludo.c
+ * @brief Plugin de ejemplo para EAFITos.
+ *
+ * Muestra cómo escribir un comando que se instala sin recompilar la shell:
+ * basta con exportar un PluginComando y declararlo en plugins.idx. Como
+ * cualquier comando, escribe con imprimir() para que la salida llegue a la
+ * sesión que lo ejecutó (cliente del servidor, `paralelo`, `--grabar`).
+ *
+ * Compilar con: make plugins
+ */
+
+#include "plugins.h"
+#include "shell.h"    /* imprimir */
+#include "colors.h"
+
+/**
+ * @brief Comando SALUDO
+ *
+ * @param args args[1] (opcional) es el nombre de la persona a saludar.
+ */
+static void cmd_saludo(char **args) {
+    const char *nombre = (args[1] != NULL) ? args[1] : "mundo";
+    imprimir(COLOR_GREEN "  ¡Hola, %s! (desde un plugin)\n" COLOR_RESET, nombre);
+}
+
+/** @brief Descriptor exportado; su nombre debe coincidir con plugins.idx. */
+const PluginComando plugin_saludo = {
+    EAFITOS_PLUGIN_ABI,
+    "saludo",
+    cmd_saludo,
+    {
+        "saludo",
+        "Saluda a una persona. Es un ejemplo de comando cargado como plugin.",
+        "saludo [nombre]",
+        "saludo\nsaludo Ana",
+        "Se carga con dlopen() la primera vez que se usa."
+    }
+};
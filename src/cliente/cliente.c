@@ -0,0 +1,101 @@
+/**
+ * @file cliente.c
+ * @brief Cliente ligero para el modo servidor de EAFITos.
+ *
+ * Uso: eafitos_cliente /ruta.sock
+ *
+ * Se conecta al socket del servidor y reenvía stdin hacia él y sus
+ * respuestas hacia stdout. No contiene nada de la shell: arranca en
+ * microsegundos y toda la sesión vive en el servidor.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/** @brief Tamaño del buffer usado para copiar datos en cada sentido. */
+#define TAM_BUFFER 65536
+
+/**
+ * @brief Escribe todo el buffer, reintentando escrituras parciales.
+ * @return 0 si se escribió todo, -1 si hubo un error.
+ */
+static int escribir_todo(int fd, const char *datos, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, datos, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        datos += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Uso: %s <ruta.sock>\n", argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_un dir;
+    memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(dir.sun_path)) {
+        fprintf(stderr, "Ruta de socket demasiado larga: %s\n", argv[1]);
+        return 1;
+    }
+    strcpy(dir.sun_path, argv[1]);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&dir, sizeof(dir)) != 0) {
+        perror("connect");
+        return 1;
+    }
+
+    char buffer[TAM_BUFFER];
+    struct pollfd fds[2] = {
+        { .fd = STDIN_FILENO, .events = POLLIN },
+        { .fd = fd,           .events = POLLIN },
+    };
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return 1;
+        }
+
+        /* Servidor -> stdout */
+        if (fds[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n <= 0) {
+                break; /* El servidor cerró la sesión ('salir' o EOF) */
+            }
+            if (escribir_todo(STDOUT_FILENO, buffer, (size_t)n) != 0) {
+                break;
+            }
+        }
+
+        /* stdin -> servidor */
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+            if (n <= 0) {
+                /* Fin de la entrada: avisamos al servidor pero seguimos
+                 * leyendo hasta recibir toda su respuesta. */
+                shutdown(fd, SHUT_WR);
+                fds[0].fd = -1;
+            } else if (escribir_todo(fd, buffer, (size_t)n) != 0) {
+                break;
+            }
+        }
+    }
+
+    close(fd);
+    return 0;
+}
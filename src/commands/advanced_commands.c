@@ -7,10 +7,25 @@
  * Salida colorizada con colors.h.
  */
 
+#define _GNU_SOURCE   /* st_mtim */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>      /* openat, AT_REMOVEDIR */
+#include <unistd.h>     /* faccessat, unlinkat */
+#include <sys/stat.h>
 #include "commands.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
 #include "colors.h"
+#include "formato.h"
+#include "utils.h"          /* recolectar_archivos */
+#include "lectura_lotes.h"  /* leer_archivos_en_lote */
+#include "cancelacion.h"    /* Ctrl+C, limite */
+#include "indice.h"         /* indice_abrir, indice_candidatos */
+#include "expresion.h"      /* buscar -e */
+#include "subcadena.h"      /* buscar_subcadena */
 
 /**
  * @brief Comando CREAR_ARCHIVO
@@ -21,40 +36,40 @@
  */
 void cmd_crear_archivo(char **args) {
     if (args[1] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET "crear <nombre_archivo>\n");
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "crear <nombre_archivo>\n");
         return;
     }
 
     const char *nombre = args[1];
+    int dir_fd = sesion_actual->dir_fd;
 
-    FILE *fp = fopen(nombre, "r");
-    if (fp != NULL) {
-        fclose(fp);
-        printf(COLOR_YELLOW "El archivo '%s' ya existe. ¿Desea sobreescribirlo? (s/n): "
+    if (faccessat(dir_fd, nombre, F_OK, 0) == 0) {
+        imprimir(COLOR_YELLOW "El archivo '%s' ya existe. ¿Desea sobreescribirlo? (s/n): "
                COLOR_RESET, nombre);
 
         char respuesta[8] = {0};
-        if (fgets(respuesta, sizeof(respuesta), stdin) == NULL) {
-            printf(COLOR_RED "[ERROR]" COLOR_RESET
-                   " No se pudo leer la respuesta. Operación cancelada.\n");
+        fflush(salida_sesion()); /* La pregunta debe verse antes de leer */
+        if (fgets(respuesta, sizeof(respuesta), entrada_sesion()) == NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                         " No se pudo leer la respuesta. Operación cancelada.\n");
             return;
         }
 
         if (respuesta[0] != 's' && respuesta[0] != 'S') {
-            printf(COLOR_DIM "Operación cancelada.\n" COLOR_RESET);
+            imprimir(COLOR_DIM "Operación cancelada.\n" COLOR_RESET);
             return;
         }
     }
 
-    fp = fopen(nombre, "w");
-    if (fp == NULL) {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET
-               " No se pudo crear el archivo '%s'.\n", nombre);
+    int fd = openat(dir_fd, nombre, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                     " No se pudo crear el archivo '%s'.\n", nombre);
         return;
     }
 
-    fclose(fp);
-    printf(COLOR_GREEN "  Archivo '%s' creado correctamente.\n" COLOR_RESET, nombre);
+    close(fd);
+    imprimir(COLOR_GREEN "  Archivo '%s' creado correctamente.\n" COLOR_RESET, nombre);
 }
 
 /**
@@ -66,94 +81,380 @@ void cmd_crear_archivo(char **args) {
  */
 void cmd_eliminar_archivo(char **args) {
     if (args[1] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET "eliminar <nombre_archivo>\n");
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "eliminar <nombre_archivo>\n");
         return;
     }
 
     const char *nombre = args[1];
+    int dir_fd = sesion_actual->dir_fd;
 
-    FILE *fp = fopen(nombre, "r");
-    if (fp == NULL) {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET
-               " El archivo '%s' no existe.\n", nombre);
+    if (faccessat(dir_fd, nombre, F_OK, 0) != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                     " El archivo '%s' no existe.\n", nombre);
         return;
     }
-    fclose(fp);
 
-    printf(COLOR_YELLOW "¿Estás seguro de eliminar '%s'? (s/n): " COLOR_RESET,
+    imprimir(COLOR_YELLOW "¿Estás seguro de eliminar '%s'? (s/n): " COLOR_RESET,
            nombre);
     char respuesta[8] = {0};
-    if (fgets(respuesta, sizeof(respuesta), stdin) == NULL) {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo leer la respuesta.\n");
+    fflush(salida_sesion()); /* La pregunta debe verse antes de leer */
+    if (fgets(respuesta, sizeof(respuesta), entrada_sesion()) == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo leer la respuesta.\n");
         return;
     }
 
     if (respuesta[0] != 's' && respuesta[0] != 'S') {
-        printf(COLOR_DIM "Operación cancelada.\n" COLOR_RESET);
+        imprimir(COLOR_DIM "Operación cancelada.\n" COLOR_RESET);
         return;
     }
 
-    if (remove(nombre) == 0) {
-        printf(COLOR_GREEN "  Archivo '%s' eliminado correctamente.\n" COLOR_RESET,
+    /* Como remove(): un directorio vacío también se elimina */
+    if (unlinkat(dir_fd, nombre, 0) == 0 ||
+        (errno == EISDIR && unlinkat(dir_fd, nombre, AT_REMOVEDIR) == 0)) {
+        imprimir(COLOR_GREEN "  Archivo '%s' eliminado correctamente.\n" COLOR_RESET,
                nombre);
     } else {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo eliminar '%s'.\n",
-               nombre);
-        perror("remove");
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo eliminar '%s'.\n",
+                     nombre);
+        perror("unlinkat");
+    }
+}
+
+/** @brief Estado de cmd_buscar mientras recibe bloques de lectura_lotes. */
+typedef struct {
+    const char *texto;     /**< Texto buscado */
+    size_t len_texto;      /**< strlen(texto) */
+    Expresion *re;         /**< Con -e: expresión compilada (texto es el patrón) */
+    int varios;            /**< 1 si se busca en más de un archivo */
+    char *resto;           /**< Línea incompleta del bloque anterior */
+    size_t len_resto;
+    size_t cap_resto;
+    int numero_linea;      /**< Línea actual del archivo en curso */
+    int encontrados;       /**< Coincidencias totales */
+    int archivos_con;      /**< Archivos con al menos una coincidencia */
+    int en_archivo;        /**< Coincidencias en el archivo en curso */
+} EstadoBuscar;
+
+/**
+ * @brief Revisa una línea completa (sin '\n') e imprime si coincide.
+ */
+static void revisar_linea(EstadoBuscar *e, const char *ruta, const char *linea, size_t len) {
+    int coincide = e->re != NULL ? expresion_coincide(e->re, linea, len)
+                                 : buscar_subcadena(linea, len, e->texto, e->len_texto) != NULL;
+    if (coincide) {
+        if (formato_estructurado()) {
+            registro_abrir();
+            registro_texto("archivo", ruta);
+            registro_entero("linea", e->numero_linea);
+            registro_texto_n("texto", linea, len);
+            registro_cerrar();
+        } else if (e->varios) {
+            imprimir(COLOR_BLUE " %s" COLOR_RESET COLOR_YELLOW ":%d:" COLOR_RESET " %.*s\n",
+                     ruta, e->numero_linea, (int)len, linea);
+        } else {
+            imprimir(COLOR_YELLOW " %3d:" COLOR_RESET " %.*s\n",
+                     e->numero_linea, (int)len, linea);
+        }
+        e->encontrados++;
+        e->en_archivo++;
+    }
+    e->numero_linea++;
+}
+
+/**
+ * @brief Guarda el final de un bloque (línea sin terminar) para el siguiente.
+ * @return 0 si se guardó, -1 si no hubo memoria.
+ */
+static int guardar_resto(EstadoBuscar *e, const char *datos, size_t n) {
+    if (e->len_resto + n > e->cap_resto) {
+        size_t nueva = (e->len_resto + n) * 2;
+        /* Una línea enorme es lo único que crece con la entrada (limite -m) */
+        if (limite_cargar(nueva - e->cap_resto) != 0) {
+            return -1;
+        }
+        char *tmp = realloc(e->resto, nueva);
+        if (tmp == NULL) {
+            limite_descargar(nueva - e->cap_resto);
+            return -1;
+        }
+        e->resto = tmp;
+        e->cap_resto = nueva;
+    }
+    memcpy(e->resto + e->len_resto, datos, n);
+    e->len_resto += n;
+    return 0;
+}
+
+/**
+ * @brief Callback de leer_archivos_en_lote(): divide cada bloque en líneas.
+ */
+static int buscar_en_bloque(const BloqueArchivo *b, void *usuario) {
+    EstadoBuscar *e = usuario;
+
+    if (b->error != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                       " El archivo '%s' no existe o no se puede abrir.\n", b->ruta);
+        e->len_resto = 0;
+        e->numero_linea = 1;
+        return 0;
+    }
+
+    const char *p = b->datos;
+    const char *fin = b->datos + b->longitud;
+    while (p < fin) {
+        const char *nl = memchr(p, '\n', (size_t)(fin - p));
+        if (nl == NULL) {
+            if (guardar_resto(e, p, (size_t)(fin - p)) != 0) return 1;
+            break;
+        }
+        if (e->len_resto > 0) {
+            /* La línea empezó en el bloque anterior */
+            if (guardar_resto(e, p, (size_t)(nl - p)) != 0) return 1;
+            revisar_linea(e, b->ruta, e->resto, e->len_resto);
+            e->len_resto = 0;
+        } else {
+            revisar_linea(e, b->ruta, p, (size_t)(nl - p));
+        }
+        p = nl + 1;
+    }
+
+    if (b->fin) {
+        if (e->len_resto > 0) {
+            revisar_linea(e, b->ruta, e->resto, e->len_resto); /* Última línea sin '\n' */
+        }
+        if (e->en_archivo > 0) {
+            e->archivos_con++;
+        }
+        e->len_resto = 0;
+        e->numero_linea = 1;
+        e->en_archivo = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief Agrega los archivos de un argumento de buscar, filtrando con el
+ *        índice de trigramas si el directorio tiene uno.
+ *
+ * Los archivos indexados y sin cambios solo se agregan si el índice dice
+ * que pueden contener el texto; los nuevos o modificados desde `indexar`
+ * se agregan siempre, así que el resultado es el mismo que sin índice.
+ *
+ * @param literal Texto que toda coincidencia contiene (NULL si no hay).
+ * @return 0, o -1 si la ruta no existe.
+ */
+static int recolectar_para_buscar(int dir_fd, const char *ruta, const char *literal,
+                                  size_t len_literal, ListaRutas *lista) {
+    ListaRutas todos = {0};
+    if (recolectar_archivos(dir_fd, ruta, &todos) != 0) {
+        return -1;
+    }
+
+    Indice *ix = indice_abrir(dir_fd, ruta);
+    unsigned char *marcas = NULL;
+    if (ix != NULL && literal != NULL) {
+        marcas = malloc(indice_n_archivos(ix) + 1);
+        if (marcas == NULL || indice_candidatos(ix, literal, len_literal, marcas) != 0) {
+            free(marcas);              /* Texto corto: el índice no ayuda */
+            marcas = NULL;
+        }
+    }
+
+    size_t largo = strlen(ruta);
+    while (largo > 1 && ruta[largo - 1] == '/') largo--;
+    for (size_t i = 0; i < todos.n; i++) {
+        const char *nombre = strrchr(todos.rutas[i], '/');
+        nombre = nombre ? nombre + 1 : todos.rutas[i];
+        if (strncmp(nombre, INDICE_NOMBRE, strlen(INDICE_NOMBRE)) == 0) {
+            continue;                  /* El propio índice (y su temporal) */
+        }
+        if (marcas != NULL) {
+            long n = indice_buscar_archivo(ix, todos.rutas[i] + largo + 1);
+            struct stat st;
+            if (n >= 0 && !marcas[n] && fstatat(dir_fd, todos.rutas[i], &st, 0) == 0 &&
+                indice_vigente(ix, n, (uint64_t)st.st_size,
+                               (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec)) {
+                continue;              /* Descartado por el índice */
+            }
+        }
+        lista_rutas_agregar(lista, todos.rutas[i]);
+    }
+
+    free(marcas);
+    indice_cerrar(ix);
+    lista_rutas_liberar(&todos);
+    return 0;
+}
+
+/**
+ * @brief Pasa a buscar_en_bloque() lo que llega por `<`, como el archivo "-".
+ */
+static void buscar_en_entrada(FILE *entrada, EstadoBuscar *e) {
+    char *buffer = malloc(LOTE_TAM_BUFFER);
+    BloqueArchivo b = { 0, "-", buffer, 0, 0, 0 };
+    if (buffer == NULL) {
+        b.error = ENOMEM;
+        b.fin = 1;
+        buscar_en_bloque(&b, e);
+        return;
+    }
+    while (!b.fin && !cancelacion_solicitada()) {
+        b.longitud = fread(buffer, 1, LOTE_TAM_BUFFER, entrada);
+        b.fin = b.longitud < LOTE_TAM_BUFFER;
+        if (b.fin && ferror(entrada)) {
+            b.error = errno;
+        }
+        if (buscar_en_bloque(&b, e) != 0) break;
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Lee los archivos de la lista, o la entrada de `<` si no es NULL.
+ */
+static void leer_para_buscar(int dir_fd, const ListaRutas *lista, FILE *entrada,
+                             EstadoBuscar *e) {
+    if (entrada != NULL) {
+        buscar_en_entrada(entrada, e);
+    } else {
+        leer_archivos_en_lote(dir_fd, (const char *const *)lista->rutas, lista->n,
+                              buscar_en_bloque, e);
     }
 }
 
 /**
  * @brief Comando BUSCAR
  *
- * Busca una cadena de texto dentro de un archivo línea por línea.
- * Si el texto es encontrado, muestra el número de línea y el contenido.
+ * Busca una cadena de texto línea por línea dentro de uno o varios
+ * archivos. Los directorios se recorren recursivamente. Con varios
+ * archivos, cada resultado se precede del nombre del archivo y las
+ * lecturas se envían en lotes (ver lectura_lotes.c). Si un directorio
+ * tiene índice (ver `indexar`), solo se leen los archivos candidatos.
+ *
+ * Con `-e` el texto es una expresión regular (ver expresion.h); los
+ * patrones compilados se guardan en la sesión y se reutilizan. Sin
+ * archivos busca en lo que llega por `<`.
  *
- * @param args args[1] texto a buscar, args[2] nombre del archivo.
+ * @param args args[1] texto a buscar (o -e y el patrón), luego archivos o
+ *             directorios.
  */
 void cmd_buscar(char **args) {
-    if (args[1] == NULL || args[2] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET
-               "buscar <texto> <nombre_archivo>\n");
+    int es_expresion = args[1] != NULL && strcmp(args[1], "-e") == 0;
+    char **rutas = args + (es_expresion ? 3 : 2);
+    FILE *entrada = NULL;
+    if (args[1] == NULL || (es_expresion && args[2] == NULL) ||
+        (rutas[0] == NULL && (entrada = entrada_redirigida()) == NULL)) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                       "buscar [-e] <texto|patrón> <archivo|directorio> [...]"
+                       "  (o: buscar <texto> < archivo)\n");
         return;
     }
 
-    const char *texto  = args[1];
-    const char *nombre = args[2];
+    const char *texto = rutas[-1];
+    int dir_fd = sesion_actual->dir_fd;
+
+    EstadoBuscar e = {0};
+    e.texto = texto;
+    e.len_texto = strlen(texto);
+    e.numero_linea = 1;
+    const char *literal = texto;
+    size_t len_literal = e.len_texto;
+    if (es_expresion) {
+        char error[128];
+        e.re = expresion_de_cache(&sesion_actual->expresiones, texto, error, sizeof(error));
+        if (e.re == NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Patrón inválido '%s': %s\n",
+                           texto, error);
+            return;
+        }
+        literal = expresion_literal(e.re, &len_literal);
+    }
 
-    FILE *fp = fopen(nombre, "r");
-    if (fp == NULL) {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET
-               " El archivo '%s' no existe o no se puede abrir.\n", nombre);
+    ListaRutas lista = {0};
+    int existentes = entrada != NULL;
+    for (int i = 0; rutas[i] != NULL; i++) {
+        if (recolectar_para_buscar(dir_fd, rutas[i], literal, len_literal, &lista) != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                           " El archivo '%s' no existe o no se puede abrir.\n", rutas[i]);
+        } else {
+            existentes++;
+        }
+    }
+    if (existentes == 0) {
+        lista_rutas_liberar(&lista);
         return;
     }
 
-    printf(COLOR_CYAN "\n Buscando '" COLOR_BOLD "%s" COLOR_RESET
-           COLOR_CYAN "' en '%s':\n" COLOR_RESET, texto, nombre);
-    printf(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+    /* Un único argumento que es un archivo (o `<`) conserva el formato clásico */
+    const char *nombre = entrada != NULL ? "-" : rutas[0];
+    e.varios = entrada == NULL &&
+               !(rutas[1] == NULL && lista.n == 1 && strcmp(lista.rutas[0], rutas[0]) == 0);
 
-    char linea[1024];
-    int numeroLinea = 1;
-    int encontrados = 0;
+    if (formato_estructurado()) {
+        /* Solo los registros de las coincidencias, sin cabecera ni resumen */
+        leer_para_buscar(dir_fd, &lista, entrada, &e);
+        free(e.resto);
+        limite_descargar(e.cap_resto);
+        lista_rutas_liberar(&lista);
+        return;
+    }
 
-    while (fgets(linea, sizeof(linea), fp) != NULL) {
-        if (strstr(linea, texto) != NULL) {
-            printf(COLOR_YELLOW " %3d:" COLOR_RESET " %s",
-                   numeroLinea, linea);
-            encontrados++;
-        }
-        numeroLinea++;
+    if (e.varios) {
+        imprimir(COLOR_CYAN "\n Buscando '" COLOR_BOLD "%s" COLOR_RESET
+                 COLOR_CYAN "' en %zu archivo(s):\n" COLOR_RESET, texto, lista.n);
+    } else {
+        imprimir(COLOR_CYAN "\n Buscando '" COLOR_BOLD "%s" COLOR_RESET
+                 COLOR_CYAN "' en '%s':\n" COLOR_RESET, texto, nombre);
     }
+    imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
 
-    printf(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
-    if (encontrados == 0) {
-        printf(COLOR_YELLOW "  No se encontró '%s' en '%s'.\n" COLOR_RESET,
-               texto, nombre);
+    leer_para_buscar(dir_fd, &lista, entrada, &e);
+
+    imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+    if (cancelacion_solicitada()) {
+        /* Ctrl+C: el recuento es parcial; la shell avisa de la interrupción */
+    } else if (e.encontrados == 0) {
+        imprimir(COLOR_YELLOW "  No se encontró '%s' en '%s'.\n" COLOR_RESET,
+                 texto, e.varios ? "los archivos indicados" : nombre);
+    } else if (e.varios) {
+        imprimir(COLOR_GREEN "  Total de coincidencias: %d (en %d archivo(s))\n" COLOR_RESET,
+                 e.encontrados, e.archivos_con);
     } else {
-        printf(COLOR_GREEN "  Total de coincidencias: %d\n" COLOR_RESET,
-               encontrados);
+        imprimir(COLOR_GREEN "  Total de coincidencias: %d\n" COLOR_RESET,
+                 e.encontrados);
+    }
+    imprimir("\n");
+
+    free(e.resto);
+    limite_descargar(e.cap_resto);
+    lista_rutas_liberar(&lista);
+}
+
+/**
+ * @brief Comando INDEXAR
+ *
+ * Crea o actualiza el índice de trigramas de un directorio, que `buscar`
+ * usa después para leer solo los archivos que pueden contener el texto.
+ * Al reindexar solo se vuelven a leer los archivos nuevos o modificados.
+ *
+ * @param args args[1] directorio a indexar.
+ */
+void cmd_indexar(char **args) {
+    if (args[1] == NULL || args[2] != NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "indexar <directorio>\n");
+        return;
     }
-    printf("\n");
 
-    fclose(fp);
+    ResumenIndice r;
+    if (indice_construir(sesion_actual->dir_fd, args[1], &r) != 0) {
+        if (errno == ECANCELED) return;   /* Ctrl+C: la shell ya avisa */
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo indexar '%s': %s\n",
+                       args[1], strerror(errno));
+        return;
+    }
+    imprimir(COLOR_GREEN "  Índice de '%s' actualizado: " COLOR_RESET
+             "%zu archivo(s), %zu trigramas, %.1f KB\n",
+             args[1], r.archivos, r.trigramas, (double)r.bytes / 1024.0);
+    imprimir(COLOR_DIM "  Leídos: %zu  Sin cambios: %zu  Eliminados: %zu\n" COLOR_RESET,
+             r.escaneados, r.reutilizados, r.eliminados);
 }
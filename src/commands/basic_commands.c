@@ -11,11 +11,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <time.h>
 #include "commands.h"
-#include "shell.h"    /* Para prompt_personalizado y MAX_PROMPT_LEN */
+#include "shell.h"    /* Para sesion_actual y MAX_PROMPT_LEN */
 #include "colors.h"   /* Para macros de color ANSI */
+#include "formato.h"  /* Para la salida estructurada de tiempo */
 #include "help.h"     /* Para mostrar_ayuda_comando() */
+#include "plugins.h"  /* Para la ayuda de los comandos de plugins */
+#include "configuracion.h" /* Para alias_definir(), alias_recorrer() y variable_definir() */
 
 /**
  * @brief Comando AYUDA
@@ -28,66 +32,110 @@
 void cmd_ayuda(char **args) {
     /* Feature 2: Si hay argumento, mostrar ayuda específica del comando */
     if (args[1] != NULL) {
-        if (!mostrar_ayuda_comando(args[1])) {
-            printf(COLOR_RED "No existe ayuda para el comando: " COLOR_BOLD "'%s'\n"
-                   COLOR_RESET, args[1]);
-            printf("Escribe " COLOR_CYAN "'ayuda'" COLOR_RESET
-                   " sin argumentos para ver todos los comandos.\n");
+        if (!mostrar_ayuda_comando(args[1]) && !plugins_mostrar_ayuda(args[1])) {
+            imprimir_error(COLOR_RED "No existe ayuda para el comando: " COLOR_BOLD "'%s'\n"
+                         COLOR_RESET, args[1]);
+            imprimir_error("Escribe " COLOR_CYAN "'ayuda'" COLOR_RESET
+                         " sin argumentos para ver todos los comandos.\n");
         }
         return;
     }
 
     /* --- Ayuda general: lista todos los comandos --- */
-    printf("\n");
-    printf(COLOR_CYAN COLOR_BOLD
+    imprimir("\n");
+    imprimir(COLOR_CYAN COLOR_BOLD
            "╔══════════════════════════════════════════╗\n"
            "║         EAFITos — Comandos Disponibles  ║\n"
            "╚══════════════════════════════════════════╝\n"
            COLOR_RESET);
 
-    printf(COLOR_YELLOW "\n  Archivos y Directorios:\n" COLOR_RESET);
-    printf(COLOR_GREEN "    listar" COLOR_RESET
-           "                    Lista archivos del directorio actual.\n");
-    printf(COLOR_GREEN "    leer" COLOR_RESET
-           "   <archivo>        Muestra el contenido de un archivo.\n");
-    printf(COLOR_GREEN "    crear" COLOR_RESET
+    imprimir(COLOR_YELLOW "\n  Archivos y Directorios:\n" COLOR_RESET);
+    imprimir(COLOR_GREEN "    listar" COLOR_RESET
+           "  [dir]             Lista archivos del directorio actual.\n");
+    imprimir(COLOR_GREEN "    leer" COLOR_RESET
+           " [-ntfp] <arch...>  Muestra archivos (o su inicio/final).\n");
+    imprimir(COLOR_GREEN "    crear" COLOR_RESET
            "  <archivo>        Crea un archivo nuevo.\n");
-    printf(COLOR_GREEN "    eliminar" COLOR_RESET
+    imprimir(COLOR_GREEN "    eliminar" COLOR_RESET
            " <archivo>        Elimina un archivo con confirmación.\n");
-    printf(COLOR_GREEN "    buscar" COLOR_RESET
-           "  <texto> <arch>  Busca texto dentro de un archivo.\n");
+    imprimir(COLOR_GREEN "    buscar" COLOR_RESET
+           " [-e] <txt> <ruta> Busca texto o regex en archivos.\n");
+    imprimir(COLOR_GREEN "    contar" COLOR_RESET
+           "  [-lwc] <arch...> Cuenta líneas, palabras y bytes.\n");
+    imprimir(COLOR_GREEN "    checksum" COLOR_RESET
+           " <ruta...>       Sumas de verificación (CRC32C/XXH64).\n");
+    imprimir(COLOR_GREEN "    uso" COLOR_RESET
+           "     [ruta...]        Espacio ocupado por directorio (du).\n");
+    imprimir(COLOR_GREEN "    indexar" COLOR_RESET
+           " <dir>            Índice de trigramas para buscar.\n");
+    imprimir(COLOR_GREEN "    ordenar" COLOR_RESET
+           " [-nru] <arch...> Ordena líneas (sort externo).\n");
+    imprimir(COLOR_GREEN "    comparar" COLOR_RESET
+           " [-U N] <a> <b>  Diferencias entre dos archivos (diff -u).\n");
+    imprimir(COLOR_GREEN "    reemplazar" COLOR_RESET
+           " <a> <b> <...> Reemplaza texto en archivos (atómico).\n");
+    imprimir(COLOR_GREEN "    cd" COLOR_RESET
+           "      [ruta | -]      Cambia el directorio de trabajo.\n");
+    imprimir(COLOR_GREEN "    pwd" COLOR_RESET
+           "                     Muestra el directorio de trabajo.\n");
+    imprimir(COLOR_GREEN "    pushd" COLOR_RESET
+           "  [ruta]          Guarda el directorio y cambia a otro.\n");
+    imprimir(COLOR_GREEN "    popd" COLOR_RESET
+           "                    Vuelve al último directorio guardado.\n");
+    imprimir(COLOR_GREEN "    dirs" COLOR_RESET
+           "                    Muestra la pila de directorios.\n");
 
-    printf(COLOR_YELLOW "\n  Sistema:\n" COLOR_RESET);
-    printf(COLOR_GREEN "    tiempo" COLOR_RESET
+    imprimir(COLOR_YELLOW "\n  Sistema:\n" COLOR_RESET);
+    imprimir(COLOR_GREEN "    tiempo" COLOR_RESET
            "                   Muestra la fecha y hora actual.\n");
-    printf(COLOR_GREEN "    calc" COLOR_RESET
+    imprimir(COLOR_GREEN "    calc" COLOR_RESET
            "   <n1> <op> <n2>  Realiza cálculos (+, -, *, /).\n");
-    printf(COLOR_GREEN "    limpiar" COLOR_RESET
+    imprimir(COLOR_GREEN "    limpiar" COLOR_RESET
            "                  Limpia la pantalla.\n");
+    imprimir(COLOR_GREEN "    vigilar" COLOR_RESET
+           " <ruta> [cmd]     Vigila cambios y re-ejecuta un comando.\n");
+    imprimir(COLOR_GREEN "    memoria" COLOR_RESET
+           " [-v] [N]         Muestra asignaciones y memoria viva por sitio.\n");
 
-    printf(COLOR_YELLOW "\n  Shell:\n" COLOR_RESET);
-    printf(COLOR_GREEN "    prompt" COLOR_RESET
+    imprimir(COLOR_YELLOW "\n  Shell:\n" COLOR_RESET);
+    imprimir(COLOR_GREEN "    prompt" COLOR_RESET
            "  <texto>          Cambia el indicador de la shell.\n");
-    printf(COLOR_GREEN "    ayuda" COLOR_RESET
+    imprimir(COLOR_GREEN "    ayuda" COLOR_RESET
            "   [comando]       Muestra esta ayuda o la de un comando.\n");
-    printf(COLOR_GREEN "    salir" COLOR_RESET
+    imprimir(COLOR_GREEN "    paralelo" COLOR_RESET
+           " [-j N] [arch]  Ejecuta comandos en paralelo.\n");
+    imprimir(COLOR_GREEN "    medir" COLOR_RESET
+           "   [-r N] <cmd>    Mide tiempo, memoria y contadores de CPU.\n");
+    imprimir(COLOR_GREEN "    limite" COLOR_RESET
+           "  [-t s] [-m MB]  Ejecuta un comando con tiempo y memoria máximos.\n");
+    imprimir(COLOR_GREEN "    alias" COLOR_RESET
+           "   [n=cmd ...]     Lista o define alias (también en ~/.eafitosrc).\n");
+    imprimir(COLOR_GREEN "    salir" COLOR_RESET
            "                   Termina la sesión.\n");
 
-    printf(COLOR_DIM "\n  Tip: escribe " COLOR_RESET
+    /* Comandos instalados como plugins (descripción tomada del índice) */
+    plugins_listar();
+
+    imprimir(COLOR_DIM "\n  Tip: escribe " COLOR_RESET
            COLOR_CYAN "'ayuda <comando>'" COLOR_RESET
-           COLOR_DIM " para ver detalles, uso y ejemplos.\n\n" COLOR_RESET);
+           COLOR_DIM " para ver detalles, uso y ejemplos.\n" COLOR_RESET);
+    imprimir(COLOR_DIM "  Redirecciones: " COLOR_RESET
+           COLOR_CYAN "< archivo, > archivo, >> archivo, 2> archivo, &> archivo" COLOR_RESET "\n");
+    imprimir(COLOR_DIM "  Salida para scripts: " COLOR_RESET
+           COLOR_CYAN "<comando> --formato json|tsv" COLOR_RESET "\n\n");
 }
 
 /**
  * @brief Comando SALIR
  *
- * Finaliza la ejecución del programa de forma controlada.
+ * Marca la sesión actual como terminada. El bucle que la atiende
+ * (loop_shell o el servidor) se encarga de cerrarla de forma controlada.
  *
  * @param args Argumentos del comando (ignorados).
  */
 void cmd_salir(char **args) {
-    printf(COLOR_CYAN "Saliendo de EAFITos. ¡Hasta pronto!\n" COLOR_RESET);
-    exit(0);
+    imprimir(COLOR_CYAN "Saliendo de EAFITos. ¡Hasta pronto!\n" COLOR_RESET);
+    sesion_actual->activa = 0;
     (void)args;
 }
 
@@ -100,9 +148,20 @@ void cmd_salir(char **args) {
  */
 void cmd_tiempo(char **args) {
     time_t t = time(NULL);
-    struct tm tm = *localtime(&t);
+    struct tm tm;
+    localtime_r(&t, &tm); /* Versión reentrante: no usa un buffer estático */
+
+    if (formato_estructurado()) {
+        char fecha[32];
+        strftime(fecha, sizeof(fecha), "%Y-%m-%dT%H:%M:%S", &tm);
+        registro_abrir();
+        registro_texto("fecha", fecha);
+        registro_entero("epoch", (long long)t);
+        registro_cerrar();
+        return;
+    }
 
-    printf(COLOR_CYAN "  Fecha y Hora del Sistema: " COLOR_RESET
+    imprimir(COLOR_CYAN "  Fecha y Hora del Sistema: " COLOR_RESET
            COLOR_BOLD "%02d-%02d-%04d %02d:%02d:%02d\n" COLOR_RESET,
            tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900,
            tm.tm_hour, tm.tm_min, tm.tm_sec);
@@ -120,16 +179,132 @@ void cmd_tiempo(char **args) {
  */
 void cmd_prompt(char **args) {
     if (args[1] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET "prompt <nuevo_texto>\n");
-        printf(COLOR_DIM "Prompt actual: '%s'\n" COLOR_RESET,
-               prompt_personalizado);
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "prompt <nuevo_texto>\n");
+        imprimir(COLOR_DIM "Prompt actual: '%s'\n" COLOR_RESET,
+               sesion_actual->prompt);
         return;
     }
 
     /* strncpy garantiza que no desbordamos MAX_PROMPT_LEN */
-    strncpy(prompt_personalizado, args[1], MAX_PROMPT_LEN - 1);
-    prompt_personalizado[MAX_PROMPT_LEN - 1] = '\0'; /* Asegurar terminador */
+    strncpy(sesion_actual->prompt, args[1], MAX_PROMPT_LEN - 1);
+    sesion_actual->prompt[MAX_PROMPT_LEN - 1] = '\0'; /* Asegurar terminador */
+
+    imprimir(COLOR_GREEN "Prompt actualizado a: " COLOR_BOLD "'%s'\n" COLOR_RESET,
+           sesion_actual->prompt);
+}
 
-    printf(COLOR_GREEN "Prompt actualizado a: " COLOR_BOLD "'%s'\n" COLOR_RESET,
-           prompt_personalizado);
+/** @brief Muestra un alias como `nombre=tokens...` (o un registro). */
+static void mostrar_alias(const char *nombre, const char *tokens, size_t n, void *usuario) {
+    const char *solo = usuario;
+    if (solo != NULL && strcmp(solo, nombre) != 0) {
+        return;
+    }
+    /* Los tokens van seguidos en memoria: se imprimen separados por espacios */
+    char linea[1024];
+    size_t usado = 0;
+    for (size_t i = 0; i < n && usado < sizeof(linea); i++) {
+        usado += (size_t)snprintf(linea + usado, sizeof(linea) - usado, "%s%s",
+                                  i ? " " : "", tokens);
+        tokens += strlen(tokens) + 1;
+    }
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("nombre", nombre);
+        registro_texto("comando", linea);
+        registro_cerrar();
+        return;
+    }
+    imprimir(COLOR_GREEN "%s" COLOR_RESET "=%s\n", nombre, linea);
+}
+
+/**
+ * @brief Comando ALIAS
+ *
+ * Sin argumentos lista los alias (del rc y de la sesión); con un nombre
+ * muestra ese; con `nombre=comando args...` lo define hasta que termine
+ * la shell. Los alias de la sesión tapan a los del rc.
+ *
+ * @param args args[1] = nombre o nombre=comando; args[2..] = más argumentos.
+ */
+void cmd_alias(char **args) {
+    if (args[1] == NULL) {
+        alias_recorrer(mostrar_alias, NULL);
+        return;
+    }
+    char *igual = strchr(args[1], '=');
+    if (igual == NULL) {
+        if (args[2] != NULL) {
+            imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "alias [nombre | nombre=comando [argumentos...]]\n");
+        } else if (!alias_existe(args[1])) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No existe el alias '%s'.\n", args[1]);
+        } else {
+            alias_recorrer(mostrar_alias, args[1]);
+        }
+        return;
+    }
+    if (igual == args[1] || (igual[1] == '\0' && args[2] == NULL)) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "alias nombre=comando [argumentos...]\n");
+        return;
+    }
+    *igual = '\0';
+    const char *nombre = args[1];
+    /* "ll=listar" trae el comando pegado; "ll= listar" lo trae en args[2] */
+    char **tokens = args + 2;
+    if (igual[1] != '\0') {
+        args[1] = igual + 1;
+        tokens = args + 1;
+    }
+    if (alias_definir(nombre, tokens) != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+    }
+}
+
+/** @brief Muestra una variable como `NOMBRE=valor` (o un registro). */
+static void mostrar_variable(const char *nombre, const char *valor, void *usuario) {
+    (void)usuario;
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("nombre", nombre);
+        registro_texto("valor", valor);
+        registro_cerrar();
+        return;
+    }
+    imprimir(COLOR_GREEN "%s" COLOR_RESET "=%s\n", nombre, valor);
+}
+
+/**
+ * @brief Comando EXPORT
+ *
+ * Sin argumentos lista las variables del rc y de la sesión; con
+ * `NOMBRE=valor` define una solo para esta sesión (otros clientes del
+ * servidor no la ven). Los programas que lanzan `paralelo`, `medir` y
+ * `limite` la reciben en su entorno.
+ *
+ * @param args args[1..] = NOMBRE=valor (el valor puede seguir en más argumentos).
+ */
+void cmd_export(char **args) {
+    if (args[1] == NULL) {
+        variables_recorrer(mostrar_variable, NULL);
+        return;
+    }
+    char *igual = strchr(args[1], '=');
+    if (igual == NULL || igual == args[1]) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "export [NOMBRE=valor]\n");
+        return;
+    }
+    *igual = '\0';
+    /* "export A=uno dos" guarda "uno dos", como en el rc */
+    char valor[1024];
+    size_t usado = (size_t)snprintf(valor, sizeof(valor), "%s", igual + 1);
+    for (int i = 2; args[i] != NULL && usado < sizeof(valor); i++) {
+        usado += (size_t)snprintf(valor + usado, sizeof(valor) - usado, " %s", args[i]);
+    }
+    if (variable_definir(args[1], valor) != 0) {
+        if (errno == EINVAL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Nombre de variable inválido: '%s'.\n",
+                           args[1]);
+        } else {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        }
+    }
 }
@@ -0,0 +1,198 @@
+/**
+ * @file dir_commands.c
+ * @brief Directorio de trabajo de la sesión: cd, pwd, pushd, popd y dirs.
+ *
+ * El directorio de trabajo no es el del proceso: cada sesión guarda un
+ * descriptor abierto (dir_fd) y los comandos de archivos resuelven las
+ * rutas relativas contra él con openat(), fstatat(), unlinkat(), etc. Así
+ * las sesiones del servidor y los hilos de `paralelo` no se pisan el
+ * directorio entre sí. La ruta canónica se guarda junto al descriptor y
+ * se actualiza solo al cambiar de directorio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "commands.h"
+#include "shell.h"    /* imprimir(), sesion_actual, sesion_cambiar_directorio() */
+#include "colors.h"
+#include "formato.h"
+#include "configuracion.h" /* variable_obtener (HOME) */
+
+/** @brief Cambia de directorio o informa por qué no se pudo. */
+static int cambiar_a(const char *ruta) {
+    if (sesion_cambiar_directorio(sesion_actual, ruta) != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se puede cambiar a '%s': %s\n",
+                       ruta, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/** @brief Muestra el directorio actual y la pila, de la cima al fondo. */
+static void mostrar_pila(void) {
+    const char *actual = sesion_directorio(sesion_actual);
+    size_t n = sesion_actual->n_pila;
+    if (formato_estructurado()) {
+        for (size_t i = 0; i <= n; i++) {
+            registro_abrir();
+            registro_entero("indice", (long long)i);
+            registro_texto("directorio", i == 0 ? (actual ? actual : "?")
+                                                : sesion_actual->pila_dirs[n - i]);
+            registro_cerrar();
+        }
+        return;
+    }
+    imprimir(COLOR_GREEN " %2d  %s\n" COLOR_RESET, 0, actual ? actual : "?");
+    for (size_t i = 1; i <= n; i++) {
+        imprimir(COLOR_DIM " %2zu" COLOR_RESET "  %s\n", i, sesion_actual->pila_dirs[n - i]);
+    }
+}
+
+/**
+ * @brief Comando CD
+ *
+ * Sin argumentos va a $HOME; con "-" vuelve al directorio anterior (y lo
+ * muestra). Solo cambia el directorio de la sesión.
+ *
+ * @param args args[1] = ruta, "-" u omitido.
+ */
+void cmd_cd(char **args) {
+    if (args[1] != NULL && args[2] != NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "cd [ruta | -]\n");
+        return;
+    }
+    if (args[1] == NULL) {
+        const char *home = variable_obtener("HOME");
+        if (home == NULL || home[0] == '\0') {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " HOME no está definido.\n");
+            return;
+        }
+        cambiar_a(home);
+        return;
+    }
+    if (strcmp(args[1], "-") == 0) {
+        if (sesion_actual->directorio_anterior == NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No hay directorio anterior.\n");
+            return;
+        }
+        /* Copia: el cambio reemplaza directorio_anterior */
+        char *anterior = strdup(sesion_actual->directorio_anterior);
+        if (anterior != NULL && cambiar_a(anterior) == 0) {
+            imprimir("%s\n", anterior);
+        }
+        free(anterior);
+        return;
+    }
+    cambiar_a(args[1]);
+}
+
+/**
+ * @brief Comando PWD
+ *
+ * Muestra la ruta canónica del directorio de la sesión (de la caché, sin
+ * llamar a getcwd()).
+ *
+ * @param args Sin argumentos.
+ */
+void cmd_pwd(char **args) {
+    (void)args;
+    const char *dir = sesion_directorio(sesion_actual);
+    if (dir == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo obtener el directorio actual.\n");
+        return;
+    }
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("directorio", dir);
+        registro_cerrar();
+        return;
+    }
+    imprimir("%s\n", dir);
+}
+
+/**
+ * @brief Comando PUSHD
+ *
+ * Con una ruta, guarda el directorio actual en la pila y cambia a ella.
+ * Sin argumentos, intercambia el directorio actual con la cima de la pila.
+ *
+ * @param args args[1] = ruta (opcional).
+ */
+void cmd_pushd(char **args) {
+    ContextoSesion *s = sesion_actual;
+    if (args[1] != NULL && args[2] != NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "pushd [ruta]\n");
+        return;
+    }
+    const char *actual = sesion_directorio(s);
+    char *guardado = (actual != NULL) ? strdup(actual) : NULL;
+    if (guardado == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo obtener el directorio actual.\n");
+        return;
+    }
+
+    if (args[1] == NULL) {
+        if (s->n_pila == 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " La pila de directorios está vacía.\n");
+            free(guardado);
+            return;
+        }
+        if (cambiar_a(s->pila_dirs[s->n_pila - 1]) != 0) {
+            free(guardado);
+            return;
+        }
+        free(s->pila_dirs[s->n_pila - 1]);
+        s->pila_dirs[s->n_pila - 1] = guardado;
+        mostrar_pila();
+        return;
+    }
+
+    char **pila = realloc(s->pila_dirs, (s->n_pila + 1) * sizeof(char *));
+    if (pila == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        free(guardado);
+        return;
+    }
+    s->pila_dirs = pila;
+    if (cambiar_a(args[1]) != 0) {
+        free(guardado);
+        return;
+    }
+    s->pila_dirs[s->n_pila++] = guardado;
+    mostrar_pila();
+}
+
+/**
+ * @brief Comando POPD
+ *
+ * Saca la cima de la pila y cambia a ese directorio.
+ *
+ * @param args Sin argumentos.
+ */
+void cmd_popd(char **args) {
+    ContextoSesion *s = sesion_actual;
+    (void)args;
+    if (s->n_pila == 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " La pila de directorios está vacía.\n");
+        return;
+    }
+    if (cambiar_a(s->pila_dirs[s->n_pila - 1]) != 0) {
+        return;   /* Se conserva: el usuario puede corregir y reintentar */
+    }
+    free(s->pila_dirs[--s->n_pila]);
+    mostrar_pila();
+}
+
+/**
+ * @brief Comando DIRS
+ *
+ * Lista el directorio actual (0) y la pila de pushd, de la cima al fondo.
+ *
+ * @param args Sin argumentos.
+ */
+void cmd_dirs(char **args) {
+    (void)args;
+    mostrar_pila();
+}
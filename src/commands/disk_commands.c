@@ -0,0 +1,428 @@
+/**
+ * @file disk_commands.c
+ * @brief Comando uso (du): espacio ocupado por árboles de directorios.
+ *
+ * Cada directorio es una tarea del grupo con robo de trabajo (hilos.c):
+ * la tarea lee sus entradas con getdents64, mide los archivos con statx
+ * relativo al descriptor del directorio y encola un subdirectorio por
+ * cada hijo. Así un árbol con millones de archivos ocupa todos los
+ * núcleos en lugar de un único recorrido recursivo.
+ */
+
+#define _GNU_SOURCE   /* statx */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>    /* DT_DIR */
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>   /* SYS_getdents64 */
+#include "commands.h"
+#include "shell.h"
+#include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "hilos.h"
+
+/** @brief Buffer de getdents64 (cientos de entradas por llamada). */
+#define USO_BUFFER_DIR (64 * 1024)
+
+/** @brief Directorios que se muestran por defecto. */
+#define USO_MOSTRAR 20
+
+/** @brief Fragmentos del conjunto de inodos (cada uno con su mutex). */
+#define USO_FRAGMENTOS 64
+
+/** @brief Entrada devuelta por getdents64 (no está en los headers de glibc). */
+struct dirent_linux64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/** @brief Un directorio del árbol. */
+typedef struct NodoDir {
+    struct NodoDir *padre;
+    struct NodoDir *siguiente;   /**< Pila de todos los nodos (para liberar) */
+    char *nombre;                /**< Relativo al padre; la ruta dada si es raíz */
+    int fd;                      /**< Abierto mientras algún hijo no se haya abierto */
+    int refs;                    /**< 1 (su recorrido) + hijos sin abrir (atómico) */
+    int profundidad;
+    uint64_t propio;             /**< Bytes del directorio y sus archivos directos */
+    uint64_t total;              /**< Bytes del subárbol completo */
+} NodoDir;
+
+/** @brief Un fragmento del conjunto de inodos ya contados. */
+typedef struct {
+    pthread_mutex_t m;
+    uint64_t *claves;   /**< Pares (dispositivo, inodo); (0, 0) = libre */
+    size_t usados, capacidad;
+} FragmentoInodos;
+
+/** @brief Estado compartido de un recorrido. */
+typedef struct {
+    int dir_fd;                  /**< Directorio de la sesión */
+    int aparente;                /**< 1: tamaño en bytes; 0: bloques en disco */
+    NodoDir *nodos;              /**< Pila de nodos (atómica) */
+    uint64_t n_archivos;         /**< (atómico) */
+    uint64_t n_dirs;             /**< (atómico) */
+    uint64_t n_errores;          /**< (atómico) */
+    FragmentoInodos inodos[USO_FRAGMENTOS];
+} DatosUso;
+
+/**
+ * @brief Registra un inodo con varios enlaces duros.
+ * @return 1 si es la primera vez que se ve (hay que contarlo), 0 si no.
+ */
+static int inodo_nuevo(DatosUso *u, uint64_t dev, uint64_t ino) {
+    uint64_t h = (ino * 0x9E3779B97F4A7C15ULL) ^ dev;
+    FragmentoInodos *f = &u->inodos[h % USO_FRAGMENTOS];
+    int nuevo = 1;
+
+    pthread_mutex_lock(&f->m);
+    if (f->usados * 2 >= f->capacidad) {
+        /* Crecer y reubicar (direccionamiento abierto, factor de carga <= 1/2) */
+        size_t cap = f->capacidad ? f->capacidad * 2 : 1024;
+        uint64_t *nuevas = calloc(cap * 2, sizeof(uint64_t));
+        if (nuevas == NULL) {
+            pthread_mutex_unlock(&f->m);
+            return 1; /* Sin memoria: se cuenta de más antes que de menos */
+        }
+        for (size_t i = 0; i < f->capacidad; i++) {
+            uint64_t d = f->claves[2 * i], n = f->claves[2 * i + 1];
+            if (d == 0 && n == 0) continue;
+            size_t j = ((n * 0x9E3779B97F4A7C15ULL) >> 20) & (cap - 1);
+            while (nuevas[2 * j] != 0 || nuevas[2 * j + 1] != 0) j = (j + 1) & (cap - 1);
+            nuevas[2 * j] = d;
+            nuevas[2 * j + 1] = n;
+        }
+        free(f->claves);
+        f->claves = nuevas;
+        f->capacidad = cap;
+    }
+
+    size_t j = ((ino * 0x9E3779B97F4A7C15ULL) >> 20) & (f->capacidad - 1);
+    for (;; j = (j + 1) & (f->capacidad - 1)) {
+        uint64_t d = f->claves[2 * j], n = f->claves[2 * j + 1];
+        if (d == 0 && n == 0) {
+            f->claves[2 * j] = dev;
+            f->claves[2 * j + 1] = ino;
+            f->usados++;
+            break;
+        }
+        if (d == dev && n == ino) {
+            nuevo = 0;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&f->m);
+    return nuevo;
+}
+
+/** @brief Bytes que ocupa un archivo según el modo elegido. */
+static uint64_t tam_statx(const DatosUso *u, const struct statx *stx) {
+    return u->aparente ? stx->stx_size : stx->stx_blocks * 512;
+}
+
+/** @brief Escribe en buf la ruta completa de un nodo. */
+static void ruta_nodo(const NodoDir *n, char *buf, size_t tam) {
+    if (n->padre == NULL) {
+        snprintf(buf, tam, "%s", n->nombre);
+        return;
+    }
+    ruta_nodo(n->padre, buf, tam);
+    size_t l = strlen(buf);
+    snprintf(buf + l, tam - l, "%s%s", (l > 0 && buf[l - 1] == '/') ? "" : "/", n->nombre);
+}
+
+/** @brief Suelta una referencia al descriptor de un nodo y lo cierra en la última. */
+static void soltar_nodo(NodoDir *n) {
+    if (__atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) == 0 && n->fd >= 0) {
+        close(n->fd);
+        n->fd = -1;
+    }
+}
+
+/** @brief Crea un nodo y lo añade a la pila de nodos del recorrido. */
+static NodoDir *crear_nodo(DatosUso *u, NodoDir *padre, const char *nombre) {
+    NodoDir *n = calloc(1, sizeof(NodoDir));
+    if (n == NULL || (n->nombre = strdup(nombre)) == NULL) {
+        free(n);
+        return NULL;
+    }
+    n->padre = padre;
+    n->fd = -1;
+    n->refs = 1;
+    n->profundidad = padre ? padre->profundidad + 1 : 0;
+
+    n->siguiente = __atomic_load_n(&u->nodos, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&u->nodos, &n->siguiente, n, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        /* n->siguiente ya tiene el nuevo tope: reintentar */
+    }
+    return n;
+}
+
+/**
+ * @brief Abre el directorio de un nodo relativo al descriptor de su padre.
+ */
+static int abrir_nodo(DatosUso *u, NodoDir *n) {
+    int base = n->padre ? n->padre->fd : u->dir_fd;
+    int fd = openat(base, n->nombre, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 && (errno == EMFILE || errno == ENFILE)) {
+        /* Demasiados directorios abiertos a la vez: ruta completa */
+        char ruta[4096];
+        ruta_nodo(n, ruta, sizeof(ruta));
+        fd = openat(u->dir_fd, ruta, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    if (n->padre != NULL) {
+        soltar_nodo(n->padre);
+    }
+    return fd;
+}
+
+/**
+ * @brief Tarea: recorre un directorio, mide sus archivos y encola sus hijos.
+ */
+static void tarea_directorio(void *tarea, GrupoRobo *grupo, void *datos) {
+    NodoDir *n = tarea;
+    DatosUso *u = datos;
+    const unsigned mascara = STATX_TYPE | STATX_SIZE | STATX_BLOCKS | STATX_NLINK | STATX_INO;
+    if (cancelacion_solicitada()) {
+        n->fd = -1;   /* Ctrl+C: el resto del árbol no se recorre */
+        return;
+    }
+
+    n->fd = abrir_nodo(u, n);
+    if (n->fd < 0) {
+        __atomic_add_fetch(&u->n_errores, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_add_fetch(&u->n_dirs, 1, __ATOMIC_RELAXED);
+
+    struct statx stx;
+    if (statx(n->fd, "", AT_EMPTY_PATH, mascara, &stx) == 0) {
+        n->propio += tam_statx(u, &stx);
+    }
+
+    char *buffer = malloc(USO_BUFFER_DIR);
+    uint64_t archivos = 0;
+    for (;;) {
+        long leidos = (buffer != NULL) ? syscall(SYS_getdents64, n->fd, buffer, USO_BUFFER_DIR) : -1;
+        if (leidos <= 0) {
+            if (leidos < 0) __atomic_add_fetch(&u->n_errores, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        for (long pos = 0; pos < leidos;) {
+            struct dirent_linux64 *e = (struct dirent_linux64 *)(buffer + pos);
+            pos += e->d_reclen;
+            const char *nom = e->d_name;
+            if (nom[0] == '.' && (nom[1] == '\0' || (nom[1] == '.' && nom[2] == '\0'))) {
+                continue;
+            }
+
+            int es_dir = (e->d_type == DT_DIR);
+            if (!es_dir) {
+                if (statx(n->fd, nom, AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, mascara, &stx) != 0) {
+                    __atomic_add_fetch(&u->n_errores, 1, __ATOMIC_RELAXED);
+                    continue;
+                }
+                es_dir = S_ISDIR(stx.stx_mode); /* d_type era DT_UNKNOWN */
+            }
+
+            if (es_dir) {
+                NodoDir *hijo = crear_nodo(u, n, nom);
+                if (hijo == NULL) {
+                    __atomic_add_fetch(&u->n_errores, 1, __ATOMIC_RELAXED);
+                    continue;
+                }
+                /* El hijo necesita nuestro fd abierto hasta que se abra */
+                __atomic_add_fetch(&n->refs, 1, __ATOMIC_RELAXED);
+                if (grupo_encolar(grupo, hijo) != 0) {
+                    soltar_nodo(n);
+                    __atomic_add_fetch(&u->n_errores, 1, __ATOMIC_RELAXED);
+                }
+                continue;
+            }
+
+            /* Con varios enlaces duros, el inodo se cuenta una sola vez */
+            if (stx.stx_nlink > 1 &&
+                !inodo_nuevo(u, ((uint64_t)stx.stx_dev_major << 32) | stx.stx_dev_minor, stx.stx_ino)) {
+                continue;
+            }
+            n->propio += tam_statx(u, &stx);
+            archivos++;
+        }
+    }
+    free(buffer);
+
+    __atomic_add_fetch(&u->n_archivos, archivos, __ATOMIC_RELAXED);
+    soltar_nodo(n);
+}
+
+/** @brief Formatea un tamaño con la unidad más adecuada (B, KB, MB, ...). */
+static void formatear_tam(uint64_t bytes, char *buf, size_t tam) {
+    static const char *unidades[] = { "B", "KB", "MB", "GB", "TB", "PB" };
+    double v = (double)bytes;
+    int u = 0;
+    while (v >= 1024.0 && u < 5) {
+        v /= 1024.0;
+        u++;
+    }
+    if (u == 0) {
+        snprintf(buf, tam, "%llu B", (unsigned long long)bytes);
+    } else {
+        snprintf(buf, tam, "%.1f %s", v, unidades[u]);
+    }
+}
+
+static int por_profundidad_desc(const void *a, const void *b) {
+    const NodoDir *x = *(NodoDir *const *)a, *y = *(NodoDir *const *)b;
+    return (x->profundidad < y->profundidad) - (x->profundidad > y->profundidad);
+}
+
+static int por_total_desc(const void *a, const void *b) {
+    const NodoDir *x = *(NodoDir *const *)a, *y = *(NodoDir *const *)b;
+    return (x->total < y->total) - (x->total > y->total);
+}
+
+/** @brief Imprime una fila (tamaño y ruta) o su registro. */
+static void imprimir_fila_uso(uint64_t bytes, const char *ruta, const char *color) {
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("ruta", ruta);
+        registro_entero("bytes", (long long)bytes);
+        registro_cerrar();
+        return;
+    }
+    char tam[32];
+    formatear_tam(bytes, tam, sizeof(tam));
+    imprimir(COLOR_YELLOW "%10s" COLOR_RESET "  %s%s%s\n", tam, color, ruta, COLOR_RESET);
+}
+
+/**
+ * @brief Suma cada subárbol en su padre e imprime los directorios más grandes.
+ */
+static void mostrar_uso(DatosUso *u, size_t n_mostrar) {
+    size_t n = 0;
+    for (NodoDir *x = u->nodos; x != NULL; x = x->siguiente) n++;
+    NodoDir **v = malloc((n ? n : 1) * sizeof(NodoDir *));
+    if (v == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        return;
+    }
+    size_t i = 0;
+    for (NodoDir *x = u->nodos; x != NULL; x = x->siguiente) v[i++] = x;
+
+    /* Los más profundos primero: cada hijo está completo al sumarlo al padre */
+    qsort(v, n, sizeof(NodoDir *), por_profundidad_desc);
+    for (i = 0; i < n; i++) {
+        v[i]->total += v[i]->propio;
+        if (v[i]->padre != NULL) v[i]->padre->total += v[i]->total;
+    }
+
+    qsort(v, n, sizeof(NodoDir *), por_total_desc);
+    char ruta[4096];
+    for (i = 0; i < n && i < n_mostrar; i++) {
+        ruta_nodo(v[i], ruta, sizeof(ruta));
+        imprimir_fila_uso(v[i]->total, ruta, v[i]->padre ? COLOR_BLUE : COLOR_BOLD COLOR_BLUE);
+    }
+    if (n > n_mostrar && !formato_estructurado()) {
+        imprimir(COLOR_DIM "  ... %zu directorios más (usa -n para ver más)\n" COLOR_RESET, n - n_mostrar);
+    }
+    free(v);
+}
+
+/**
+ * @brief Comando USO (du)
+ *
+ * Mide el espacio de uno o varios árboles de directorios en paralelo y
+ * muestra los directorios más grandes, ordenados por tamaño. Los archivos
+ * con varios enlaces duros se cuentan una sola vez.
+ *
+ * @param args [-b] [-n N] [ruta...] (por defecto el directorio actual).
+ */
+void cmd_uso(char **args) {
+    DatosUso *u = calloc(1, sizeof(DatosUso));
+    if (u == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        return;
+    }
+    u->dir_fd = sesion_actual->dir_fd;
+    size_t n_mostrar = USO_MOSTRAR;
+
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-b") == 0) {
+            u->aparente = 1;
+        } else if (strcmp(args[i], "-n") == 0 && args[i + 1] != NULL && atoi(args[i + 1]) > 0) {
+            n_mostrar = (size_t)atoi(args[++i]);
+        } else {
+            imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "uso [-b] [-n N] [ruta...]\n");
+            free(u);
+            return;
+        }
+    }
+    for (int f = 0; f < USO_FRAGMENTOS; f++) {
+        pthread_mutex_init(&u->inodos[f].m, NULL);
+    }
+
+    /* Raíces: los directorios son tareas; los archivos sueltos se miden aquí */
+    char *por_defecto[] = { ".", NULL };
+    char **rutas = (args[i] != NULL) ? &args[i] : por_defecto;
+    size_t n_rutas = 0;
+    while (rutas[n_rutas] != NULL) n_rutas++;
+    void **raices = calloc(n_rutas, sizeof(void *));
+    size_t n_raices = 0;
+    uint64_t sueltos = 0;
+
+    for (size_t r = 0; raices != NULL && r < n_rutas; r++) {
+        struct statx stx;
+        if (statx(u->dir_fd, rutas[r], AT_SYMLINK_NOFOLLOW, STATX_TYPE | STATX_SIZE | STATX_BLOCKS, &stx) != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", rutas[r], strerror(errno));
+        } else if (!S_ISDIR(stx.stx_mode)) {
+            imprimir_fila_uso(tam_statx(u, &stx), rutas[r], "");
+            sueltos++;
+        } else {
+            NodoDir *raiz = crear_nodo(u, NULL, rutas[r]);
+            if (raiz != NULL) raices[n_raices++] = raiz;
+        }
+    }
+
+    ejecutar_con_robo(raices, n_raices, 0, tarea_directorio, u);
+
+    if (cancelacion_solicitada()) {
+        n_raices = 0;   /* Totales incompletos: no se muestran */
+    }
+    if (n_raices > 0) {
+        mostrar_uso(u, n_mostrar);
+    }
+    if (n_raices > 0 && !formato_estructurado()) {
+        imprimir(COLOR_DIM "  %llu archivos en %llu directorios" COLOR_RESET,
+                 (unsigned long long)(u->n_archivos + sueltos), (unsigned long long)u->n_dirs);
+        if (u->n_errores > 0) {
+            imprimir(COLOR_RED " (%llu entradas sin acceso)" COLOR_RESET,
+                     (unsigned long long)u->n_errores);
+        }
+        imprimir("\n");
+    }
+
+    for (NodoDir *x = u->nodos, *sig; x != NULL; x = sig) {
+        sig = x->siguiente;
+        if (x->fd >= 0) close(x->fd);
+        free(x->nombre);
+        free(x);
+    }
+    for (int f = 0; f < USO_FRAGMENTOS; f++) {
+        pthread_mutex_destroy(&u->inodos[f].m);
+        free(u->inodos[f].claves);
+    }
+    free(raices);
+    free(u);
+}
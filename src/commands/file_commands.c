@@ -7,90 +7,711 @@
  * Salida colorizada con colors.h.
  */
 
+#define _GNU_SOURCE   /* fopencookie */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
 #include <dirent.h>    /* Librería POSIX para manejo de directorios */
 #include <sys/stat.h>  /* Para stat() y verificar si es directorio */
+#include <sys/ioctl.h>
 #include "commands.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
 #include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "lectura_lotes.h"
+#include "lineas.h"
+#include "visor.h"
+#include "vigilancia.h"
+
+/** @brief Líneas que muestra `leer -f` si no se indica -t. */
+#define LEER_LINEAS_SEGUIR 10
 
 /**
  * @brief Comando LISTAR (ls)
  *
- * Abre el directorio actual (".") e itera sobre sus entradas.
+ * Abre el directorio de la sesión (o el indicado, relativo a él) con
+ * openat() e itera sobre sus entradas; cada una se examina con fstatat()
+ * relativo al directorio abierto.
  * Coloriza: directorios en azul, archivos en blanco.
  *
- * @param args Argumentos del comando (ignorados en esta versión).
+ * @param args args[1] = directorio a listar (opcional).
  */
 void cmd_listar(char **args) {
     DIR *d;
     struct dirent *dir;
     int n_archivos = 0;
+    int estructurado = formato_estructurado();
+    const char *ruta = (args[1] != NULL) ? args[1] : ".";
 
-    d = opendir(".");
+    int fd = openat(sesion_actual->dir_fd, ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    d = (fd >= 0) ? fdopendir(fd) : NULL;
     if (d) {
-        printf(COLOR_CYAN " Contenido del directorio actual:\n" COLOR_RESET);
-        printf(COLOR_DIM " ─────────────────────────────\n" COLOR_RESET);
+        if (!estructurado && args[1] == NULL) {
+            imprimir(COLOR_CYAN " Contenido del directorio actual:\n" COLOR_RESET);
+            imprimir(COLOR_DIM " ─────────────────────────────\n" COLOR_RESET);
+        } else if (!estructurado) {
+            imprimir(COLOR_CYAN " Contenido de '%s':\n" COLOR_RESET, ruta);
+            imprimir(COLOR_DIM " ─────────────────────────────\n" COLOR_RESET);
+        }
 
         while ((dir = readdir(d)) != NULL) {
             /* Filtramos las entradas especiales "." y ".." */
             if (strcmp(dir->d_name, ".") != 0 && strcmp(dir->d_name, "..") != 0) {
-                /* Usamos stat para detectar si es directorio */
+                /* Usamos fstatat para detectar si es directorio */
                 struct stat st;
-                if (stat(dir->d_name, &st) == 0 && S_ISDIR(st.st_mode)) {
+                int hay_stat = fstatat(dirfd(d), dir->d_name, &st, 0) == 0;
+                if (estructurado) {
+                    registro_abrir();
+                    registro_texto("nombre", dir->d_name);
+                    registro_texto("tipo", (hay_stat && S_ISDIR(st.st_mode)) ? "directorio" : "archivo");
+                    registro_entero("bytes", hay_stat ? (long long)st.st_size : -1);
+                    registro_cerrar();
+                } else if (hay_stat && S_ISDIR(st.st_mode)) {
                     /* Directorio: color azul con indicador "/" */
-                    printf(COLOR_BLUE "  📁 %s/\n" COLOR_RESET, dir->d_name);
+                    imprimir(COLOR_BLUE "  📁 %s/\n" COLOR_RESET, dir->d_name);
                 } else {
                     /* Archivo regular: color blanco */
-                    printf("  📄 %s\n", dir->d_name);
+                    imprimir("  📄 %s\n", dir->d_name);
                 }
                 n_archivos++;
             }
         }
         closedir(d);
 
-        printf(COLOR_DIM " ─────────────────────────────\n" COLOR_RESET);
-        printf(COLOR_DIM "  Total: %d elemento(s)\n" COLOR_RESET, n_archivos);
+        if (!estructurado) {
+            imprimir(COLOR_DIM " ─────────────────────────────\n" COLOR_RESET);
+            imprimir(COLOR_DIM "  Total: %d elemento(s)\n" COLOR_RESET, n_archivos);
+        }
     } else {
-        printf(COLOR_RED "[ERROR] No se pudo abrir el directorio actual.\n"
-               COLOR_RESET);
-        perror("opendir");
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir el directorio '%s': %s\n",
+                       ruta, strerror(errno));
+        if (fd >= 0) close(fd);
+    }
+}
+
+/** @brief Líneas de un archivo convertidas en registros (salida estructurada). */
+typedef struct {
+    const char *ruta;   /**< Archivo de origen */
+    uint64_t linea;     /**< Número de la próxima línea, o 0 si no se conoce (-t, -f) */
+    char *resto;        /**< Línea incompleta del bloque anterior */
+    size_t len, cap;
+} LineasRegistro;
+
+static void registrar_linea(LineasRegistro *l, const char *texto, size_t len) {
+    registro_abrir();
+    registro_texto("archivo", l->ruta);
+    if (l->linea > 0) {
+        registro_entero("linea", (long long)l->linea++);
     }
+    registro_texto_n("texto", texto, len);
+    registro_cerrar();
+}
 
-    (void)args;
+static int guardar_resto_lineas(LineasRegistro *l, const char *datos, size_t n) {
+    if (l->len + n > l->cap) {
+        size_t cap = l->cap ? l->cap : 256;
+        while (cap < l->len + n) cap *= 2;
+        char *nuevo = realloc(l->resto, cap);
+        if (nuevo == NULL) return -1;
+        l->resto = nuevo;
+        l->cap = cap;
+    }
+    memcpy(l->resto + l->len, datos, n);
+    l->len += n;
+    return 0;
+}
+
+static ssize_t escribir_lineas(void *cookie, const char *buf, size_t n) {
+    LineasRegistro *l = cookie;
+    const char *p = buf, *fin = buf + n;
+    const char *nl;
+    while ((nl = memchr(p, '\n', (size_t)(fin - p))) != NULL) {
+        if (l->len > 0) {
+            if (guardar_resto_lineas(l, p, (size_t)(nl - p)) != 0) return -1;
+            registrar_linea(l, l->resto, l->len);
+            l->len = 0;
+        } else {
+            registrar_linea(l, p, (size_t)(nl - p));
+        }
+        p = nl + 1;
+    }
+    if (p < fin && guardar_resto_lineas(l, p, (size_t)(fin - p)) != 0) return -1;
+    return (ssize_t)n;
+}
+
+static int cerrar_lineas(void *cookie) {
+    LineasRegistro *l = cookie;
+    if (l->len > 0) {
+        registrar_linea(l, l->resto, l->len);   /* Última línea sin '\n' */
+    }
+    free(l->resto);
+    free(l);
+    return 0;
 }
 
 /**
- * @brief Comando LEER (cat)
+ * @brief Destino del contenido de un archivo.
  *
- * Abre un archivo en modo lectura y muestra su contenido con
- * cabecera y pie decorativos.
+ * En modo texto es la salida de la sesión; con salida estructurada, un
+ * flujo que emite un registro {archivo, linea, texto} por cada línea.
+ * Se cierra con cerrar_salida_contenido().
  *
- * @param args args[1] debe contener la ruta o nombre del archivo a leer.
+ * @param primera Número de la primera línea que se escribirá, o 0 si no se conoce.
  */
-void cmd_leer(char **args) {
-    if (args[1] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET "leer <nombre_archivo>\n");
+static FILE *abrir_salida_contenido(const char *ruta, uint64_t primera) {
+    if (!formato_estructurado()) {
+        return salida_sesion();
+    }
+    LineasRegistro *l = calloc(1, sizeof(*l));
+    cookie_io_functions_t funciones = { .write = escribir_lineas, .close = cerrar_lineas };
+    FILE *f = (l != NULL) ? fopencookie(l, "w", funciones) : NULL;
+    if (f == NULL) {
+        free(l);
+        return salida_sesion();
+    }
+    setvbuf(f, NULL, _IONBF, 0);   /* En orden con los mensajes de error */
+    l->ruta = ruta;
+    l->linea = primera;
+    return f;
+}
+
+static void cerrar_salida_contenido(FILE *f) {
+    if (f != salida_sesion()) {
+        fclose(f);
+    }
+}
+
+/** @brief Estado de cmd_leer mientras recibe bloques de lectura_lotes. */
+typedef struct {
+    size_t actual;     /**< Índice del archivo cuya cabecera ya se imprimió */
+    int con_cabecera;  /**< 1 si ya se imprimió la cabecera de 'actual' */
+    FILE *salida;      /**< Destino del contenido de 'actual' */
+} EstadoLeer;
+
+/**
+ * @brief Callback de leer_archivos_en_lote(): imprime cada bloque.
+ */
+static int imprimir_bloque(const BloqueArchivo *b, void *usuario) {
+    EstadoLeer *e = usuario;
+    int decorar = !formato_estructurado();
+
+    if (b->error != 0) {
+        if (e->con_cabecera && e->actual == b->indice) {
+            /* Falló a mitad de la lectura: cerramos la caja igualmente */
+            cerrar_salida_contenido(e->salida);
+            if (decorar) imprimir(COLOR_DIM "\n─────────────────────────────────\n" COLOR_RESET);
+        }
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                       " No se pudo abrir '%s'. Verifique que exista.\n", b->ruta);
+        e->con_cabecera = 0;
+        return 0;
+    }
+
+    if (!e->con_cabecera || e->actual != b->indice) {
+        /* Cabecera decorativa */
+        if (decorar) {
+            imprimir(COLOR_CYAN "\n ── Contenido de '%s' ──\n" COLOR_RESET, b->ruta);
+            imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+        }
+        e->salida = abrir_salida_contenido(b->ruta, 1);
+        e->actual = b->indice;
+        e->con_cabecera = 1;
+    }
+
+    fwrite(b->datos, 1, b->longitud, e->salida);
+
+    if (b->fin) {
+        cerrar_salida_contenido(e->salida);
+        if (decorar) imprimir(COLOR_DIM "\n─────────────────────────────────\n\n" COLOR_RESET);
+        e->con_cabecera = 0;
+    }
+    return 0;
+}
+
+/** @brief Callback de vigilancia_leer(): solo importa que hubo eventos. */
+static void ignorar_evento(const char *ruta, int tipo, void *usuario) {
+    (void)ruta;
+    (void)tipo;
+    (void)usuario;
+}
+
+/**
+ * @brief Muestra lo que se va añadiendo a un archivo (`leer -f`).
+ *
+ * Se bloquea en inotify (vigilancia.h) hasta que el archivo cambia y
+ * entonces copia los bytes nuevos; no hay sondeo periódico. Si el archivo
+ * se trunca, se vuelve a leer desde el principio. Termina con Ctrl+C.
+ *
+ * @param fd Descriptor del archivo.
+ * @param ruta Ruta del archivo (para la vigilancia y los mensajes).
+ * @param pos Desplazamiento hasta donde ya se mostró.
+ * @param salida Destino del contenido (ver abrir_salida_contenido()).
+ */
+static void seguir_archivo(int fd, const char *ruta, off_t pos, FILE *salida) {
+    Vigilancia *v = vigilancia_crear(sesion_actual->dir_fd, ruta, 0);
+    if (v == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se puede seguir '%s': %s\n", ruta, strerror(errno));
+        return;
+    }
+
+    /* Igual que en vigilar: Ctrl+C llega como un descriptor más en poll() */
+    int fd_cancelar = cancelacion_fd();
+
+    imprimir(COLOR_DIM "── Siguiendo '%s' (Ctrl+C para terminar) ──\n" COLOR_RESET, ruta);
+    fflush(salida);
+    fflush(salida_sesion());
+
+    for (;;) {
+        struct pollfd pfd[3] = {
+            { vigilancia_fd(v), POLLIN, 0 },
+            { fd_cancelar, POLLIN, 0 },
+            { limite_fd(), POLLIN, 0 },   /* Plazo de `limite` */
+        };
+        int r = poll(pfd, 3, -1);
+        if (r < 0 && errno != EINTR) {
+            break;
+        }
+        if (r > 0 && (pfd[1].revents & POLLIN)) {
+            cancelacion_reiniciar();
+            break;
+        }
+        if (r > 0 && (pfd[2].revents & POLLIN)) {
+            break;
+        }
+        if (r > 0 && (pfd[0].revents & POLLIN)) {
+            if (vigilancia_leer(v, ignorar_evento, NULL) < 0) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Lectura de eventos: %s\n", strerror(errno));
+                break;
+            }
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size < pos) {
+                imprimir(COLOR_DIM "\n── '%s' se truncó; se lee desde el principio ──\n" COLOR_RESET, ruta);
+                pos = 0;
+            }
+            off_t nuevo = lineas_copiar_desde(fd, pos, salida);
+            if (nuevo < 0) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo leer '%s': %s\n", ruta, strerror(errno));
+                break;
+            }
+            pos = nuevo;
+            fflush(salida);
+            fflush(salida_sesion());
+        }
+    }
+
+    vigilancia_destruir(v);
+    imprimir(COLOR_DIM "\n── Fin del seguimiento ──\n" COLOR_RESET);
+}
+
+/**
+ * @brief Muestra las primeras o las últimas líneas de un archivo.
+ *
+ * @param ruta Archivo.
+ * @param primeras Líneas del principio (-n), o 0.
+ * @param ultimas Líneas del final (-t), o 0.
+ * @param seguir 1 para seguir mostrando lo que se añada (-f).
+ */
+static void leer_extremo(const char *ruta, uint64_t primeras, uint64_t ultimas, int seguir) {
+    int fd = openat(sesion_actual->dir_fd, ruta, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                       " No se pudo abrir '%s'. Verifique que exista.\n", ruta);
+        return;
+    }
+
+    struct stat st;
+    if (primeras == 0 && (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                       " '%s' no es un archivo regular: -t y -f necesitan leerlo desde el final.\n", ruta);
+        close(fd);
+        return;
+    }
+
+    int decorar = !formato_estructurado();
+    FILE *salida = abrir_salida_contenido(ruta, (primeras > 0) ? 1 : 0);
+    off_t fin = 0;
+    int r = 0;
+    if (decorar) {
+        imprimir(COLOR_CYAN "\n ── Contenido de '%s' ──\n" COLOR_RESET, ruta);
+        imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+    }
+    if (primeras > 0) {
+        r = lineas_copiar_primeras(fd, primeras, salida);
+    } else {
+        off_t desde = lineas_desde_final(fd, st.st_size, ultimas);
+        fin = (desde < 0) ? -1 : lineas_copiar_desde(fd, desde, salida);
+        r = (fin < 0) ? -1 : 0;
+    }
+    if (r != 0) {
+        if (errno != ECANCELED) {   /* Ctrl+C: la shell ya avisa */
+            imprimir_error(COLOR_RED "\n[ERROR]" COLOR_RESET " No se pudo leer '%s': %s\n", ruta, strerror(errno));
+        }
+    } else if (seguir) {
+        seguir_archivo(fd, ruta, fin, salida);
+    }
+    cerrar_salida_contenido(salida);
+    if (decorar) imprimir(COLOR_DIM "\n─────────────────────────────────\n\n" COLOR_RESET);
+    close(fd);
+}
+
+/* ============================================================
+ * Paginador (leer -p)
+ * ============================================================ */
+
+/** @brief Estado del paginador. */
+typedef struct {
+    Visor *v;
+    FILE *salida;
+    const char *ruta;
+    off_t arriba;          /**< Comienzo de la primera línea visible */
+    off_t debajo;          /**< Comienzo de la línea después de la pantalla (-1: fin) */
+    int filas, columnas;   /**< Tamaño del área de texto */
+    char busqueda[256];    /**< Último texto buscado */
+    int busqueda_atras;    /**< Dirección de la última búsqueda */
+    char mensaje[128];     /**< Aviso para la barra de estado */
+} Paginador;
+
+/** @brief Lee el tamaño de la terminal (24x80 si no se puede). */
+static void medir_terminal(Paginador *p) {
+    struct winsize ws;
+    if (ioctl(fileno(p->salida), TIOCGWINSZ, &ws) == 0 && ws.ws_row > 1 && ws.ws_col > 0) {
+        p->filas = ws.ws_row - 1;
+        p->columnas = ws.ws_col;
+    } else {
+        p->filas = 23;
+        p->columnas = 80;
+    }
+}
+
+/**
+ * @brief Escribe una línea recortada al ancho de la terminal.
+ *
+ * Los tabuladores se expanden, los caracteres de control se muestran como
+ * '.' y los bytes de continuación UTF-8 no ocupan columna.
+ */
+static void pintar_linea(Paginador *p, const char *s, size_t n) {
+    int col = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if ((c & 0xC0) == 0x80) {
+            fputc(c, p->salida);
+            continue;
+        }
+        if (col >= p->columnas) break;
+        if (c == '\t') {
+            do { fputc(' ', p->salida); } while (++col % 8 != 0 && col < p->columnas);
+            continue;
+        }
+        if (c == '\r' && i + 1 == n) break;
+        fputc((c < 32 || c == 127) ? '.' : c, p->salida);
+        col++;
+    }
+}
+
+/** @brief Dibuja la pantalla completa y la barra de estado. */
+static void pintar(Paginador *p) {
+    char linea[4096];
+    size_t max = (size_t)p->columnas * 4 < sizeof(linea) ? (size_t)p->columnas * 4 : sizeof(linea);
+    off_t pos = p->arriba;
+
+    fputs("\033[H", p->salida);
+    for (int f = 0; f < p->filas; f++) {
+        fputs("\033[K", p->salida);
+        if (pos >= 0 && pos < visor_tamano(p->v)) {
+            pintar_linea(p, linea, visor_copiar_linea(p->v, pos, linea, max));
+            pos = visor_siguiente(p->v, pos);
+        } else {
+            pos = -1;
+            fputs(COLOR_DIM "~" COLOR_RESET, p->salida);
+        }
+        fputs("\r\n", p->salida);
+    }
+    p->debajo = pos;
+
+    /* Barra de estado */
+    off_t tam = visor_tamano(p->v), indexado;
+    int64_t total = visor_total_lineas(p->v, &indexado);
+    int64_t numero = visor_numero_linea(p->v, p->arriba);
+    int pct = (tam > 0) ? (int)((p->debajo < 0 ? tam : p->debajo) * 100 / tam) : 100;
+    char estado[512], num[32], tot[48];
+    if (numero > 0) snprintf(num, sizeof(num), "%lld", (long long)numero);
+    else snprintf(num, sizeof(num), "?");
+    if (total >= 0) snprintf(tot, sizeof(tot), "%lld", (long long)total);
+    else snprintf(tot, sizeof(tot), "? (indexando %d%%)", (int)(tam > 0 ? indexado * 100 / tam : 100));
+    snprintf(estado, sizeof(estado), " %s  línea %s/%s  %d%%  %s", p->ruta, num, tot, pct,
+             p->mensaje[0] ? p->mensaje : "q:salir /?:buscar n/N :línea o %");
+    fputs("\033[K\033[7m", p->salida);
+    pintar_linea(p, estado, strlen(estado));
+    fputs("\033[0m", p->salida);
+    fflush(p->salida);
+    p->mensaje[0] = '\0';
+}
+
+/** @brief Pide un texto en la barra de estado. @return 0 si se canceló (buf queda a medias). */
+static int pedir_texto(Paginador *p, const char *indicador, char *buf, size_t tam) {
+    size_t n = 0;
+    fprintf(p->salida, "\033[%d;1H\033[K%s", p->filas + 1, indicador);
+    fflush(p->salida);
+    for (;;) {
+        char c;
+        if (read(STDIN_FILENO, &c, 1) != 1) return 0;
+        if (c == '\r' || c == '\n') break;
+        if (c == 27 || c == 3) return 0;
+        if ((c == 127 || c == 8) && n > 0) {
+            n--;
+            fputs("\b \b", p->salida);
+        } else if ((unsigned char)c >= 32 && c != 127 && n + 1 < tam) {
+            buf[n++] = c;
+            fputc(c, p->salida);
+        }
+        fflush(p->salida);
+    }
+    buf[n] = '\0';
+    return n > 0;
+}
+
+/** @brief Busca 'p->busqueda' desde la pantalla actual y la mueve ahí. */
+static void repetir_busqueda(Paginador *p, int atras) {
+    if (p->busqueda[0] == '\0') {
+        snprintf(p->mensaje, sizeof(p->mensaje), "No hay búsqueda previa");
+        return;
+    }
+    off_t sig = visor_siguiente(p->v, p->arriba);
+    off_t desde = atras ? p->arriba : (sig < 0 ? visor_tamano(p->v) : sig);
+    off_t r = visor_buscar(p->v, desde, p->busqueda, strlen(p->busqueda), atras);
+    if (r < 0) {
+        snprintf(p->mensaje, sizeof(p->mensaje), "'%.60s' no encontrado", p->busqueda);
+    } else {
+        p->arriba = r;
+    }
+}
+
+/** @brief Retrocede 'n' líneas desde la primera visible. */
+static void subir(Paginador *p, int n) {
+    while (n-- > 0 && p->arriba > 0) {
+        p->arriba = visor_anterior(p->v, p->arriba);
+    }
+}
+
+/** @brief Muestra la última pantalla del archivo. */
+static void ir_al_final(Paginador *p) {
+    off_t tam = visor_tamano(p->v);
+    p->arriba = (tam > 0) ? visor_inicio_linea(p->v, tam - 1) : 0;
+    subir(p, p->filas - 1);
+}
+
+/** @brief Salta a "N" (línea) o "N%" (porcentaje del tamaño). */
+static void saltar(Paginador *p, const char *destino) {
+    char *fin;
+    unsigned long long n = strtoull(destino, &fin, 10);
+    if (fin == destino || (*fin != '\0' && strcmp(fin, "%") != 0)) {
+        snprintf(p->mensaje, sizeof(p->mensaje), "Destino no válido: %.40s", destino);
+    } else if (*fin == '%') {
+        if (n > 100) n = 100;
+        off_t pos = (off_t)((long double)visor_tamano(p->v) * n / 100);
+        p->arriba = (pos > 0) ? visor_inicio_linea(p->v, pos < visor_tamano(p->v) ? pos : pos - 1) : 0;
+    } else {
+        p->arriba = visor_ir_linea(p->v, n);
+    }
+}
+
+/**
+ * @brief Paginador interactivo sobre un archivo (`leer -p`).
+ *
+ * La terminal se pone en modo crudo y se usa la pantalla alternativa.
+ * Solo se lee lo que se muestra (ver visor.h); el índice de líneas se
+ * construye en segundo plano y la barra de estado se refresca mientras
+ * avanza.
+ */
+static void paginar(const char *ruta) {
+    FILE *salida = salida_sesion();
+    if (!isatty(STDIN_FILENO) || !isatty(fileno(salida))) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " leer -p necesita una terminal interactiva.\n");
+        return;
+    }
+    int fd = openat(sesion_actual->dir_fd, ruta, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir '%s' como archivo regular.\n", ruta);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    Visor *v = visor_abrir(fd, st.st_size);
+    if (v == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        close(fd);
         return;
     }
 
-    FILE *fp = fopen(args[1], "r");
-    if (fp == NULL) {
-        printf(COLOR_RED "[ERROR]" COLOR_RESET
-               " No se pudo abrir '%s'. Verifique que exista.\n", args[1]);
+    struct termios original, crudo;
+    tcgetattr(STDIN_FILENO, &original);
+    crudo = original;
+    crudo.c_lflag &= ~(ICANON | ECHO | ISIG);
+    crudo.c_cc[VMIN] = 1;
+    crudo.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &crudo);
+    fputs("\033[?1049h\033[?25l", salida);   /* Pantalla alternativa, sin cursor */
+
+    Paginador p = { .v = v, .salida = salida, .ruta = ruta };
+    for (int seguir = 1; seguir;) {
+        medir_terminal(&p);
+        pintar(&p);
+
+        /* Mientras se indexa, refrescar la barra cada medio segundo */
+        struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+        int espera = (visor_total_lineas(v, NULL) < 0) ? 500 : -1;
+        if (poll(&pfd, 1, espera) <= 0) continue;
+
+        /* Una tecla por lectura, para no consumir lo que se escriba después
+         * (p. ej. ":1500" pegado); el resto de una secuencia ESC llega junto */
+        char tecla[8];
+        if (read(STDIN_FILENO, tecla, 1) != 1) break;
+        ssize_t n = 1;
+        if (tecla[0] == 27 && poll(&pfd, 1, 30) > 0) {
+            ssize_t r = read(STDIN_FILENO, tecla + 1, 3);
+            if (r > 0) n += r;
+        }
+        char c = tecla[0];
+        if (c == 27 && n >= 3 && tecla[1] == '[') {
+            /* Flechas, Inicio/Fin y RePág/AvPág */
+            c = (tecla[2] == 'A') ? 'k' : (tecla[2] == 'B') ? 'j'
+              : (tecla[2] == 'H') ? 'g' : (tecla[2] == 'F') ? 'G'
+              : (tecla[2] == '5') ? 'b' : (tecla[2] == '6') ? ' ' : 0;
+        }
+
+        char texto[256];
+        switch (c) {
+        case 'q': case 3:
+            seguir = 0;
+            break;
+        case ' ': case 'f':
+            if (p.debajo >= 0) p.arriba = p.debajo;
+            break;
+        case 'b':
+            subir(&p, p.filas);
+            break;
+        case 'j': case '\r': case '\n': {
+            off_t sig = visor_siguiente(v, p.arriba);
+            if (sig >= 0 && p.debajo >= 0) p.arriba = sig;
+            break;
+        }
+        case 'k':
+            subir(&p, 1);
+            break;
+        case 'g':
+            p.arriba = 0;
+            break;
+        case 'G':
+            ir_al_final(&p);
+            break;
+        case ':':
+            if (pedir_texto(&p, ":", texto, sizeof(texto))) saltar(&p, texto);
+            break;
+        case '/': case '?':
+            /* Se edita aparte: ESC no debe dejar la búsqueda anterior a medias */
+            if (pedir_texto(&p, (c == '/') ? "/" : "?", texto, sizeof(texto))) {
+                snprintf(p.busqueda, sizeof(p.busqueda), "%s", texto);
+                p.busqueda_atras = (c == '?');
+                repetir_busqueda(&p, p.busqueda_atras);
+            }
+            break;
+        case 'n':
+            repetir_busqueda(&p, p.busqueda_atras);
+            break;
+        case 'N':
+            repetir_busqueda(&p, !p.busqueda_atras);
+            break;
+        default:
+            break;
+        }
+    }
+
+    fputs("\033[?25h\033[?1049l", salida);
+    fflush(salida);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &original);
+    visor_cerrar(v);
+    close(fd);
+}
+
+/** @brief Convierte el número de líneas de -n/-t (0 si no es válido). */
+static uint64_t leer_numero_lineas(const char *texto) {
+    char *fin;
+    errno = 0;
+    unsigned long long n = strtoull(texto, &fin, 10);
+    if (texto[0] < '0' || texto[0] > '9' || *fin != '\0' || errno != 0) {
+        return 0;
+    }
+    return n;
+}
+
+/**
+ * @brief Comando LEER (cat, head, tail)
+ *
+ * Muestra el contenido de uno o varios archivos con cabecera y pie
+ * decorativos. Con varios archivos, las aperturas y lecturas se envían
+ * en lotes (io_uring cuando está disponible, ver lectura_lotes.c).
+ * -n N muestra solo las primeras N líneas; -t N las últimas N, leyendo
+ * el archivo hacia atrás desde el final; -f sigue mostrando lo que se
+ * añada al archivo (con -t, después de sus últimas líneas); -p abre un
+ * paginador interactivo.
+ *
+ * @param args [-n N | -t N | -p] [-f] <archivo> [archivo...]
+ */
+void cmd_leer(char **args) {
+    uint64_t primeras = 0, ultimas = 0;
+    int seguir = 0, paginado = 0, valido = 1;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-n") == 0 && args[i + 1] != NULL) {
+            primeras = leer_numero_lineas(args[++i]);
+            valido = valido && primeras > 0;
+        } else if (strcmp(args[i], "-t") == 0 && args[i + 1] != NULL) {
+            ultimas = leer_numero_lineas(args[++i]);
+            valido = valido && ultimas > 0;
+        } else if (strcmp(args[i], "-f") == 0) {
+            seguir = 1;
+        } else if (strcmp(args[i], "-p") == 0) {
+            paginado = 1;
+        } else {
+            valido = 0;
+            break;
+        }
+    }
+    size_t n = 0;
+    while (args[i + n] != NULL) {
+        n++;
+    }
+    if (n == 0 || !valido || (primeras > 0 && (ultimas > 0 || seguir)) ||
+        (paginado && (primeras > 0 || ultimas > 0 || seguir)) || ((seguir || paginado) && n > 1)) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "leer [-n N | -t N | -p] [-f] <nombre_archivo> [archivo...]\n");
+        if ((seguir || paginado) && n > 1) {
+            imprimir(COLOR_DIM "  -f y -p trabajan sobre un solo archivo.\n" COLOR_RESET);
+        }
         return;
     }
 
-    /* Cabecera decorativa */
-    printf(COLOR_CYAN "\n ── Contenido de '%s' ──\n" COLOR_RESET, args[1]);
-    printf(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+    if (paginado) {
+        paginar(args[i]);
+        return;
+    }
 
-    char ch;
-    while ((ch = fgetc(fp)) != EOF) {
-        putchar(ch);
+    if (primeras > 0 || ultimas > 0 || seguir) {
+        if (seguir && ultimas == 0) {
+            ultimas = LEER_LINEAS_SEGUIR;
+        }
+        for (size_t k = 0; k < n; k++) {
+            leer_extremo(args[i + k], primeras, ultimas, seguir);
+        }
+        return;
     }
 
-    printf(COLOR_DIM "\n─────────────────────────────────\n\n" COLOR_RESET);
-    fclose(fp);
+    EstadoLeer estado = { 0, 0, NULL };
+    leer_archivos_en_lote(sesion_actual->dir_fd, (const char *const *)&args[i], n,
+                          imprimir_bloque, &estado);
 }
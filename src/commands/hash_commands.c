@@ -0,0 +1,523 @@
+/**
+ * @file hash_commands.c
+ * @brief Comando checksum: sumas de verificación paralelas y manifiestos.
+ *
+ * El trabajo se hace en dos fases sobre el grupo de hilos (hilos.c):
+ *  1. Una tarea por archivo: lo abre y, si es pequeño, lo suma entero.
+ *     Los archivos grandes se mapean en memoria y se parten en trozos.
+ *  2. Una tarea por trozo de archivo grande. Al final se unen los trozos:
+ *     los CRC32C se combinan matemáticamente (el resultado es el CRC32C
+ *     normal del archivo) y los XXH64 forman un árbol de un nivel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "shell.h"
+#include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "hash.h"
+#include "hilos.h"
+#include "utils.h"
+
+/** @brief Archivos mayores que esto se reparten en trozos entre hilos. */
+#define CHECKSUM_TROZO (8u * 1024 * 1024)
+
+/** @brief Buffer de lectura de los archivos pequeños. */
+#define CHECKSUM_BUFFER (64 * 1024)
+
+/** @brief Algoritmos disponibles. */
+typedef enum {
+    ALG_CRC32C,
+    ALG_XXH64
+} AlgoritmoSuma;
+
+/** @brief Estado y resultado de un archivo. */
+typedef struct {
+    const char *ruta;
+    int error;                   /**< errno si no se pudo sumar */
+    uint64_t suma;               /**< Resultado final */
+    const unsigned char *mapa;   /**< Archivo grande mapeado (o NULL) */
+    size_t tam;
+    size_t n_trozos;             /**< Trozos del archivo grande (0 si no lo es) */
+    uint64_t *sumas_trozos;      /**< Suma de cada trozo */
+} ArchivoSuma;
+
+/** @brief Un trozo de archivo grande. */
+typedef struct {
+    size_t archivo;
+    size_t indice;
+} TrozoSuma;
+
+/** @brief Datos compartidos por las tareas. */
+typedef struct {
+    int dir_fd;
+    AlgoritmoSuma alg;
+    ArchivoSuma *archivos;
+    TrozoSuma *trozos;
+} TrabajoSuma;
+
+/** @brief Suma un bloque en memoria con el algoritmo elegido. */
+static uint64_t sumar_bloque(AlgoritmoSuma alg, const void *datos, size_t n) {
+    return (alg == ALG_CRC32C) ? crc32c(0, datos, n) : xxh64(datos, n, 0);
+}
+
+/**
+ * @brief Suma un descriptor completo leyéndolo por bloques.
+ */
+static int sumar_stream(int fd, AlgoritmoSuma alg, uint64_t *suma) {
+    unsigned char buffer[CHECKSUM_BUFFER];
+    uint32_t crc = 0;
+    EstadoXXH64 e;
+    xxh64_iniciar(&e, 0);
+
+    for (;;) {
+        if (cancelacion_solicitada()) return ECANCELED;
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return errno;
+        if (n == 0) break;
+        if (alg == ALG_CRC32C) {
+            crc = crc32c(crc, buffer, (size_t)n);
+        } else {
+            xxh64_actualizar(&e, buffer, (size_t)n);
+        }
+    }
+    *suma = (alg == ALG_CRC32C) ? crc : xxh64_final(&e);
+    return 0;
+}
+
+/**
+ * @brief Fase 1: abre un archivo; lo suma si es pequeño o lo mapea si es grande.
+ */
+static void tarea_archivo(size_t i, void *datos) {
+    TrabajoSuma *t = datos;
+    ArchivoSuma *a = &t->archivos[i];
+    if (cancelacion_solicitada()) {
+        a->error = ECANCELED;
+        return;
+    }
+
+    int fd = openat(t->dir_fd, a->ruta, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        a->error = errno;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        a->error = errno;
+        close(fd);
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        a->error = EISDIR;
+        close(fd);
+        return;
+    }
+
+    if (S_ISREG(st.st_mode) && (uint64_t)st.st_size > CHECKSUM_TROZO) {
+        size_t tam = (size_t)st.st_size;
+        size_t n_trozos = (tam + CHECKSUM_TROZO - 1) / CHECKSUM_TROZO;
+        void *m = mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+        a->sumas_trozos = calloc(n_trozos, sizeof(uint64_t));
+        if (m != MAP_FAILED && a->sumas_trozos != NULL) {
+            madvise(m, tam, MADV_SEQUENTIAL);
+            a->mapa = m;
+            a->tam = tam;
+            a->n_trozos = n_trozos;
+            close(fd); /* El mapa sigue siendo válido sin el descriptor */
+            return;
+        }
+        if (m != MAP_FAILED) munmap(m, tam);
+        free(a->sumas_trozos);
+        a->sumas_trozos = NULL;
+    }
+
+    a->error = sumar_stream(fd, t->alg, &a->suma);
+    close(fd);
+}
+
+/**
+ * @brief Fase 2: suma un trozo de un archivo grande.
+ */
+static void tarea_trozo(size_t i, void *datos) {
+    TrabajoSuma *t = datos;
+    ArchivoSuma *a = &t->archivos[t->trozos[i].archivo];
+    size_t k = t->trozos[i].indice;
+    if (cancelacion_solicitada()) {
+        return;   /* calcular_sumas() marca el archivo como cancelado */
+    }
+    size_t inicio = k * CHECKSUM_TROZO;
+    size_t fin = (a->tam - inicio > CHECKSUM_TROZO) ? inicio + CHECKSUM_TROZO : a->tam;
+    a->sumas_trozos[k] = sumar_bloque(t->alg, a->mapa + inicio, fin - inicio);
+}
+
+/**
+ * @brief Une las sumas de los trozos de un archivo grande.
+ *
+ * CRC32C: se combinan en el CRC32C del archivo completo.
+ * XXH64: raíz = XXH64 de las sumas de los trozos (8 bytes little-endian c/u).
+ */
+static uint64_t unir_trozos(const ArchivoSuma *a, AlgoritmoSuma alg) {
+    if (alg == ALG_CRC32C) {
+        uint32_t crc = (uint32_t)a->sumas_trozos[0];
+        for (size_t k = 1; k < a->n_trozos; k++) {
+            size_t inicio = k * CHECKSUM_TROZO;
+            size_t largo = (a->tam - inicio > CHECKSUM_TROZO) ? CHECKSUM_TROZO : a->tam - inicio;
+            crc = crc32c_combinar(crc, (uint32_t)a->sumas_trozos[k], largo);
+        }
+        return crc;
+    }
+
+    EstadoXXH64 e;
+    xxh64_iniciar(&e, 0);
+    for (size_t k = 0; k < a->n_trozos; k++) {
+        unsigned char le[8];
+        for (int b = 0; b < 8; b++) le[b] = (unsigned char)(a->sumas_trozos[k] >> (8 * b));
+        xxh64_actualizar(&e, le, sizeof(le));
+    }
+    return xxh64_final(&e);
+}
+
+/**
+ * @brief Calcula en paralelo la suma de cada archivo de la lista.
+ *
+ * El resultado (o el errno) de cada archivo queda en su ArchivoSuma; con
+ * Ctrl+C los que no se terminaron quedan con ECANCELED.
+ */
+static void calcular_sumas(ArchivoSuma *archivos, size_t n, AlgoritmoSuma alg) {
+    TrabajoSuma t = { sesion_actual->dir_fd, alg, archivos, NULL };
+    ejecutar_en_paralelo(n, 0, tarea_archivo, &t);
+
+    size_t n_trozos = 0;
+    for (size_t i = 0; i < n; i++) n_trozos += archivos[i].n_trozos;
+
+    if (n_trozos > 0) {
+        t.trozos = malloc(n_trozos * sizeof(TrozoSuma));
+    }
+    if (t.trozos != NULL) {
+        size_t j = 0;
+        for (size_t i = 0; i < n; i++) {
+            for (size_t k = 0; k < archivos[i].n_trozos; k++) {
+                t.trozos[j++] = (TrozoSuma){ i, k };
+            }
+        }
+        ejecutar_en_paralelo(n_trozos, 0, tarea_trozo, &t);
+        free(t.trozos);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        ArchivoSuma *a = &archivos[i];
+        if (a->n_trozos > 0) {
+            if (cancelacion_solicitada()) {
+                a->error = ECANCELED;   /* Puede faltar la suma de algún trozo */
+            } else if (t.trozos != NULL) {
+                a->suma = unir_trozos(a, alg);
+            } else {
+                a->error = ENOMEM;
+            }
+            munmap((void *)a->mapa, a->tam);
+            free(a->sumas_trozos);
+            a->mapa = NULL;
+            a->sumas_trozos = NULL;
+        }
+    }
+}
+
+/** @brief Formatea una suma en hexadecimal (8 dígitos CRC32C, 16 XXH64). */
+static void formatear_suma(char *buf, size_t tam, AlgoritmoSuma alg, uint64_t suma) {
+    if (alg == ALG_CRC32C) {
+        snprintf(buf, tam, "%08llx", (unsigned long long)suma);
+    } else {
+        snprintf(buf, tam, "%016llx", (unsigned long long)suma);
+    }
+}
+
+/* =============================================================================
+ * Verificación contra un manifiesto
+ * ========================================================================== */
+
+/**
+ * @brief Informa el resultado de un archivo al verificar.
+ *
+ * En modo texto solo se muestran los problemas; con salida estructurada
+ * hay un registro por archivo, también los correctos ("ok").
+ */
+static void informar_verificacion(const char *estado, const char *color,
+                                  const char *ruta, const char *detalle) {
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("ruta", ruta);
+        registro_texto("estado", estado);
+        registro_texto("detalle", detalle ? detalle : "");
+        registro_cerrar();
+    } else if (detalle != NULL) {
+        imprimir("%s%-6s" COLOR_RESET " %s: %s\n", color, estado, ruta, detalle);
+    } else if (color != NULL) {
+        imprimir("%s%-6s" COLOR_RESET " %s\n", color, estado, ruta);
+    }
+}
+
+/** @brief Una línea del manifiesto: "<suma>  <ruta>". */
+typedef struct {
+    char *ruta;
+    uint64_t suma;
+    AlgoritmoSuma alg;
+} EntradaManifiesto;
+
+static int comparar_entradas(const void *a, const void *b) {
+    return strcmp(((const EntradaManifiesto *)a)->ruta, ((const EntradaManifiesto *)b)->ruta);
+}
+
+/**
+ * @brief Lee un manifiesto generado por 'checksum -o'.
+ * @return Número de entradas (en *entradas), o -1 si no se pudo leer.
+ */
+static long leer_manifiesto(const char *ruta, EntradaManifiesto **entradas) {
+    int fd = openat(sesion_actual->dir_fd, ruta, O_RDONLY | O_CLOEXEC);
+    FILE *f = (fd >= 0) ? fdopen(fd, "r") : NULL;
+    if (f == NULL) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    EntradaManifiesto *v = NULL;
+    size_t n = 0, cap = 0;
+    char *linea = NULL;
+    size_t tam_linea = 0;
+    ssize_t largo;
+    while ((largo = getline(&linea, &tam_linea, f)) > 0) {
+        if (linea[largo - 1] == '\n') linea[--largo] = '\0';
+        char *sep = strstr(linea, "  ");
+        if (sep == NULL) continue;
+        size_t digitos = (size_t)(sep - linea);
+        if (digitos != 8 && digitos != 16) continue;
+
+        if (n == cap) {
+            size_t nueva = cap ? cap * 2 : 64;
+            EntradaManifiesto *tmp = realloc(v, nueva * sizeof(*v));
+            if (tmp == NULL) break;
+            v = tmp;
+            cap = nueva;
+        }
+        v[n].suma = strtoull(linea, NULL, 16);
+        v[n].alg = (digitos == 8) ? ALG_CRC32C : ALG_XXH64;
+        v[n].ruta = strdup(sep + 2);
+        if (v[n].ruta == NULL) break;
+        n++;
+    }
+    free(linea);
+    fclose(f);
+    *entradas = v;
+    return (long)n;
+}
+
+/**
+ * @brief Modo --verificar: comprueba los archivos del manifiesto y, si se
+ *        dan directorios, informa de los archivos que no están en él.
+ */
+static void verificar_manifiesto(const char *manifiesto, char **dirs) {
+    EntradaManifiesto *entradas = NULL;
+    long leidas = leer_manifiesto(manifiesto, &entradas);
+    if (leidas < 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo leer '%s': %s\n",
+                       manifiesto, strerror(errno));
+        return;
+    }
+    size_t n = (size_t)leidas;
+
+    ArchivoSuma *archivos = calloc(n ? n : 1, sizeof(ArchivoSuma));
+    if (archivos == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        n = 0;
+    }
+
+    /* Un manifiesto tiene un solo algoritmo; si mezcla, se suma dos veces */
+    size_t ok = 0, fallos = 0, faltan = 0, nuevos = 0;
+    for (int pasada = ALG_CRC32C; archivos != NULL && pasada <= ALG_XXH64; pasada++) {
+        size_t m = 0;
+        size_t *indices = malloc((n ? n : 1) * sizeof(size_t));
+        if (indices == NULL) break;
+        for (size_t i = 0; i < n; i++) {
+            if (entradas[i].alg == (AlgoritmoSuma)pasada) {
+                memset(&archivos[m], 0, sizeof(ArchivoSuma));
+                archivos[m].ruta = entradas[i].ruta;
+                indices[m++] = i;
+            }
+        }
+        if (m > 0) {
+            calcular_sumas(archivos, m, (AlgoritmoSuma)pasada);
+            for (size_t k = 0; k < m && !cancelacion_solicitada(); k++) {
+                const EntradaManifiesto *e = &entradas[indices[k]];
+                if (archivos[k].error == ENOENT) {
+                    informar_verificacion("FALTA", COLOR_YELLOW, e->ruta, NULL);
+                    faltan++;
+                } else if (archivos[k].error != 0) {
+                    informar_verificacion("ERROR", COLOR_RED, e->ruta, strerror(archivos[k].error));
+                    fallos++;
+                } else if (archivos[k].suma != e->suma) {
+                    informar_verificacion("FALLO", COLOR_RED, e->ruta, NULL);
+                    fallos++;
+                } else {
+                    informar_verificacion("OK", NULL, e->ruta, NULL);
+                    ok++;
+                }
+            }
+        }
+        free(indices);
+    }
+
+    /* Archivos presentes en los directorios pero no en el manifiesto */
+    if (dirs[0] != NULL && n > 0) {
+        qsort(entradas, n, sizeof(EntradaManifiesto), comparar_entradas);
+    }
+    for (int d = 0; dirs[d] != NULL && !cancelacion_solicitada(); d++) {
+        ListaRutas lista = {0};
+        if (recolectar_archivos(sesion_actual->dir_fd, dirs[d], &lista) != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", dirs[d], strerror(errno));
+        }
+        for (size_t i = 0; i < lista.n; i++) {
+            EntradaManifiesto clave = { lista.rutas[i], 0, ALG_CRC32C };
+            if (strcmp(lista.rutas[i], manifiesto) != 0 &&
+                (n == 0 || bsearch(&clave, entradas, n, sizeof(EntradaManifiesto),
+                                   comparar_entradas) == NULL)) {
+                informar_verificacion("NUEVO", COLOR_CYAN, lista.rutas[i], NULL);
+                nuevos++;
+            }
+        }
+        lista_rutas_liberar(&lista);
+    }
+
+    if (!formato_estructurado() && !cancelacion_solicitada()) {
+        imprimir("%s%zu correctos, %zu con fallos, %zu faltantes, %zu nuevos.\n" COLOR_RESET,
+                 (fallos || faltan || nuevos) ? COLOR_RED : COLOR_GREEN,
+                 ok, fallos, faltan, nuevos);
+    }
+
+    for (size_t i = 0; i < (size_t)leidas; i++) free(entradas[i].ruta);
+    free(entradas);
+    free(archivos);
+}
+
+/**
+ * @brief Comando CHECKSUM
+ *
+ * Calcula CRC32C (por defecto) o XXH64 de archivos y directorios
+ * (recursivamente), en paralelo sobre todos los núcleos. Con -o guarda
+ * además un manifiesto que luego se comprueba con --verificar.
+ *
+ * @param args [-a crc32c|xxh64] [-o manifiesto] <ruta...>
+ *             o --verificar <manifiesto> [directorio...]
+ */
+void cmd_checksum(char **args) {
+    if (args[1] != NULL && strcmp(args[1], "--verificar") == 0) {
+        if (args[2] == NULL) {
+            imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "checksum --verificar <manifiesto> [directorio...]\n");
+            return;
+        }
+        verificar_manifiesto(args[2], &args[3]);
+        return;
+    }
+
+    AlgoritmoSuma alg = ALG_CRC32C;
+    const char *salida = NULL;
+    int i = 1;
+    int falta_valor = 0;
+    for (; args[i] != NULL && args[i][0] == '-'; i += 2) {
+        if (args[i + 1] == NULL) {
+            falta_valor = 1;
+            break;
+        }
+        if (strcmp(args[i], "-a") == 0) {
+            if (strcmp(args[i + 1], "crc32c") == 0) alg = ALG_CRC32C;
+            else if (strcmp(args[i + 1], "xxh64") == 0) alg = ALG_XXH64;
+            else {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Algoritmo '%s' no soportado (crc32c, xxh64).\n",
+                               args[i + 1]);
+                return;
+            }
+        } else if (strcmp(args[i], "-o") == 0) {
+            salida = args[i + 1];
+        } else {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Opción '%s' no reconocida.\n", args[i]);
+            return;
+        }
+    }
+    if (falta_valor || args[i] == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                       "checksum [-a crc32c|xxh64] [-o manifiesto] <ruta...>\n"
+                       "      checksum --verificar <manifiesto> [directorio...]\n");
+        return;
+    }
+
+    ListaRutas lista = {0};
+    for (; args[i] != NULL; i++) {
+        if (recolectar_archivos(sesion_actual->dir_fd, args[i], &lista) != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", args[i], strerror(errno));
+        }
+    }
+
+    ArchivoSuma *archivos = calloc(lista.n ? lista.n : 1, sizeof(ArchivoSuma));
+    if (archivos == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        free(archivos);
+        lista_rutas_liberar(&lista);
+        return;
+    }
+    for (size_t k = 0; k < lista.n; k++) {
+        archivos[k].ruta = lista.rutas[k];
+    }
+    calcular_sumas(archivos, lista.n, alg);
+    if (cancelacion_solicitada()) {
+        /* Ctrl+C: ni sumas a medias ni un manifiesto incompleto */
+        free(archivos);
+        lista_rutas_liberar(&lista);
+        return;
+    }
+
+    FILE *manifiesto = NULL;
+    if (salida != NULL) {
+        int fd = openat(sesion_actual->dir_fd, salida, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        manifiesto = (fd >= 0) ? fdopen(fd, "w") : NULL;
+        if (manifiesto == NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo crear '%s': %s\n", salida, strerror(errno));
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    char hex[17];
+    for (size_t k = 0; k < lista.n; k++) {
+        if (archivos[k].error != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", archivos[k].ruta,
+                           strerror(archivos[k].error));
+            continue;
+        }
+        formatear_suma(hex, sizeof(hex), alg, archivos[k].suma);
+        if (formato_estructurado()) {
+            registro_abrir();
+            registro_texto("ruta", archivos[k].ruta);
+            registro_texto("algoritmo", (alg == ALG_CRC32C) ? "crc32c" : "xxh64");
+            registro_texto("suma", hex);
+            registro_cerrar();
+        } else {
+            imprimir(COLOR_YELLOW "%s" COLOR_RESET "  %s\n", hex, archivos[k].ruta);
+        }
+        if (manifiesto != NULL && strcmp(archivos[k].ruta, salida) != 0) {
+            fprintf(manifiesto, "%s  %s\n", hex, archivos[k].ruta);
+        }
+    }
+    if (manifiesto != NULL) {
+        fclose(manifiesto);
+        imprimir(MSG_INFO("Manifiesto guardado en '%s'.") "\n", salida);
+    }
+
+    free(archivos);
+    lista_rutas_liberar(&lista);
+}
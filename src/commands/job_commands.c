@@ -0,0 +1,534 @@
+/**
+ * @file job_commands.c
+ * @brief Comandos que ejecutan otros comandos.
+ *
+ * Implementa `paralelo`, que reparte una lista de líneas de comando entre
+ * varios hilos y muestra la salida de cada una completa y en el orden de
+ * la lista, `medir`, que ejecuta un comando y muestra cuánto tiempo y
+ * qué recursos consumió, y `limite`, que lo detiene si pasa de un tiempo
+ * o de una cantidad de memoria.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "commands.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
+#include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "hilos.h"
+#include "medicion.h"
+#include "trabajos.h"
+
+/** @brief Estado compartido entre los hilos de `paralelo` y el que imprime. */
+typedef struct {
+    char **lineas;              /**< Líneas a ejecutar */
+    size_t n;                   /**< Número de líneas */
+    int hilos;                  /**< Trabajos simultáneos */
+    ResultadoTrabajo *res;      /**< Resultado de cada línea */
+    unsigned char *listo;       /**< 1 cuando res[i] está completo */
+    const ContextoSesion *origen;
+    LimiteComando *limite;      /**< Límite de `paralelo` (si corre dentro de `limite`) */
+    pthread_mutex_t mutex;
+    pthread_cond_t terminado;   /**< Se avisa cada vez que un trabajo termina */
+} EstadoParalelo;
+
+/** @brief Tarea i: ejecuta la línea i y avisa al hilo que imprime. */
+static void ejecutar_linea(size_t i, void *datos) {
+    EstadoParalelo *e = datos;
+    ResultadoTrabajo r;
+    if (cancelacion_solicitada()) {
+        /* Ctrl+C: las líneas que no empezaron ya no se ejecutan */
+        memset(&r, 0, sizeof(r));
+        r.codigo = 128 + SIGINT;
+    } else if (trabajo_ejecutar(e->lineas[i], e->origen, &r) != 0) {
+        memset(&r, 0, sizeof(r));
+        r.codigo = 1;
+    }
+    pthread_mutex_lock(&e->mutex);
+    e->res[i] = r;
+    e->listo[i] = 1;
+    pthread_cond_broadcast(&e->terminado);
+    pthread_mutex_unlock(&e->mutex);
+}
+
+/** @brief Hilo coordinador: reparte todas las líneas entre los trabajadores. */
+static void *repartir(void *arg) {
+    EstadoParalelo *e = arg;
+    limite_heredar(e->limite);
+    ejecutar_en_paralelo(e->n, e->hilos, ejecutar_linea, e);
+    return NULL;
+}
+
+/**
+ * @brief Lee las líneas de comando (sin vacías ni comentarios '#').
+ * @return Número de líneas leídas (se detiene antes si no hay memoria).
+ */
+static long leer_lineas(FILE *f, char ***lineas) {
+    size_t n = 0, cap = 0;
+    char *linea = NULL;
+    size_t tam = 0;
+    ssize_t len;
+    *lineas = NULL;
+    while ((len = getline(&linea, &tam, f)) != -1) {
+        while (len > 0 && (linea[len - 1] == '\n' || linea[len - 1] == '\r')) {
+            linea[--len] = '\0';
+        }
+        size_t ini = strspn(linea, " \t");
+        if (linea[ini] == '\0' || linea[ini] == '#') {
+            continue;
+        }
+        if (n == cap) {
+            cap = cap ? cap * 2 : 64;
+            char **nuevo = realloc(*lineas, cap * sizeof(char *));
+            if (nuevo == NULL) break;
+            *lineas = nuevo;
+        }
+        if (((*lineas)[n] = strdup(linea + ini)) == NULL) break;
+        n++;
+    }
+    free(linea);
+    return (long)n;
+}
+
+/**
+ * @brief Ejecuta las líneas, 'hilos' a la vez, y muestra su salida en orden.
+ *
+ * Un hilo coordinador reparte las líneas (ejecutar_en_paralelo toma la
+ * siguiente libre de un contador, así que empiezan en orden); este hilo
+ * espera a cada línea por turno e imprime su salida en cuanto termina.
+ */
+static void ejecutar_en_orden(char **lineas, size_t n, int hilos) {
+    EstadoParalelo e = {
+        .lineas = lineas, .n = n, .hilos = hilos, .origen = sesion_actual,
+        .limite = limite_actual(),
+        .res = calloc(n, sizeof(ResultadoTrabajo)),
+        .listo = calloc(n, 1),
+    };
+    if (e.res == NULL || e.listo == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        free(e.res);
+        free(e.listo);
+        return;
+    }
+    pthread_mutex_init(&e.mutex, NULL);
+    pthread_cond_init(&e.terminado, NULL);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    pthread_t coordinador;
+    if (pthread_create(&coordinador, NULL, repartir, &e) != 0) {
+        repartir(&e);   /* Sin hilo extra: se ejecuta todo antes de imprimir */
+        coordinador = pthread_self();
+    }
+
+    /* Imprimir en orden: la salida de la línea k sale en cuanto ella y
+     * todas las anteriores terminaron */
+    FILE *salida = salida_sesion();
+    int estructurado = formato_estructurado();
+    int fallidos = 0;
+    for (size_t k = 0; k < n; k++) {
+        pthread_mutex_lock(&e.mutex);
+        while (!e.listo[k]) {
+            pthread_cond_wait(&e.terminado, &e.mutex);
+        }
+        pthread_mutex_unlock(&e.mutex);
+
+        ResultadoTrabajo *r = &e.res[k];
+        /* Los comandos de la shell ya entregan registros; el texto de los
+         * programas externos pasa por la conversión a mensajes */
+        if (estructurado && !r->externo) {
+            formato_reenviar(r->salida, r->len);
+        } else {
+            fwrite(r->salida, 1, r->len, salida);
+        }
+        if (r->codigo != 0 && !cancelacion_solicitada()) {
+            fallidos++;
+            if (estructurado) {
+                registro_abrir();
+                registro_entero("linea", (long long)(k + 1));
+                registro_texto("comando", lineas[k]);
+                registro_entero("codigo", r->codigo);
+                registro_cerrar();
+            } else {
+                imprimir(COLOR_RED "[paralelo]" COLOR_RESET " línea %zu (%s) terminó con código %d\n",
+                         k + 1, lineas[k], r->codigo);
+            }
+        }
+        fflush(salida);
+        free(r->salida);
+        r->salida = NULL;
+    }
+    if (!pthread_equal(coordinador, pthread_self())) {
+        pthread_join(coordinador, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    if (fallidos > 0 && !estructurado) {
+        imprimir(MSG_WARN("%zu línea(s) en %.2f s con %d trabajo(s) simultáneo(s); %d fallaron.") "\n",
+                 n, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, hilos, fallidos);
+    }
+    pthread_cond_destroy(&e.terminado);
+    pthread_mutex_destroy(&e.mutex);
+    free(e.res);
+    free(e.listo);
+}
+
+/**
+ * @brief Comando PARALELO (xargs -P / GNU parallel)
+ *
+ * Lee líneas de comando de un archivo (o, sin archivo, de la entrada hasta
+ * Ctrl+D) y las ejecuta de N en N. Los comandos de la shell corren en
+ * hilos, cada uno con su propia sesión; los demás se lanzan como
+ * programas externos. La salida de cada línea se guarda aparte y se
+ * muestra en el orden de la lista en cuanto esa línea y todas las
+ * anteriores terminaron.
+ *
+ * @param args [-j N] [archivo]
+ */
+void cmd_paralelo(char **args) {
+    int hilos = hilos_disponibles();
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-j") == 0) {
+        hilos = (args[i + 1] != NULL) ? atoi(args[i + 1]) : 0;
+        i += 2;
+    }
+    if (hilos <= 0 || (args[i] != NULL && args[i + 1] != NULL)) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "paralelo [-j N] [archivo_de_comandos]\n");
+        return;
+    }
+
+    FILE *f;
+    if (args[i] != NULL) {
+        int fd = openat(sesion_actual->dir_fd, args[i], O_RDONLY | O_CLOEXEC);
+        f = (fd >= 0) ? fdopen(fd, "r") : NULL;
+        if (f == NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir '%s': %s\n", args[i], strerror(errno));
+            if (fd >= 0) close(fd);
+            return;
+        }
+    } else {
+        f = entrada_sesion();
+        if (isatty(fileno(f))) {
+            imprimir(COLOR_DIM "Un comando por línea; Ctrl+D para ejecutarlos.\n" COLOR_RESET);
+            fflush(salida_sesion());
+        }
+    }
+
+    char **lineas;
+    long n = leer_lineas(f, &lineas);
+    if (args[i] != NULL) {
+        fclose(f);
+    } else {
+        clearerr(f);   /* La shell sigue leyendo de la misma entrada */
+    }
+    if (n <= 0) {
+        free(lineas);
+        return;
+    }
+
+    ejecutar_en_orden(lineas, (size_t)n, hilos);
+    for (long k = 0; k < n; k++) {
+        free(lineas[k]);
+    }
+    free(lineas);
+}
+
+/* =============================================================================
+ * MEDIR
+ * ========================================================================== */
+
+/** @brief Resumen de las repeticiones de `medir`. */
+typedef struct {
+    Medicion media;     /**< Promedios (rss_max_kb: el máximo) */
+    double minimo;      /**< Tiempo real mínimo (s) */
+    double mediana;     /**< Tiempo real mediano (s) */
+    double desviacion;  /**< Desviación estándar del tiempo real (s) */
+} ResumenMedicion;
+
+static int comparar_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/** @brief Promedia las mediciones y calcula mínimo, mediana y desviación. */
+static void resumir_mediciones(const Medicion *m, int n, ResumenMedicion *r) {
+    memset(r, 0, sizeof(*r));
+    double *reales = malloc((size_t)n * sizeof(double));
+    double suma = 0;
+    r->media.hay_contadores = 1;
+    r->media.rss_max_kb = -1;
+    r->media.memoria_del_proceso = m[0].memoria_del_proceso;
+    for (int k = 0; k < n; k++) {
+        suma += m[k].real;
+        r->media.usuario += m[k].usuario / n;
+        r->media.sistema += m[k].sistema / n;
+        if (m[k].rss_max_kb > r->media.rss_max_kb) r->media.rss_max_kb = m[k].rss_max_kb;
+        r->media.fallos_menores += m[k].fallos_menores;
+        r->media.fallos_mayores += m[k].fallos_mayores;
+        r->media.cambios_voluntarios += m[k].cambios_voluntarios;
+        r->media.cambios_involuntarios += m[k].cambios_involuntarios;
+        r->media.hay_contadores &= m[k].hay_contadores;
+        r->media.ciclos += m[k].ciclos / (uint64_t)n;
+        r->media.instrucciones += m[k].instrucciones / (uint64_t)n;
+        r->media.fallos_cache += m[k].fallos_cache / (uint64_t)n;
+        if (reales != NULL) reales[k] = m[k].real;
+    }
+    r->media.real = suma / n;
+    r->media.fallos_menores /= n;
+    r->media.fallos_mayores /= n;
+    r->media.cambios_voluntarios /= n;
+    r->media.cambios_involuntarios /= n;
+
+    double var = 0;
+    for (int k = 0; k < n; k++) {
+        var += (m[k].real - r->media.real) * (m[k].real - r->media.real);
+    }
+    r->desviacion = (n > 1) ? sqrt(var / (n - 1)) : 0;
+    if (reales != NULL) {
+        qsort(reales, (size_t)n, sizeof(double), comparar_double);
+        r->minimo = reales[0];
+        r->mediana = (n % 2) ? reales[n / 2] : (reales[n / 2 - 1] + reales[n / 2]) / 2;
+        free(reales);
+    } else {
+        r->minimo = r->mediana = r->media.real;
+    }
+}
+
+/** @brief Escribe un tiempo en s, ms o µs según su magnitud. */
+static const char *formatear_tiempo(char *buf, size_t tam, double s) {
+    if (s >= 1.0) snprintf(buf, tam, "%.3f s", s);
+    else if (s >= 1e-3) snprintf(buf, tam, "%.3f ms", s * 1e3);
+    else snprintf(buf, tam, "%.1f µs", s * 1e6);
+    return buf;
+}
+
+/** @brief Muestra el resultado de `medir` (texto o un registro). */
+static void mostrar_medicion(char **comando, int n, const ResumenMedicion *r, int codigo) {
+    const Medicion *m = &r->media;
+    if (formato_estructurado()) {
+        char linea[1024] = "";
+        for (int k = 0; comando[k] != NULL; k++) {
+            if (k > 0) strncat(linea, " ", sizeof(linea) - strlen(linea) - 1);
+            strncat(linea, comando[k], sizeof(linea) - strlen(linea) - 1);
+        }
+        registro_abrir();
+        registro_texto("comando", linea);
+        registro_entero("repeticiones", n);
+        registro_entero("codigo", codigo);
+        registro_real("real", m->real);
+        if (n > 1) {
+            registro_real("real_min", r->minimo);
+            registro_real("real_mediana", r->mediana);
+            registro_real("real_desv", r->desviacion);
+        }
+        registro_real("usuario", m->usuario);
+        registro_real("sistema", m->sistema);
+        if (m->rss_max_kb >= 0) {
+            registro_entero(m->memoria_del_proceso ? "rss_max_proceso_kb" : "rss_max_kb",
+                            m->rss_max_kb);
+        }
+        registro_entero("fallos_menores", m->fallos_menores);
+        registro_entero("fallos_mayores", m->fallos_mayores);
+        registro_entero("cambios_voluntarios", m->cambios_voluntarios);
+        registro_entero("cambios_involuntarios", m->cambios_involuntarios);
+        if (m->hay_contadores) {
+            registro_entero("ciclos", (long long)m->ciclos);
+            registro_entero("instrucciones", (long long)m->instrucciones);
+            registro_entero("fallos_cache", (long long)m->fallos_cache);
+        }
+        registro_cerrar();
+        return;
+    }
+
+    char t1[32], t2[32], t3[32], t4[32];
+    imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+    imprimir(COLOR_CYAN "  Tiempo real:        " COLOR_RESET COLOR_BOLD "%s" COLOR_RESET,
+             formatear_tiempo(t1, sizeof(t1), m->real));
+    if (n > 1) {
+        imprimir("  (mín %s, mediana %s, desv. %s; %d repeticiones)",
+                 formatear_tiempo(t2, sizeof(t2), r->minimo),
+                 formatear_tiempo(t3, sizeof(t3), r->mediana),
+                 formatear_tiempo(t4, sizeof(t4), r->desviacion), n);
+    }
+    imprimir("\n");
+    imprimir(COLOR_CYAN "  CPU usuario:        " COLOR_RESET "%s\n", formatear_tiempo(t1, sizeof(t1), m->usuario));
+    imprimir(COLOR_CYAN "  CPU sistema:        " COLOR_RESET "%s\n", formatear_tiempo(t1, sizeof(t1), m->sistema));
+    if (m->rss_max_kb < 0) {
+        imprimir(COLOR_CYAN "  Memoria máxima:     " COLOR_RESET "no disponible"
+                 COLOR_DIM " (no supera la de la shell)\n" COLOR_RESET);
+    } else if (m->memoria_del_proceso) {
+        imprimir(COLOR_CYAN "  Memoria máxima:     " COLOR_RESET "%ld KB"
+                 COLOR_DIM " (pico de toda la shell)\n" COLOR_RESET, m->rss_max_kb);
+    } else {
+        imprimir(COLOR_CYAN "  Memoria máxima:     " COLOR_RESET "%ld KB\n", m->rss_max_kb);
+    }
+    imprimir(COLOR_CYAN "  Fallos de página:   " COLOR_RESET "%ld menores, %ld mayores\n",
+             m->fallos_menores, m->fallos_mayores);
+    imprimir(COLOR_CYAN "  Cambios de contexto:" COLOR_RESET " %ld voluntarios, %ld involuntarios\n",
+             m->cambios_voluntarios, m->cambios_involuntarios);
+    if (m->hay_contadores) {
+        imprimir(COLOR_CYAN "  Ciclos:             " COLOR_RESET "%llu\n", (unsigned long long)m->ciclos);
+        imprimir(COLOR_CYAN "  Instrucciones:      " COLOR_RESET "%llu", (unsigned long long)m->instrucciones);
+        if (m->ciclos > 0) {
+            imprimir(COLOR_DIM "  (%.2f por ciclo)" COLOR_RESET, (double)m->instrucciones / (double)m->ciclos);
+        }
+        imprimir("\n");
+        imprimir(COLOR_CYAN "  Fallos de caché:    " COLOR_RESET "%llu\n", (unsigned long long)m->fallos_cache);
+    } else {
+        imprimir(COLOR_DIM "  (contadores de hardware no disponibles: perf_event_open no está permitido)\n" COLOR_RESET);
+    }
+    if (n > 1) {
+        imprimir(COLOR_DIM "  Valores por repetición (promedio); memoria: el máximo.\n" COLOR_RESET);
+    }
+    if (codigo != 0) {
+        imprimir(MSG_WARN("El programa terminó con código %d.") "\n", codigo);
+    }
+}
+
+/**
+ * @brief Ejecuta una vez el comando de `medir` y lo mide.
+ * @return Código de salida (0 para los comandos de la shell).
+ */
+static int medir_una_vez(char **comando, int externo, Medicion *m) {
+    Cronometro c;
+    struct rusage uso;
+    int codigo = 0;
+    memset(&uso, 0, sizeof(uso));
+    medicion_comenzar(&c);
+    if (externo) {
+        codigo = trabajo_externo(comando, &uso);
+    } else {
+        ejecutar(comando);
+    }
+    medicion_terminar(&c, externo ? &uso : NULL, m);
+    return codigo;
+}
+
+/**
+ * @brief Comando MEDIR (time / perf stat)
+ *
+ * Ejecuta un comando de la shell o un programa externo y muestra el
+ * tiempo real, el de CPU (usuario y sistema), la memoria máxima, los
+ * fallos de página y los cambios de contexto; si perf_event_open está
+ * permitido, también ciclos, instrucciones y fallos de caché. Con -r N
+ * repite el comando y muestra mínimo, mediana y desviación del tiempo
+ * real; la salida del comando solo se muestra la primera vez.
+ *
+ * @param args [-r N] <comando> [argumentos...]
+ */
+void cmd_medir(char **args) {
+    int repeticiones = 1;
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-r") == 0) {
+        repeticiones = (args[i + 1] != NULL) ? atoi(args[i + 1]) : 0;
+        i += 2;
+    }
+    if (repeticiones <= 0 || args[i] == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "medir [-r N] <comando> [argumentos...]\n");
+        return;
+    }
+
+    char **comando = &args[i];
+    size_t n = 0;
+    while (comando[n] != NULL) n++;
+    int externo = !comando_registrado(comando[0]);
+
+    /* Cada ejecución recibe una copia: los comandos compactan sus argumentos */
+    Medicion *m = calloc((size_t)repeticiones, sizeof(Medicion));
+    char **copia = malloc((n + 1) * sizeof(char *));
+    if (m == NULL || copia == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        free(m);
+        free(copia);
+        return;
+    }
+
+    FILE *salida = sesion_actual->salida;
+    FILE *descarte = NULL;
+    int hechas = 0, codigo = 0;
+    for (int r = 0; r < repeticiones && !cancelacion_solicitada(); r++) {
+        if (r == 1) {
+            /* Las repeticiones no vuelven a mostrar la salida del comando */
+            fflush(salida_sesion());
+            descarte = fopen("/dev/null", "w");
+            if (descarte != NULL) sesion_actual->salida = descarte;
+        }
+        memcpy(copia, comando, (n + 1) * sizeof(char *));
+        codigo = medir_una_vez(copia, externo, &m[r]);
+        hechas++;
+    }
+    sesion_actual->salida = salida;
+    if (descarte != NULL) fclose(descarte);
+
+    if (!cancelacion_solicitada()) {
+        ResumenMedicion resumen;
+        resumir_mediciones(m, hechas, &resumen);
+        mostrar_medicion(comando, hechas, &resumen, codigo);
+    }
+    free(copia);
+    free(m);
+}
+
+/**
+ * @brief Comando LIMITE (timeout / ulimit)
+ *
+ * Ejecuta un comando con un tiempo máximo (-t, en segundos, admite
+ * decimales) y/o un tope de memoria (-m, en MB). Un programa externo
+ * recibe RLIMIT_AS y, al vencer el plazo, SIGTERM y luego SIGKILL. Un
+ * comando de la shell se detiene en sus puntos de cancelación, como con
+ * Ctrl+C, y sus buffers proporcionales a la entrada se descuentan del
+ * tope. El límite es del hilo: dentro de `paralelo` solo afecta a su línea.
+ *
+ * @param args [-t segundos] [-m MB] <comando> [argumentos...]
+ */
+void cmd_limite(char **args) {
+    double segundos = 0;
+    long mb = 0;
+    int i = 1;
+    int valido = 1;
+    while (args[i] != NULL && args[i + 1] != NULL && valido) {
+        char *fin;
+        if (strcmp(args[i], "-t") == 0) {
+            segundos = strtod(args[i + 1], &fin);
+            valido = (*fin == '\0' && segundos > 0 && segundos < 1e9);
+        } else if (strcmp(args[i], "-m") == 0) {
+            mb = strtol(args[i + 1], &fin, 10);
+            valido = (*fin == '\0' && mb > 0 && (size_t)mb <= SIZE_MAX >> 20);
+        } else {
+            break;
+        }
+        i += 2;
+    }
+    if (!valido || (segundos == 0 && mb == 0) || args[i] == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "limite [-t segundos] [-m MB] <comando> [argumentos...]\n");
+        return;
+    }
+
+    char **comando = &args[i];
+    int codigo = 0, externo = !comando_registrado(comando[0]);
+    LimiteComando l;
+    limite_comenzar(&l, (uint64_t)ceil(segundos * 1000), (size_t)mb << 20);
+    if (externo) {
+        codigo = trabajo_externo(comando, NULL);
+    } else {
+        ejecutar(comando);
+    }
+    MotivoLimite motivo = limite_motivo(&l);
+    limite_terminar(&l);
+
+    if (motivo == LIMITE_TIEMPO) {
+        imprimir_error(MSG_WARN("'%s' se detuvo: superó el límite de %g s.") "\n", comando[0], segundos);
+    } else if (motivo == LIMITE_MEMORIA) {
+        imprimir_error(MSG_WARN("'%s' se detuvo: superó el límite de %ld MB.") "\n", comando[0], mb);
+    } else if (externo && codigo != 0 && codigo != TRABAJO_NO_ENCONTRADO) {
+        imprimir(MSG_WARN("'%s' terminó con código %d.") "\n", comando[0], codigo);
+    }
+}
@@ -2,14 +2,25 @@
  * @file system_commands.c
  * @brief Comandos de utilería del sistema.
  * 
- * Actualmente contiene la calculadora, pero podría expandirse para incluir
- * gestión de procesos o informes de memoria.
+ * Contiene la calculadora, la vigilancia de archivos (vigilar) y el informe
+ * del rastreo de memoria (memoria), y podría expandirse para incluir
+ * gestión de procesos.
  */
 
 #include <stdio.h>
 #include <stdlib.h>  /* Para atof (ASCII to Float conversion) */
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
 #include "commands.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
 #include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "vigilancia.h"
+#include "utils.h"    /* memoria_estadisticas, MEMORIA_RASTREADA */
 
 /**
  * @brief Comando LIMPIAR
@@ -31,8 +42,8 @@ void cmd_limpiar(char **args) {
      *   de la vista, pero al deslizar hacia arriba seguía siendo visible.
      *   Con \033[3J se elimina completamente del buffer de la terminal.
      */
-    printf("\033[2J\033[3J\033[H");
-    fflush(stdout);
+    imprimir("\033[2J\033[3J\033[H");
+    fflush(salida_sesion());
     (void)args;
 }
 
@@ -50,9 +61,9 @@ void cmd_limpiar(char **args) {
 void cmd_calc(char **args) {
     // 1. Validación de argumentos. Necesitamos exáctamente 3 partes después del comando.
     if (args[1] == NULL || args[2] == NULL || args[3] == NULL) {
-        printf(COLOR_YELLOW "Uso: " COLOR_RESET
-               "calc <num1> <operador> <num2>\n"
-               COLOR_DIM "Ejemplo: calc 5 + 3\n" COLOR_RESET);
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                     "calc <num1> <operador> <num2>\n"
+                     COLOR_DIM "Ejemplo: calc 5 + 3\n" COLOR_RESET);
         return;
     }
 
@@ -77,18 +88,306 @@ void cmd_calc(char **args) {
             break;
         case '/':
             if (n2 == 0) {
-                printf(COLOR_RED "[ERROR]" COLOR_RESET
-                       " División por cero no permitida.\n");
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                             " División por cero no permitida.\n");
                 return;
             }
             res = n1 / n2;
             break;
         default:
-            printf(COLOR_RED "[ERROR]" COLOR_RESET
-                   " Operador '%c' no reconocido. Use +, -, * o /.\n", op);
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                         " Operador '%c' no reconocido. Use +, -, * o /.\n", op);
             return;
     }
 
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_real("resultado", res);
+        registro_cerrar();
+        return;
+    }
+
     /* Resultado en verde */
-    printf(COLOR_GREEN "  Resultado: " COLOR_BOLD "%.2f\n" COLOR_RESET, res);
+    imprimir(COLOR_GREEN "  Resultado: " COLOR_BOLD "%.2f\n" COLOR_RESET, res);
+}
+
+/* =============================================================================
+ * VIGILAR (watch)
+ * ========================================================================== */
+
+/** @brief Espera por defecto sin cambios antes de reaccionar (ms). */
+#define VIGILAR_ESPERA_MS 200
+
+/** @brief Rutas distintas que se listan por lote; el resto solo se cuenta. */
+#define VIGILAR_MAX_RUTAS 256
+
+/** @brief Cambios acumulados desde la última reacción. */
+typedef struct {
+    char *rutas[VIGILAR_MAX_RUTAS];
+    int tipos[VIGILAR_MAX_RUTAS];    /**< EVENTO_* combinados por ruta */
+    int n;
+    long otros;                      /**< Eventos sobre rutas que no cupieron */
+} LoteCambios;
+
+/** @brief Agrupa un evento en el lote: una entrada por ruta. */
+static void acumular_evento(const char *ruta, int tipo, void *usuario) {
+    LoteCambios *l = usuario;
+    for (int i = 0; i < l->n; i++) {
+        if (strcmp(l->rutas[i], ruta) == 0) {
+            l->tipos[i] |= tipo;
+            return;
+        }
+    }
+    if (l->n == VIGILAR_MAX_RUTAS || (l->rutas[l->n] = strdup(ruta)) == NULL) {
+        l->otros++;
+        return;
+    }
+    l->tipos[l->n++] = tipo;
+}
+
+/** @brief Descarta eventos (los que provoca el propio comando ejecutado). */
+static void ignorar_evento(const char *ruta, int tipo, void *usuario) {
+    (void)ruta;
+    (void)tipo;
+    (void)usuario;
+}
+
+static void vaciar_lote(LoteCambios *l) {
+    for (int i = 0; i < l->n; i++) {
+        free(l->rutas[i]);
+    }
+    l->n = 0;
+    l->otros = 0;
+}
+
+/** @brief Milisegundos de un reloj monotónico. */
+static long long ahora_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** @brief Texto de un conjunto de EVENTO_* (el más relevante). */
+static const char *nombre_evento(int tipos) {
+    if ((tipos & EVENTO_CREADO) && (tipos & EVENTO_ELIMINADO)) return "temporal";
+    if (tipos & EVENTO_ELIMINADO) return "eliminado";
+    if (tipos & EVENTO_CREADO) return "creado";
+    if (tipos & EVENTO_MOVIDO) return "movido";
+    return "modificado";
+}
+
+/**
+ * @brief Muestra un lote de cambios y, si se indicó, ejecuta el comando.
+ */
+static void reaccionar(LoteCambios *l, char **comando, Vigilancia *v) {
+    char hora[16];
+    time_t t = time(NULL);
+    struct tm local;   /* localtime() comparte su buffer entre sesiones e hilos */
+    strftime(hora, sizeof(hora), "%H:%M:%S", localtime_r(&t, &local));
+    long total = l->n + l->otros;
+
+    if (comando[0] == NULL) {
+        imprimir(COLOR_DIM "[%s]" COLOR_RESET " %ld cambio(s)\n", hora, total);
+        for (int i = 0; i < l->n; i++) {
+            imprimir("  " COLOR_YELLOW "%-10s" COLOR_RESET " %s\n", nombre_evento(l->tipos[i]), l->rutas[i]);
+        }
+        if (l->otros > 0) {
+            imprimir(COLOR_DIM "  ... y %ld evento(s) más\n" COLOR_RESET, l->otros);
+        }
+    } else {
+        imprimir(COLOR_DIM "[%s]" COLOR_RESET " %ld cambio(s) " COLOR_CYAN "→ %s" COLOR_RESET "\n",
+                 hora, total, comando[0]);
+        ejecutar(comando);
+        /* Lo que el comando haya cambiado no debe volver a dispararlo */
+        vigilancia_leer(v, ignorar_evento, NULL);
+    }
+    fflush(salida_sesion());
+    vaciar_lote(l);
+}
+
+/**
+ * @brief Comando VIGILAR (watch)
+ *
+ * Espera cambios en un archivo o directorio bloqueado en inotify/fanotify
+ * (sin sondeo). Los eventos se agrupan: se reacciona cuando pasan 'espera'
+ * ms sin cambios nuevos. Sin comando imprime los cambios; con comando lo
+ * vuelve a ejecutar. Termina con Ctrl+C o tras -n reacciones.
+ *
+ * @param args [-r] [-d ms] [-n N] <ruta> [comando...]
+ */
+void cmd_vigilar(char **args) {
+    int recursiva = 0;
+    long espera = VIGILAR_ESPERA_MS, max_lotes = -1;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            recursiva = 1;
+        } else if (strcmp(args[i], "-d") == 0 && args[i + 1] != NULL) {
+            espera = atol(args[++i]);
+        } else if (strcmp(args[i], "-n") == 0 && args[i + 1] != NULL) {
+            max_lotes = atol(args[++i]);
+        } else {
+            break;
+        }
+    }
+    if (args[i] == NULL || args[i][0] == '-' || espera < 0) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "vigilar [-r] [-d ms] [-n N] <ruta> [comando...]\n");
+        return;
+    }
+    const char *ruta = args[i];
+    char **comando = &args[i + 1];
+
+    Vigilancia *v = vigilancia_crear(sesion_actual->dir_fd, ruta, recursiva);
+    if (v == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se puede vigilar '%s': %s\n", ruta, strerror(errno));
+        return;
+    }
+
+    /* Ctrl+C llega como un descriptor más en poll() (ver cancelacion.h):
+     * es la forma normal de terminar, no una interrupción */
+    int fd_cancelar = cancelacion_fd();
+
+    imprimir(MSG_INFO("Vigilando '%s'%s con %s (Ctrl+C para terminar).") "\n",
+             ruta, recursiva ? " y sus subdirectorios" : "", vigilancia_mecanismo(v));
+    fflush(salida_sesion());
+
+    LoteCambios lote = { .n = 0, .otros = 0 };
+    long long primero = 0, ultimo = 0;
+    long lotes = 0;
+    while (max_lotes < 0 || lotes < max_lotes) {
+        struct pollfd pfd[3] = {
+            { vigilancia_fd(v), POLLIN, 0 },
+            { fd_cancelar, POLLIN, 0 },
+            { limite_fd(), POLLIN, 0 },   /* Plazo de `limite` */
+        };
+        int timeout = -1;
+        if (lote.n > 0 || lote.otros > 0) {
+            /* Reaccionar tras 'espera' ms de calma, o como mucho 10 esperas
+             * después del primer cambio si los eventos no paran */
+            long long limite = ultimo + espera;
+            if (limite > primero + 10 * espera) limite = primero + 10 * espera;
+            long long falta = limite - ahora_ms();
+            timeout = (falta > 0) ? (int)falta : 0;
+        }
+
+        int r = poll(pfd, 3, timeout);
+        if (r < 0 && errno != EINTR) {
+            break;
+        }
+        if (r > 0 && (pfd[1].revents & POLLIN)) {
+            cancelacion_reiniciar();
+            break;
+        }
+        if (r > 0 && (pfd[2].revents & POLLIN)) {
+            break;
+        }
+        if (r > 0 && (pfd[0].revents & POLLIN)) {
+            int vacio = (lote.n == 0 && lote.otros == 0);
+            if (vigilancia_leer(v, acumular_evento, &lote) < 0) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Lectura de eventos: %s\n", strerror(errno));
+                break;
+            }
+            ultimo = ahora_ms();
+            if (vacio) primero = ultimo;
+            continue;
+        }
+        if (r == 0 && (lote.n > 0 || lote.otros > 0)) {
+            reaccionar(&lote, comando, v);
+            lotes++;
+        }
+    }
+
+    vaciar_lote(&lote);
+    vigilancia_destruir(v);
+    imprimir(MSG_INFO("Vigilancia terminada.") "\n");
+}
+
+/** @brief Sitios que lista `memoria` si no se indica otro número. */
+#define MEMORIA_SITIOS 10
+
+/**
+ * @brief Comando MEMORIA
+ *
+ * Muestra el rastreo de las macros MEM_* (ver utils.h): asignaciones,
+ * liberaciones, bytes vivos y pico, y los sitios de llamada con más
+ * memoria viva. Con -v lista también los bloques vivos. Sin compilar con
+ * RASTREO_MEMORIA=1 solo avisa de cómo activarlo.
+ *
+ * @param args [-v] [N]
+ */
+void cmd_memoria(char **args) {
+    int detalle = 0;
+    long max = MEMORIA_SITIOS;
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-v") == 0) {
+        detalle = 1;
+        i++;
+    }
+    if (args[i] != NULL) {
+        char *fin;
+        max = strtol(args[i], &fin, 10);
+        if (*fin != '\0' || max <= 0 || args[i + 1] != NULL) {
+            imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "memoria [-v] [N]\n");
+            return;
+        }
+    }
+    if (!MEMORIA_RASTREADA) {
+        imprimir(MSG_WARN("El rastreo de memoria no está compilado: reconstruye con "
+                          "'make clean && make RASTREO_MEMORIA=1'.") "\n");
+        return;
+    }
+
+    EstadisticasMemoria e;
+    memoria_estadisticas(&e);
+    size_t total = memoria_sitios(NULL, 0);
+    size_t n = ((size_t)max < total) ? (size_t)max : total;
+    SitioMemoria *sitios = malloc((n > 0 ? n : 1) * sizeof(SitioMemoria));
+    if (sitios == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        return;
+    }
+    memoria_sitios(sitios, n);
+
+    if (formato_estructurado()) {
+        for (size_t k = 0; k < n; k++) {
+            registro_abrir();
+            registro_texto("archivo", sitios[k].archivo);
+            registro_entero("linea", sitios[k].linea);
+            registro_entero("asignaciones", (long long)sitios[k].e.asignaciones);
+            registro_entero("bytes", (long long)sitios[k].e.bytes_totales);
+            registro_entero("bloques_vivos", (long long)sitios[k].e.bloques_vivos);
+            registro_entero("bytes_vivos", (long long)sitios[k].e.bytes_vivos);
+            registro_entero("pico", (long long)sitios[k].e.pico_bytes);
+            registro_cerrar();
+        }
+        free(sitios);
+        return;
+    }
+
+    imprimir(COLOR_CYAN "\n Memoria rastreada (MEM_*):\n" COLOR_RESET);
+    imprimir("  Asignaciones: " COLOR_BOLD "%zu" COLOR_RESET " (%zu bytes)   Liberaciones: %zu\n",
+             e.asignaciones, e.bytes_totales, e.liberaciones);
+    imprimir("  Vivos:        " COLOR_BOLD "%zu" COLOR_RESET " bloque(s), %zu bytes   Pico: %zu bytes\n",
+             e.bloques_vivos, e.bytes_vivos, e.pico_bytes);
+    if (n > 0) {
+        imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+        imprimir(COLOR_DIM "  %10s %12s %8s %12s %12s  %s\n" COLOR_RESET,
+                 "llamadas", "bytes", "vivos", "bytes vivos", "pico", "sitio");
+        for (size_t k = 0; k < n; k++) {
+            const EstadisticasMemoria *s = &sitios[k].e;
+            imprimir("  %10zu %12zu %8zu %12zu %12zu  " COLOR_BLUE "%s" COLOR_RESET COLOR_YELLOW ":%d" COLOR_RESET "\n",
+                     s->asignaciones, s->bytes_totales, s->bloques_vivos, s->bytes_vivos,
+                     s->pico_bytes, sitios[k].archivo, sitios[k].linea);
+        }
+        if (total > n) {
+            imprimir(COLOR_DIM "  ... y %zu sitio(s) más\n" COLOR_RESET, total - n);
+        }
+    }
+    if (detalle && e.bloques_vivos > 0) {
+        imprimir(COLOR_DIM "─────────────────────────────────\n" COLOR_RESET);
+        fflush(salida_sesion());
+        memoria_volcar_vivos(salida_sesion(), (size_t)max);
+    }
+    imprimir("\n");
+    free(sitios);
 }
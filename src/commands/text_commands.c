@@ -0,0 +1,609 @@
+/**
+ * @file text_commands.c
+ * @brief Comandos de procesamiento de texto sobre archivos grandes.
+ *
+ * Estos comandos están pensados para archivos de varios GB: usan mmap(),
+ * instrucciones SIMD y reparten el trabajo entre todos los núcleos.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "shell.h"
+#include "colors.h"
+#include "cancelacion.h"
+#include "formato.h"
+#include "conteo.h"
+#include "hilos.h"
+#include "ordenamiento.h"
+#include "diferencias.h"
+#include "reemplazo.h"
+#include "utils.h"         /* recolectar_archivos */
+
+/* =============================================================================
+ * CONTAR (wc)
+ * ========================================================================== */
+
+/** @brief Tamaño de cada trozo de archivo que cuenta un hilo. */
+#define CONTAR_TROZO (16u * 1024 * 1024)
+
+/** @brief Buffer de lectura para archivos que no se pueden mapear. */
+#define CONTAR_BUFFER (1u * 1024 * 1024)
+
+/** @brief Un archivo pedido a 'contar'. */
+typedef struct {
+    const char *ruta;
+    int fd;                      /**< -1 si no se pudo abrir */
+    int error;                   /**< errno de la apertura o lectura */
+    const unsigned char *mapa;   /**< Contenido mapeado (NULL = leer por stream) */
+    size_t tam;                  /**< Tamaño mapeado */
+    Conteo total;
+} ArchivoContar;
+
+/** @brief Una tarea: un trozo [inicio, fin) de un archivo, o el archivo entero por stream. */
+typedef struct {
+    size_t archivo;
+    size_t inicio, fin;
+    int error;
+    Conteo parcial;
+} TrozoContar;
+
+/** @brief Datos compartidos por las tareas de 'contar'. */
+typedef struct {
+    ArchivoContar *archivos;
+    TrozoContar *trozos;
+} TrabajoContar;
+
+/**
+ * @brief Tarea de conteo: un trozo mapeado o un archivo completo por read().
+ */
+static void tarea_contar(size_t i, void *datos) {
+    TrabajoContar *t = datos;
+    TrozoContar *trozo = &t->trozos[i];
+    ArchivoContar *a = &t->archivos[trozo->archivo];
+    if (cancelacion_solicitada()) {
+        return;   /* Ctrl+C: los trozos pendientes se descartan */
+    }
+
+    if (a->mapa != NULL) {
+        /* El byte anterior al trozo decide si la primera palabra ya se contó */
+        int previo = (trozo->inicio == 0) ? 1 : es_espacio(a->mapa[trozo->inicio - 1]);
+        contar_bloque(a->mapa + trozo->inicio, trozo->fin - trozo->inicio, previo, &trozo->parcial);
+        return;
+    }
+
+    /* Sin mapa (tuberías, /proc, ...): lectura por bloques grandes */
+    unsigned char *buffer = malloc(CONTAR_BUFFER);
+    if (buffer == NULL) {
+        trozo->error = ENOMEM;
+        return;
+    }
+    int previo = 1;
+    while (!cancelacion_solicitada()) {
+        ssize_t n = read(a->fd, buffer, CONTAR_BUFFER);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            trozo->error = errno;
+            break;
+        }
+        if (n == 0) break;
+        previo = contar_bloque(buffer, (size_t)n, previo, &trozo->parcial);
+    }
+    free(buffer);
+}
+
+/**
+ * @brief Mapea el archivo ya abierto en a->fd si es regular; si no, se
+ *        leerá por stream.
+ */
+static void mapear_archivo(ArchivoContar *a) {
+    struct stat st;
+    if (fstat(a->fd, &st) != 0) {
+        a->error = errno;
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        a->error = EISDIR;
+        return;
+    }
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, a->fd, 0);
+        if (m != MAP_FAILED) {
+            madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL); /* Lectura anticipada agresiva */
+            a->mapa = m;
+            a->tam = (size_t)st.st_size;
+        }
+    }
+}
+
+/**
+ * @brief Abre y, si se puede, mapea un archivo para contarlo.
+ */
+static void preparar_archivo(ArchivoContar *a, int dir_fd) {
+    a->fd = openat(dir_fd, a->ruta, O_RDONLY | O_CLOEXEC);
+    if (a->fd < 0) {
+        a->error = errno;
+        return;
+    }
+    mapear_archivo(a);
+}
+
+/**
+ * @brief Prepara la entrada de `<` como el archivo "-".
+ *
+ * El stream acaba de abrirse y nadie lo ha leído, así que su descriptor
+ * está al principio y se puede mapear igual que un archivo.
+ */
+static void preparar_entrada(ArchivoContar *a, FILE *entrada) {
+    a->ruta = "-";
+    a->fd = fcntl(fileno(entrada), F_DUPFD_CLOEXEC, 0);
+    if (a->fd < 0) {
+        a->error = errno;
+        return;
+    }
+    mapear_archivo(a);
+}
+
+/**
+ * @brief Imprime una fila del resultado según las columnas elegidas.
+ */
+static void imprimir_fila_contar(const Conteo *c, int l, int w, int b, const char *nombre) {
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_texto("archivo", nombre);
+        if (l) registro_entero("lineas", (long long)c->lineas);
+        if (w) registro_entero("palabras", (long long)c->palabras);
+        if (b) registro_entero("bytes", (long long)c->bytes);
+        registro_cerrar();
+        return;
+    }
+    if (l) imprimir(COLOR_YELLOW " %12llu" COLOR_RESET, (unsigned long long)c->lineas);
+    if (w) imprimir(COLOR_YELLOW " %12llu" COLOR_RESET, (unsigned long long)c->palabras);
+    if (b) imprimir(COLOR_YELLOW " %14llu" COLOR_RESET, (unsigned long long)c->bytes);
+    imprimir("  %s\n", nombre);
+}
+
+/**
+ * @brief Divide los archivos en trozos, los cuenta en paralelo y suma los
+ *        parciales de cada archivo en su campo 'total'.
+ */
+static void contar_en_paralelo(ArchivoContar *archivos, size_t n, TrozoContar *trozos) {
+    /* 2. Repartir los trozos entre los hilos */
+    size_t t = 0;
+    for (size_t k = 0; k < n; k++) {
+        ArchivoContar *a = &archivos[k];
+        if (a->error != 0) continue;
+        if (a->mapa == NULL) {
+            trozos[t++] = (TrozoContar){ k, 0, 0, 0, {0, 0, 0} };
+            continue;
+        }
+        for (size_t ini = 0; ini < a->tam; ini += CONTAR_TROZO) {
+            size_t fin = (a->tam - ini > CONTAR_TROZO) ? ini + CONTAR_TROZO : a->tam;
+            trozos[t++] = (TrozoContar){ k, ini, fin, 0, {0, 0, 0} };
+        }
+    }
+    TrabajoContar trabajo = { archivos, trozos };
+    ejecutar_en_paralelo(t, 0, tarea_contar, &trabajo);
+
+    /* 3. Sumar los trozos de cada archivo e imprimir en orden */
+    for (size_t k = 0; k < t; k++) {
+        ArchivoContar *a = &archivos[trozos[k].archivo];
+        a->total.lineas   += trozos[k].parcial.lineas;
+        a->total.palabras += trozos[k].parcial.palabras;
+        a->total.bytes    += trozos[k].parcial.bytes;
+        if (trozos[k].error != 0) a->error = trozos[k].error;
+    }
+}
+
+/**
+ * @brief Imprime una fila por archivo (o su error) y el total si hay varios.
+ */
+static void imprimir_resultados_contar(const ArchivoContar *archivos, size_t n,
+                                       int l, int w, int b) {
+    Conteo total = {0, 0, 0};
+    int validos = 0;
+    for (size_t k = 0; k < n; k++) {
+        const ArchivoContar *a = &archivos[k];
+        if (a->error != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", a->ruta, strerror(a->error));
+        } else {
+            imprimir_fila_contar(&a->total, l, w, b, a->ruta);
+            total.lineas += a->total.lineas;
+            total.palabras += a->total.palabras;
+            total.bytes += a->total.bytes;
+            validos++;
+        }
+    }
+    /* Con salida estructurada no hay fila de total: se suma al procesarla */
+    if (validos > 1 && !formato_estructurado()) {
+        imprimir(COLOR_BOLD);
+        imprimir_fila_contar(&total, l, w, b, "total");
+        imprimir(COLOR_RESET);
+    }
+}
+
+/**
+ * @brief Comando CONTAR (wc)
+ *
+ * Cuenta líneas, palabras y bytes de uno o varios archivos. Cada archivo
+ * se mapea en memoria y se divide en trozos de 16 MB que se cuentan en
+ * paralelo con SIMD (ver conteo.c). Sin archivos cuenta lo que llega
+ * por `<`.
+ *
+ * @param args Opciones -l/-w/-c (por defecto las tres) seguidas de archivos.
+ */
+void cmd_contar(char **args) {
+    int l = 0, w = 0, b = 0;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        for (const char *o = args[i] + 1; *o; o++) {
+            if (*o == 'l') l = 1;
+            else if (*o == 'w') w = 1;
+            else if (*o == 'c') b = 1;
+            else {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Opción '-%c' no reconocida.\n", *o);
+                return;
+            }
+        }
+    }
+    FILE *entrada = args[i] == NULL ? entrada_redirigida() : NULL;
+    if (args[i] == NULL && entrada == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                       "contar [-l] [-w] [-c] <archivo> [archivo...]  (o: contar < archivo)\n");
+        return;
+    }
+    if (!l && !w && !b) {
+        l = w = b = 1;
+    }
+
+    size_t n = 0;
+    while (args[i + n] != NULL) n++;
+    if (entrada != NULL) n = 1;   /* La entrada cuenta como un archivo "-" */
+
+    ArchivoContar *archivos = calloc(n, sizeof(ArchivoContar));
+    if (archivos == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        return;
+    }
+
+    /* 1. Abrir/mapear y calcular cuántos trozos hay */
+    size_t n_trozos = 0;
+    for (size_t k = 0; k < n; k++) {
+        if (entrada != NULL) {
+            preparar_entrada(&archivos[k], entrada);
+        } else {
+            archivos[k].ruta = args[i + k];
+            preparar_archivo(&archivos[k], sesion_actual->dir_fd);
+        }
+        if (archivos[k].error != 0) continue;
+        n_trozos += archivos[k].mapa ? (archivos[k].tam + CONTAR_TROZO - 1) / CONTAR_TROZO : 1;
+    }
+
+    TrozoContar *trozos = calloc(n_trozos ? n_trozos : 1, sizeof(TrozoContar));
+    if (trozos == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+    } else {
+        contar_en_paralelo(archivos, n, trozos);
+        if (!cancelacion_solicitada()) {   /* Con Ctrl+C los totales están incompletos */
+            imprimir_resultados_contar(archivos, n, l, w, b);
+        }
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        if (archivos[k].mapa != NULL) munmap((void *)archivos[k].mapa, archivos[k].tam);
+        if (archivos[k].fd >= 0) close(archivos[k].fd);
+    }
+    free(trozos);
+    free(archivos);
+}
+
+/* =============================================================================
+ * ORDENAR (sort)
+ * ========================================================================== */
+
+/**
+ * @brief Comando ORDENAR
+ *
+ * Ordena las líneas de uno o varios archivos con memoria acotada: lo que
+ * no cabe en el presupuesto (-m) se ordena por partes en archivos
+ * temporales y se mezcla al final (ver ordenamiento.c). Sin archivos
+ * ordena lo que llega por `<`.
+ *
+ * @param args Opciones -n/-r/-u, -k campo, -m MB, -o salida; luego archivos.
+ */
+void cmd_ordenar(char **args) {
+    OpcionesOrden op = { 0, 0, 0, 1, (size_t)ORDEN_MEMORIA_MB * 1024 * 1024 };
+    const char *ruta_salida = NULL;
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        const char *o = args[i] + 1;
+        if (strcmp(o, "k") == 0 || strcmp(o, "m") == 0 || strcmp(o, "o") == 0) {
+            if (args[i + 1] == NULL) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Falta el valor de '-%s'.\n", o);
+                return;
+            }
+            const char *valor = args[++i];
+            if (*o == 'o') {
+                ruta_salida = valor;
+                continue;
+            }
+            long v = atol(valor);
+            if (v < 1) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Valor inválido para '-%s': %s\n", o, valor);
+                return;
+            }
+            if (*o == 'k') op.campo = (int)v;
+            else op.memoria = (size_t)v * 1024 * 1024;
+            continue;
+        }
+        for (; *o; o++) {
+            if (*o == 'n') op.numerico = 1;
+            else if (*o == 'r') op.inverso = 1;
+            else if (*o == 'u') op.unico = 1;
+            else {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Opción '-%c' no reconocida.\n", *o);
+                return;
+            }
+        }
+    }
+    FILE *entrada = args[i] == NULL ? entrada_redirigida() : NULL;
+    if (args[i] == NULL && entrada == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                       "ordenar [-n] [-r] [-u] [-k campo] [-m MB] [-o salida] <archivo...>"
+                       "  (o: ordenar < archivo)\n");
+        return;
+    }
+
+    size_t n = 0;
+    while (args[i + n] != NULL) n++;
+
+    ResumenOrden r;
+    const char *ruta_error = NULL;
+    if (ordenar_archivos(sesion_actual->dir_fd, (const char *const *)args + i, n,
+                         entrada != NULL ? fileno(entrada) : -1, &op,
+                         ruta_salida, salida_sesion(), &r, &ruta_error) != 0) {
+        if (errno == ECANCELED) {
+            return;   /* Ctrl+C: la shell ya avisa */
+        }
+        if (errno == E2BIG) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                           " Hay una línea más larga que la memoria disponible (-m).\n");
+        } else if (ruta_error != NULL) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s\n", ruta_error, strerror(errno));
+        } else {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo ordenar: %s\n", strerror(errno));
+        }
+        return;
+    }
+    if (ruta_salida != NULL) {
+        imprimir(COLOR_GREEN "  %llu líneas ordenadas en '%s'" COLOR_RESET,
+                 (unsigned long long)r.lineas, ruta_salida);
+        if (r.corridas > 0) {
+            imprimir(COLOR_DIM " (%zu corridas en disco, %d pasada(s) de mezcla)" COLOR_RESET,
+                     r.corridas, r.pasadas);
+        }
+        imprimir("\n");
+    }
+}
+
+/* =============================================================================
+ * COMPARAR (diff -u)
+ * ========================================================================== */
+
+/** @brief Archivo mapeado para comparar. */
+typedef struct {
+    const unsigned char *mapa;   /**< NULL si está vacío */
+    size_t tam;
+} ArchivoComparar;
+
+/**
+ * @brief Abre y mapea un archivo regular completo.
+ * @return 0, o -1 (con el error ya mostrado).
+ */
+static int mapear_para_comparar(const char *ruta, ArchivoComparar *a) {
+    a->mapa = NULL;
+    a->tam = 0;
+    int fd = openat(sesion_actual->dir_fd, ruta, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir '%s': %s\n", ruta, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s' no es un archivo regular.\n", ruta);
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo mapear '%s': %s\n", ruta, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+        a->mapa = m;
+        a->tam = (size_t)st.st_size;
+    }
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief Comando COMPARAR
+ *
+ * Muestra las diferencias entre dos archivos en formato unificado. Los
+ * colores solo se usan si la salida es una terminal, para que
+ * `comparar a b > cambios.patch` produzca un parche válido.
+ *
+ * @param args Opción -U N (líneas de contexto) y los dos archivos.
+ */
+void cmd_comparar(char **args) {
+    int contexto = DIFERENCIAS_CONTEXTO;
+    int i = 1;
+    if (args[i] != NULL && strcmp(args[i], "-U") == 0) {
+        char *fin = NULL;
+        long v = (args[i + 1] != NULL) ? strtol(args[i + 1], &fin, 10) : -1;
+        if (fin == NULL || *fin != '\0' || v < 0 || v > 1000000) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Valor inválido para '-U'.\n");
+            return;
+        }
+        contexto = (int)v;
+        i += 2;
+    }
+    if (args[i] == NULL || args[i + 1] == NULL || args[i + 2] != NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET "comparar [-U N] <archivo_a> <archivo_b>\n");
+        return;
+    }
+
+    ArchivoComparar a, b;
+    if (mapear_para_comparar(args[i], &a) != 0) {
+        return;
+    }
+    if (mapear_para_comparar(args[i + 1], &b) != 0) {
+        if (a.mapa != NULL) munmap((void *)a.mapa, a.tam);
+        return;
+    }
+
+    FILE *salida = formato_estructurado() ? NULL : salida_sesion();
+    int color = salida != NULL && isatty(fileno(salida));
+    ResumenDiferencias r;
+    int res = diferencias_unificadas(a.mapa, a.tam, args[i], b.mapa, b.tam, args[i + 1],
+                                     contexto, salida, color, &r);
+    if (res < 0 && errno != ECANCELED) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo comparar: %s\n", strerror(errno));
+    } else if (res >= 0 && formato_estructurado()) {
+        registro_abrir();
+        registro_texto("archivo_a", args[i]);
+        registro_texto("archivo_b", args[i + 1]);
+        registro_entero("iguales", res == 0);
+        registro_entero("borradas", (long long)r.borradas);
+        registro_entero("agregadas", (long long)r.agregadas);
+        registro_entero("bloques", (long long)r.bloques);
+        registro_cerrar();
+    } else if (res == 0 && color) {
+        imprimir(COLOR_GREEN "Los archivos son idénticos.\n" COLOR_RESET);
+    }
+
+    if (a.mapa != NULL) munmap((void *)a.mapa, a.tam);
+    if (b.mapa != NULL) munmap((void *)b.mapa, b.tam);
+}
+
+/* =============================================================================
+ * REEMPLAZAR (sed -i 's/a/b/g' con cadenas literales)
+ * ========================================================================== */
+
+/** @brief Lo que se reemplaza, compartido por todas las tareas. */
+typedef struct {
+    int dir_fd;                 /**< Directorio de la sesión (los hilos no ven sesion_actual) */
+    const char *buscar, *reemplazo;
+    size_t m, r;
+    char **rutas;
+    ResultadoReemplazo *resultados;
+    int *errores;               /**< errno por archivo (0 = bien) */
+} TrabajoReemplazar;
+
+/** @brief Tarea: un archivo completo. */
+static void tarea_reemplazar(size_t i, void *datos) {
+    TrabajoReemplazar *t = datos;
+    if (cancelacion_solicitada()) {
+        t->errores[i] = ECANCELED;
+        return;
+    }
+    if (reemplazar_en_archivo(t->dir_fd, t->rutas[i], t->buscar, t->m,
+                              t->reemplazo, t->r, &t->resultados[i]) != 0) {
+        t->errores[i] = errno;
+    }
+}
+
+/**
+ * @brief Comando REEMPLAZAR
+ *
+ * Reemplaza todas las apariciones de un texto literal en uno o varios
+ * archivos (los directorios se recorren). Los archivos se procesan en
+ * paralelo, uno por tarea; cada uno se escribe en un temporal del mismo
+ * directorio y se sustituye con rename(), y los que no contienen el texto
+ * no se reescriben (ver reemplazo.h).
+ *
+ * @param args args[1] texto a buscar, args[2] reemplazo, luego archivos o directorios.
+ */
+void cmd_reemplazar(char **args) {
+    if (args[1] == NULL || args[2] == NULL || args[3] == NULL) {
+        imprimir_error(COLOR_YELLOW "Uso: " COLOR_RESET
+                       "reemplazar <buscar> <reemplazo> <archivo|directorio> [...]\n");
+        return;
+    }
+    if (args[1][0] == '\0') {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " El texto a buscar no puede estar vacío.\n");
+        return;
+    }
+
+    ListaRutas lista = {0};
+    for (int i = 3; args[i] != NULL; i++) {
+        if (recolectar_archivos(sesion_actual->dir_fd, args[i], &lista) != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                           " El archivo '%s' no existe o no se puede abrir.\n", args[i]);
+        }
+    }
+    if (lista.n == 0) {
+        lista_rutas_liberar(&lista);
+        return;
+    }
+
+    TrabajoReemplazar t = {
+        sesion_actual->dir_fd, args[1], args[2], strlen(args[1]), strlen(args[2]), lista.rutas,
+        calloc(lista.n, sizeof(ResultadoReemplazo)), calloc(lista.n, sizeof(int))
+    };
+    if (t.resultados == NULL || t.errores == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Memoria insuficiente.\n");
+        free(t.resultados);
+        free(t.errores);
+        lista_rutas_liberar(&lista);
+        return;
+    }
+    ejecutar_en_paralelo(lista.n, 0, tarea_reemplazar, &t);
+
+    /* Resultados en el orden de los argumentos; con Ctrl+C, lo ya reescrito
+     * queda completo y el resto intacto */
+    unsigned long long total = 0;
+    size_t reescritos = 0;
+    for (size_t k = 0; k < lista.n; k++) {
+        const ResultadoReemplazo *r = &t.resultados[k];
+        if (t.errores[k] == ECANCELED) {
+            continue;
+        }
+        if (t.errores[k] == ELOOP) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                           " '%s' es un enlace simbólico: reemplace en su destino.\n", lista.rutas[k]);
+        } else if (t.errores[k] != 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " '%s': %s (sin cambios)\n",
+                           lista.rutas[k], strerror(t.errores[k]));
+        } else if (formato_estructurado()) {
+            registro_abrir();
+            registro_texto("archivo", lista.rutas[k]);
+            registro_entero("reemplazos", (long long)r->reemplazos);
+            registro_entero("reescrito", r->reescrito);
+            registro_cerrar();
+        } else if (r->reemplazos > 0) {
+            imprimir("  %s: " COLOR_YELLOW "%llu" COLOR_RESET " reemplazo(s)\n",
+                     lista.rutas[k], (unsigned long long)r->reemplazos);
+        }
+        total += r->reemplazos;
+        reescritos += (size_t)r->reescrito;
+    }
+    if (!formato_estructurado() && !cancelacion_solicitada()) {
+        imprimir(COLOR_GREEN "  Total: %llu reemplazo(s); %zu de %zu archivo(s) reescritos.\n"
+                 COLOR_RESET, total, reescritos, lista.n);
+    }
+
+    free(t.resultados);
+    free(t.errores);
+    lista_rutas_liberar(&lista);
+}
@@ -0,0 +1,840 @@
+/**
+ * @file configuracion.c
+ * @brief Carga de `~/.eafitosrc` con instantánea binaria (ver configuracion.h).
+ *
+ * La instantánea es un único bloque con desplazamientos en lugar de
+ * punteros, así que sirve tal cual desde el mmap():
+ *
+ *     Cabecera | alias[n_alias] (ordenados) | variables[n_vars] | cadenas
+ *
+ * Los tokens de un alias son cadenas consecutivas terminadas en '\0'. Al
+ * parsear el rc se construye el mismo bloque en memoria, de modo que las
+ * búsquedas no distinguen de dónde salió. Los alias definidos durante la
+ * sesión (comando `alias`) van aparte, en la sesión, y tienen prioridad
+ * sobre los del rc. Las variables siguen el mismo esquema: las del rc se
+ * leen del bloque y las del comando `export` viven en la sesión.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "configuracion.h"
+#include "colors.h"
+#include "hash.h"     /* crc32c */
+
+/** @brief "EAFRC" + versión del formato; cambiarla invalida las instantáneas. */
+#define MAGIA_INSTANTANEA 0x4346524641450001ULL
+
+/** @brief Cabecera de la instantánea; todos los desplazamientos son desde el inicio. */
+typedef struct {
+    uint64_t magia;
+    uint64_t tam;             /**< Bytes totales del bloque */
+    int64_t  rc_mtime_s;      /**< Identidad del rc del que salió */
+    int64_t  rc_mtime_ns;
+    uint64_t rc_tam;
+    uint64_t rc_inodo;
+    uint32_t prompt;          /**< Desplazamiento del prompt (0 = no hay) */
+    uint32_t n_alias;
+    uint32_t off_alias;
+    uint32_t n_vars;
+    uint32_t off_vars;
+    uint32_t suma;            /**< CRC32C de todo lo que sigue a la cabecera */
+} CabeceraRc;
+
+/** @brief Un alias: desplazamientos de su nombre y de sus tokens. */
+typedef struct {
+    uint32_t nombre;
+    uint32_t tokens;
+    uint32_t n_tokens;
+    uint32_t bytes_tokens;    /**< Incluye el '\0' de cada token */
+} AliasRc;
+
+/** @brief Una variable: desplazamientos de "NOMBRE" y "valor". */
+typedef struct {
+    uint32_t nombre;
+    uint32_t valor;
+} VariableRc;
+
+/** @brief Bloque de la configuración del rc (mmap o heap); inmutable tras cargarlo. */
+static const unsigned char *bloque = NULL;
+
+/**
+ * @brief Alias definido durante la sesión (mismo formato de tokens).
+ *
+ * Viven en ContextoSesion::alias: cada sesión (cliente del servidor, sesión
+ * de libeafitos) ve solo los suyos más los del rc.
+ */
+typedef struct AliasSesion {
+    char *nombre;
+    char *tokens;
+    size_t n_tokens;
+    size_t bytes_tokens;
+} AliasSesion;
+
+/** @brief Variable definida con `export` durante la sesión (ContextoSesion::variables). */
+typedef struct VariableSesion {
+    char *nombre;
+    char *valor;
+} VariableSesion;
+
+extern char **environ;
+
+/* ------------------------------------------------------------------ */
+/* Construcción del bloque al parsear el rc                            */
+/* ------------------------------------------------------------------ */
+
+/** @brief Alias leído del rc, antes de ordenarlo. */
+typedef struct {
+    uint32_t nombre;
+    uint32_t tokens;
+    uint32_t n_tokens;
+    uint32_t bytes_tokens;
+    int linea;                /**< Para quedarse con la última definición */
+} AliasLeido;
+
+/** @brief Acumula las cadenas y las tablas mientras se parsea. */
+typedef struct {
+    char *cadenas;
+    size_t n_cadenas, cap_cadenas;
+    AliasLeido *alias;
+    size_t n_alias, cap_alias;
+    VariableRc *vars;
+    size_t n_vars, cap_vars;
+    uint32_t prompt;          /**< +1: 0 significa que no hay */
+    const char *ruta;         /**< Del rc, para los avisos */
+    int avisos;
+} Constructor;
+
+/** @brief Añade 'n' bytes al área de cadenas. @return Desplazamiento, o UINT32_MAX. */
+static uint32_t agregar_bytes(Constructor *c, const char *s, size_t n) {
+    if (c->n_cadenas + n > c->cap_cadenas) {
+        size_t cap = c->cap_cadenas ? c->cap_cadenas * 2 : 1024;
+        while (cap < c->n_cadenas + n) cap *= 2;
+        char *nuevo = (cap <= UINT32_MAX) ? realloc(c->cadenas, cap) : NULL;
+        if (nuevo == NULL) {
+            return UINT32_MAX;
+        }
+        c->cadenas = nuevo;
+        c->cap_cadenas = cap;
+    }
+    memcpy(c->cadenas + c->n_cadenas, s, n);
+    c->n_cadenas += n;
+    return (uint32_t)(c->n_cadenas - n);
+}
+
+static uint32_t agregar_cadena(Constructor *c, const char *s) {
+    return agregar_bytes(c, s, strlen(s) + 1);
+}
+
+/** @brief Avisa de una línea inválida del rc (no detiene la carga). */
+static void aviso_rc(Constructor *c, int num_linea, const char *mensaje) {
+    fprintf(stderr, MSG_WARN("%s:%d: %s") "\n", c->ruta, num_linea, mensaje);
+    c->avisos++;
+}
+
+/** @brief 1 si 'nombre' sirve como nombre de variable de entorno. */
+static int nombre_variable_valido(const char *nombre) {
+    if (!(nombre[0] == '_' || (nombre[0] >= 'A' && nombre[0] <= 'Z') ||
+          (nombre[0] >= 'a' && nombre[0] <= 'z'))) {
+        return 0;
+    }
+    return nombre[strspn(nombre, "_ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789")] == '\0';
+}
+
+/** @brief `alias nombre=comando args...` */
+static int leer_alias(Constructor *c, char *resto, int num_linea) {
+    char *igual = strchr(resto, '=');
+    /* El nombre no puede estar vacío ni tener espacios antes del '=' */
+    if (igual == NULL || igual == resto || strcspn(resto, DELIM) < (size_t)(igual - resto)) {
+        aviso_rc(c, num_linea, "se esperaba 'alias <nombre>=<comando> [argumentos]'.");
+        return 0;
+    }
+    *igual = '\0';
+
+    uint32_t tokens = UINT32_MAX;
+    uint32_t n = 0;
+    size_t inicio = c->n_cadenas;
+    char *guardado = NULL;
+    for (char *t = strtok_r(igual + 1, DELIM, &guardado); t != NULL;
+         t = strtok_r(NULL, DELIM, &guardado)) {
+        uint32_t off = agregar_cadena(c, t);
+        if (off == UINT32_MAX) return -1;
+        if (n++ == 0) tokens = off;
+    }
+    if (n == 0) {
+        aviso_rc(c, num_linea, "el alias no tiene comando.");
+        return 0;
+    }
+    uint32_t bytes = (uint32_t)(c->n_cadenas - inicio);
+    uint32_t nombre = agregar_cadena(c, resto);
+    if (nombre == UINT32_MAX) return -1;
+
+    if (c->n_alias == c->cap_alias) {
+        size_t cap = c->cap_alias ? c->cap_alias * 2 : 16;
+        AliasLeido *nuevo = realloc(c->alias, cap * sizeof(*nuevo));
+        if (nuevo == NULL) return -1;
+        c->alias = nuevo;
+        c->cap_alias = cap;
+    }
+    c->alias[c->n_alias++] = (AliasLeido){ nombre, tokens, n, bytes, num_linea };
+    return 0;
+}
+
+/** @brief `export NOMBRE=valor` (el valor es el resto de la línea). */
+static int leer_variable(Constructor *c, char *resto, int num_linea) {
+    char *igual = strchr(resto, '=');
+    if (igual == NULL) {
+        aviso_rc(c, num_linea, "se esperaba 'export <NOMBRE>=<valor>'.");
+        return 0;
+    }
+    *igual = '\0';
+    if (!nombre_variable_valido(resto)) {
+        aviso_rc(c, num_linea, "nombre de variable inválido.");
+        return 0;
+    }
+    uint32_t nombre = agregar_cadena(c, resto);
+    uint32_t valor = agregar_cadena(c, igual + 1);
+    if (nombre == UINT32_MAX || valor == UINT32_MAX) return -1;
+
+    if (c->n_vars == c->cap_vars) {
+        size_t cap = c->cap_vars ? c->cap_vars * 2 : 16;
+        VariableRc *nuevo = realloc(c->vars, cap * sizeof(*nuevo));
+        if (nuevo == NULL) return -1;
+        c->vars = nuevo;
+        c->cap_vars = cap;
+    }
+    c->vars[c->n_vars++] = (VariableRc){ nombre, valor };
+    return 0;
+}
+
+/** @brief Interpreta una línea del rc. @return -1 solo si falta memoria. */
+static int leer_linea_rc(Constructor *c, char *linea, int num_linea) {
+    linea[strcspn(linea, "\r\n")] = '\0';
+    linea += strspn(linea, " \t");
+    if (linea[0] == '\0' || linea[0] == '#') {
+        return 0;
+    }
+    size_t largo = strcspn(linea, " \t");
+    char *resto = linea + largo;
+    if (*resto != '\0') {
+        *resto++ = '\0';
+        resto += strspn(resto, " \t");
+    }
+    /* Sin espacios finales (el prompt y los valores los conservarían) */
+    size_t fin = strlen(resto);
+    while (fin > 0 && (resto[fin - 1] == ' ' || resto[fin - 1] == '\t')) {
+        resto[--fin] = '\0';
+    }
+
+    if (strcmp(linea, "alias") == 0) {
+        return leer_alias(c, resto, num_linea);
+    }
+    if (strcmp(linea, "export") == 0) {
+        return leer_variable(c, resto, num_linea);
+    }
+    if (strcmp(linea, "prompt") == 0) {
+        if (resto[0] == '\0') {
+            aviso_rc(c, num_linea, "falta el texto del prompt.");
+            return 0;
+        }
+        char recortado[MAX_PROMPT_LEN];
+        snprintf(recortado, sizeof(recortado), "%s", resto);
+        uint32_t off = agregar_cadena(c, recortado);
+        if (off == UINT32_MAX) return -1;
+        c->prompt = off + 1;
+        return 0;
+    }
+    aviso_rc(c, num_linea, "directiva desconocida (se esperaba alias, export o prompt).");
+    return 0;
+}
+
+/** @brief Orden de los alias leídos: por nombre y, a igual nombre, por línea. */
+static const char *cadenas_orden;
+static int comparar_leidos(const void *a, const void *b) {
+    const AliasLeido *x = a, *y = b;
+    int r = strcmp(cadenas_orden + x->nombre, cadenas_orden + y->nombre);
+    return r != 0 ? r : x->linea - y->linea;
+}
+
+/**
+ * @brief Serializa lo leído en el formato de la instantánea.
+ *
+ * Un alias repetido se queda con su última definición.
+ *
+ * @return Bloque en el heap (cabecera incluida), o NULL si no hubo memoria.
+ */
+static unsigned char *serializar(Constructor *c, const struct stat *st, size_t *tam) {
+    cadenas_orden = c->cadenas;
+    qsort(c->alias, c->n_alias, sizeof(*c->alias), comparar_leidos);
+    size_t n_alias = 0;
+    for (size_t i = 0; i < c->n_alias; i++) {
+        if (i + 1 < c->n_alias &&
+            strcmp(c->cadenas + c->alias[i].nombre, c->cadenas + c->alias[i + 1].nombre) == 0) {
+            continue;
+        }
+        c->alias[n_alias++] = c->alias[i];
+    }
+
+    size_t off_alias = sizeof(CabeceraRc);
+    size_t off_vars = off_alias + n_alias * sizeof(AliasRc);
+    size_t off_cadenas = off_vars + c->n_vars * sizeof(VariableRc);
+    size_t total = off_cadenas + c->n_cadenas;
+    if (total > UINT32_MAX) {
+        return NULL;
+    }
+    unsigned char *b = calloc(1, total);
+    if (b == NULL) {
+        return NULL;
+    }
+    uint32_t base = (uint32_t)off_cadenas;
+    AliasRc *alias = (AliasRc *)(b + off_alias);
+    for (size_t i = 0; i < n_alias; i++) {
+        alias[i] = (AliasRc){ base + c->alias[i].nombre, base + c->alias[i].tokens,
+                              c->alias[i].n_tokens, c->alias[i].bytes_tokens };
+    }
+    VariableRc *vars = (VariableRc *)(b + off_vars);
+    for (size_t i = 0; i < c->n_vars; i++) {
+        vars[i] = (VariableRc){ base + c->vars[i].nombre, base + c->vars[i].valor };
+    }
+    if (c->n_cadenas > 0) {
+        memcpy(b + off_cadenas, c->cadenas, c->n_cadenas);
+    }
+
+    CabeceraRc *h = (CabeceraRc *)b;
+    h->magia = MAGIA_INSTANTANEA;
+    h->tam = total;
+    h->rc_mtime_s = (int64_t)st->st_mtim.tv_sec;
+    h->rc_mtime_ns = (int64_t)st->st_mtim.tv_nsec;
+    h->rc_tam = (uint64_t)st->st_size;
+    h->rc_inodo = (uint64_t)st->st_ino;
+    h->prompt = c->prompt ? base + c->prompt - 1 : 0;
+    h->n_alias = (uint32_t)n_alias;
+    h->off_alias = (uint32_t)off_alias;
+    h->n_vars = (uint32_t)c->n_vars;
+    h->off_vars = (uint32_t)off_vars;
+    h->suma = crc32c(0, b + sizeof(CabeceraRc), total - sizeof(CabeceraRc));
+    *tam = total;
+    return b;
+}
+
+/** @brief Lee y parsea el rc. @return Bloque en el heap, o NULL. */
+static unsigned char *parsear_rc(FILE *f, const char *ruta, const struct stat *st,
+                                 size_t *tam, int *avisos) {
+    Constructor c;
+    memset(&c, 0, sizeof(c));
+    c.ruta = ruta;
+    char *linea = NULL;
+    size_t cap = 0;
+    int num_linea = 0, error = 0;
+    while (!error && getline(&linea, &cap, f) != -1) {
+        error = leer_linea_rc(&c, linea, ++num_linea) != 0;
+    }
+    free(linea);
+
+    unsigned char *b = error ? NULL : serializar(&c, st, tam);
+    *avisos = c.avisos;
+    free(c.cadenas);
+    free(c.alias);
+    free(c.vars);
+    return b;
+}
+
+/* ------------------------------------------------------------------ */
+/* Instantánea en disco                                                */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Comprueba que 'b' sea una instantánea íntegra del rc 'st'.
+ *
+ * Verifica la identidad del rc, la suma y que todo desplazamiento caiga
+ * dentro del bloque, para no leer fuera del mmap si el archivo está
+ * truncado o dañado.
+ */
+static int instantanea_valida(const unsigned char *b, size_t tam, const struct stat *st) {
+    if (tam < sizeof(CabeceraRc)) {
+        return 0;
+    }
+    const CabeceraRc *h = (const CabeceraRc *)b;
+    if (h->magia != MAGIA_INSTANTANEA || h->tam != tam ||
+        h->rc_mtime_s != (int64_t)st->st_mtim.tv_sec ||
+        h->rc_mtime_ns != (int64_t)st->st_mtim.tv_nsec ||
+        h->rc_tam != (uint64_t)st->st_size || h->rc_inodo != (uint64_t)st->st_ino) {
+        return 0;
+    }
+    if (h->off_alias < sizeof(CabeceraRc) ||
+        (uint64_t)h->off_alias + (uint64_t)h->n_alias * sizeof(AliasRc) > tam ||
+        h->off_vars < sizeof(CabeceraRc) ||
+        (uint64_t)h->off_vars + (uint64_t)h->n_vars * sizeof(VariableRc) > tam ||
+        h->off_alias % sizeof(uint32_t) != 0 || h->off_vars % sizeof(uint32_t) != 0) {
+        return 0;
+    }
+    if (crc32c(0, b + sizeof(CabeceraRc), tam - sizeof(CabeceraRc)) != h->suma) {
+        return 0;
+    }
+    /* Con la suma correcta el bloque es el que escribimos; aun así, que
+     * ninguna cadena se salga (el bloque termina en '\0' si hay cadenas) */
+    if (tam > sizeof(CabeceraRc) && b[tam - 1] != '\0' && (h->n_alias || h->n_vars || h->prompt)) {
+        return 0;
+    }
+    const AliasRc *a = (const AliasRc *)(b + h->off_alias);
+    for (uint32_t i = 0; i < h->n_alias; i++) {
+        if (a[i].nombre >= tam || a[i].tokens >= tam || a[i].n_tokens == 0 ||
+            (uint64_t)a[i].tokens + a[i].bytes_tokens > tam) {
+            return 0;
+        }
+    }
+    const VariableRc *v = (const VariableRc *)(b + h->off_vars);
+    for (uint32_t i = 0; i < h->n_vars; i++) {
+        if (v[i].nombre >= tam || v[i].valor >= tam) {
+            return 0;
+        }
+    }
+    return h->prompt < tam;
+}
+
+/** @brief Proyecta la instantánea si existe y corresponde al rc. */
+static const unsigned char *mapear_instantanea(const char *ruta, const struct stat *rc) {
+    int fd = open(ruta, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *m = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(CabeceraRc)) {
+        m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+    if (!instantanea_valida(m, (size_t)st.st_size, rc)) {
+        munmap(m, (size_t)st.st_size);
+        return NULL;
+    }
+    return m;
+}
+
+/**
+ * @brief Guarda la instantánea: archivo temporal y rename(), para que otra
+ *        shell que arranca a la vez nunca lea una a medio escribir.
+ */
+static void guardar_instantanea(const char *ruta, const unsigned char *b, size_t tam) {
+    char temporal[4096];
+    if (snprintf(temporal, sizeof(temporal), "%s.XXXXXX", ruta) >= (int)sizeof(temporal)) {
+        return;
+    }
+    int fd = mkstemp(temporal);
+    if (fd < 0) {
+        return;   /* Directorio de solo lectura: simplemente no hay caché */
+    }
+    size_t escrito = 0;
+    while (escrito < tam) {
+        ssize_t n = write(fd, b + escrito, tam - escrito);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        escrito += (size_t)n;
+    }
+    if (close(fd) != 0 || escrito != tam || rename(temporal, ruta) != 0) {
+        unlink(temporal);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* API                                                                 */
+/* ------------------------------------------------------------------ */
+
+OrigenConfiguracion configuracion_cargar(const char *ruta, ContextoSesion *sesion) {
+    char por_defecto[4096];
+    if (ruta == NULL) {
+        const char *env = getenv(RC_ENV);
+        if (env != NULL) {
+            if (env[0] == '\0') return RC_SIN_ARCHIVO;
+            ruta = env;
+        } else {
+            const char *home = getenv("HOME");
+            snprintf(por_defecto, sizeof(por_defecto), "%s/" RC_ARCHIVO, home ? home : ".");
+            ruta = por_defecto;
+        }
+    }
+
+    FILE *f = fopen(ruta, "re");
+    struct stat st;
+    if (f == NULL || fstat(fileno(f), &st) != 0) {
+        if (f != NULL) fclose(f);
+        return RC_SIN_ARCHIVO;
+    }
+
+    char ruta_instantanea[4096];
+    int cabe = snprintf(ruta_instantanea, sizeof(ruta_instantanea), "%s" RC_SUFIJO_INSTANTANEA,
+                        ruta) < (int)sizeof(ruta_instantanea);
+    OrigenConfiguracion origen = RC_DESDE_INSTANTANEA;
+    const unsigned char *b = cabe ? mapear_instantanea(ruta_instantanea, &st) : NULL;
+    if (b == NULL) {
+        size_t tam = 0;
+        int avisos = 0;
+        unsigned char *nuevo = parsear_rc(f, ruta, &st, &tam, &avisos);
+        if (nuevo == NULL) {
+            fclose(f);
+            fprintf(stderr, MSG_WARN("No se pudo cargar %s: memoria insuficiente.") "\n", ruta);
+            return RC_SIN_ARCHIVO;
+        }
+        if (avisos == 0 && cabe) {
+            guardar_instantanea(ruta_instantanea, nuevo, tam);
+        }
+        b = nuevo;
+        origen = RC_PARSEADO;
+    }
+    fclose(f);
+
+    /* Una carga anterior (pruebas) se deja viva: puede haber alias expandidos en uso.
+     * Las variables no van a setenv(): se consultan en el bloque (variable_obtener) */
+    bloque = b;
+    const CabeceraRc *h = (const CabeceraRc *)b;
+    if (sesion != NULL && h->prompt != 0) {
+        snprintf(sesion->prompt, sizeof(sesion->prompt), "%s", (const char *)b + h->prompt);
+    }
+    return origen;
+}
+
+/** @brief Alias del rc por búsqueda binaria en la tabla ordenada, o NULL. */
+static const AliasRc *buscar_en_bloque(const char *nombre) {
+    if (bloque == NULL) {
+        return NULL;
+    }
+    const CabeceraRc *h = (const CabeceraRc *)bloque;
+    const AliasRc *a = (const AliasRc *)(bloque + h->off_alias);
+    size_t bajo = 0, alto = h->n_alias;
+    while (bajo < alto) {
+        size_t medio = bajo + (alto - bajo) / 2;
+        int r = strcmp(nombre, (const char *)bloque + a[medio].nombre);
+        if (r == 0) return &a[medio];
+        if (r < 0) alto = medio;
+        else bajo = medio + 1;
+    }
+    return NULL;
+}
+
+/** @brief Alias de la sesión en curso, o NULL. */
+static AliasSesion *buscar_en_sesion(const char *nombre) {
+    for (size_t i = 0; i < sesion_actual->n_alias; i++) {
+        if (strcmp(sesion_actual->alias[i].nombre, nombre) == 0) {
+            return &sesion_actual->alias[i];
+        }
+    }
+    return NULL;
+}
+
+int alias_existe(const char *nombre) {
+    return buscar_en_sesion(nombre) != NULL || buscar_en_bloque(nombre) != NULL;
+}
+
+/**
+ * @brief Arma el argv expandido en un solo bloque: punteros, luego los
+ *        tokens del alias copiados. Los args[1..] se reutilizan tal cual.
+ */
+static char **armar_expansion(const char *tokens, size_t n, size_t bytes, char *const *args) {
+    size_t resto = 0;
+    while (args[1 + resto] != NULL) resto++;
+    size_t punteros = (n + resto + 1) * sizeof(char *);
+    char **r = malloc(punteros + bytes);
+    if (r == NULL) {
+        return NULL;
+    }
+    char *copia = (char *)r + punteros;
+    memcpy(copia, tokens, bytes);
+    for (size_t i = 0; i < n; i++) {
+        r[i] = copia;
+        copia += strlen(copia) + 1;
+    }
+    for (size_t i = 0; i < resto; i++) {
+        r[n + i] = args[1 + i];
+    }
+    r[n + resto] = NULL;
+    return r;
+}
+
+char **alias_expandir(char *const *args) {
+    const AliasSesion *s = buscar_en_sesion(args[0]);
+    if (s != NULL) {
+        return armar_expansion(s->tokens, s->n_tokens, s->bytes_tokens, args);
+    }
+    const AliasRc *a = buscar_en_bloque(args[0]);
+    if (a != NULL) {
+        return armar_expansion((const char *)bloque + a->tokens, a->n_tokens, a->bytes_tokens, args);
+    }
+    return NULL;
+}
+
+/** @brief Añade un alias ya copiado a 'sesion'; 0 o -1 sin memoria. */
+static int agregar_alias(ContextoSesion *sesion, AliasSesion alias) {
+    AliasSesion *nuevo = realloc(sesion->alias, (sesion->n_alias + 1) * sizeof(*nuevo));
+    if (nuevo == NULL) {
+        return -1;
+    }
+    sesion->alias = nuevo;
+    sesion->alias[sesion->n_alias++] = alias;
+    return 0;
+}
+
+int alias_definir(const char *nombre, char *const *tokens) {
+    size_t n = 0, bytes = 0;
+    for (; tokens[n] != NULL; n++) {
+        bytes += strlen(tokens[n]) + 1;
+    }
+    char *copia = malloc(bytes);
+    char *copia_nombre = strdup(nombre);
+    if (copia == NULL || copia_nombre == NULL || n == 0) {
+        free(copia);
+        free(copia_nombre);
+        return -1;
+    }
+    char *p = copia;
+    for (size_t i = 0; i < n; i++) {
+        size_t largo = strlen(tokens[i]) + 1;
+        memcpy(p, tokens[i], largo);
+        p += largo;
+    }
+
+    AliasSesion *existente = buscar_en_sesion(nombre);
+    if (existente != NULL) {
+        free(existente->tokens);
+        free(copia_nombre);
+        existente->tokens = copia;
+        existente->n_tokens = n;
+        existente->bytes_tokens = bytes;
+        return 0;
+    }
+    if (agregar_alias(sesion_actual, (AliasSesion){ copia_nombre, copia, n, bytes }) != 0) {
+        free(copia);
+        free(copia_nombre);
+        return -1;
+    }
+    return 0;
+}
+
+int alias_copiar(ContextoSesion *destino, const ContextoSesion *origen) {
+    for (size_t i = 0; i < origen->n_alias; i++) {
+        const AliasSesion *a = &origen->alias[i];
+        char *nombre = strdup(a->nombre);
+        char *tokens = malloc(a->bytes_tokens);
+        if (nombre == NULL || tokens == NULL ||
+            agregar_alias(destino, (AliasSesion){ nombre, tokens, a->n_tokens, a->bytes_tokens }) != 0) {
+            free(nombre);
+            free(tokens);
+            return -1;
+        }
+        memcpy(tokens, a->tokens, a->bytes_tokens);
+    }
+    return 0;
+}
+
+void alias_liberar(ContextoSesion *sesion) {
+    for (size_t i = 0; i < sesion->n_alias; i++) {
+        free(sesion->alias[i].nombre);
+        free(sesion->alias[i].tokens);
+    }
+    free(sesion->alias);
+    sesion->alias = NULL;
+    sesion->n_alias = 0;
+}
+
+static int comparar_sesion(const void *a, const void *b) {
+    return strcmp(((const AliasSesion *)a)->nombre, ((const AliasSesion *)b)->nombre);
+}
+
+void alias_recorrer(void (*fn)(const char *nombre, const char *tokens, size_t n, void *usuario),
+                    void *usuario) {
+    /* Mezcla de dos listas ordenadas; los de la sesión tapan a los del rc */
+    AliasSesion *propios = sesion_actual->alias;
+    size_t n_propios = sesion_actual->n_alias;
+    qsort(propios, n_propios, sizeof(*propios), comparar_sesion);
+    const CabeceraRc *h = (const CabeceraRc *)bloque;
+    const AliasRc *a = h ? (const AliasRc *)(bloque + h->off_alias) : NULL;
+    size_t n_rc = h ? h->n_alias : 0, i = 0, j = 0;
+    while (i < n_propios || j < n_rc) {
+        int r = (i == n_propios) ? 1 : (j == n_rc) ? -1
+              : strcmp(propios[i].nombre, (const char *)bloque + a[j].nombre);
+        if (r <= 0) {
+            fn(propios[i].nombre, propios[i].tokens, propios[i].n_tokens, usuario);
+            i++;
+            j += (r == 0);
+        } else {
+            fn((const char *)bloque + a[j].nombre, (const char *)bloque + a[j].tokens,
+               a[j].n_tokens, usuario);
+            j++;
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Variables                                                           */
+/* ------------------------------------------------------------------ */
+
+/** @brief Variables del rc (n en *n), o NULL si no hay rc. */
+static const VariableRc *variables_rc(uint32_t *n) {
+    const CabeceraRc *h = (const CabeceraRc *)bloque;
+    *n = h ? h->n_vars : 0;
+    return h ? (const VariableRc *)(bloque + h->off_vars) : NULL;
+}
+
+/** @brief Valor de una variable del rc (la última definición), o NULL. */
+static const char *buscar_variable_rc(const char *nombre) {
+    uint32_t n;
+    const VariableRc *v = variables_rc(&n);
+    for (uint32_t i = n; i > 0; i--) {
+        if (strcmp((const char *)bloque + v[i - 1].nombre, nombre) == 0) {
+            return (const char *)bloque + v[i - 1].valor;
+        }
+    }
+    return NULL;
+}
+
+/** @brief Variable de 'sesion', o NULL. */
+static VariableSesion *buscar_variable_sesion(const ContextoSesion *sesion, const char *nombre) {
+    for (size_t i = 0; i < sesion->n_variables; i++) {
+        if (strcmp(sesion->variables[i].nombre, nombre) == 0) {
+            return &sesion->variables[i];
+        }
+    }
+    return NULL;
+}
+
+const char *variable_obtener(const char *nombre) {
+    const VariableSesion *s = buscar_variable_sesion(sesion_actual, nombre);
+    if (s != NULL) {
+        return s->valor;
+    }
+    const char *rc = buscar_variable_rc(nombre);
+    return rc != NULL ? rc : getenv(nombre);
+}
+
+/** @brief Añade una variable ya copiada a 'sesion'; 0 o -1 sin memoria. */
+static int agregar_variable(ContextoSesion *sesion, VariableSesion variable) {
+    VariableSesion *nuevo = realloc(sesion->variables,
+                                    (sesion->n_variables + 1) * sizeof(*nuevo));
+    if (nuevo == NULL) {
+        return -1;
+    }
+    sesion->variables = nuevo;
+    sesion->variables[sesion->n_variables++] = variable;
+    return 0;
+}
+
+int variable_definir(const char *nombre, const char *valor) {
+    if (!nombre_variable_valido(nombre)) {
+        errno = EINVAL;
+        return -1;
+    }
+    char *copia = strdup(valor);
+    if (copia == NULL) {
+        return -1;
+    }
+    VariableSesion *existente = buscar_variable_sesion(sesion_actual, nombre);
+    if (existente != NULL) {
+        free(existente->valor);
+        existente->valor = copia;
+        return 0;
+    }
+    char *copia_nombre = strdup(nombre);
+    if (copia_nombre == NULL ||
+        agregar_variable(sesion_actual, (VariableSesion){ copia_nombre, copia }) != 0) {
+        free(copia_nombre);
+        free(copia);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+int variables_copiar(ContextoSesion *destino, const ContextoSesion *origen) {
+    for (size_t i = 0; i < origen->n_variables; i++) {
+        char *nombre = strdup(origen->variables[i].nombre);
+        char *valor = strdup(origen->variables[i].valor);
+        if (nombre == NULL || valor == NULL ||
+            agregar_variable(destino, (VariableSesion){ nombre, valor }) != 0) {
+            free(nombre);
+            free(valor);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void variables_liberar(ContextoSesion *sesion) {
+    for (size_t i = 0; i < sesion->n_variables; i++) {
+        free(sesion->variables[i].nombre);
+        free(sesion->variables[i].valor);
+    }
+    free(sesion->variables);
+    sesion->variables = NULL;
+    sesion->n_variables = 0;
+}
+
+/** @brief Escribe "nombre=valor" en *cadenas y reemplaza (o añade) su entrada en 'env'. */
+static void poner_en_entorno(char **env, size_t *n, char **cadenas,
+                             const char *nombre, const char *valor) {
+    size_t largo = strlen(nombre);
+    size_t i = 0;
+    while (i < *n && !(strncmp(env[i], nombre, largo) == 0 && env[i][largo] == '=')) {
+        i++;
+    }
+    env[i] = *cadenas;
+    if (i == *n) (*n)++;
+    *cadenas += sprintf(*cadenas, "%s=%s", nombre, valor) + 1;
+}
+
+char **variables_entorno(void) {
+    uint32_t n_rc;
+    const VariableRc *v = variables_rc(&n_rc);
+    const ContextoSesion *s = sesion_actual;
+    size_t n_env = 0, bytes = 0;
+    while (environ[n_env] != NULL) n_env++;
+    for (uint32_t i = 0; i < n_rc; i++) {
+        bytes += strlen((const char *)bloque + v[i].nombre) +
+                 strlen((const char *)bloque + v[i].valor) + 2;
+    }
+    for (size_t i = 0; i < s->n_variables; i++) {
+        bytes += strlen(s->variables[i].nombre) + strlen(s->variables[i].valor) + 2;
+    }
+
+    size_t punteros = (n_env + n_rc + s->n_variables + 1) * sizeof(char *);
+    char **env = malloc(punteros + bytes);
+    if (env == NULL) {
+        return NULL;
+    }
+    memcpy(env, environ, n_env * sizeof(char *));
+    char *cadenas = (char *)env + punteros;
+    size_t n = n_env;
+    for (uint32_t i = 0; i < n_rc; i++) {
+        poner_en_entorno(env, &n, &cadenas, (const char *)bloque + v[i].nombre,
+                         (const char *)bloque + v[i].valor);
+    }
+    for (size_t i = 0; i < s->n_variables; i++) {
+        poner_en_entorno(env, &n, &cadenas, s->variables[i].nombre, s->variables[i].valor);
+    }
+    env[n] = NULL;
+    return env;
+}
+
+void variables_recorrer(void (*fn)(const char *nombre, const char *valor, void *usuario),
+                        void *usuario) {
+    uint32_t n_rc;
+    const VariableRc *v = variables_rc(&n_rc);
+    for (uint32_t i = 0; i < n_rc; i++) {
+        const char *nombre = (const char *)bloque + v[i].nombre;
+        /* Solo la definición que vale: ni tapada por la sesión ni repetida después */
+        if (buscar_variable_sesion(sesion_actual, nombre) == NULL &&
+            buscar_variable_rc(nombre) == (const char *)bloque + v[i].valor) {
+            fn(nombre, (const char *)bloque + v[i].valor, usuario);
+        }
+    }
+    for (size_t i = 0; i < sesion_actual->n_variables; i++) {
+        fn(sesion_actual->variables[i].nombre, sesion_actual->variables[i].valor, usuario);
+    }
+}
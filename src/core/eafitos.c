@@ -0,0 +1,96 @@
+/**
+ * @file eafitos.c
+ * @brief Implementación de la API embebible de libeafitos.
+ *
+ * Cada llamada a eafitos_exec() activa el contexto en el hilo que llama
+ * (sesion_actual es _Thread_local), dirige la salida de los comandos al
+ * descriptor indicado y ejecuta la línea con el mismo despachador que la
+ * shell interactiva.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>   /* dup, close */
+#include <pthread.h>  /* pthread_once */
+#include "eafitos.h"
+#include "shell.h"
+#include "plugins.h"
+#include "utils.h"    /* MEM_FREE */
+
+/** @brief Entrada compartida por todos los contextos: siempre da EOF. */
+static FILE *entrada_vacia = NULL;
+
+static pthread_once_t inicializado = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Inicialización global, una sola vez por proceso.
+ */
+static void inicializar_biblioteca(void) {
+    entrada_vacia = fopen("/dev/null", "r");
+    plugins_inicializar(NULL);
+}
+
+eafitos_ctx *eafitos_create(void) {
+    pthread_once(&inicializado, inicializar_biblioteca);
+
+    ContextoSesion *ctx = malloc(sizeof(ContextoSesion));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    if (sesion_iniciar(ctx) != 0) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->entrada = entrada_vacia;
+    return ctx;
+}
+
+int eafitos_exec(eafitos_ctx *ctx, const char *linea, int out_fd) {
+    if (ctx == NULL || linea == NULL) {
+        return -1;
+    }
+
+    /* Copia modificable: el parser escribe '\0' entre los tokens */
+    char *copia = strdup(linea);
+    if (copia == NULL) {
+        return -1;
+    }
+
+    /* Duplicamos el fd para que fclose() no cierre el del llamador */
+    int fd = dup(out_fd);
+    FILE *salida = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (salida == NULL) {
+        if (fd >= 0) close(fd);
+        free(copia);
+        return -1;
+    }
+
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = ctx;
+    ctx->salida = salida;
+    ctx->errores = salida;   /* Un solo descriptor: los errores van en orden con la salida */
+
+    int resultado = -1;
+    char **args = parsear_linea(copia);
+    if (args != NULL) {
+        ejecutar(args);
+        MEM_FREE(args);
+        resultado = ctx->activa ? 0 : 1;
+    }
+
+    ctx->salida = NULL;
+    ctx->errores = NULL;
+    sesion_actual = anterior;
+    fclose(salida); /* Vacía el buffer en out_fd */
+    free(copia);
+    return resultado;
+}
+
+void eafitos_destroy(eafitos_ctx *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    sesion_cerrar(ctx);
+    free(ctx);
+}
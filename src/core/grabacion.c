@@ -0,0 +1,451 @@
+/**
+ * @file grabacion.c
+ * @brief Grabación y reproducción de sesiones (ver grabacion.h).
+ *
+ * La salida se captura con un stream de fopencookie() que calcula el XXH64
+ * de todo lo que pasa por él: al grabar reenvía cada byte a la salida
+ * original (el usuario ve lo mismo de siempre), al reproducir la descarta.
+ * Los errores se capturan igual en un hash aparte, que se combina con el
+ * de la salida: así el orden entre ambos streams no afecta al resultado.
+ * La entrada de la sesión se envuelve igual, sin buffer, para anotar solo
+ * los bytes que el comando consumió de verdad y no adelantar la lectura de
+ * la siguiente línea.
+ */
+
+#define _GNU_SOURCE   /* fopencookie */
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "grabacion.h"
+#include "shell.h"
+#include "colors.h"
+#include "formato.h"
+#include "hash.h"     /* xxh64_* */
+#include "utils.h"    /* MEM_FREE */
+
+/** @brief Texto acumulado en un buffer reutilizable. */
+typedef struct {
+    char *datos;
+    size_t n, cap;
+} Texto;
+
+static int texto_agregar(Texto *t, const char *s, size_t n) {
+    if (t->n + n + 1 > t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 256;
+        while (cap < t->n + n + 1) cap *= 2;
+        char *nuevo = realloc(t->datos, cap);
+        if (nuevo == NULL) return -1;
+        t->datos = nuevo;
+        t->cap = cap;
+    }
+    memcpy(t->datos + t->n, s, n);
+    t->n += n;
+    t->datos[t->n] = '\0';
+    return 0;
+}
+
+/** @brief Salida capturada de un comando: hash, tamaño y destino opcional. */
+typedef struct {
+    EstadoXXH64 estado;
+    uint64_t bytes;
+    FILE *destino;            /**< NULL = descartar (reproducción) */
+} Captura;
+
+static ssize_t escribir_captura(void *c, const char *buf, size_t n) {
+    Captura *cap = c;
+    xxh64_actualizar(&cap->estado, buf, n);
+    cap->bytes += n;
+    if (cap->destino != NULL && fwrite(buf, 1, n, cap->destino) != n) {
+        return -1;
+    }
+    return (ssize_t)n;
+}
+
+static int cerrar_captura(void *c) {
+    Captura *cap = c;
+    return (cap->destino != NULL) ? fflush(cap->destino) : 0;
+}
+
+/**
+ * @brief Hash de la línea: el de la salida, combinado con el de los errores
+ *        si los hubo (así las líneas sin errores dan el mismo hash que antes
+ *        de que los errores fueran a su propio stream).
+ */
+static uint64_t hash_linea(Captura *salida, Captura *errores) {
+    uint64_t h = xxh64_final(&salida->estado);
+    if (errores->bytes == 0) {
+        return h;
+    }
+    uint64_t partes[2] = { h, xxh64_final(&errores->estado) };
+    return xxh64(partes, sizeof(partes), 0);
+}
+
+/** @brief Abre un stream de captura con el buffer indicado (NULL si falla). */
+static FILE *abrir_captura(Captura *c, FILE *destino, int modo, size_t tam) {
+    xxh64_iniciar(&c->estado, 0);
+    c->bytes = 0;
+    c->destino = destino;
+    cookie_io_functions_t fs = { NULL, escribir_captura, NULL, cerrar_captura };
+    FILE *f = fopencookie(c, "w", fs);
+    if (f != NULL) {
+        setvbuf(f, NULL, modo, tam);
+    }
+    return f;
+}
+
+/** @brief Entrada envuelta: lo que el comando lee se anota en 'leido'. */
+typedef struct {
+    FILE *fuente;
+    Texto *leido;
+} EntradaGrabada;
+
+static ssize_t leer_entrada(void *c, char *buf, size_t n) {
+    EntradaGrabada *e = c;
+    size_t i = 0;
+    while (i < n) {
+        int ch = fgetc(e->fuente);
+        if (ch == EOF) break;
+        buf[i++] = (char)ch;
+        if (ch == '\n') break;   /* Sin adelantarse a la línea siguiente */
+    }
+    texto_agregar(e->leido, buf, i);
+    return (ssize_t)i;
+}
+
+static uint64_t ahora_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** @brief Escribe 's' con '\\', tab, '\n' y '\r' escapados. */
+static void escribir_escapado(FILE *f, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        switch (s[i]) {
+        case '\\': fputs("\\\\", f); break;
+        case '\t': fputs("\\t", f); break;
+        case '\n': fputs("\\n", f); break;
+        case '\r': fputs("\\r", f); break;
+        default: fputc(s[i], f);
+        }
+    }
+}
+
+/** @brief Deshace escribir_escapado() en el lugar. @return Longitud final. */
+static size_t desescapar(char *s) {
+    char *w = s;
+    for (char *r = s; *r != '\0'; r++) {
+        if (*r != '\\' || r[1] == '\0') {
+            *w++ = *r;
+            continue;
+        }
+        r++;
+        *w++ = (*r == 't') ? '\t' : (*r == 'n') ? '\n' : (*r == 'r') ? '\r' : *r;
+    }
+    *w = '\0';
+    return (size_t)(w - s);
+}
+
+/* ------------------------------------------------------------------ */
+/* Grabación                                                           */
+/* ------------------------------------------------------------------ */
+
+/** @brief Estado de la grabación en curso (solo la sesión interactiva graba). */
+static struct {
+    FILE *archivo;
+    uint64_t inicio_ns;
+    uint64_t linea_ns;        /**< Cuándo se leyó la línea en curso */
+    Texto linea;
+    Texto entrada;
+    Captura captura;
+    Captura captura_errores;
+    EntradaGrabada envoltura;
+    FILE *salida;             /**< Streams de fopencookie de la línea en curso */
+    FILE *errores;
+    FILE *entrada_cookie;
+    FILE *salida_anterior;
+    FILE *errores_anterior;
+    FILE *entrada_anterior;
+} grabacion;
+
+int grabacion_iniciar(const char *ruta) {
+    FILE *f = fopen(ruta, "we");
+    if (f == NULL) {
+        return -1;
+    }
+    /* Un registro por línea y completo en disco aunque la shell muera */
+    setvbuf(f, NULL, _IOLBF, 0);
+    /* El formato de la sesión: la reproducción lo usa para que las salidas
+     * sean comparables aunque se pida el resumen en otro formato */
+    static const char *const nombres[] = { "texto", "json", "tsv" };
+    fprintf(f, "%s %s\n", GRABACION_CABECERA, nombres[sesion_actual->formato]);
+    grabacion.archivo = f;
+    grabacion.inicio_ns = ahora_ns();
+    return 0;
+}
+
+void grabacion_comenzar_linea(const char *linea) {
+    if (grabacion.archivo == NULL) {
+        return;
+    }
+    grabacion.linea_ns = ahora_ns();
+    grabacion.linea.n = 0;
+    grabacion.entrada.n = 0;
+    texto_agregar(&grabacion.linea, linea, strcspn(linea, "\r\n"));
+
+    grabacion.salida_anterior = sesion_actual->salida;
+    grabacion.errores_anterior = sesion_actual->errores;
+    grabacion.entrada_anterior = sesion_actual->entrada;
+    grabacion.envoltura.fuente = entrada_sesion();
+    grabacion.envoltura.leido = &grabacion.entrada;
+
+    /* Por líneas: `leer -f` y el paginador siguen viéndose al momento */
+    grabacion.salida = abrir_captura(&grabacion.captura, salida_sesion(), _IOLBF, 0);
+    if (grabacion.salida != NULL) {
+        sesion_actual->salida = grabacion.salida;
+    }
+    grabacion.errores = abrir_captura(&grabacion.captura_errores, errores_sesion(), _IOLBF, 0);
+    if (grabacion.errores != NULL) {
+        sesion_actual->errores = grabacion.errores;
+    }
+    cookie_io_functions_t fe = { leer_entrada, NULL, NULL, NULL };
+    grabacion.entrada_cookie = fopencookie(&grabacion.envoltura, "r", fe);
+    if (grabacion.entrada_cookie != NULL) {
+        setvbuf(grabacion.entrada_cookie, NULL, _IONBF, 0);
+        sesion_actual->entrada = grabacion.entrada_cookie;
+    }
+}
+
+void grabacion_terminar_linea(void) {
+    if (grabacion.archivo == NULL) {
+        return;
+    }
+    if (grabacion.salida != NULL) {
+        fclose(grabacion.salida);
+        grabacion.salida = NULL;
+    }
+    if (grabacion.errores != NULL) {
+        fclose(grabacion.errores);
+        grabacion.errores = NULL;
+    }
+    if (grabacion.entrada_cookie != NULL) {
+        fclose(grabacion.entrada_cookie);
+        grabacion.entrada_cookie = NULL;
+    }
+    sesion_actual->salida = grabacion.salida_anterior;
+    sesion_actual->errores = grabacion.errores_anterior;
+    sesion_actual->entrada = grabacion.entrada_anterior;
+
+    FILE *f = grabacion.archivo;
+    fprintf(f, "%" PRIu64 "\t%" PRIu64 "\t%016" PRIx64 "\t%" PRIu64 "\t",
+            grabacion.linea_ns - grabacion.inicio_ns, ahora_ns() - grabacion.linea_ns,
+            hash_linea(&grabacion.captura, &grabacion.captura_errores),
+            grabacion.captura.bytes + grabacion.captura_errores.bytes);
+    escribir_escapado(f, grabacion.linea.datos ? grabacion.linea.datos : "", grabacion.linea.n);
+    fputc('\t', f);
+    escribir_escapado(f, grabacion.entrada.datos ? grabacion.entrada.datos : "", grabacion.entrada.n);
+    fputc('\n', f);
+}
+
+void grabacion_cerrar(void) {
+    if (grabacion.archivo != NULL) {
+        fclose(grabacion.archivo);
+        grabacion.archivo = NULL;
+    }
+    free(grabacion.linea.datos);
+    free(grabacion.entrada.datos);
+    memset(&grabacion.linea, 0, sizeof(grabacion.linea));
+    memset(&grabacion.entrada, 0, sizeof(grabacion.entrada));
+}
+
+/* ------------------------------------------------------------------ */
+/* Reproducción                                                        */
+/* ------------------------------------------------------------------ */
+
+/** @brief Un registro ya separado en campos (apuntan a la línea leída). */
+typedef struct {
+    uint64_t t_ns, duracion_ns, hash, bytes;
+    char *linea;
+    char *entrada;
+    size_t n_entrada;
+} Registro;
+
+/** @brief Separa una línea del archivo. @return 0 si tiene el formato esperado. */
+static int separar_registro(char *s, Registro *r) {
+    char *campos[6];
+    for (int i = 0; i < 6; i++) {
+        campos[i] = s;
+        s = (i < 5) ? strchr(s, '\t') : NULL;
+        if (i < 5 && s == NULL) return -1;
+        if (s != NULL) *s++ = '\0';
+    }
+    campos[5][strcspn(campos[5], "\n")] = '\0';
+    char *fin;
+    r->t_ns = strtoull(campos[0], &fin, 10);
+    if (*fin != '\0') return -1;
+    r->duracion_ns = strtoull(campos[1], &fin, 10);
+    if (*fin != '\0') return -1;
+    r->hash = strtoull(campos[2], &fin, 16);
+    if (*fin != '\0') return -1;
+    r->bytes = strtoull(campos[3], &fin, 10);
+    if (*fin != '\0') return -1;
+    r->linea = campos[4];
+    desescapar(r->linea);
+    r->entrada = campos[5];
+    r->n_entrada = desescapar(r->entrada);
+    return 0;
+}
+
+static void dormir_hasta(uint64_t objetivo_ns) {
+    uint64_t t = ahora_ns();
+    if (objetivo_ns <= t) {
+        return;
+    }
+    uint64_t resta = objetivo_ns - t;
+    struct timespec ts = { (time_t)(resta / 1000000000ULL), (long)(resta % 1000000000ULL) };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/** @brief Informa una salida distinta de la grabada (las primeras). */
+static void informar_diferencia(size_t num, const Registro *r, uint64_t hash, uint64_t bytes,
+                                size_t diferencias) {
+    if (diferencias > GRABACION_MAX_DIFERENCIAS) {
+        return;
+    }
+    fprintf(stderr, MSG_WARN("línea %zu ('%s'): salida distinta (grabado %016" PRIx64 ", %"
+            PRIu64 " bytes; ahora %016" PRIx64 ", %" PRIu64 " bytes).") "\n",
+            num, r->linea, r->hash, r->bytes, hash, bytes);
+    if (diferencias == GRABACION_MAX_DIFERENCIAS) {
+        fprintf(stderr, MSG_WARN("... no se detallan más diferencias.") "\n");
+    }
+}
+
+int grabacion_reproducir(const char *ruta, int al_ritmo) {
+    FILE *f = fopen(ruta, "re");
+    if (f == NULL) {
+        fprintf(stderr, COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir '%s': %s\n",
+                ruta, strerror(errno));
+        return 2;
+    }
+    char *texto = NULL;
+    size_t cap_texto = 0;
+    if (getline(&texto, &cap_texto, f) == -1 ||
+        strncmp(texto, GRABACION_CABECERA, strlen(GRABACION_CABECERA)) != 0) {
+        fprintf(stderr, COLOR_RED "[ERROR]" COLOR_RESET " '%s' no es una grabación de EAFITos.\n", ruta);
+        free(texto);
+        fclose(f);
+        return 2;
+    }
+
+    /* Sesión nueva: la reproducción no hereda el estado de la actual */
+    ContextoSesion sesion;
+    sesion_iniciar(&sesion);
+    const char *formato = texto + strlen(GRABACION_CABECERA);
+    char nombre_formato[8] = "";
+    if (sscanf(formato, " %7s", nombre_formato) == 1 && formato_desde_nombre(nombre_formato) >= 0) {
+        sesion.formato = formato_desde_nombre(nombre_formato);
+    }
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &sesion;
+    FILE *vacia = fopen("/dev/null", "re");
+
+    char *copia = NULL;
+    size_t cap_copia = 0;
+    char **tokens = NULL;
+    size_t cap_tokens = 0;
+    size_t num = 1, comandos = 0, diferencias = 0, invalidas = 0;
+    uint64_t grabado_ns = 0, inicio = ahora_ns();
+
+    while (sesion.activa && getline(&texto, &cap_texto, f) != -1) {
+        num++;
+        Registro r;
+        if (texto[0] == '#' || texto[0] == '\n') {
+            continue;
+        }
+        if (separar_registro(texto, &r) != 0) {
+            invalidas++;
+            continue;
+        }
+        if (al_ritmo) {
+            dormir_hasta(inicio + r.t_ns);
+        }
+
+        /* El parser escribe en la línea: copia en un buffer reutilizado */
+        size_t largo = strlen(r.linea) + 1;
+        if (largo > cap_copia) {
+            char *nuevo = realloc(copia, largo);
+            if (nuevo == NULL) break;
+            copia = nuevo;
+            cap_copia = largo;
+        }
+        memcpy(copia, r.linea, largo);
+        char **args = parsear_linea_en(copia, &tokens, &cap_tokens);
+        if (args == NULL) {
+            break;
+        }
+
+        /* Salida y errores se descartan: solo cuentan sus hashes */
+        Captura captura, captura_errores;
+        sesion.salida = abrir_captura(&captura, NULL, _IOFBF, 1 << 16);
+        sesion.errores = abrir_captura(&captura_errores, NULL, _IOFBF, 1 << 12);
+        sesion.entrada = (r.n_entrada > 0) ? fmemopen(r.entrada, r.n_entrada, "r") : vacia;
+        if (sesion.salida != NULL && sesion.errores != NULL) {
+            ejecutar(args);
+        }
+        if (sesion.salida != NULL) fclose(sesion.salida);
+        if (sesion.errores != NULL) fclose(sesion.errores);
+        if (sesion.entrada != vacia && sesion.entrada != NULL) {
+            fclose(sesion.entrada);
+        }
+        sesion.salida = sesion.errores = NULL;
+        sesion.entrada = NULL;
+
+        comandos++;
+        grabado_ns = r.t_ns + r.duracion_ns;
+        uint64_t hash = hash_linea(&captura, &captura_errores);
+        uint64_t bytes = captura.bytes + captura_errores.bytes;
+        if (hash != r.hash || bytes != r.bytes) {
+            informar_diferencia(num, &r, hash, bytes, ++diferencias);
+        }
+    }
+    double segundos = (double)(ahora_ns() - inicio) / 1e9;
+
+    free(texto);
+    free(copia);
+    MEM_FREE(tokens);
+    fclose(f);
+    if (vacia != NULL) fclose(vacia);
+    sesion_cerrar(&sesion);
+    sesion_actual = anterior;
+
+    if (formato_estructurado()) {
+        registro_abrir();
+        registro_entero("comandos", (long long)comandos);
+        registro_entero("diferencias", (long long)diferencias);
+        registro_entero("invalidas", (long long)invalidas);
+        registro_real("segundos", segundos);
+        registro_real("segundos_grabados", (double)grabado_ns / 1e9);
+        registro_real("comandos_por_segundo", segundos > 0 ? comandos / segundos : 0.0);
+        registro_cerrar();
+    } else {
+        imprimir(COLOR_CYAN "Reproducción de %s" COLOR_RESET "%s\n", ruta,
+                 al_ritmo ? " (al ritmo grabado)" : "");
+        imprimir("  Comandos:     %zu\n", comandos);
+        imprimir("  Tiempo:       %.3f s (grabado: %.3f s)\n", segundos, (double)grabado_ns / 1e9);
+        imprimir("  Rendimiento:  %.0f comandos/s\n", segundos > 0 ? comandos / segundos : 0.0);
+        if (invalidas > 0) {
+            imprimir(MSG_WARN("%zu línea(s) mal formadas ignoradas.") "\n", invalidas);
+        }
+        if (diferencias == 0) {
+            imprimir(COLOR_GREEN "  Todas las salidas coinciden con la grabación.\n" COLOR_RESET);
+        } else {
+            imprimir(COLOR_RED "  %zu salida(s) distinta(s) de la grabación.\n" COLOR_RESET, diferencias);
+        }
+    }
+    fflush(salida_sesion());
+    return (invalidas > 0 && comandos == 0) ? 2 : (diferencias > 0) ? 1 : 0;
+}
@@ -14,6 +14,8 @@
  * En este caso, se usa para la función printf() que imprime texto en la terminal.
  */
 #include <stdio.h>
+#include <stdlib.h> /* atoi */
+#include <string.h> /* strcmp */
 
 /*
  * --- Cabeceras Propias ---
@@ -21,23 +23,94 @@
  * como loop_shell(), permitiendo que main() conozca su existencia.
  */
 #include "shell.h"
+#include "plugins.h"
+#include "formato.h"
+#include "configuracion.h"
+#include "grabacion.h"
 
 /**
  * @brief Función principal del programa.
  * 
  * En C, la ejecución siempre comienza en la función main.
+ *
+ * Opciones de línea de comandos:
+ *   --servidor <ruta.sock>   Atiende sesiones remotas por un socket Unix.
+ *   --trabajadores <N>       Procesos trabajadores del servidor (por defecto, uno por CPU).
+ *   --formato <json|tsv>     Salida estructurada en todas las sesiones (ver formato.h).
+ *   --grabar <archivo>       Graba cada línea con su instante y el hash de su salida.
+ *   --reproducir <archivo>   Reproduce una grabación y compara las salidas (grabacion.h).
+ *   --ritmo                  Con --reproducir, respeta los tiempos grabados.
  * 
+ * @param argc Número de argumentos de la línea de comandos.
+ * @param argv Argumentos de la línea de comandos.
  * @return int Retorna 0 al sistema operativo para indicar que el programa
  *         terminó correctamente (EXIT_SUCCESS).
  */
-int main() {
-    // Imprime el mensaje de bienvenida a la salida estándar (stdout)
-    printf("Iniciando EAFITos v1.0...\n");
-    printf("Escribe 'ayuda' para comenzar.\n\n");
-    
+int main(int argc, char **argv) {
+    const char *ruta_socket = NULL;
+    const char *ruta_grabar = NULL;
+    const char *ruta_reproducir = NULL;
+    int trabajadores = 0;
+    int al_ritmo = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--servidor") == 0 && i + 1 < argc) {
+            ruta_socket = argv[++i];
+        } else if (strcmp(argv[i], "--trabajadores") == 0 && i + 1 < argc) {
+            trabajadores = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--formato") == 0 && i + 1 < argc &&
+                   formato_desde_nombre(argv[i + 1]) >= 0) {
+            formato_establecer_global(formato_desde_nombre(argv[++i]));
+        } else if (strcmp(argv[i], "--grabar") == 0 && i + 1 < argc) {
+            ruta_grabar = argv[++i];
+        } else if (strcmp(argv[i], "--reproducir") == 0 && i + 1 < argc) {
+            ruta_reproducir = argv[++i];
+        } else if (strcmp(argv[i], "--ritmo") == 0) {
+            al_ritmo = 1;
+        } else {
+            fprintf(stderr, "Uso: %s [--formato texto|json|tsv] [--servidor <ruta.sock> [--trabajadores N]]\n"
+                    "       [--grabar <archivo> | --reproducir <archivo> [--ritmo]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (ruta_socket != NULL) {
+        // Modo servidor: las sesiones llegan por el socket (ver servidor.c).
+        // Los alias y variables del rc valen para todas; el prompt no.
+        plugins_inicializar(NULL);
+        configuracion_cargar(NULL, NULL);
+        return servidor_ejecutar(ruta_socket, trabajadores);
+    }
+
+    if (ruta_reproducir != NULL) {
+        // Reproducción: sin bienvenida ni prompt, solo el resumen.
+        plugins_inicializar(NULL);
+        configuracion_cargar(NULL, NULL);
+        return grabacion_reproducir(ruta_reproducir, al_ritmo);
+    }
+    if (ruta_grabar != NULL && grabacion_iniciar(ruta_grabar) != 0) {
+        perror(ruta_grabar);
+        return 1;
+    }
+
+    // Imprime el mensaje de bienvenida a la salida estándar (stdout).
+    // Con salida estructurada no se imprime: stdout solo lleva registros.
+    if (formato_global() == FORMATO_TEXTO) {
+        printf("Iniciando EAFITos v1.0...\n");
+        printf("Escribe 'ayuda' para comenzar.\n\n");
+    }
+
+    // Registra los plugins leyendo solo su índice; los .so se cargan al usarse.
+    plugins_inicializar(NULL);
+
+    // Alias, variables y prompt de ~/.eafitosrc (desde su instantánea si está al día).
+    configuracion_cargar(NULL, sesion_actual);
+
     // Llama al bucle principal de la shell ubicado en src/core/shell_loop.c.
     // Esta función no retornará hasta que el usuario decida salir.
     loop_shell();
+    grabacion_cerrar();
 
     // Retornamos 0 para indicar una finalización exitosa.
     return 0;
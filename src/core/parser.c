@@ -7,9 +7,11 @@
  */
 
 #include <stdio.h>  // Para getline, perror, fprintf, stdin
-#include <stdlib.h> // Para malloc, realloc, free, exit
-#include <string.h> // Para strtok
+#include <stdlib.h> // Para free
+#include <string.h> // Para strtok_r
 #include "shell.h"  // Definiciones globales como DELIM
+#include "colors.h" // Mensajes de error de las redirecciones
+#include "utils.h"  // MEM_REALLOC, MEM_FREE (rastreo opcional)
 
 /**
  * @brief Lee una línea completa de texto desde la entrada estándar (teclado).
@@ -18,26 +20,40 @@
  * getline() maneja automáticamente la asignación de memoria: si la línea es
  * demasiado larga para el buffer, getline() lo redimensiona usando realloc().
  * 
- * @return char* Puntero a la cadena de caracteres (string) leída.
+ * No termina el proceso en EOF ni en error: devuelve NULL y deja que el
+ * llamador (loop_shell) decida, para que la shell pueda embeberse.
+ *
+ * @return char* Puntero a la cadena de caracteres (string) leída, o NULL.
  *         IMPORTANTE: El llamador es responsable de liberar (free) esta memoria.
  */
 char *leer_linea(void) {
     char *linea = NULL;
     size_t bufsize = 0; // getline asignará el tamaño necesario
 
+    if (leer_linea_en(&linea, &bufsize) == NULL) {
+        free(linea); // getline pudo reservar el buffer aunque falle
+        return NULL;
+    }
+    return linea;
+}
+
+/**
+ * @brief Como leer_linea(), pero reutilizando el buffer de la llamada anterior.
+ *
+ * getline() solo hace realloc() si la línea no cabe: en el bucle de la
+ * shell, pasada la primera línea larga, leer no reserva memoria.
+ */
+char *leer_linea_en(char **buffer, size_t *capacidad) {
     // getline(&buffer, &tamaño, stream)
     // Lee hasta encontrar un salto de línea o EOF (End Of File)
-    if (getline(&linea, &bufsize, stdin) == -1) {
-        if (feof(stdin)) {
-            // Se encontró EOF (Ctrl+D), salimos elegantemente
-            exit(EXIT_SUCCESS);
-        } else {
-            // Ocurrió un error real
+    if (getline(buffer, capacidad, stdin) == -1) {
+        if (!feof(stdin)) {
+            // Ocurrió un error real (EOF con Ctrl+D es el fin normal)
             perror("Error al leer línea");
-            exit(EXIT_FAILURE);
         }
+        return NULL;
     }
-    return linea;
+    return *buffer;
 }
 
 /**
@@ -50,47 +66,130 @@ char *leer_linea(void) {
  * introducirá el usuario.
  * 
  * @param linea La cadena de texto cruda leída anteriormente.
- * @return char** Un arreglo de cadenas (doble puntero) terminado en NULL.
+ * @return char** Un arreglo de cadenas (doble puntero) terminado en NULL,
+ *         o NULL si no hubo memoria suficiente.
  */
 char **parsear_linea(char *linea) {
-    int bufsize = 64; // Tamaño inicial arbitrario del buffer de tokens
-    int posicion = 0;
-    
-    // malloc: Asigna un bloque de memoria de (64 * tamaño_puntero) bytes.
-    // char** tokens es, en esencia, una lista de punteros a string.
-    char **tokens = malloc(bufsize * sizeof(char*));
-    char *token;
-
-    if (!tokens) {
-        fprintf(stderr, "Error de asignación de memoria (malloc falló)\n");
-        exit(EXIT_FAILURE);
+    char **tokens = NULL;
+    size_t capacidad = 0;
+    if (parsear_linea_en(linea, &tokens, &capacidad) == NULL) {
+        MEM_FREE(tokens);
+        return NULL;
     }
+    return tokens;
+}
 
-    // strtok: Divide el string 'linea' usando los delimitadores (espacio, tab, etc.)
-    // La primera llamada toma la cadena; las siguientes con NULL continúan parseando la misma cadena.
-    token = strtok(linea, DELIM);
-    while (token != NULL) {
-        tokens[posicion] = token;
-        posicion++;
+/**
+ * @brief Como parsear_linea(), pero en un arreglo que se reutiliza.
+ *
+ * El arreglo solo crece (de 64 en 64 punteros) cuando la línea tiene más
+ * tokens de los que caben, así que el bucle de la shell no reserva memoria
+ * por cada línea. Si falla, el arreglo anterior sigue siendo del llamador.
+ */
+char **parsear_linea_en(char *linea, char ***tokens, size_t *capacidad) {
+    size_t posicion = 0;
+    char *token;
+    char *guardado; // Estado de strtok_r (en lugar del estado global de strtok)
 
-        // Si tenemos más argumentos que el tamaño de nuestro buffer...
-        if (posicion >= bufsize) {
-            bufsize += 64; // Aumentamos el tamaño
+    // strtok_r: Divide el string 'linea' usando los delimitadores (espacio, tab, etc.)
+    // La primera llamada toma la cadena; las siguientes con NULL continúan parseando la misma cadena.
+    // A diferencia de strtok, guarda su progreso en 'guardado', así que varios hilos
+    // pueden parsear líneas distintas a la vez.
+    token = strtok_r(linea, DELIM, &guardado);
+    for (;;) {
+        // Si no queda sitio para este token (o para el NULL final)...
+        if (posicion >= *capacidad) {
+            size_t nueva = *capacidad + 64; // Aumentamos el tamaño
             // realloc: Intenta redimensionar el bloque de memoria existente,
-            // preservando el contenido anterior.
-            tokens = realloc(tokens, bufsize * sizeof(char*));
-            if (!tokens) {
-                fprintf(stderr, "Error de reasignación de memoria (realloc falló)\n");
-                exit(EXIT_FAILURE);
+            // preservando el contenido anterior (con NULL equivale a malloc).
+            char **nuevos = MEM_REALLOC(*tokens, nueva * sizeof(char*));
+            if (!nuevos) {
+                fprintf(stderr, "Error de asignación de memoria (realloc falló)\n");
+                return NULL;
             }
+            *tokens = nuevos;
+            *capacidad = nueva;
         }
+        if (token == NULL) {
+            break;
+        }
+        (*tokens)[posicion] = token;
+        posicion++;
 
         // Obtener el siguiente token
-        token = strtok(NULL, DELIM);
+        token = strtok_r(NULL, DELIM, &guardado);
     }
     
     // Lista terminada en NULL: Convención estándar en C para indicar el fin de un arreglo de punteros.
     // Esencial para que las funciones que usen 'args' sepan dónde parar.
-    tokens[posicion] = NULL;
-    return tokens;
+    (*tokens)[posicion] = NULL;
+    return *tokens;
+}
+
+/**
+ * @brief Reconoce un token de redirección: un operador solo (`>`) o
+ *        seguido del archivo (`>out.txt`).
+ *
+ * Un token que después del operador vuelve a tener '<' o '>' (como
+ * `<div>`) no es una redirección sino texto, para que `buscar <div> f`
+ * siga funcionando.
+ *
+ * @param token Token a revisar.
+ * @param tipo Recibe '<', '>', 'a' (>>), 'e' (2>), 'E' (2>>) o '&' (&>).
+ * @return Longitud del operador, o 0 si el token no es una redirección.
+ */
+static size_t operador_redireccion(const char *token, char *tipo) {
+    static const struct { const char *op; char tipo; } operadores[] = {
+        { "2>>", 'E' }, { "2>", 'e' }, { "&>", '&' }, { ">>", 'a' }, { ">", '>' }, { "<", '<' },
+    };
+    for (size_t i = 0; i < sizeof(operadores) / sizeof(operadores[0]); i++) {
+        size_t n = strlen(operadores[i].op);
+        if (strncmp(token, operadores[i].op, n) == 0) {
+            if (strpbrk(token + n, "<>") != NULL) {
+                return 0;
+            }
+            *tipo = operadores[i].tipo;
+            return n;
+        }
+    }
+    return 0;
+}
+
+int separar_redirecciones(char **args, Redirecciones *r) {
+    memset(r, 0, sizeof(*r));
+    int destino = 0;
+    for (int i = 0; args[i] != NULL; i++) {
+        char tipo;
+        size_t n = operador_redireccion(args[i], &tipo);
+        if (n == 0) {
+            /* "\>" y "\<" al principio: el texto literal, sin la barra */
+            const char *t = args[i];
+            int escapado = t[0] == '\\' && (t[1] == '<' || t[1] == '>' ||
+                                             ((t[1] == '2' || t[1] == '&') && t[2] == '>'));
+            args[destino++] = args[i] + escapado;
+            continue;
+        }
+
+        /* Archivo pegado al operador (">out") o en el token siguiente */
+        const char *archivo = args[i] + n;
+        if (*archivo == '\0') {
+            archivo = args[i + 1];
+            if (archivo == NULL || operador_redireccion(archivo, &(char){0}) > 0) {
+                imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Falta el archivo después de '%s'.\n", args[i]);
+                return -1;
+            }
+            i++;
+        }
+
+        switch (tipo) {
+        case '<': r->entrada = archivo; break;
+        case '>': r->salida = archivo; r->anexar_salida = 0; break;
+        case 'a': r->salida = archivo; r->anexar_salida = 1; break;
+        case 'e': r->errores = archivo; r->anexar_errores = 0; break;
+        case 'E': r->errores = archivo; r->anexar_errores = 1; break;
+        case '&': r->salida = r->errores = archivo; r->anexar_salida = r->anexar_errores = 0; break;
+        }
+    }
+    args[destino] = NULL;
+    return 0;
 }
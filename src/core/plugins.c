@@ -0,0 +1,260 @@
+/**
+ * @file plugins.c
+ * @brief Registro perezoso de comandos externos cargados con dlopen().
+ *
+ * Al iniciar la shell solo se parsea el índice `plugins.idx`: una línea por
+ * comando con el nombre, el .so, el símbolo exportado y una descripción.
+ * La biblioteca compartida se abre la primera vez que se usa el comando,
+ * por lo que instalar más plugins no hace más lento el arranque.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>    /* dlopen, dlsym, dlclose, dlerror */
+#include <pthread.h>  /* Mutex para la carga perezosa desde varios hilos */
+#include "plugins.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
+#include "colors.h"
+
+/** @brief Estado de una entrada del índice. */
+typedef enum {
+    PLUGIN_SIN_CARGAR = 0,  /**< Solo conocemos lo que dice el índice */
+    PLUGIN_CARGADO,         /**< dlopen + dlsym correctos */
+    PLUGIN_ERROR            /**< Falló la carga; no se reintenta */
+} EstadoPlugin;
+
+/** @brief Una línea del índice más el estado de carga. */
+typedef struct {
+    char *nombre;                 /**< Comando que registra */
+    char *ruta;                   /**< Ruta completa al .so */
+    char *simbolo;                /**< Símbolo del PluginComando */
+    char *descripcion;            /**< Descripción corta (para 'ayuda') */
+    EstadoPlugin estado;
+    void *handle;                 /**< Devuelto por dlopen() */
+    const PluginComando *def;     /**< Descriptor resuelto con dlsym() */
+} EntradaPlugin;
+
+static EntradaPlugin *plugins = NULL;
+static int n_plugins = 0;
+
+/** @brief Protege la carga perezosa cuando varios hilos usan la biblioteca. */
+static pthread_mutex_t mutex_carga = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Construye la ruta del directorio de plugins por defecto.
+ */
+static void directorio_por_defecto(char *destino, size_t tam) {
+    const char *env = getenv(PLUGINS_ENV_DIR);
+    if (env != NULL && env[0] != '\0') {
+        snprintf(destino, tam, "%s", env);
+        return;
+    }
+    const char *home = getenv("HOME");
+    snprintf(destino, tam, "%s/.eafitos/plugins", home ? home : ".");
+}
+
+/**
+ * @brief Parsea una línea del índice y la añade al registro.
+ *
+ * Las líneas mal formadas se ignoran con un aviso, para que un plugin roto
+ * no impida arrancar la shell.
+ */
+static void registrar_linea(const char *dir, char *linea, int num_linea) {
+    char *guardado = NULL;
+    char *nombre  = strtok_r(linea, " \t\r\n", &guardado);
+    if (nombre == NULL || nombre[0] == '#') {
+        return; /* Línea vacía o comentario */
+    }
+    char *archivo = strtok_r(NULL, " \t\r\n", &guardado);
+    char *simbolo = strtok_r(NULL, " \t\r\n", &guardado);
+    if (archivo == NULL || simbolo == NULL) {
+        fprintf(stderr, MSG_WARN("plugins.idx:%d: se esperaba "
+                "'<comando> <archivo.so> <simbolo>'.") "\n", num_linea);
+        return;
+    }
+
+    /* El resto de la línea (sin espacios iniciales ni salto final) es la descripción */
+    char vacia[1] = "";
+    char *desc = guardado ? guardado + strspn(guardado, " \t") : vacia;
+    desc[strcspn(desc, "\r\n")] = '\0';
+
+    EntradaPlugin *nuevo = realloc(plugins, (n_plugins + 1) * sizeof(EntradaPlugin));
+    if (nuevo == NULL) {
+        fprintf(stderr, "Error de asignación de memoria (realloc falló)\n");
+        return;
+    }
+    plugins = nuevo;
+
+    EntradaPlugin *e = &plugins[n_plugins];
+    memset(e, 0, sizeof(*e));
+    e->nombre      = strdup(nombre);
+    e->simbolo     = strdup(simbolo);
+    e->descripcion = strdup(desc);
+    if (archivo[0] == '/') {
+        e->ruta = strdup(archivo);
+    } else {
+        size_t tam = strlen(dir) + strlen(archivo) + 2;
+        e->ruta = malloc(tam);
+        if (e->ruta != NULL) {
+            snprintf(e->ruta, tam, "%s/%s", dir, archivo);
+        }
+    }
+    if (!e->nombre || !e->simbolo || !e->descripcion || !e->ruta) {
+        fprintf(stderr, "Error de asignación de memoria (strdup falló)\n");
+        free(e->nombre);
+        free(e->simbolo);
+        free(e->descripcion);
+        free(e->ruta);
+        return;
+    }
+    n_plugins++;
+}
+
+int plugins_inicializar(const char *directorio) {
+    char dir[1024];
+    if (directorio != NULL) {
+        snprintf(dir, sizeof(dir), "%s", directorio);
+    } else {
+        directorio_por_defecto(dir, sizeof(dir));
+    }
+
+    /* Volver a inicializar reemplaza el registro en vez de duplicarlo */
+    plugins_liberar();
+
+    char ruta_indice[1100];
+    snprintf(ruta_indice, sizeof(ruta_indice), "%s/" PLUGINS_INDICE, dir);
+
+    FILE *fp = fopen(ruta_indice, "r");
+    if (fp == NULL) {
+        return 0; /* Sin índice no hay plugins: no es un error */
+    }
+
+    char linea[1024];
+    int num_linea = 0;
+    while (fgets(linea, sizeof(linea), fp) != NULL) {
+        registrar_linea(dir, linea, ++num_linea);
+    }
+    fclose(fp);
+    return n_plugins;
+}
+
+/**
+ * @brief Busca una entrada del índice por nombre de comando.
+ */
+static EntradaPlugin *buscar_plugin(const char *nombre) {
+    for (int i = 0; i < n_plugins; i++) {
+        if (strcmp(plugins[i].nombre, nombre) == 0) {
+            return &plugins[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Carga el .so de una entrada la primera vez que se necesita.
+ *
+ * Verifica que el símbolo exista, que la versión del ABI coincida y que
+ * el nombre declarado por el plugin sea el mismo del índice.
+ *
+ * @return 1 si el plugin está listo para usarse, 0 si no se pudo cargar.
+ */
+static int cargar_plugin_sin_bloqueo(EntradaPlugin *e) {
+    if (e->estado == PLUGIN_CARGADO) return 1;
+    if (e->estado == PLUGIN_ERROR)   return 0;
+
+    e->estado = PLUGIN_ERROR; /* Se corrige al final si todo sale bien */
+
+    /* RTLD_LAZY: los símbolos del plugin se resuelven al usarse por primera vez */
+    e->handle = dlopen(e->ruta, RTLD_LAZY | RTLD_LOCAL);
+    if (e->handle == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo cargar el plugin '%s': %s\n",
+                     e->nombre, dlerror());
+        return 0;
+    }
+
+    dlerror(); /* Limpia errores previos antes de dlsym */
+    const PluginComando *def = dlsym(e->handle, e->simbolo);
+    if (def == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " El plugin '%s' no exporta '%s'.\n",
+                     e->nombre, e->simbolo);
+    } else if (def->abi != EAFITOS_PLUGIN_ABI) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " El plugin '%s' usa el ABI %d "
+                     "(se esperaba %d).\n", e->nombre, def->abi, EAFITOS_PLUGIN_ABI);
+    } else if (def->funcion == NULL || def->nombre == NULL ||
+               strcmp(def->nombre, e->nombre) != 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " El plugin '%s' no coincide con "
+                     "su entrada en " PLUGINS_INDICE ".\n", e->nombre);
+    } else {
+        e->def = def;
+        e->estado = PLUGIN_CARGADO;
+        return 1;
+    }
+
+    dlclose(e->handle);
+    e->handle = NULL;
+    return 0;
+}
+
+/**
+ * @brief Versión segura entre hilos de cargar_plugin_sin_bloqueo().
+ */
+static int cargar_plugin(EntradaPlugin *e) {
+    pthread_mutex_lock(&mutex_carga);
+    int listo = cargar_plugin_sin_bloqueo(e);
+    pthread_mutex_unlock(&mutex_carga);
+    return listo;
+}
+
+int plugins_ejecutar(char **args) {
+    EntradaPlugin *e = buscar_plugin(args[0]);
+    if (e == NULL) {
+        return 0;
+    }
+    if (cargar_plugin(e)) {
+        e->def->funcion(args);
+    }
+    return 1;
+}
+
+int plugins_existe(const char *nombre) {
+    return buscar_plugin(nombre) != NULL;
+}
+
+int plugins_mostrar_ayuda(const char *nombre) {
+    EntradaPlugin *e = buscar_plugin(nombre);
+    if (e == NULL) {
+        return 0;
+    }
+    if (cargar_plugin(e)) {
+        imprimir_ayuda(&e->def->ayuda);
+    }
+    return 1;
+}
+
+void plugins_listar(void) {
+    if (n_plugins == 0) {
+        return;
+    }
+    /* Solo se usa la descripción del índice: no hace falta abrir ningún .so */
+    imprimir(COLOR_YELLOW "\n  Plugins:\n" COLOR_RESET);
+    for (int i = 0; i < n_plugins; i++) {
+        imprimir(COLOR_GREEN "    %-24s" COLOR_RESET " %s\n",
+               plugins[i].nombre, plugins[i].descripcion);
+    }
+}
+
+void plugins_liberar(void) {
+    for (int i = 0; i < n_plugins; i++) {
+        if (plugins[i].handle != NULL) {
+            dlclose(plugins[i].handle);
+        }
+        free(plugins[i].nombre);
+        free(plugins[i].ruta);
+        free(plugins[i].simbolo);
+        free(plugins[i].descripcion);
+    }
+    free(plugins);
+    plugins = NULL;
+    n_plugins = 0;
+}
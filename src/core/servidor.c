@@ -0,0 +1,526 @@
+/**
+ * @file servidor.c
+ * @brief Modo servidor: muchas sesiones de EAFITos en un solo proceso.
+ *
+ * Uso: sistema_os --servidor /ruta.sock [--trabajadores N]
+ *
+ * Arquitectura (modelo "pre-fork"):
+ *  - El proceso padre crea el socket Unix y lanza N trabajadores con fork().
+ *  - Cada trabajador tiene su propio bucle epoll que vigila el socket de
+ *    escucha (con EPOLLEXCLUSIVE, para que solo uno despierte por conexión)
+ *    y los sockets de sus clientes.
+ *  - Cada cliente tiene su propio ContextoSesion (prompt, directorio, ...),
+ *    cuya salida es un stream sobre el socket del cliente. Antes de ejecutar
+ *    una línea se activa su contexto.
+ *  - El bucle epoll solo acepta conexiones y lee. Las líneas completas de un
+ *    cliente pasan a una cola que atiende un grupo fijo de hilos del
+ *    trabajador, mientras su socket queda fuera de epoll (EPOLLONESHOT); al
+ *    terminar, el hilo lo vuelve a armar. Un comando largo, o un cliente que
+ *    deja de leer su salida, solo ocupa un hilo, no detiene al bucle.
+ *  - Si la cola está llena, el cliente espera en una lista del bucle con su
+ *    socket sin armar: no se le lee nada más (contrapresión) hasta que un
+ *    hilo libera un puesto y avisa al bucle por un eventfd.
+ *
+ * El costo de arranque se paga una vez por trabajador, no por sesión.
+ */
+
+#define _GNU_SOURCE   /* accept4 */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/epoll.h>   /* epoll_create1, epoll_ctl, epoll_wait */
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>      /* struct sockaddr_un */
+#include <sys/wait.h>
+#include "shell.h"
+#include "colors.h"
+#include "utils.h"    /* MEM_FREE */
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+/** @brief Máximo de eventos procesados por cada llamada a epoll_wait(). */
+#define MAX_EVENTOS 64
+
+/** @brief Tamaño de lectura de cada read() sobre un cliente. */
+#define TAM_LECTURA 4096
+
+/** @brief Un cliente conectado a un trabajador. */
+typedef struct Cliente {
+    int fd;               /**< Socket del cliente */
+    FILE *salida;         /**< Stream de escritura sobre el socket (ctx.salida) */
+    ContextoSesion ctx;   /**< Estado propio de la sesión */
+    char *buffer;         /**< Bytes recibidos aún sin procesar */
+    size_t usado;         /**< Bytes válidos en buffer */
+    size_t capacidad;     /**< Tamaño reservado de buffer */
+    int epfd;             /**< epoll del trabajador (para rearmar o quitar el socket) */
+    int fin_entrada;      /**< 1 cuando el cliente cerró su lado (EOF) */
+    struct Cliente *siguiente_en_espera; /**< Lista de espera del bucle (cola llena) */
+} Cliente;
+
+/**
+ * @brief Grupo fijo de hilos de un trabajador y su cola de clientes.
+ *
+ * La cola es circular y se protege con el candado. La lista de espera solo
+ * la toca el hilo del bucle epoll.
+ */
+typedef struct {
+    pthread_mutex_t candado;
+    pthread_cond_t hay_trabajo;
+    Cliente *cola[SERVIDOR_COLA];
+    size_t inicio, n;
+    int aviso;                  /**< eventfd: un hilo liberó un puesto de la cola llena */
+    Cliente *espera_primero;    /**< Clientes que no cupieron, en orden de llegada */
+    Cliente *espera_ultimo;
+} GrupoHilos;
+
+/** @brief Grupo de hilos de este proceso trabajador. */
+static GrupoHilos grupo = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, {NULL}, 0, 0, -1, NULL, NULL
+};
+
+/** @brief Se pone en 1 cuando el padre recibe SIGINT/SIGTERM. */
+static volatile sig_atomic_t detener = 0;
+
+static void manejador_detener(int sig) {
+    (void)sig;
+    detener = 1;
+}
+
+/**
+ * @brief Escribe el prompt de la sesión en el socket del cliente.
+ */
+static void enviar_prompt(Cliente *c) {
+    fprintf(c->salida, COLOR_CYAN COLOR_BOLD "%s" COLOR_RESET "> ", c->ctx.prompt);
+    fflush(c->salida);
+}
+
+/**
+ * @brief Ejecuta una línea dentro del contexto de un cliente.
+ *
+ * Activa la sesión del cliente; su salida ya apunta al socket. No se hace
+ * fchdir(): varias sesiones corren a la vez en hilos del mismo proceso y
+ * los comandos resuelven las rutas con el dir_fd de la sesión.
+ */
+static void ejecutar_linea(Cliente *c, char *linea) {
+    sesion_actual = &c->ctx;
+
+    char **args = parsear_linea(linea);
+    if (args != NULL) {
+        ejecutar(args);
+        MEM_FREE(args);
+    }
+    fflush(c->salida);
+}
+
+/**
+ * @brief Procesa todas las líneas completas del buffer de un cliente.
+ * @return 1 si la sesión sigue activa, 0 si el cliente ejecutó 'salir'.
+ */
+static int procesar_lineas(Cliente *c) {
+    size_t inicio = 0;
+    for (size_t i = 0; i < c->usado; i++) {
+        if (c->buffer[i] != '\n') {
+            continue;
+        }
+        c->buffer[i] = '\0';
+        ejecutar_linea(c, c->buffer + inicio);
+        inicio = i + 1;
+        if (!c->ctx.activa) {
+            return 0;
+        }
+        enviar_prompt(c);
+    }
+
+    /* Conservamos la línea incompleta al inicio del buffer */
+    memmove(c->buffer, c->buffer + inicio, c->usado - inicio);
+    c->usado -= inicio;
+    return 1;
+}
+
+/**
+ * @brief Cierra la conexión de un cliente y libera su sesión.
+ */
+static void cerrar_cliente(Cliente *c) {
+    epoll_ctl(c->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    fclose(c->salida);
+    close(c->fd);
+    sesion_cerrar(&c->ctx);
+    free(c->buffer);
+    free(c);
+}
+
+/**
+ * @brief Vuelve a vigilar el socket del cliente (o lo cierra si no se puede).
+ */
+static void rearmar_cliente(Cliente *c) {
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = c };
+    if (epoll_ctl(c->epfd, EPOLL_CTL_MOD, c->fd, &ev) != 0) {
+        perror("epoll_ctl");
+        cerrar_cliente(c);
+    }
+}
+
+/**
+ * @brief Ejecuta las líneas completas de un cliente (en un hilo del grupo).
+ *
+ * Mientras corre, el socket no está armado en epoll: el bucle del
+ * trabajador no toca este cliente hasta que el hilo lo rearma o lo cierra.
+ */
+static void ejecutar_cliente(Cliente *c) {
+    int sigue = procesar_lineas(c);
+    if (sigue && c->fin_entrada && c->usado > 0) {
+        /* EOF (Ctrl+D en el cliente): ejecutamos la última línea sin '\n' */
+        c->buffer[c->usado] = '\0';
+        ejecutar_linea(c, c->buffer);
+        c->usado = 0;
+    }
+    if (!sigue || c->fin_entrada) {
+        cerrar_cliente(c);
+    } else {
+        rearmar_cliente(c);
+    }
+}
+
+/**
+ * @brief Hilo del grupo: toma clientes de la cola y ejecuta sus líneas.
+ */
+static void *hilo_del_grupo(void *arg) {
+    GrupoHilos *g = arg;
+    for (;;) {
+        pthread_mutex_lock(&g->candado);
+        while (g->n == 0) {
+            pthread_cond_wait(&g->hay_trabajo, &g->candado);
+        }
+        Cliente *c = g->cola[g->inicio];
+        g->inicio = (g->inicio + 1) % SERVIDOR_COLA;
+        int estaba_llena = (g->n-- == SERVIDOR_COLA);
+        pthread_mutex_unlock(&g->candado);
+
+        if (estaba_llena) {
+            /* Puede haber clientes en espera: el bucle los pasa a la cola */
+            uint64_t uno = 1;
+            ssize_t escritos = write(g->aviso, &uno, sizeof(uno));
+            (void)escritos;
+        }
+        ejecutar_cliente(c);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Pone un cliente en la cola del grupo.
+ * @return 0, o -1 si la cola está llena.
+ */
+static int encolar(GrupoHilos *g, Cliente *c) {
+    pthread_mutex_lock(&g->candado);
+    if (g->n == SERVIDOR_COLA) {
+        pthread_mutex_unlock(&g->candado);
+        return -1;
+    }
+    g->cola[(g->inicio + g->n) % SERVIDOR_COLA] = c;
+    g->n++;
+    pthread_cond_signal(&g->hay_trabajo);
+    pthread_mutex_unlock(&g->candado);
+    return 0;
+}
+
+/**
+ * @brief Manda a ejecutar las líneas de un cliente.
+ *
+ * Si la cola está llena (o ya hay otros esperando, para respetar el orden),
+ * el cliente queda en la lista de espera con el socket sin armar: no se le
+ * lee nada más hasta que entre a la cola.
+ */
+static void despachar_cliente(GrupoHilos *g, Cliente *c) {
+    if (g->espera_primero == NULL && encolar(g, c) == 0) {
+        return;
+    }
+    c->siguiente_en_espera = NULL;
+    if (g->espera_ultimo != NULL) {
+        g->espera_ultimo->siguiente_en_espera = c;
+    } else {
+        g->espera_primero = c;
+    }
+    g->espera_ultimo = c;
+}
+
+/**
+ * @brief Pasa a la cola los clientes en espera que quepan (tras el aviso).
+ */
+static void atender_espera(GrupoHilos *g) {
+    uint64_t avisos;
+    ssize_t leidos = read(g->aviso, &avisos, sizeof(avisos));
+    (void)leidos;
+    while (g->espera_primero != NULL && encolar(g, g->espera_primero) == 0) {
+        g->espera_primero = g->espera_primero->siguiente_en_espera;
+    }
+    if (g->espera_primero == NULL) {
+        g->espera_ultimo = NULL;
+    }
+}
+
+/**
+ * @brief Crea el eventfd de aviso y los hilos del grupo.
+ * @return 0, o -1 si no se pudo crear ningún hilo.
+ */
+static int iniciar_grupo(GrupoHilos *g, int epfd) {
+    g->aviso = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = g };
+    if (g->aviso < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, g->aviso, &ev) != 0) {
+        perror("eventfd");
+        return -1;
+    }
+    int creados = 0;
+    pthread_attr_t atributos;
+    pthread_attr_init(&atributos);
+    pthread_attr_setdetachstate(&atributos, PTHREAD_CREATE_DETACHED);
+    for (int i = 0; i < SERVIDOR_HILOS; i++) {
+        pthread_t hilo;
+        if (pthread_create(&hilo, &atributos, hilo_del_grupo, g) == 0) {
+            creados++;
+        }
+    }
+    pthread_attr_destroy(&atributos);
+    return creados > 0 ? 0 : -1;
+}
+
+/**
+ * @brief Lee lo disponible de un cliente y, si completó alguna línea, la
+ *        manda a ejecutar al grupo de hilos.
+ */
+static void atender_cliente(Cliente *c) {
+    if (c->capacidad - c->usado < TAM_LECTURA) {
+        size_t nueva = c->capacidad * 2 + TAM_LECTURA;
+        char *tmp = realloc(c->buffer, nueva + 1); /* +1 para el '\0' final */
+        if (tmp == NULL) {
+            fprintf(stderr, "Error de reasignación de memoria (realloc falló)\n");
+            cerrar_cliente(c);
+            return;
+        }
+        c->buffer = tmp;
+        c->capacidad = nueva;
+    }
+
+    /* epoll ya indicó que hay datos: este read() no se bloquea */
+    size_t antes = c->usado;
+    ssize_t n = read(c->fd, c->buffer + c->usado, c->capacidad - c->usado);
+    if (n < 0 && errno == EINTR) {
+        rearmar_cliente(c);
+        return;
+    }
+    if (n <= 0) {
+        c->fin_entrada = 1;
+        if (c->usado == 0) {
+            cerrar_cliente(c);
+            return;
+        }
+    } else {
+        c->usado += (size_t)n;
+        if (memchr(c->buffer + antes, '\n', (size_t)n) == NULL) {
+            rearmar_cliente(c);   /* Línea incompleta: a esperar el resto */
+            return;
+        }
+    }
+
+    despachar_cliente(&grupo, c);
+}
+
+/**
+ * @brief Acepta conexiones pendientes y las registra en epoll.
+ */
+static void aceptar_clientes(int fd_escucha, int epfd) {
+    for (;;) {
+        /* El socket de escucha es no bloqueante: otro trabajador pudo ganar
+         * la conexión, en cuyo caso accept4() devuelve EAGAIN. */
+        int fd = accept4(fd_escucha, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept4");
+            }
+            return;
+        }
+
+        Cliente *c = calloc(1, sizeof(Cliente));
+        int fd_salida = dup(fd); /* fclose(salida) no debe cerrar el socket de epoll */
+        if (c == NULL || fd_salida < 0 || sesion_iniciar(&c->ctx) != 0 ||
+            (c->salida = fdopen(fd_salida, "w")) == NULL) {
+            fprintf(stderr, "No se pudo crear la sesión del cliente\n");
+            if (fd_salida >= 0) close(fd_salida);
+            free(c);
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->epfd = epfd;
+        c->ctx.salida = c->salida;
+        c->ctx.errores = c->salida;   /* El cliente tiene un solo canal: los errores van en orden */
+
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLONESHOT, .data.ptr = c };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            perror("epoll_ctl");
+            sesion_cerrar(&c->ctx);
+            fclose(c->salida);
+            close(fd);
+            free(c);
+            continue;
+        }
+
+        fprintf(c->salida, "Iniciando EAFITos v1.0 (sesión remota)...\n"
+                           "Escribe 'ayuda' para comenzar.\n\n");
+        enviar_prompt(c);
+    }
+}
+
+/**
+ * @brief Bucle de eventos de un proceso trabajador. No retorna.
+ */
+static void bucle_trabajador(int fd_escucha) {
+    /* Los comandos interactivos (p. ej. confirmaciones) no tienen teclado:
+     * leen EOF y cancelan la operación. */
+    int nulo = open("/dev/null", O_RDONLY);
+    if (nulo >= 0) {
+        dup2(nulo, STDIN_FILENO);
+        close(nulo);
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        perror("epoll_create1");
+        _exit(EXIT_FAILURE);
+    }
+
+    /* El puntero NULL identifica al socket de escucha en los eventos */
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = NULL };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd_escucha, &ev) != 0) {
+        perror("epoll_ctl");
+        _exit(EXIT_FAILURE);
+    }
+    /* Los hilos se crean aquí, después del fork(): cada trabajador tiene los suyos */
+    if (iniciar_grupo(&grupo, epfd) != 0) {
+        _exit(EXIT_FAILURE);
+    }
+
+    struct epoll_event eventos[MAX_EVENTOS];
+    for (;;) {
+        int n = epoll_wait(epfd, eventos, MAX_EVENTOS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            _exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < n; i++) {
+            Cliente *c = eventos[i].data.ptr;
+            if (c == NULL) {
+                aceptar_clientes(fd_escucha, epfd);
+            } else if ((void *)c == &grupo) {
+                atender_espera(&grupo);
+            } else {
+                atender_cliente(c);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Crea el socket Unix de escucha (no bloqueante).
+ * @return El descriptor, o -1 si hubo un error.
+ */
+static int crear_socket_escucha(const char *ruta) {
+    struct sockaddr_un dir;
+    if (strlen(ruta) >= sizeof(dir.sun_path)) {
+        fprintf(stderr, MSG_ERROR("Ruta de socket demasiado larga: %s") "\n", ruta);
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    strcpy(dir.sun_path, ruta);
+
+    unlink(ruta); /* Un socket viejo de una ejecución anterior impide bind() */
+    if (bind(fd, (struct sockaddr *)&dir, sizeof(dir)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int servidor_ejecutar(const char *ruta_socket, int n_trabajadores) {
+    if (n_trabajadores <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_trabajadores = (cpus > 0) ? (int)cpus : 1;
+    }
+
+    /* Un cliente que se desconecta a mitad de una respuesta no debe matar
+     * al trabajador: write() devolverá EPIPE en su lugar. */
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd_escucha = crear_socket_escucha(ruta_socket);
+    if (fd_escucha < 0) {
+        return 1;
+    }
+
+    fflush(stdout); /* Evita que los hijos hereden y repitan salida pendiente */
+    pid_t *pids = calloc((size_t)n_trabajadores, sizeof(pid_t));
+    if (pids == NULL) {
+        close(fd_escucha);
+        return 1;
+    }
+    for (int i = 0; i < n_trabajadores; i++) {
+        pids[i] = fork();
+        if (pids[i] == 0) {
+            free(pids);
+            bucle_trabajador(fd_escucha);
+        } else if (pids[i] < 0) {
+            perror("fork");
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = manejador_detener;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf(MSG_INFO("Servidor escuchando en %s con %d trabajador(es).") "\n",
+           ruta_socket, n_trabajadores);
+    fflush(stdout);
+
+    /* El padre solo espera: si un trabajador muere, el resto sigue atendiendo */
+    int vivos = n_trabajadores;
+    while (vivos > 0 && !detener) {
+        if (wait(NULL) > 0) {
+            vivos--;
+        } else if (errno == ECHILD) {
+            break;
+        }
+    }
+
+    for (int i = 0; i < n_trabajadores; i++) {
+        if (pids[i] > 0) kill(pids[i], SIGTERM);
+    }
+    while (wait(NULL) > 0) { /* Recoge a todos los hijos */ }
+
+    free(pids);
+    close(fd_escucha);
+    unlink(ruta_socket);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file sesion.c
+ * @brief Contexto por sesión de la shell.
+ *
+ * Agrupa el estado que cada sesión necesita por separado (prompt,
+ * directorio de trabajo, ...). En modo interactivo hay una sola sesión;
+ * en modo servidor hay una por cliente conectado.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>   /* va_list para imprimir() e imprimir_error() */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>   /* PATH_MAX */
+#include <fcntl.h>    /* open, O_DIRECTORY, AT_FDCWD */
+#include <unistd.h>   /* close, getcwd, readlink */
+#include "shell.h"
+#include "expresion.h" /* expresion_cache_liberar */
+#include "formato.h"   /* formato_global */
+#include "configuracion.h" /* alias_liberar, variables_liberar */
+
+/**
+ * @brief Sesión del modo interactivo (la única si no hay servidor).
+ *
+ * salida/entrada/errores en NULL significan stdout/stdin/stderr, que no son constantes
+ * y por eso no pueden usarse en un inicializador estático.
+ */
+static ContextoSesion sesion_principal = {
+    PROMPT_POR_DEFECTO, 1, AT_FDCWD, NULL, NULL, NULL, NULL, 0, NULL, NULL, NULL, 0, NULL, 0, NULL, 0
+};
+
+_Thread_local ContextoSesion *sesion_actual = &sesion_principal;
+
+FILE *salida_sesion(void) {
+    return (sesion_actual->salida != NULL) ? sesion_actual->salida : stdout;
+}
+
+FILE *entrada_sesion(void) {
+    return (sesion_actual->entrada != NULL) ? sesion_actual->entrada : stdin;
+}
+
+FILE *errores_sesion(void) {
+    return (sesion_actual->errores != NULL) ? sesion_actual->errores : stderr;
+}
+
+int imprimir(const char *formato, ...) {
+    va_list ap;
+    va_start(ap, formato);
+    int n = vfprintf(salida_sesion(), formato, ap);
+    va_end(ap);
+    return n;
+}
+
+int imprimir_error(const char *formato, ...) {
+    va_list ap;
+    va_start(ap, formato);
+    int n = vfprintf(errores_sesion(), formato, ap);
+    va_end(ap);
+    return n;
+}
+
+int sesion_iniciar(ContextoSesion *sesion) {
+    memset(sesion, 0, sizeof(*sesion));
+    snprintf(sesion->prompt, MAX_PROMPT_LEN, "%s", PROMPT_POR_DEFECTO);
+    sesion->activa = 1;
+    sesion->formato = formato_global();
+
+    /* AT_FDCWD = "el directorio actual del proceso". No abrimos un fd por
+     * sesión hasta que haga falta: con miles de sesiones agotaríamos el
+     * límite de descriptores abiertos. */
+    sesion->dir_fd = AT_FDCWD;
+    return 0;
+}
+
+void sesion_cerrar(ContextoSesion *sesion) {
+    if (sesion->dir_fd >= 0) {
+        close(sesion->dir_fd);
+        sesion->dir_fd = -1;
+    }
+    expresion_cache_liberar(sesion->expresiones);
+    sesion->expresiones = NULL;
+    free(sesion->directorio);
+    free(sesion->directorio_anterior);
+    sesion->directorio = sesion->directorio_anterior = NULL;
+    for (size_t i = 0; i < sesion->n_pila; i++) {
+        free(sesion->pila_dirs[i]);
+    }
+    free(sesion->pila_dirs);
+    sesion->pila_dirs = NULL;
+    sesion->n_pila = 0;
+    alias_liberar(sesion);
+    variables_liberar(sesion);
+    sesion->activa = 0;
+}
+
+/**
+ * @brief Ruta canónica de un descriptor de directorio.
+ *
+ * El enlace /proc/self/fd/N ya es la ruta sin "..", sin "." y con los
+ * enlaces simbólicos resueltos; si /proc no está montado se une la ruta
+ * pedida a la anterior tal cual.
+ *
+ * @return Ruta nueva (malloc), o NULL si no se puede saber.
+ */
+static char *ruta_canonica(int fd, const char *anterior, const char *ruta) {
+    char enlace[64], destino[PATH_MAX];
+    snprintf(enlace, sizeof(enlace), "/proc/self/fd/%d", fd);
+    ssize_t n = readlink(enlace, destino, sizeof(destino) - 1);
+    if (n > 0 && destino[0] == '/') {
+        destino[n] = '\0';
+        return strdup(destino);
+    }
+    if (ruta[0] == '/') {
+        return strdup(ruta);
+    }
+    if (anterior == NULL) {
+        return NULL;
+    }
+    snprintf(destino, sizeof(destino), "%s/%s", strcmp(anterior, "/") == 0 ? "" : anterior, ruta);
+    return strdup(destino);
+}
+
+int sesion_cambiar_directorio(ContextoSesion *sesion, const char *ruta) {
+    int fd = openat(sesion->dir_fd, ruta, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    char *nueva = ruta_canonica(fd, sesion_directorio(sesion), ruta);
+    free(sesion->directorio_anterior);
+    sesion->directorio_anterior = sesion->directorio;
+    sesion->directorio = nueva;
+    if (sesion->dir_fd >= 0) {
+        close(sesion->dir_fd);
+    }
+    sesion->dir_fd = fd;
+    return 0;
+}
+
+const char *sesion_directorio(ContextoSesion *sesion) {
+    if (sesion->directorio == NULL) {
+        if (sesion->dir_fd >= 0) {
+            sesion->directorio = ruta_canonica(sesion->dir_fd, NULL, ".");
+        } else {
+            char buf[PATH_MAX];
+            if (getcwd(buf, sizeof(buf)) != NULL) {
+                sesion->directorio = strdup(buf);
+            }
+        }
+    }
+    return sesion->directorio;
+}
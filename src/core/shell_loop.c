@@ -13,19 +13,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>    /* openat, O_* */
 #include <signal.h>   /* sigaction, SIGINT, SIGTSTP */
-#include <unistd.h>   /* write, STDOUT_FILENO */
+#include <unistd.h>   /* write, dup2, STDOUT_FILENO */
 #include "shell.h"
 #include "commands.h"
 #include "colors.h"
-
-/* =============================================================================
- * Variable Global: Prompt personalizable
- * =============================================================================
- * Definida aquí (extern declarada en shell.h) para que cmd_prompt() en
- * basic_commands.c pueda modificarla directamente.
- */
-char prompt_personalizado[MAX_PROMPT_LEN] = "EAFITos";
+#include "plugins.h"
+#include "formato.h"
+#include "cancelacion.h"
+#include "configuracion.h"  /* alias_expandir */
+#include "grabacion.h"      /* --grabar */
+#include "utils.h"    /* MEM_FREE */
 
 /*
  * --- Registro de Comandos ---
@@ -48,7 +48,26 @@ char *nombres_comandos[] = {
     "limpiar",
     "eliminar",
     "buscar",
-    "prompt"   /* Feature 1: Comando para cambiar el prompt */
+    "prompt",  /* Feature 1: Comando para cambiar el prompt */
+    "contar",
+    "checksum",
+    "uso",
+    "vigilar",
+    "indexar",
+    "ordenar",
+    "paralelo",
+    "medir",
+    "limite",
+    "memoria",
+    "cd",
+    "pwd",
+    "pushd",
+    "popd",
+    "dirs",
+    "alias",
+    "export",
+    "comparar",
+    "reemplazar"
 };
 
 /*
@@ -67,7 +86,26 @@ void (*func_comandos[]) (char **) = {
     &cmd_limpiar,
     &cmd_eliminar_archivo,
     &cmd_buscar,
-    &cmd_prompt   /* Feature 1: Puntero al nuevo comando prompt */
+    &cmd_prompt,  /* Feature 1: Puntero al nuevo comando prompt */
+    &cmd_contar,
+    &cmd_checksum,
+    &cmd_uso,
+    &cmd_vigilar,
+    &cmd_indexar,
+    &cmd_ordenar,
+    &cmd_paralelo,
+    &cmd_medir,
+    &cmd_limite,
+    &cmd_memoria,
+    &cmd_cd,
+    &cmd_pwd,
+    &cmd_pushd,
+    &cmd_popd,
+    &cmd_dirs,
+    &cmd_alias,
+    &cmd_export,
+    &cmd_comparar,
+    &cmd_reemplazar
 };
 
 /**
@@ -88,17 +126,27 @@ int num_comandos() {
  * ya que printf() no está garantizado como seguro en este contexto.
  */
 
+/** @brief 1 mientras loop_shell() ejecuta un comando (lo lee el manejador). */
+static int comando_en_curso = 0;
+
 /**
  * @brief Manejador de SIGINT (Ctrl+C).
  *
- * En lugar de terminar el proceso, imprime un mensaje orientador y
- * muestra el prompt de nuevo para continuar la sesión.
+ * Si hay un comando en curso, pide su cancelación (ver cancelacion.h) y el
+ * comando termina en cuanto su bucle lo nota. En el prompt, en lugar de
+ * terminar el proceso, imprime un mensaje orientador y muestra el prompt
+ * de nuevo para continuar la sesión.
  *
  * @param sig Número de la señal recibida (siempre SIGINT aquí).
  */
 static void manejador_sigint(int sig) {
     (void)sig; /* Silencia advertencia de parámetro no usado */
 
+    if (__atomic_load_n(&comando_en_curso, __ATOMIC_ACQUIRE)) {
+        cancelacion_solicitar();
+        return;
+    }
+
     /* Usamos write() porque es async-signal-safe */
     const char *msg = "\n" COLOR_YELLOW "[Ctrl+C]" COLOR_RESET
                       " Usa 'salir' para terminar la shell.\n";
@@ -106,7 +154,7 @@ static void manejador_sigint(int sig) {
 
     /* Reescribimos el prompt manualmente para que el usuario sepa que sigue activo */
     write(STDOUT_FILENO, COLOR_CYAN, strlen(COLOR_CYAN));
-    write(STDOUT_FILENO, prompt_personalizado, strlen(prompt_personalizado));
+    write(STDOUT_FILENO, sesion_actual->prompt, strlen(sesion_actual->prompt));
     write(STDOUT_FILENO, COLOR_RESET "> ", strlen(COLOR_RESET "> "));
 }
 
@@ -126,7 +174,7 @@ static void manejador_sigtstp(int sig) {
     write(STDOUT_FILENO, msg, strlen(msg));
 
     write(STDOUT_FILENO, COLOR_CYAN, strlen(COLOR_CYAN));
-    write(STDOUT_FILENO, prompt_personalizado, strlen(prompt_personalizado));
+    write(STDOUT_FILENO, sesion_actual->prompt, strlen(sesion_actual->prompt));
     write(STDOUT_FILENO, COLOR_RESET "> ", strlen(COLOR_RESET "> "));
 }
 
@@ -141,6 +189,9 @@ static void manejador_sigtstp(int sig) {
 static void registrar_manejadores_senales(void) {
     struct sigaction sa_int, sa_tstp;
 
+    /* El self-pipe debe existir antes de que llegue la primera señal */
+    cancelacion_fd();
+
     /* --- Configurar SIGINT (Ctrl+C) --- */
     sa_int.sa_handler = manejador_sigint;
     sigemptyset(&sa_int.sa_mask);   /* No bloquear señales adicionales */
@@ -155,16 +206,11 @@ static void registrar_manejadores_senales(void) {
 }
 
 /**
- * @brief Busca y ejecuta el comando solicitado por el usuario.
+ * @brief Busca y ejecuta un comando ya sin redirecciones.
  *
  * @param args Lista de argumentos parseados. args[0] es el nombre del comando.
  */
-void ejecutar(char **args) {
-    if (args[0] == NULL) {
-        /* El usuario presionó Enter sin escribir nada. */
-        return;
-    }
-
+static void despachar(char **args) {
     /* Recorremos el registro de comandos buscando una coincidencia. */
     for (int i = 0; i < num_comandos(); i++) {
         /* strcmp: Retorna 0 si dos cadenas son idénticas. */
@@ -175,11 +221,186 @@ void ejecutar(char **args) {
         }
     }
 
-    /* Si salimos del ciclo, el comando no existe. */
-    printf(COLOR_RED "Comando desconocido: " COLOR_BOLD "%s\n" COLOR_RESET,
-           args[0]);
-    printf("Escribe " COLOR_CYAN "'ayuda'" COLOR_RESET
-           " para ver los comandos disponibles.\n");
+    /* No es un comando integrado: probamos con los plugins del índice. */
+    if (plugins_ejecutar(args)) {
+        return;
+    }
+
+    /* Si llegamos aquí, el comando no existe. */
+    imprimir_error(COLOR_RED "Comando desconocido: " COLOR_BOLD "%s\n" COLOR_RESET,
+                 args[0]);
+    imprimir_error("Escribe " COLOR_CYAN "'ayuda'" COLOR_RESET
+                 " para ver los comandos disponibles.\n");
+}
+
+/**
+ * @brief Ejecuta un comando con la salida en el formato de la sesión.
+ *
+ * En modo JSON/TSV, el texto que el comando imprime se convierte en
+ * registros (ver formato.h); los comandos con salida estructurada propia
+ * escriben sus registros directamente.
+ */
+static void ejecutar_comando(char **args) {
+    FILE *mensajes = formato_estructurado() ? formato_comenzar_comando() : NULL;
+    despachar(args);
+    formato_terminar_comando(mensajes);
+}
+
+/**
+ * @brief Abre el archivo de una redirección, relativo al directorio de la sesión.
+ * @return El descriptor, o -1 (con un mensaje) si no se pudo abrir.
+ */
+static int abrir_redireccion(const char *ruta, int flags) {
+    int fd = openat(sesion_actual->dir_fd, ruta, flags | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo abrir '%s' para redirigir: %s\n",
+                       ruta, strerror(errno));
+    }
+    return fd;
+}
+
+/** @brief Stream abierto por el `<` del comando en curso en este hilo. */
+static _Thread_local FILE *entrada_de_redireccion = NULL;
+
+FILE *entrada_redirigida(void) {
+    /* Solo mientras la sesión siga leyendo de él (no en una sesión anidada) */
+    if (sesion_actual == NULL || sesion_actual->entrada != entrada_de_redireccion) {
+        return NULL;
+    }
+    return entrada_de_redireccion;
+}
+
+/**
+ * @brief Ejecuta un comando con sus redirecciones, sin crear procesos.
+ *
+ * `<`, `>`/`>>` y `2>` sustituyen los streams de la sesión (entrada,
+ * salida y errores), así que solo afectan a este comando aunque otros
+ * hilos estén ejecutando comandos de otras sesiones. La salida a archivo
+ * usa un buffer grande y se vacía una sola vez al terminar. Con `&>` los
+ * errores usan el mismo stream que la salida y quedan en orden.
+ */
+static void ejecutar_redirigido(char **args, const Redirecciones *r) {
+    int fd_entrada = -1, fd_salida = -1, fd_errores = -1;
+    if (r->entrada != NULL &&
+        (fd_entrada = abrir_redireccion(r->entrada, O_RDONLY)) < 0) {
+        return;
+    }
+    if (r->salida != NULL &&
+        (fd_salida = abrir_redireccion(r->salida, O_WRONLY | O_CREAT |
+                                       (r->anexar_salida ? O_APPEND : O_TRUNC))) < 0) {
+        if (fd_entrada >= 0) close(fd_entrada);
+        return;
+    }
+    if (r->errores != NULL && r->errores != r->salida &&
+               (fd_errores = abrir_redireccion(r->errores, O_WRONLY | O_CREAT |
+                                               (r->anexar_errores ? O_APPEND : O_TRUNC))) < 0) {
+        if (fd_entrada >= 0) close(fd_entrada);
+        if (fd_salida >= 0) close(fd_salida);
+        return;
+    }
+
+    FILE *entrada_anterior = sesion_actual->entrada;
+    FILE *salida_anterior = sesion_actual->salida;
+    FILE *errores_anterior = sesion_actual->errores;
+    FILE *redireccion_anterior = entrada_de_redireccion;
+    FILE *entrada = NULL, *salida = NULL, *errores = NULL;
+    if (fd_entrada >= 0 && (entrada = fdopen(fd_entrada, "r")) != NULL) {
+        sesion_actual->entrada = entrada;
+        entrada_de_redireccion = entrada;
+    }
+    if (fd_salida >= 0 && (salida = fdopen(fd_salida, "w")) != NULL) {
+        setvbuf(salida, NULL, _IOFBF, 1 << 16);
+        fflush(salida_sesion());   /* Lo pendiente va antes, al destino anterior */
+        sesion_actual->salida = salida;
+    }
+    if (r->errores != NULL && r->errores == r->salida) {
+        sesion_actual->errores = salida_sesion();   /* &> */
+    } else if (fd_errores >= 0 && (errores = fdopen(fd_errores, "w")) != NULL) {
+        sesion_actual->errores = errores;
+    }
+
+    ejecutar_comando(args);
+
+    sesion_actual->errores = errores_anterior;
+    if (errores != NULL) {
+        fclose(errores);
+    } else if (fd_errores >= 0) {
+        close(fd_errores);
+    }
+    if (salida != NULL) {
+        sesion_actual->salida = salida_anterior;
+        fclose(salida);
+    } else if (fd_salida >= 0) {
+        close(fd_salida);
+    }
+    if (entrada != NULL) {
+        sesion_actual->entrada = entrada_anterior;
+        entrada_de_redireccion = redireccion_anterior;
+        fclose(entrada);
+    } else if (fd_entrada >= 0) {
+        close(fd_entrada);
+    }
+}
+
+/**
+ * @brief Ejecuta un comando ya expandido (sin alias).
+ *
+ * Antes separa la opción `--formato` y las redirecciones (`<`, `>`, `>>`,
+ * `2>`, `2>>`, `&>`).
+ */
+static void ejecutar_expandido(char **args) {
+    int formato = formato_separar_opcion(args);
+    Redirecciones r;
+    if (formato == -2 || separar_redirecciones(args, &r) != 0) {
+        return;
+    }
+    if (args[0] == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Falta el comando antes de la redirección.\n");
+        return;
+    }
+
+    /* `--formato X` solo vale para este comando */
+    int formato_sesion = sesion_actual->formato;
+    if (formato >= 0) {
+        sesion_actual->formato = formato;
+    }
+    if (r.entrada != NULL || r.salida != NULL || r.errores != NULL) {
+        ejecutar_redirigido(args, &r);
+    } else {
+        ejecutar_comando(args);
+    }
+    sesion_actual->formato = formato_sesion;
+}
+
+/**
+ * @brief Busca y ejecuta el comando solicitado por el usuario.
+ *
+ * Si args[0] es un alias, se ejecuta su expansión (un solo nivel: un alias
+ * como `listar=listar -l` no se vuelve a expandir).
+ *
+ * @param args Lista de argumentos parseados. args[0] es el nombre del comando.
+ */
+void ejecutar(char **args) {
+    if (args[0] == NULL) {
+        /* El usuario presionó Enter sin escribir nada. */
+        return;
+    }
+    char **expandido = alias_expandir(args);
+    if (expandido != NULL) {
+        ejecutar_expandido(expandido);
+        free(expandido);
+        return;
+    }
+    ejecutar_expandido(args);
+}
+
+int comando_registrado(const char *nombre) {
+    for (int i = 0; i < num_comandos(); i++) {
+        if (strcmp(nombre, nombres_comandos[i]) == 0) {
+            return 1;
+        }
+    }
+    return plugins_existe(nombre) || alias_existe(nombre);
 }
 
 /**
@@ -189,33 +410,53 @@ void ejecutar(char **args) {
  *  1. Read:    Muestra el prompt colorizado y lee la entrada.
  *  2. Parse:   Divide la entrada en argumentos.
  *  3. Execute: Busca y ejecuta el comando.
- *  4. Loop:    Libera memoria y repite.
+ *  4. Loop:    Repite con los mismos buffers; se liberan al terminar.
  */
 void loop_shell() {
-    char *linea;      /* Almacenará la línea cruda */
-    char **args;      /* Almacenará los tokens */
-    int status = 1;   /* Variable de control del bucle */
+    /* Buffers reutilizados entre líneas: en régimen estable, leer y parsear
+     * una línea no reserva memoria (se comprueba con RASTREO_MEMORIA=1) */
+    char *linea = NULL;      /* Almacenará la línea cruda */
+    size_t cap_linea = 0;
+    char **tokens = NULL;    /* Almacenará los tokens */
+    size_t cap_tokens = 0;
+    char **args;
 
     /* Feature 3: Registrar manejadores de señales ANTES del loop */
     registrar_manejadores_senales();
 
     do {
-        /* Feature 1: Prompt colorizado usando la variable global */
-        printf(COLOR_CYAN COLOR_BOLD "%s" COLOR_RESET "> ", prompt_personalizado);
-        fflush(stdout); /* Asegurar que el prompt aparezca antes de leer */
-
-        /* 1. Lectura */
-        linea = leer_linea();
+        /* Feature 1: Prompt colorizado tomado de la sesión (con salida
+         * estructurada, solo si hay alguien escribiendo en una terminal) */
+        if (formato_global() == FORMATO_TEXTO || isatty(STDIN_FILENO)) {
+            printf(COLOR_CYAN COLOR_BOLD "%s" COLOR_RESET "> ", sesion_actual->prompt);
+            fflush(stdout); /* Asegurar que el prompt aparezca antes de leer */
+        }
 
-        /* 2. Parseo */
-        args = parsear_linea(linea);
+        /* 1. Lectura (NULL = EOF con Ctrl+D: terminamos la sesión) */
+        if (leer_linea_en(&linea, &cap_linea) == NULL) {
+            if (formato_global() == FORMATO_TEXTO) printf("\n");
+            break;
+        }
 
-        /* 3. Ejecución */
-        ejecutar(args);
+        /* 2. Parseo (--grabar guarda la línea antes: el parser la modifica) */
+        grabacion_comenzar_linea(linea);
+        args = parsear_linea_en(linea, &tokens, &cap_tokens);
 
-        /* 4. Limpieza de memoria (Gestión manual requerida en C) */
-        free(linea); /* Libera el buffer de getline */
-        free(args);  /* Libera el arreglo de punteros */
+        /* 3. Ejecución (Ctrl+C durante el comando lo cancela) */
+        if (args != NULL) {
+            cancelacion_reiniciar();
+            __atomic_store_n(&comando_en_curso, 1, __ATOMIC_RELEASE);
+            ejecutar(args);
+            __atomic_store_n(&comando_en_curso, 0, __ATOMIC_RELEASE);
+            if (cancelacion_solicitada()) {
+                imprimir_error("\n" MSG_WARN("Comando interrumpido (Ctrl+C).") "\n");
+                cancelacion_reiniciar();
+            }
+        }
+        grabacion_terminar_linea();
+    } while (sesion_actual->activa); /* 'salir' marca la sesión como inactiva */
 
-    } while (status); /* El loop corre hasta que cmd_salir hace exit(0) */
+    /* 4. Limpieza de memoria (Gestión manual requerida en C) */
+    free(linea);       /* Libera el buffer de getline */
+    MEM_FREE(tokens);  /* Libera el arreglo de punteros */
 }
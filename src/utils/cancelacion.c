@@ -0,0 +1,183 @@
+/**
+ * @file cancelacion.c
+ * @brief Bandera de cancelación, self-pipe y límites por comando
+ *        (ver cancelacion.h).
+ */
+
+#define _GNU_SOURCE   /* pipe2 */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include "cancelacion.h"
+
+static int solicitada = 0;
+
+/** @brief Extremos del pipe; -1 hasta que se crean. */
+static int tuberia[2] = { -1, -1 };
+
+static pthread_once_t creada = PTHREAD_ONCE_INIT;
+
+/** @brief Límite más interior del hilo (NULL: sin límite). */
+static _Thread_local LimiteComando *limite_hilo = NULL;
+
+static void crear_tuberia(void) {
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == 0) {
+        __atomic_store_n(&tuberia[1], fds[1], __ATOMIC_RELEASE);
+        __atomic_store_n(&tuberia[0], fds[0], __ATOMIC_RELEASE);
+        if (__atomic_load_n(&solicitada, __ATOMIC_ACQUIRE)) {
+            (void)!write(fds[1], "", 1);   /* Pedida antes de que existiera el pipe */
+        }
+    }
+}
+
+void cancelacion_solicitar(void) {
+    int guardado = errno;   /* Se llama desde un manejador de señales */
+    __atomic_store_n(&solicitada, 1, __ATOMIC_RELEASE);
+    int fd = __atomic_load_n(&tuberia[1], __ATOMIC_ACQUIRE);
+    if (fd >= 0) {
+        (void)!write(fd, "", 1);   /* Si el pipe está lleno ya hay un aviso pendiente */
+    }
+    errno = guardado;
+}
+
+int cancelacion_solicitada(void) {
+    if (__atomic_load_n(&solicitada, __ATOMIC_RELAXED)) {
+        return 1;
+    }
+    return limite_hilo != NULL && limite_motivo(limite_hilo) != LIMITE_NINGUNO;
+}
+
+int cancelacion_fd(void) {
+    pthread_once(&creada, crear_tuberia);
+    return tuberia[0];
+}
+
+void cancelacion_reiniciar(void) {
+    __atomic_store_n(&solicitada, 0, __ATOMIC_RELEASE);
+    int fd = cancelacion_fd();
+    char basura[64];
+    while (fd >= 0 && read(fd, basura, sizeof(basura)) > 0) {
+    }
+}
+
+/* =============================================================================
+ * Límites por comando
+ * ========================================================================== */
+
+static int64_t ahora_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+void limite_comenzar(LimiteComando *l, uint64_t ms, size_t bytes) {
+    LimiteComando *exterior = limite_hilo;
+    l->plazo_ns = (ms > 0) ? ahora_ns() + (int64_t)ms * 1000000 : 0;
+    if (exterior != NULL && exterior->plazo_ns != 0 &&
+        (l->plazo_ns == 0 || exterior->plazo_ns < l->plazo_ns)) {
+        l->plazo_ns = exterior->plazo_ns;   /* Manda el plazo más cercano */
+    }
+    l->memoria_max = bytes;
+    l->memoria_usada = 0;
+    l->motivo = LIMITE_NINGUNO;
+    l->fd_plazo = -1;
+    l->anterior = exterior;
+
+    if (l->plazo_ns != 0) {
+        l->fd_plazo = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        struct itimerspec vence = { { 0, 0 }, { l->plazo_ns / 1000000000, l->plazo_ns % 1000000000 } };
+        if (l->fd_plazo >= 0 && timerfd_settime(l->fd_plazo, TFD_TIMER_ABSTIME, &vence, NULL) != 0) {
+            close(l->fd_plazo);
+            l->fd_plazo = -1;
+        }
+    }
+    limite_hilo = l;
+}
+
+void limite_terminar(LimiteComando *l) {
+    if (l->fd_plazo >= 0) {
+        close(l->fd_plazo);
+        l->fd_plazo = -1;
+    }
+    limite_hilo = l->anterior;
+}
+
+MotivoLimite limite_motivo(LimiteComando *l) {
+    int m = __atomic_load_n(&l->motivo, __ATOMIC_RELAXED);
+    if (m != LIMITE_NINGUNO) {
+        return (MotivoLimite)m;
+    }
+    if (l->plazo_ns != 0 && ahora_ns() >= l->plazo_ns) {
+        int esperado = LIMITE_NINGUNO;
+        __atomic_compare_exchange_n(&l->motivo, &esperado, LIMITE_TIEMPO, 0,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        return (MotivoLimite)__atomic_load_n(&l->motivo, __ATOMIC_RELAXED);
+    }
+    /* La memoria se descuenta también de los límites exteriores */
+    for (LimiteComando *e = l->anterior; e != NULL; e = e->anterior) {
+        if (__atomic_load_n(&e->motivo, __ATOMIC_RELAXED) == LIMITE_MEMORIA) {
+            return LIMITE_MEMORIA;
+        }
+    }
+    return LIMITE_NINGUNO;
+}
+
+LimiteComando *limite_actual(void) {
+    return limite_hilo;
+}
+
+void limite_heredar(LimiteComando *l) {
+    limite_hilo = l;
+}
+
+int limite_fd(void) {
+    return (limite_hilo != NULL) ? limite_hilo->fd_plazo : -1;
+}
+
+int limite_cargar(size_t bytes) {
+    for (LimiteComando *l = limite_hilo; l != NULL; l = l->anterior) {
+        if (l->memoria_max == 0) {
+            continue;
+        }
+        size_t usada = __atomic_add_fetch(&l->memoria_usada, bytes, __ATOMIC_RELAXED);
+        if (usada > l->memoria_max || usada < bytes) {
+            /* Deshacer lo cargado en este y en los interiores */
+            for (LimiteComando *d = limite_hilo; d != l->anterior; d = d->anterior) {
+                if (d->memoria_max != 0) {
+                    __atomic_sub_fetch(&d->memoria_usada, bytes, __ATOMIC_RELAXED);
+                }
+            }
+            int esperado = LIMITE_NINGUNO;
+            __atomic_compare_exchange_n(&l->motivo, &esperado, LIMITE_MEMORIA, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void limite_descargar(size_t bytes) {
+    for (LimiteComando *l = limite_hilo; l != NULL; l = l->anterior) {
+        if (l->memoria_max != 0) {
+            __atomic_sub_fetch(&l->memoria_usada, bytes, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+size_t limite_memoria_libre(void) {
+    size_t libre = SIZE_MAX;
+    for (LimiteComando *l = limite_hilo; l != NULL; l = l->anterior) {
+        if (l->memoria_max == 0) {
+            continue;
+        }
+        size_t usada = __atomic_load_n(&l->memoria_usada, __ATOMIC_RELAXED);
+        size_t resto = (usada < l->memoria_max) ? l->memoria_max - usada : 0;
+        if (resto < libre) libre = resto;
+    }
+    return libre;
+}
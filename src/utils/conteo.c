@@ -0,0 +1,141 @@
+/**
+ * @file conteo.c
+ * @brief Conteo SIMD de líneas, palabras y bytes.
+ *
+ * Para cada bloque de 64 bytes se construyen dos máscaras de 64 bits:
+ *   - nl: bit i encendido si el byte i es '\n'.
+ *   - ws: bit i encendido si el byte i es espacio en blanco.
+ * Las líneas son popcount(nl). Una palabra empieza donde hay un byte que no
+ * es espacio precedido de uno que sí lo es:
+ *   inicios = ~ws & ((ws << 1) | bit_del_bloque_anterior)
+ * y las palabras son popcount(inicios). Así no hay ninguna bifurcación por
+ * byte y el bucle queda limitado por el ancho de banda de memoria.
+ */
+
+#include <string.h>
+#include "conteo.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define HAY_X86_SIMD 1
+#endif
+
+/** @brief Calcula las máscaras nl/ws de 64 bytes. */
+typedef void (*FuncionMascaras)(const unsigned char *p, uint64_t *nl, uint64_t *ws);
+
+/**
+ * @brief Versión escalar (cualquier arquitectura).
+ */
+static void mascaras_escalar(const unsigned char *p, uint64_t *nl, uint64_t *ws) {
+    uint64_t m_nl = 0, m_ws = 0;
+    for (int i = 0; i < 64; i++) {
+        m_nl |= (uint64_t)(p[i] == '\n') << i;
+        m_ws |= (uint64_t)es_espacio(p[i]) << i;
+    }
+    *nl = m_nl;
+    *ws = m_ws;
+}
+
+#ifdef HAY_X86_SIMD
+
+/**
+ * @brief Versión SSE2 (presente en toda CPU x86-64): 4 vectores de 16 bytes.
+ */
+__attribute__((target("sse2")))
+static void mascaras_sse2(const unsigned char *p, uint64_t *nl, uint64_t *ws) {
+    const __m128i v_nl  = _mm_set1_epi8('\n');
+    const __m128i v_esp = _mm_set1_epi8(' ');
+    const __m128i v_9   = _mm_set1_epi8('\t');
+    const __m128i v_4   = _mm_set1_epi8(4);
+    uint64_t m_nl = 0, m_ws = 0;
+
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        /* '\t'..'\r' son 9..13: (v - 9) <= 4 sin signo, comprobado con min */
+        __m128i d = _mm_sub_epi8(v, v_9);
+        __m128i rango = _mm_cmpeq_epi8(_mm_min_epu8(d, v_4), d);
+        __m128i es_ws = _mm_or_si128(rango, _mm_cmpeq_epi8(v, v_esp));
+        m_nl |= (uint64_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, v_nl)) << (16 * i);
+        m_ws |= (uint64_t)(unsigned)_mm_movemask_epi8(es_ws) << (16 * i);
+    }
+    *nl = m_nl;
+    *ws = m_ws;
+}
+
+/**
+ * @brief Versión AVX2: 2 vectores de 32 bytes.
+ */
+__attribute__((target("avx2")))
+static void mascaras_avx2(const unsigned char *p, uint64_t *nl, uint64_t *ws) {
+    const __m256i v_nl  = _mm256_set1_epi8('\n');
+    const __m256i v_esp = _mm256_set1_epi8(' ');
+    const __m256i v_9   = _mm256_set1_epi8('\t');
+    const __m256i v_4   = _mm256_set1_epi8(4);
+    uint64_t m_nl = 0, m_ws = 0;
+
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + 32 * i));
+        __m256i d = _mm256_sub_epi8(v, v_9);
+        __m256i rango = _mm256_cmpeq_epi8(_mm256_min_epu8(d, v_4), d);
+        __m256i es_ws = _mm256_or_si256(rango, _mm256_cmpeq_epi8(v, v_esp));
+        m_nl |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v_nl)) << (32 * i);
+        m_ws |= (uint64_t)(uint32_t)_mm256_movemask_epi8(es_ws) << (32 * i);
+    }
+    *nl = m_nl;
+    *ws = m_ws;
+}
+
+#endif /* HAY_X86_SIMD */
+
+/**
+ * @brief Elige la mejor implementación para esta CPU (una sola vez).
+ */
+static FuncionMascaras elegir_mascaras(void) {
+#ifdef HAY_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return mascaras_avx2;
+    if (__builtin_cpu_supports("sse2")) return mascaras_sse2;
+#endif
+    return mascaras_escalar;
+}
+
+int contar_bloque(const unsigned char *datos, size_t n, int previo_espacio, Conteo *c) {
+    /* Acceso atómico: si dos hilos llegan a la vez, ambos eligen la misma
+     * función y el resultado es idéntico. */
+    static FuncionMascaras elegida = NULL;
+    FuncionMascaras mascaras = __atomic_load_n(&elegida, __ATOMIC_RELAXED);
+    if (mascaras == NULL) {
+        mascaras = elegir_mascaras();
+        __atomic_store_n(&elegida, mascaras, __ATOMIC_RELAXED);
+    }
+
+    uint64_t lineas = 0, palabras = 0;
+    uint64_t previo = previo_espacio ? 1 : 0;
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        uint64_t nl, ws;
+        mascaras(datos + i, &nl, &ws);
+        lineas += (uint64_t)__builtin_popcountll(nl);
+        palabras += (uint64_t)__builtin_popcountll(~ws & ((ws << 1) | previo));
+        previo = ws >> 63;
+    }
+
+    /* Cola de menos de 64 bytes: la copiamos a un bloque relleno con
+     * espacios, que no añaden líneas ni inician palabras. */
+    if (i < n) {
+        unsigned char cola[64];
+        memset(cola, ' ', sizeof(cola));
+        memcpy(cola, datos + i, n - i);
+        uint64_t nl, ws;
+        mascaras(cola, &nl, &ws);
+        lineas += (uint64_t)__builtin_popcountll(nl);
+        palabras += (uint64_t)__builtin_popcountll(~ws & ((ws << 1) | previo));
+        previo = es_espacio(datos[n - 1]);
+    }
+
+    c->lineas += lineas;
+    c->palabras += palabras;
+    c->bytes += n;
+    return (int)previo;
+}
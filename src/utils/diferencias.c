@@ -0,0 +1,703 @@
+/**
+ * @file diferencias.c
+ * @brief Diferencias en formato unificado con el algoritmo de Myers (ver diferencias.h).
+ */
+
+#define _GNU_SOURCE   /* memrchr */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "diferencias.h"
+#include "hash.h"          /* xxh64 */
+#include "cancelacion.h"   /* cancelacion_solicitada, limite_cargar */
+#include "colors.h"
+
+/** @brief Bytes que se comparan de una vez al buscar el prefijo y el sufijo. */
+#define BLOQUE_COMPARACION 65536
+
+/** @brief Líneas de cada texto que se comparan a la vez. */
+#define VENTANA_LINEAS 16384
+
+/** @brief Hasta dónde crece la ventana cuando no tiene ninguna línea única en común. */
+#define VENTANA_MAXIMA (1 << 20)
+
+/* ------------------------------------------------------------------ */
+/* Prefijo y sufijo comunes                                            */
+/* ------------------------------------------------------------------ */
+
+static size_t prefijo_comun(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t p = 0;
+    while (p < n) {
+        size_t bloque = (n - p < BLOQUE_COMPARACION) ? n - p : BLOQUE_COMPARACION;
+        if (memcmp(a + p, b + p, bloque) != 0) {
+            while (a[p] == b[p]) p++;
+            return p;
+        }
+        p += bloque;
+    }
+    return p;
+}
+
+/** @brief Bytes finales iguales, sin pasar de 'max'. */
+static size_t sufijo_comun(const unsigned char *a, size_t na, const unsigned char *b, size_t nb,
+                           size_t max) {
+    size_t s = 0;
+    while (s < max) {
+        size_t bloque = (max - s < BLOQUE_COMPARACION) ? max - s : BLOQUE_COMPARACION;
+        if (memcmp(a + na - s - bloque, b + nb - s - bloque, bloque) != 0) {
+            while (a[na - 1 - s] == b[nb - 1 - s]) s++;
+            return s;
+        }
+        s += bloque;
+    }
+    return s;
+}
+
+/** @brief Inicio de la línea que contiene la posición 'p' (o que empieza en ella). */
+static size_t inicio_linea(const unsigned char *t, size_t p) {
+    const unsigned char *nl = (p > 0) ? memrchr(t, '\n', p) : NULL;
+    return nl ? (size_t)(nl - t) + 1 : 0;
+}
+
+/** @brief Retrocede 'n' líneas completas desde el inicio de línea 'p'. */
+static size_t retroceder_lineas(const unsigned char *t, size_t p, int n) {
+    for (int i = 0; i < n && p > 0; i++) {
+        const unsigned char *nl = (p > 1) ? memrchr(t, '\n', p - 1) : NULL;
+        p = nl ? (size_t)(nl - t) + 1 : 0;
+    }
+    return p;
+}
+
+/** @brief Avanza 'n' líneas desde 'p' (sin pasar de 'fin'). */
+static size_t avanzar_lineas(const unsigned char *t, size_t p, size_t fin, int n) {
+    for (int i = 0; i < n && p < fin; i++) {
+        const unsigned char *nl = memchr(t + p, '\n', fin - p);
+        p = nl ? (size_t)(nl - t) + 1 : fin;
+    }
+    return p;
+}
+
+static size_t contar_lineas(const unsigned char *t, size_t n) {
+    size_t lineas = 0;
+    for (const unsigned char *p = t, *fin = t + n; p < fin; lineas++) {
+        const unsigned char *nl = memchr(p, '\n', (size_t)(fin - p));
+        p = nl ? nl + 1 : fin;
+    }
+    return lineas;
+}
+
+/* ------------------------------------------------------------------ */
+/* Espacio de trabajo de una ventana                                   */
+/* ------------------------------------------------------------------ */
+
+/** @brief Casilla de la tabla hash: hash de la línea y número de su clase + 1 (0 = libre). */
+typedef struct {
+    uint64_t hash;
+    uint32_t id;
+} Casilla;
+
+/**
+ * @brief Memoria de trabajo, reutilizada de una ventana a la siguiente.
+ *
+ * Solo crece (y se descuenta del tope de `limite` al crecer): lo que ocupa
+ * depende del tamaño de la ventana, no del de los archivos.
+ */
+typedef struct {
+    uint32_t *ids;            /**< Clase de cada línea (las de 'a' seguidas de las de 'b') */
+    unsigned char *marcas;    /**< 1 si la línea es un cambio */
+    uint32_t *reducidos;      /**< Clases de las líneas presentes en los dos lados */
+    uint32_t *posiciones;     /**< Línea de la ventana de cada reducido */
+    unsigned char *marcas_r;  /**< Marcas de Myers sobre los reducidos */
+    int32_t *v1, *v2;         /**< Frentes de Myers */
+    size_t cap_lineas;
+    Casilla *tabla;
+    size_t cap_tabla;
+    const unsigned char **texto_clase;   /**< Primera aparición de cada clase */
+    size_t *largo_clase;
+    unsigned char *veces_a;   /**< Apariciones de cada clase en 'a' (hasta 2) */
+    unsigned char *veces_b;   /**< Ídem en 'b' */
+    size_t cap_clases;
+    size_t cargado;           /**< Bytes descontados con limite_cargar() */
+} Espacio;
+
+/**
+ * @brief Lleva '*p' de 'viejos' a 'nuevos' elementos, descontándolo del tope.
+ * @return 0, o -1 con errno (ECANCELED por `limite`, ENOMEM).
+ */
+static int crecer(Espacio *e, void *p, size_t viejos, size_t nuevos, size_t tam) {
+    void **arreglo = p;
+    size_t extra = (nuevos - viejos) * tam;
+    if (limite_cargar(extra) != 0) {
+        errno = ECANCELED;
+        return -1;
+    }
+    void *nuevo = realloc(*arreglo, nuevos * tam);
+    if (nuevo == NULL) {
+        limite_descargar(extra);
+        errno = ENOMEM;
+        return -1;
+    }
+    *arreglo = nuevo;
+    e->cargado += extra;
+    return 0;
+}
+
+/** @brief Asegura espacio para 'n' líneas en la ventana. */
+static int reservar_lineas(Espacio *e, size_t n) {
+    if (n <= e->cap_lineas) {
+        return 0;
+    }
+    size_t v = n + 2;   /* Diagonales de Myers: 2 * max_d + 2 con max_d = (n + 1) / 2 */
+    if (crecer(e, &e->ids, e->cap_lineas, n, sizeof(uint32_t)) != 0 ||
+        crecer(e, &e->marcas, e->cap_lineas, n, 1) != 0 ||
+        crecer(e, &e->reducidos, e->cap_lineas, n, sizeof(uint32_t)) != 0 ||
+        crecer(e, &e->posiciones, e->cap_lineas, n, sizeof(uint32_t)) != 0 ||
+        crecer(e, &e->marcas_r, e->cap_lineas, n, 1) != 0 ||
+        crecer(e, &e->v1, e->cap_lineas ? e->cap_lineas + 2 : 0, v, sizeof(int32_t)) != 0 ||
+        crecer(e, &e->v2, e->cap_lineas ? e->cap_lineas + 2 : 0, v, sizeof(int32_t)) != 0) {
+        return -1;   /* Lo que sí creció queda registrado y se libera al final */
+    }
+    e->cap_lineas = n;
+    return 0;
+}
+
+/** @brief Duplica la tabla hash y reubica las clases ya numeradas. */
+static int agrandar_tabla(Espacio *e) {
+    size_t cap = e->cap_tabla ? e->cap_tabla * 2 : 1024;
+    if (limite_cargar(cap * sizeof(Casilla)) != 0) {
+        errno = ECANCELED;
+        return -1;
+    }
+    Casilla *nueva = calloc(cap, sizeof(Casilla));
+    if (nueva == NULL) {
+        limite_descargar(cap * sizeof(Casilla));
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t i = 0; i < e->cap_tabla; i++) {
+        if (e->tabla[i].id != 0) {
+            size_t j = e->tabla[i].hash & (cap - 1);
+            while (nueva[j].id != 0) j = (j + 1) & (cap - 1);
+            nueva[j] = e->tabla[i];
+        }
+    }
+    free(e->tabla);
+    limite_descargar(e->cap_tabla * sizeof(Casilla));
+    e->tabla = nueva;
+    e->cap_tabla = cap;
+    return 0;
+}
+
+static void liberar_espacio(Espacio *e) {
+    free(e->ids);
+    free(e->marcas);
+    free(e->reducidos);
+    free(e->posiciones);
+    free(e->marcas_r);
+    free(e->v1);
+    free(e->v2);
+    free(e->tabla);
+    free(e->texto_clase);
+    free(e->largo_clase);
+    free(e->veces_a);
+    free(e->veces_b);
+    limite_descargar(e->cargado + e->cap_tabla * sizeof(Casilla));
+}
+
+/* ------------------------------------------------------------------ */
+/* Numeración de líneas                                                */
+/* ------------------------------------------------------------------ */
+
+/**
+ * @brief Asigna a cada línea el número de su clase: las líneas con el mismo
+ *        contenido (no solo el mismo hash) reciben el mismo número.
+ *
+ * La tabla se dimensiona por las líneas distintas (se duplica al pasar de
+ * la mitad de ocupación), no por el total de líneas.
+ *
+ * @param veces Cuenta de apariciones del lado que se numera (e->veces_a o e->veces_b).
+ * @return 0, o -1 con errno.
+ */
+static int numerar(Espacio *e, const unsigned char *t, size_t n, uint32_t *ids,
+                   unsigned char **veces, uint32_t *n_clases) {
+    size_t k = 0;
+    for (const unsigned char *p = t, *fin = t + n; p < fin; k++) {
+        const unsigned char *nl = memchr(p, '\n', (size_t)(fin - p));
+        size_t largo = nl ? (size_t)(nl - p) + 1 : (size_t)(fin - p);
+        uint64_t h = xxh64(p, largo, 0);
+        size_t mascara = e->cap_tabla - 1;
+        size_t i = h & mascara;
+        while (e->tabla[i].id != 0) {
+            uint32_t c = e->tabla[i].id - 1;
+            if (e->tabla[i].hash == h && e->largo_clase[c] == largo &&
+                memcmp(e->texto_clase[c], p, largo) == 0) {
+                break;
+            }
+            i = (i + 1) & mascara;
+        }
+        uint32_t c;
+        if (e->tabla[i].id != 0) {
+            c = e->tabla[i].id - 1;
+        } else {
+            c = (*n_clases)++;
+            if (c == e->cap_clases) {
+                size_t cap = e->cap_clases ? e->cap_clases * 2 : 1024;
+                if (crecer(e, &e->texto_clase, e->cap_clases, cap, sizeof(*e->texto_clase)) != 0 ||
+                    crecer(e, &e->largo_clase, e->cap_clases, cap, sizeof(size_t)) != 0 ||
+                    crecer(e, &e->veces_a, e->cap_clases, cap, 1) != 0 ||
+                    crecer(e, &e->veces_b, e->cap_clases, cap, 1) != 0) {
+                    return -1;
+                }
+                e->cap_clases = cap;
+            }
+            e->texto_clase[c] = p;
+            e->largo_clase[c] = largo;
+            e->veces_a[c] = e->veces_b[c] = 0;
+            e->tabla[i] = (Casilla){ h, c + 1 };
+            if ((size_t)*n_clases * 2 > e->cap_tabla && agrandar_tabla(e) != 0) {
+                return -1;
+            }
+        }
+        ids[k] = c;
+        if ((*veces)[c] < 2) (*veces)[c]++;
+        p += largo;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Myers en espacio lineal                                             */
+/* ------------------------------------------------------------------ */
+
+typedef struct {
+    const uint32_t *a, *b;
+    unsigned char *borrada;    /**< 1 si la línea de 'a' no está en 'b' */
+    unsigned char *agregada;   /**< 1 si la línea de 'b' no está en 'a' */
+    int32_t *v1, *v2;          /**< Frentes hacia adelante y hacia atrás */
+    int cancelado;
+} Myers;
+
+static void myers(Myers *m, long a0, long a1, long b0, long b1);
+
+/**
+ * @brief Busca la serpiente del medio avanzando desde los dos extremos a la
+ *        vez y divide el problema en ese punto.
+ *
+ * Los dos frentes se guardan por diagonal (k = x - y); cuando se cruzan, el
+ * punto donde lo hacen está en un camino de edición mínimo.
+ */
+static void bisectar(Myers *m, long a0, long a1, long b0, long b1) {
+    const uint32_t *A = m->a, *B = m->b;
+    long n1 = a1 - a0, n2 = b1 - b0;
+    long max_d = (n1 + n2 + 1) / 2;
+    long off = max_d, largo = 2 * max_d;
+    int32_t *v1 = m->v1, *v2 = m->v2;
+    for (long i = 0; i < largo + 2; i++) {
+        v1[i] = v2[i] = -1;
+    }
+    v1[off + 1] = 0;
+    v2[off + 1] = 0;
+    long delta = n1 - n2;
+    int frente = (delta & 1) != 0;   /* Con delta impar se cruzan yendo hacia adelante */
+    long k1ini = 0, k1fin = 0, k2ini = 0, k2fin = 0;
+
+    for (long d = 0; d < max_d; d++) {
+        if ((d & 255) == 0 && cancelacion_solicitada()) {
+            m->cancelado = 1;
+            return;
+        }
+        for (long k1 = -d + k1ini; k1 <= d - k1fin; k1 += 2) {
+            long o1 = off + k1;
+            long x1 = (k1 == -d || (k1 != d && v1[o1 - 1] < v1[o1 + 1])) ? v1[o1 + 1] : v1[o1 - 1] + 1;
+            long y1 = x1 - k1;
+            while (x1 < n1 && y1 < n2 && A[a0 + x1] == B[b0 + y1]) {
+                x1++;
+                y1++;
+            }
+            v1[o1] = (int32_t)x1;
+            if (x1 > n1) {
+                k1fin += 2;          /* Se salió por la derecha */
+            } else if (y1 > n2) {
+                k1ini += 2;          /* Se salió por abajo */
+            } else if (frente) {
+                long o2 = off + delta - k1;
+                if (o2 >= 0 && o2 < largo && v2[o2] != -1 && x1 >= n1 - v2[o2]) {
+                    myers(m, a0, a0 + x1, b0, b0 + y1);
+                    myers(m, a0 + x1, a1, b0 + y1, b1);
+                    return;
+                }
+            }
+        }
+        for (long k2 = -d + k2ini; k2 <= d - k2fin; k2 += 2) {
+            long o2 = off + k2;
+            long x2 = (k2 == -d || (k2 != d && v2[o2 - 1] < v2[o2 + 1])) ? v2[o2 + 1] : v2[o2 - 1] + 1;
+            long y2 = x2 - k2;
+            while (x2 < n1 && y2 < n2 && A[a1 - 1 - x2] == B[b1 - 1 - y2]) {
+                x2++;
+                y2++;
+            }
+            v2[o2] = (int32_t)x2;
+            if (x2 > n1) {
+                k2fin += 2;
+            } else if (y2 > n2) {
+                k2ini += 2;
+            } else if (!frente) {
+                long o1 = off + delta - k2;
+                if (o1 >= 0 && o1 < largo && v1[o1] != -1) {
+                    long x1 = v1[o1];
+                    long y1 = off + x1 - o1;
+                    if (x1 >= n1 - x2) {
+                        myers(m, a0, a0 + x1, b0, b0 + y1);
+                        myers(m, a0 + x1, a1, b0 + y1, b1);
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    /* Nada en común */
+    memset(m->borrada + a0, 1, (size_t)n1);
+    memset(m->agregada + b0, 1, (size_t)n2);
+}
+
+/** @brief Marca las líneas borradas y agregadas de a[a0..a1) frente a b[b0..b1). */
+static void myers(Myers *m, long a0, long a1, long b0, long b1) {
+    while (a0 < a1 && b0 < b1 && m->a[a0] == m->b[b0]) {
+        a0++;
+        b0++;
+    }
+    while (a0 < a1 && b0 < b1 && m->a[a1 - 1] == m->b[b1 - 1]) {
+        a1--;
+        b1--;
+    }
+    if (a0 == a1) {
+        memset(m->agregada + b0, 1, (size_t)(b1 - b0));
+    } else if (b0 == b1) {
+        memset(m->borrada + a0, 1, (size_t)(a1 - a0));
+    } else if (!m->cancelado) {
+        bisectar(m, a0, a1, b0, b1);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Salida unificada                                                    */
+/* ------------------------------------------------------------------ */
+
+/** @brief Un cambio: 'na' líneas de 'a' desde 'ia' sustituidas por 'nb' de 'b' desde 'ib'. */
+typedef struct {
+    size_t ia, na, ib, nb;
+} Cambio;
+
+/** @brief Recorre las líneas de un texto hacia adelante. */
+typedef struct {
+    const unsigned char *p, *fin;
+    size_t indice;
+} Cursor;
+
+static const unsigned char *linea_en(Cursor *c, size_t indice, size_t *largo) {
+    while (c->indice < indice) {
+        const unsigned char *nl = memchr(c->p, '\n', (size_t)(c->fin - c->p));
+        c->p = nl ? nl + 1 : c->fin;
+        c->indice++;
+    }
+    const unsigned char *nl = memchr(c->p, '\n', (size_t)(c->fin - c->p));
+    *largo = nl ? (size_t)(nl - c->p) + 1 : (size_t)(c->fin - c->p);
+    return c->p;
+}
+
+static void escribir_linea(FILE *f, char signo, Cursor *c, size_t indice, int color) {
+    size_t largo;
+    const unsigned char *l = linea_en(c, indice, &largo);
+    int con_salto = largo > 0 && l[largo - 1] == '\n';
+    if (color && signo != ' ') fputs(signo == '-' ? COLOR_RED : COLOR_GREEN, f);
+    fputc(signo, f);
+    fwrite(l, 1, largo - (size_t)con_salto, f);
+    if (color && signo != ' ') fputs(COLOR_RESET, f);
+    fputc('\n', f);
+    if (!con_salto) {
+        fputs("\\ No newline at end of file\n", f);
+    }
+}
+
+/** @brief "inicio,cuenta" como diff -u (",1" se omite; con 0 líneas, la anterior). */
+static void escribir_rango(FILE *f, char signo, uint64_t base, size_t inicio, size_t cuenta) {
+    uint64_t primera = base + inicio + (cuenta > 0 ? 1 : 0);
+    if (cuenta == 1) {
+        fprintf(f, " %c%llu", signo, (unsigned long long)primera);
+    } else {
+        fprintf(f, " %c%llu,%zu", signo, (unsigned long long)primera, cuenta);
+    }
+}
+
+static void escribir_bloques(FILE *f, const Cambio *c, size_t n_cambios, size_t n1, size_t n2,
+                             Cursor *ca, Cursor *cb, uint64_t base, int contexto, int color,
+                             ResumenDiferencias *r) {
+    size_t ctx = (size_t)contexto;
+    for (size_t s = 0; s < n_cambios;) {
+        /* Se juntan los cambios separados por 2*contexto líneas iguales o menos */
+        size_t e = s;
+        while (e + 1 < n_cambios && c[e + 1].ia - (c[e].ia + c[e].na) <= 2 * ctx) {
+            e++;
+        }
+        size_t ini_a = (c[s].ia > ctx) ? c[s].ia - ctx : 0;
+        size_t ini_b = c[s].ib - (c[s].ia - ini_a);
+        size_t fin_a = c[e].ia + c[e].na + ctx;
+        if (fin_a > n1) fin_a = n1;
+        size_t fin_b = c[e].ib + c[e].nb + (fin_a - (c[e].ia + c[e].na));
+        if (fin_b > n2) fin_b = n2;
+        r->bloques++;
+
+        if (f != NULL) {
+            if (color) fputs(COLOR_CYAN, f);
+            fputs("@@", f);
+            escribir_rango(f, '-', base, ini_a, fin_a - ini_a);
+            escribir_rango(f, '+', base, ini_b, fin_b - ini_b);
+            fputs(" @@", f);
+            if (color) fputs(COLOR_RESET, f);
+            fputc('\n', f);
+        }
+        size_t ia = ini_a;
+        for (size_t t = s; t <= e; t++) {
+            for (; ia < c[t].ia; ia++) {
+                if (f != NULL) escribir_linea(f, ' ', ca, ia, color);
+            }
+            for (size_t i = 0; i < c[t].na; i++) {
+                if (f != NULL) escribir_linea(f, '-', ca, c[t].ia + i, color);
+            }
+            for (size_t i = 0; i < c[t].nb; i++) {
+                if (f != NULL) escribir_linea(f, '+', cb, c[t].ib + i, color);
+            }
+            ia = c[t].ia + c[t].na;
+            r->borradas += c[t].na;
+            r->agregadas += c[t].nb;
+        }
+        for (; ia < fin_a; ia++) {
+            if (f != NULL) escribir_linea(f, ' ', ca, ia, color);
+        }
+        s = e + 1;
+    }
+}
+
+/** @brief Cambios ya confirmados, en orden. */
+typedef struct {
+    Cambio *c;
+    size_t n, cap;
+} ListaCambios;
+
+/**
+ * @brief Junta las líneas marcadas en cambios consecutivos y los añade a 'l'.
+ *
+ * @param base_a, base_b Número (dentro de la parte central) de la primera
+ *        línea de cada lado.
+ * @return 0, o -1 si no hubo memoria.
+ */
+static int agrupar_cambios(const unsigned char *borrada, size_t n1,
+                           const unsigned char *agregada, size_t n2,
+                           size_t base_a, size_t base_b, ListaCambios *l) {
+    size_t i = 0, j = 0;
+    while (i < n1 || j < n2) {
+        if ((i < n1 && borrada[i]) || (j < n2 && agregada[j])) {
+            if (l->n == l->cap) {
+                size_t cap = l->cap ? l->cap * 2 : 64;
+                Cambio *nuevo = realloc(l->c, cap * sizeof(*nuevo));
+                if (nuevo == NULL) {
+                    return -1;
+                }
+                l->c = nuevo;
+                l->cap = cap;
+            }
+            Cambio x = { base_a + i, 0, base_b + j, 0 };
+            while ((i < n1 && borrada[i]) || (j < n2 && agregada[j])) {
+                for (; i < n1 && borrada[i]; i++) x.na++;
+                for (; j < n2 && agregada[j]; j++) x.nb++;
+            }
+            l->c[l->n++] = x;
+        } else {
+            i++;
+            j++;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Compara una ventana de 'n1' líneas de 'a' con 'n2' de 'b' y deja
+ *        en e->marcas (las de 'a' seguidas de las de 'b') las que cambian.
+ *
+ * Las líneas que no aparecen en el otro lado son cambios seguros: se marcan
+ * sin pasar por Myers, que solo recorre las demás. Así dos tramos sin nada
+ * en común (p. ej. registros con marcas de tiempo) no cuestan O(n²).
+ *
+ * @return 0, o -1 con errno.
+ */
+static int comparar_ventana(Espacio *e, const unsigned char *ta, size_t bytes_a, size_t n1,
+                            const unsigned char *tb, size_t bytes_b, size_t n2) {
+    if (reservar_lineas(e, n1 + n2) != 0) {
+        return -1;
+    }
+    if (e->cap_tabla == 0 && agrandar_tabla(e) != 0) {
+        return -1;
+    }
+    memset(e->tabla, 0, e->cap_tabla * sizeof(Casilla));
+    uint32_t n_clases = 0;
+    if (numerar(e, ta, bytes_a, e->ids, &e->veces_a, &n_clases) != 0 ||
+        numerar(e, tb, bytes_b, e->ids + n1, &e->veces_b, &n_clases) != 0) {
+        return -1;
+    }
+
+    size_t r1 = 0, r2 = 0;
+    for (size_t i = 0; i < n1 + n2; i++) {
+        int comun = e->veces_a[e->ids[i]] > 0 && e->veces_b[e->ids[i]] > 0;
+        e->marcas[i] = !comun;
+        if (comun) {
+            e->reducidos[r1 + r2] = e->ids[i];
+            e->posiciones[r1 + r2] = (uint32_t)i;
+            if (i < n1) r1++;
+            else r2++;
+        }
+    }
+
+    memset(e->marcas_r, 0, r1 + r2);
+    Myers m = { e->reducidos, e->reducidos + r1, e->marcas_r, e->marcas_r + r1, e->v1, e->v2, 0 };
+    myers(&m, 0, (long)r1, 0, (long)r2);
+    if (m.cancelado) {
+        errno = ECANCELED;
+        return -1;
+    }
+    for (size_t i = 0; i < r1 + r2; i++) {
+        e->marcas[e->posiciones[i]] = e->marcas_r[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief Última pareja de líneas iguales de la ventana.
+ *
+ * @param unica 1 = solo cuentan las líneas que aparecen una sola vez en cada
+ *        lado: una línea repetida (vacía, "}") puede coincidir por azar
+ *        cuando la ventana cae en medio de un bloque insertado, una única no.
+ * @return 1 y la pareja en (*ui, *uj), o 0 si la ventana no tiene ninguna.
+ */
+static int ultima_coincidencia(const Espacio *e, size_t n1, size_t n2, int unica,
+                               size_t *ui, size_t *uj) {
+    const unsigned char *borrada = e->marcas, *agregada = e->marcas + n1;
+    int hay = 0;
+    size_t i = 0, j = 0;
+    while (i < n1 && j < n2) {
+        if (borrada[i]) {
+            i++;
+        } else if (agregada[j]) {
+            j++;
+        } else {
+            uint32_t c = e->ids[i];
+            if (!unica || (e->veces_a[c] == 1 && e->veces_b[c] == 1)) {
+                *ui = i;
+                *uj = j;
+                hay = 1;
+            }
+            i++;
+            j++;
+        }
+    }
+    return hay;
+}
+
+int diferencias_unificadas(const unsigned char *a, size_t na, const char *nombre_a,
+                           const unsigned char *b, size_t nb, const char *nombre_b,
+                           int contexto, FILE *salida, int color, ResumenDiferencias *r) {
+    memset(r, 0, sizeof(*r));
+    size_t min = (na < nb) ? na : nb;
+    size_t p = prefijo_comun(a, b, min);
+    if (p == na && p == nb) {
+        return 0;
+    }
+
+    /* Parte central: de 'contexto' líneas antes de la primera diferencia a
+     * 'contexto' líneas después de la última (en líneas completas) */
+    size_t ini = retroceder_lineas(a, inicio_linea(a, p), contexto);
+    size_t s = sufijo_comun(a, na, b, nb, min - p);
+    size_t fin_a = na - s, fin_b = nb - s;
+    int en_linea = (fin_a == 0 || a[fin_a - 1] == '\n') && (fin_b == 0 || b[fin_b - 1] == '\n');
+    if (!en_linea) {
+        fin_a = avanzar_lineas(a, fin_a, na, 1);   /* Primer fin de línea dentro del sufijo */
+    }
+    fin_a = avanzar_lineas(a, fin_a, na, contexto);
+    fin_b = nb - (na - fin_a);
+    uint64_t base = contar_lineas(a, ini);
+
+    const unsigned char *ma = a + ini, *mb = b + ini;
+    size_t ta = fin_a - ini, tb = fin_b - ini;
+
+    /* Por ventanas: se saltan las líneas iguales con memcmp(), se comparan
+     * las VENTANA_LINEAS siguientes de cada lado y se confirman los cambios
+     * hasta la última pareja de líneas iguales; desde ahí se sigue. */
+    Espacio e;
+    memset(&e, 0, sizeof(e));
+    ListaCambios cambios = { NULL, 0, 0 };
+    size_t pa = 0, pb = 0, la = 0, lb = 0;
+    int ventana = VENTANA_LINEAS;
+    int resultado = -1;
+    for (;;) {
+        if (cancelacion_solicitada()) {
+            errno = ECANCELED;
+            goto fin;
+        }
+        size_t resto_a = ta - pa, resto_b = tb - pb;
+        size_t k = prefijo_comun(ma + pa, mb + pb, (resto_a < resto_b) ? resto_a : resto_b);
+        if (k == resto_a && k == resto_b) {
+            break;
+        }
+        size_t q = inicio_linea(ma + pa, k);
+        size_t iguales = contar_lineas(ma + pa, q);
+        pa += q;
+        pb += q;
+        la += iguales;
+        lb += iguales;
+
+        size_t fa = avanzar_lineas(ma, pa, ta, ventana);
+        size_t fb = avanzar_lineas(mb, pb, tb, ventana);
+        size_t n1 = contar_lineas(ma + pa, fa - pa), n2 = contar_lineas(mb + pb, fb - pb);
+        if (comparar_ventana(&e, ma + pa, fa - pa, n1, mb + pb, fb - pb, n2) != 0) {
+            goto fin;
+        }
+        /* Se confirma hasta la última línea única en común; si no hay, se
+         * agranda la ventana y, ya en el máximo, vale cualquier coincidencia */
+        size_t ci = n1, cj = n2;
+        if (fa != ta || fb != tb) {
+            if (!ultima_coincidencia(&e, n1, n2, 1, &ci, &cj)) {
+                if (ventana < VENTANA_MAXIMA) {
+                    ventana *= 2;
+                    continue;
+                }
+                ultima_coincidencia(&e, n1, n2, 0, &ci, &cj);
+            }
+        }
+        if (agrupar_cambios(e.marcas, ci, e.marcas + n1, cj, la, lb, &cambios) != 0) {
+            errno = ENOMEM;
+            goto fin;
+        }
+        pa = avanzar_lineas(ma, pa, ta, (int)ci);
+        pb = avanzar_lineas(mb, pb, tb, (int)cj);
+        la += ci;
+        lb += cj;
+        ventana = VENTANA_LINEAS;
+    }
+
+    if (salida != NULL) {
+        if (color) fputs(COLOR_BOLD, salida);
+        fprintf(salida, "--- %s\n+++ %s\n", nombre_a, nombre_b);
+        if (color) fputs(COLOR_RESET, salida);
+    }
+    /* Las ventanas pueden dejar el último cambio al final de la parte
+     * central: el contexto posterior sale del sufijo común */
+    size_t extra = contar_lineas(a + fin_a, avanzar_lineas(a, fin_a, na, contexto) - fin_a);
+    Cursor ca = { ma, a + na, 0 }, cb = { mb, b + nb, 0 };
+    escribir_bloques(salida, cambios.c, cambios.n, la + extra, lb + extra, &ca, &cb, base,
+                     contexto, color, r);
+    resultado = 1;
+
+fin:
+    free(cambios.c);
+    liberar_espacio(&e);
+    return resultado;
+}
@@ -0,0 +1,864 @@
+/**
+ * @file expresion.c
+ * @brief Parser, NFA de Thompson y DFA perezoso (ver expresion.h).
+ *
+ * Búsqueda sin anclar: en cada paso del DFA se vuelven a añadir los estados
+ * iniciales del NFA, lo que equivale a probar una coincidencia que empieza
+ * en cada posición, pero simulando todas a la vez.
+ *
+ * `^` y `$` ocupan cero bytes: al calcular un cierre, `^` solo se atraviesa
+ * en el estado inicial y `$` solo al consumir el símbolo virtual "fin de
+ * línea" que se añade tras el último byte. Así el DFA no necesita guardar
+ * en qué posición de la línea está.
+ *
+ * Los bytes se agrupan en clases (dos bytes están en la misma clase si
+ * ningún conjunto del patrón los distingue), de modo que la tabla de
+ * transiciones de cada estado tiene una entrada por clase y no 256.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "expresion.h"
+#include "subcadena.h"
+
+/** @brief Límite de estados del NFA (acota patrones como (a{255}){255}). */
+#define MAX_ESTADOS_NFA 20000
+
+/** @brief Repetición máxima en {m,n}. */
+#define MAX_REPETICION 255
+
+/** @brief Anidamiento máximo de paréntesis. */
+#define MAX_PROFUNDIDAD 200
+
+/** @brief Memoria máxima de la caché de estados del DFA de un patrón. */
+#define MAX_MEMORIA_DFA (2 * 1024 * 1024)
+
+/** @brief Longitud máxima del literal usado como prefiltro. */
+#define MAX_LITERAL 255
+
+/** @brief Patrones distintos que recuerda la caché de una sesión. */
+#define TAM_CACHE_EXPRESIONES 8
+
+/* =============================================================================
+ * Árbol sintáctico
+ * ========================================================================== */
+
+enum { N_CLASE, N_INICIO, N_FIN, N_CONCAT, N_ALT, N_REPETIR, N_VACIO };
+
+typedef struct {
+    int tipo;
+    uint64_t bits[4];  /**< N_CLASE: bytes aceptados */
+    int a, b;          /**< Hijos (índices en el arreglo de nodos) */
+    int min, max;      /**< N_REPETIR; max = -1 es ilimitado */
+} Nodo;
+
+typedef struct {
+    const char *p;
+    const char *error;
+    Nodo *nodos;
+    int n, cap;
+    int profundidad;
+} Parser;
+
+static int nuevo_nodo(Parser *ps, int tipo) {
+    if (ps->n == ps->cap) {
+        int nueva = ps->cap ? ps->cap * 2 : 64;
+        Nodo *tmp = realloc(ps->nodos, (size_t)nueva * sizeof(Nodo));
+        if (tmp == NULL) {
+            ps->error = "sin memoria";
+            return -1;
+        }
+        ps->nodos = tmp;
+        ps->cap = nueva;
+    }
+    Nodo *n = &ps->nodos[ps->n];
+    memset(n, 0, sizeof(*n));
+    n->tipo = tipo;
+    n->a = n->b = -1;
+    return ps->n++;
+}
+
+static inline void bit_poner(uint64_t *bits, unsigned c) {
+    bits[c >> 6] |= 1ull << (c & 63);
+}
+
+static inline int bit_esta(const uint64_t *bits, unsigned c) {
+    return (bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static void bits_rango(uint64_t *bits, unsigned desde, unsigned hasta) {
+    for (unsigned c = desde; c <= hasta; c++) bit_poner(bits, c);
+}
+
+/**
+ * @brief Aplica un escape de clase (\d, \w, \s, ...) a un conjunto.
+ * @return 1 si 'c' era un escape de clase, 0 si es un byte literal.
+ */
+static int escape_clase(char c, uint64_t *bits) {
+    uint64_t tmp[4] = {0};
+    switch (c) {
+        case 'd': case 'D': bits_rango(tmp, '0', '9'); break;
+        case 'w': case 'W':
+            bits_rango(tmp, '0', '9');
+            bits_rango(tmp, 'a', 'z');
+            bits_rango(tmp, 'A', 'Z');
+            bit_poner(tmp, '_');
+            break;
+        case 's': case 'S':
+            bits_rango(tmp, '\t', '\r');
+            bit_poner(tmp, ' ');
+            break;
+        default:
+            return 0;
+    }
+    int negado = c == 'D' || c == 'W' || c == 'S';
+    for (int i = 0; i < 4; i++) bits[i] |= negado ? ~tmp[i] : tmp[i];
+    return 1;
+}
+
+/** @brief Byte literal de un escape (\t, \n o el propio carácter). */
+static unsigned char escape_literal(char c) {
+    return c == 't' ? '\t' : c == 'n' ? '\n' : (unsigned char)c;
+}
+
+static int parsear_alternativa(Parser *ps);
+
+/** @brief Conjunto entre corchetes; ps->p apunta justo después de '['. */
+static int parsear_conjunto(Parser *ps) {
+    int id = nuevo_nodo(ps, N_CLASE);
+    if (id < 0) return -1;
+    uint64_t bits[4] = {0};
+    int negado = 0;
+    if (*ps->p == '^') {
+        negado = 1;
+        ps->p++;
+    }
+    int primero = 1;
+    while (*ps->p != '\0' && (*ps->p != ']' || primero)) {
+        primero = 0;
+        unsigned char desde;
+        if (*ps->p == '\\' && ps->p[1] != '\0') {
+            if (escape_clase(ps->p[1], bits)) {
+                ps->p += 2;
+                continue;
+            }
+            desde = escape_literal(ps->p[1]);
+            ps->p += 2;
+        } else {
+            desde = (unsigned char)*ps->p++;
+        }
+        if (ps->p[0] == '-' && ps->p[1] != ']' && ps->p[1] != '\0') {
+            unsigned char hasta;
+            if (ps->p[1] == '\\' && ps->p[2] != '\0') {
+                hasta = escape_literal(ps->p[2]);
+                ps->p += 3;
+            } else {
+                hasta = (unsigned char)ps->p[1];
+                ps->p += 2;
+            }
+            if (hasta < desde) {
+                ps->error = "rango inválido en [...]";
+                return -1;
+            }
+            bits_rango(bits, desde, hasta);
+        } else {
+            bit_poner(bits, desde);
+        }
+    }
+    if (*ps->p != ']') {
+        ps->error = "falta ']'";
+        return -1;
+    }
+    ps->p++;
+    for (int i = 0; i < 4; i++) ps->nodos[id].bits[i] = negado ? ~bits[i] : bits[i];
+    return id;
+}
+
+static int parsear_atomo(Parser *ps) {
+    char c = *ps->p;
+    if (c == '(') {
+        if (++ps->profundidad > MAX_PROFUNDIDAD) {
+            ps->error = "demasiados paréntesis anidados";
+            return -1;
+        }
+        ps->p++;
+        int id = parsear_alternativa(ps);
+        if (id < 0) return -1;
+        if (*ps->p != ')') {
+            ps->error = "falta ')'";
+            return -1;
+        }
+        ps->p++;
+        ps->profundidad--;
+        return id;
+    }
+    if (c == '[') {
+        ps->p++;
+        return parsear_conjunto(ps);
+    }
+    if (c == '^' || c == '$') {
+        ps->p++;
+        return nuevo_nodo(ps, c == '^' ? N_INICIO : N_FIN);
+    }
+    if (c == '*' || c == '+' || c == '?') {
+        ps->error = "repetición sin nada que repetir";
+        return -1;
+    }
+
+    int id = nuevo_nodo(ps, N_CLASE);
+    if (id < 0) return -1;
+    uint64_t *bits = ps->nodos[id].bits;
+    if (c == '.') {
+        memset(bits, 0xFF, 4 * sizeof(uint64_t));
+        bits['\n' >> 6] &= ~(1ull << ('\n' & 63));
+        ps->p++;
+    } else if (c == '\\') {
+        if (ps->p[1] == '\0') {
+            ps->error = "'\\' al final del patrón";
+            return -1;
+        }
+        if (!escape_clase(ps->p[1], bits)) {
+            bit_poner(bits, escape_literal(ps->p[1]));
+        }
+        ps->p += 2;
+    } else {
+        bit_poner(bits, (unsigned char)c);
+        ps->p++;
+    }
+    return id;
+}
+
+/** @brief Lee {m}, {m,} o {m,n}. @return 1 si había llaves válidas, 0 si no. */
+static int parsear_llaves(Parser *ps, int *min, int *max) {
+    const char *p = ps->p + 1;
+    char *fin;
+    if (*p < '0' || *p > '9') return 0;
+    long a = strtol(p, &fin, 10), b = a;
+    if (*fin == ',') {
+        p = fin + 1;
+        if (*p == '}') {
+            b = -1;
+            fin = (char *)p;
+        } else if (*p >= '0' && *p <= '9') {
+            b = strtol(p, &fin, 10);
+        } else {
+            return 0;
+        }
+    }
+    if (*fin != '}') return 0;
+    if (a > MAX_REPETICION || b > MAX_REPETICION || (b >= 0 && b < a)) {
+        ps->error = "repetición {m,n} inválida (máximo 255)";
+        return -1;
+    }
+    *min = (int)a;
+    *max = (int)b;
+    ps->p = fin + 1;
+    return 1;
+}
+
+static int parsear_repeticion(Parser *ps) {
+    int id = parsear_atomo(ps);
+    while (id >= 0) {
+        int min, max;
+        char c = *ps->p;
+        if (c == '*') { min = 0; max = -1; ps->p++; }
+        else if (c == '+') { min = 1; max = -1; ps->p++; }
+        else if (c == '?') { min = 0; max = 1; ps->p++; }
+        else if (c == '{') {
+            int r = parsear_llaves(ps, &min, &max);
+            if (r < 0) return -1;
+            if (r == 0) break;     /* '{' literal */
+        } else {
+            break;
+        }
+        int rep = nuevo_nodo(ps, N_REPETIR);
+        if (rep < 0) return -1;
+        ps->nodos[rep].a = id;
+        ps->nodos[rep].min = min;
+        ps->nodos[rep].max = max;
+        id = rep;
+    }
+    return id;
+}
+
+static int parsear_concatenacion(Parser *ps) {
+    int id = -1;
+    while (*ps->p != '\0' && *ps->p != '|' && *ps->p != ')') {
+        int siguiente = parsear_repeticion(ps);
+        if (siguiente < 0) return -1;
+        if (id < 0) {
+            id = siguiente;
+        } else {
+            int c = nuevo_nodo(ps, N_CONCAT);
+            if (c < 0) return -1;
+            ps->nodos[c].a = id;
+            ps->nodos[c].b = siguiente;
+            id = c;
+        }
+    }
+    return id >= 0 ? id : nuevo_nodo(ps, N_VACIO);
+}
+
+static int parsear_alternativa(Parser *ps) {
+    int id = parsear_concatenacion(ps);
+    while (id >= 0 && *ps->p == '|') {
+        ps->p++;
+        int otra = parsear_concatenacion(ps);
+        if (otra < 0) return -1;
+        int alt = nuevo_nodo(ps, N_ALT);
+        if (alt < 0) return -1;
+        ps->nodos[alt].a = id;
+        ps->nodos[alt].b = otra;
+        id = alt;
+    }
+    return id;
+}
+
+/* =============================================================================
+ * Literal requerido (prefiltro)
+ * ========================================================================== */
+
+typedef struct {
+    char actual[MAX_LITERAL];
+    size_t len_actual;
+    char mejor[MAX_LITERAL];
+    size_t len_mejor;
+    int solo_literal;   /**< 1 mientras todo el patrón sean bytes sueltos */
+} Literales;
+
+/** @return El byte si el conjunto tiene exactamente uno, o -1. */
+static int byte_unico(const Nodo *n) {
+    int total = 0, byte = -1;
+    for (int i = 0; i < 4; i++) {
+        int k = __builtin_popcountll(n->bits[i]);
+        if (k == 1) byte = i * 64 + __builtin_ctzll(n->bits[i]);
+        total += k;
+    }
+    return total == 1 ? byte : -1;
+}
+
+static void cerrar_tramo(Literales *l) {
+    if (l->len_actual > l->len_mejor) {
+        memcpy(l->mejor, l->actual, l->len_actual);
+        l->len_mejor = l->len_actual;
+    }
+    l->len_actual = 0;
+}
+
+/**
+ * @brief Recorre una concatenación buscando tramos de bytes sueltos.
+ *
+ * Solo se entra en nodos que toda coincidencia atraviesa (concatenación y
+ * repetición con mínimo >= 1); las alternativas no aportan literal.
+ */
+static void buscar_literales(const Nodo *nodos, int id, Literales *l) {
+    const Nodo *n = &nodos[id];
+    if (n->tipo == N_CONCAT) {
+        buscar_literales(nodos, n->a, l);
+        buscar_literales(nodos, n->b, l);
+        return;
+    }
+    int byte = n->tipo == N_CLASE ? byte_unico(n) : -1;
+    if (byte >= 0) {
+        if (l->len_actual == MAX_LITERAL) cerrar_tramo(l);
+        l->actual[l->len_actual++] = (char)byte;
+        return;
+    }
+    l->solo_literal = 0;
+    cerrar_tramo(l);
+    if (n->tipo == N_REPETIR && n->min >= 1) {
+        buscar_literales(nodos, n->a, l);
+        cerrar_tramo(l);   /* Lo repetido no es contiguo con lo que sigue */
+    }
+}
+
+/* =============================================================================
+ * NFA
+ * ========================================================================== */
+
+enum { E_BYTES, E_INICIO, E_FIN, E_DIVIDIR, E_ACEPTA };
+
+typedef struct {
+    int tipo;
+    int sal, sal2;
+    uint64_t bits[4];
+} EstadoNFA;
+
+typedef struct {
+    int *nfa;          /**< Estados del NFA (ordenados) */
+    int n;
+    int acepta;
+    int32_t *trans;    /**< Por símbolo: estado destino o -1 si no se calculó */
+} EstadoDFA;
+
+struct Expresion {
+    char *patron;
+
+    EstadoNFA *nfa;
+    int n_nfa, cap_nfa;
+    int inicio;
+
+    unsigned char clase[256];  /**< Clase de cada byte */
+    unsigned char representante[256];
+    int n_clases;
+    int simb_fin, n_simbolos;  /**< simb_fin = n_clases: "fin de línea" */
+
+    EstadoDFA *dfa;
+    int n_dfa, cap_dfa;
+    int *tabla;                /**< Hash de conjuntos -> estado del DFA (-1 vacío) */
+    size_t cap_tabla;
+    size_t memoria_dfa;
+    int inicial;               /**< Estado inicial del DFA, o -1 */
+    int acepta_vacia;          /**< 1 si la línea vacía coincide */
+
+    int *pila;                 /**< Auxiliares para calcular cierres */
+    int *conjunto;
+    int n_conjunto;
+    uint32_t *marca;
+    uint32_t generacion;
+
+    char literal[MAX_LITERAL];
+    size_t len_literal;
+    int solo_literal;
+};
+
+static int nuevo_estado(Expresion *re, int tipo, int sal, int sal2) {
+    if (re->n_nfa >= MAX_ESTADOS_NFA) return -1;
+    if (re->n_nfa == re->cap_nfa) {
+        int nueva = re->cap_nfa ? re->cap_nfa * 2 : 64;
+        if (nueva > MAX_ESTADOS_NFA) nueva = MAX_ESTADOS_NFA;
+        EstadoNFA *tmp = realloc(re->nfa, (size_t)nueva * sizeof(EstadoNFA));
+        if (tmp == NULL) return -1;
+        re->nfa = tmp;
+        re->cap_nfa = nueva;
+    }
+    EstadoNFA *e = &re->nfa[re->n_nfa];
+    memset(e, 0, sizeof(*e));
+    e->tipo = tipo;
+    e->sal = sal;
+    e->sal2 = sal2;
+    return re->n_nfa++;
+}
+
+/**
+ * @brief Compila un nodo "hacia atrás": 'sig' es el estado al que se llega
+ *        después del nodo. @return Estado de entrada, o -1.
+ */
+static int compilar(Expresion *re, const Nodo *nodos, int id, int sig) {
+    const Nodo *n = &nodos[id];
+    switch (n->tipo) {
+        case N_VACIO:
+            return sig;
+        case N_CLASE: {
+            int e = nuevo_estado(re, E_BYTES, sig, -1);
+            if (e >= 0) memcpy(re->nfa[e].bits, n->bits, sizeof(n->bits));
+            return e;
+        }
+        case N_INICIO:
+            return nuevo_estado(re, E_INICIO, sig, -1);
+        case N_FIN:
+            return nuevo_estado(re, E_FIN, sig, -1);
+        case N_CONCAT: {
+            int b = compilar(re, nodos, n->b, sig);
+            return b < 0 ? -1 : compilar(re, nodos, n->a, b);
+        }
+        case N_ALT: {
+            int a = compilar(re, nodos, n->a, sig);
+            int b = a < 0 ? -1 : compilar(re, nodos, n->b, sig);
+            return b < 0 ? -1 : nuevo_estado(re, E_DIVIDIR, a, b);
+        }
+        case N_REPETIR: {
+            int t = sig;
+            if (n->max < 0) {
+                /* a*: bifurcación que vuelve a entrar al cuerpo o sale */
+                int s = nuevo_estado(re, E_DIVIDIR, -1, sig);
+                if (s < 0) return -1;
+                int cuerpo = compilar(re, nodos, n->a, s);
+                if (cuerpo < 0) return -1;
+                re->nfa[s].sal = cuerpo;
+                t = s;
+            } else {
+                /* Copias opcionales: (a(a(...)?)?)? */
+                for (int i = n->min; i < n->max; i++) {
+                    int cuerpo = compilar(re, nodos, n->a, t);
+                    if (cuerpo < 0) return -1;
+                    t = nuevo_estado(re, E_DIVIDIR, cuerpo, sig);
+                    if (t < 0) return -1;
+                }
+            }
+            for (int i = 0; i < n->min; i++) {
+                t = compilar(re, nodos, n->a, t);
+                if (t < 0) return -1;
+            }
+            return t;
+        }
+    }
+    return -1;
+}
+
+/** @brief Agrupa los bytes que ningún conjunto del NFA distingue. */
+static void calcular_clases(Expresion *re) {
+    memset(re->clase, 0, sizeof(re->clase));
+    int n_clases = 1;
+    for (int s = 0; s < re->n_nfa; s++) {
+        if (re->nfa[s].tipo != E_BYTES) continue;
+        /* Cada clase existente se parte en (dentro, fuera) del conjunto */
+        int nueva_dentro[256], nueva_fuera[256];
+        for (int c = 0; c < n_clases; c++) nueva_dentro[c] = nueva_fuera[c] = -1;
+        int total = 0;
+        unsigned char clase_nueva[256];
+        for (int b = 0; b < 256; b++) {
+            int c = re->clase[b];
+            int *destino = bit_esta(re->nfa[s].bits, (unsigned)b) ? &nueva_dentro[c] : &nueva_fuera[c];
+            if (*destino < 0) *destino = total++;
+            clase_nueva[b] = (unsigned char)*destino;
+        }
+        memcpy(re->clase, clase_nueva, sizeof(clase_nueva));
+        n_clases = total;
+    }
+    re->n_clases = n_clases;
+    for (int b = 255; b >= 0; b--) re->representante[re->clase[b]] = (unsigned char)b;
+    re->simb_fin = n_clases;
+    re->n_simbolos = n_clases + 1;
+}
+
+/* =============================================================================
+ * DFA perezoso
+ * ========================================================================== */
+
+/** @brief Posición en la línea al calcular un cierre (para las anclas). */
+#define EN_INICIO 0x1
+#define EN_FIN    0x2
+
+/**
+ * @brief Añade al conjunto en curso el cierre de un estado del NFA.
+ *
+ * Solo se guardan los estados que consumen algo (o `$` pendientes); un `^`
+ * fuera del inicio no puede cumplirse nunca y se descarta.
+ */
+static void agregar_cierre(Expresion *re, int s, int posicion) {
+    int tope = 0;
+    re->pila[tope++] = s;
+    while (tope > 0) {
+        s = re->pila[--tope];
+        if (re->marca[s] == re->generacion) continue;
+        re->marca[s] = re->generacion;
+        const EstadoNFA *e = &re->nfa[s];
+        if (e->tipo == E_DIVIDIR) {
+            re->pila[tope++] = e->sal2;
+            re->pila[tope++] = e->sal;
+        } else if (e->tipo == E_INICIO) {
+            if (posicion & EN_INICIO) re->pila[tope++] = e->sal;
+        } else if (e->tipo == E_FIN && (posicion & EN_FIN)) {
+            re->pila[tope++] = e->sal;
+        } else {
+            re->conjunto[re->n_conjunto++] = s;
+        }
+    }
+}
+
+static void nueva_generacion(Expresion *re) {
+    re->n_conjunto = 0;
+    if (++re->generacion == 0) {
+        memset(re->marca, 0, (size_t)re->n_nfa * sizeof(uint32_t));
+        re->generacion = 1;
+    }
+}
+
+static uint32_t hash_conjunto(const int *v, int n) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < n; i++) {
+        h = (h ^ (uint32_t)v[i]) * 16777619u;
+    }
+    return h;
+}
+
+/** @brief Descarta todos los estados del DFA (la caché se llenó). */
+static void vaciar_dfa(Expresion *re) {
+    for (int i = 0; i < re->n_dfa; i++) {
+        free(re->dfa[i].nfa);
+        free(re->dfa[i].trans);
+    }
+    re->n_dfa = 0;
+    re->memoria_dfa = 0;
+    re->inicial = -1;
+    for (size_t i = 0; i < re->cap_tabla; i++) re->tabla[i] = -1;
+}
+
+static int tabla_insertar(Expresion *re, int id) {
+    if ((size_t)(re->n_dfa + 1) * 2 > re->cap_tabla) {
+        size_t nueva = re->cap_tabla ? re->cap_tabla * 2 : 256;
+        int *tmp = malloc(nueva * sizeof(int));
+        if (tmp == NULL) return -1;
+        for (size_t i = 0; i < nueva; i++) tmp[i] = -1;
+        for (int i = 0; i < re->n_dfa; i++) {
+            if (i == id) continue;
+            size_t h = hash_conjunto(re->dfa[i].nfa, re->dfa[i].n) & (nueva - 1);
+            while (tmp[h] >= 0) h = (h + 1) & (nueva - 1);
+            tmp[h] = i;
+        }
+        free(re->tabla);
+        re->tabla = tmp;
+        re->cap_tabla = nueva;
+    }
+    size_t h = hash_conjunto(re->dfa[id].nfa, re->dfa[id].n) & (re->cap_tabla - 1);
+    while (re->tabla[h] >= 0) h = (h + 1) & (re->cap_tabla - 1);
+    re->tabla[h] = id;
+    return 0;
+}
+
+static int comparar_int(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Devuelve el estado del DFA del conjunto en curso, creándolo si hace falta.
+ * @param vaciado Recibe 1 si hubo que vaciar la caché (los ids previos dejan de valer).
+ * @return Id del estado, o -1 si no hubo memoria.
+ */
+static int estado_para_conjunto(Expresion *re, int *vaciado) {
+    qsort(re->conjunto, (size_t)re->n_conjunto, sizeof(int), comparar_int);
+    int n = re->n_conjunto;
+    *vaciado = 0;
+
+    if (re->cap_tabla > 0) {
+        size_t h = hash_conjunto(re->conjunto, n) & (re->cap_tabla - 1);
+        for (; re->tabla[h] >= 0; h = (h + 1) & (re->cap_tabla - 1)) {
+            const EstadoDFA *d = &re->dfa[re->tabla[h]];
+            if (d->n == n && memcmp(d->nfa, re->conjunto, (size_t)n * sizeof(int)) == 0) {
+                return re->tabla[h];
+            }
+        }
+    }
+
+    size_t costo = sizeof(EstadoDFA) + (size_t)n * sizeof(int) +
+                   (size_t)re->n_simbolos * sizeof(int32_t) + 2 * sizeof(int);
+    if (re->memoria_dfa + costo > MAX_MEMORIA_DFA && re->n_dfa > 0) {
+        vaciar_dfa(re);
+        *vaciado = 1;
+    }
+    if (re->n_dfa == re->cap_dfa) {
+        int nueva = re->cap_dfa ? re->cap_dfa * 2 : 64;
+        EstadoDFA *tmp = realloc(re->dfa, (size_t)nueva * sizeof(EstadoDFA));
+        if (tmp == NULL) return -1;
+        re->dfa = tmp;
+        re->cap_dfa = nueva;
+    }
+    EstadoDFA *d = &re->dfa[re->n_dfa];
+    d->nfa = malloc(((size_t)n + 1) * sizeof(int));
+    d->trans = malloc((size_t)re->n_simbolos * sizeof(int32_t));
+    if (d->nfa == NULL || d->trans == NULL) {
+        free(d->nfa);
+        free(d->trans);
+        return -1;
+    }
+    memcpy(d->nfa, re->conjunto, (size_t)n * sizeof(int));
+    d->n = n;
+    d->acepta = 0;
+    for (int i = 0; i < n; i++) {
+        if (re->nfa[re->conjunto[i]].tipo == E_ACEPTA) d->acepta = 1;
+    }
+    for (int i = 0; i < re->n_simbolos; i++) d->trans[i] = -1;
+    int id = re->n_dfa++;
+    if (tabla_insertar(re, id) != 0) {
+        re->n_dfa--;
+        free(d->nfa);
+        free(d->trans);
+        return -1;
+    }
+    re->memoria_dfa += costo;
+    return id;
+}
+
+static int estado_inicial(Expresion *re) {
+    if (re->inicial < 0) {
+        int vaciado;
+        nueva_generacion(re);
+        agregar_cierre(re, re->inicio, EN_INICIO);
+        re->inicial = estado_para_conjunto(re, &vaciado);
+    }
+    return re->inicial;
+}
+
+/**
+ * @brief Calcula (y guarda) la transición de un estado del DFA.
+ *
+ * Con un byte avanzan los estados cuyo conjunto lo contiene; con el fin de
+ * línea, los `$` pendientes se cumplen.
+ */
+static int calcular_paso(Expresion *re, int d, int simbolo) {
+    nueva_generacion(re);
+    int fin = simbolo == re->simb_fin;
+    const EstadoDFA *origen = &re->dfa[d];
+    for (int i = 0; i < origen->n; i++) {
+        const EstadoNFA *e = &re->nfa[origen->nfa[i]];
+        if (fin ? e->tipo == E_FIN
+                : e->tipo == E_BYTES && bit_esta(e->bits, re->representante[simbolo])) {
+            agregar_cierre(re, e->sal, fin ? EN_FIN : 0);
+        }
+    }
+    /* Una coincidencia puede empezar aquí */
+    agregar_cierre(re, re->inicio, fin ? EN_FIN : 0);
+
+    int vaciado;
+    int destino = estado_para_conjunto(re, &vaciado);
+    if (destino >= 0 && !vaciado) {
+        re->dfa[d].trans[simbolo] = destino;
+    }
+    return destino;
+}
+
+static inline int paso(Expresion *re, int d, int simbolo) {
+    int32_t t = re->dfa[d].trans[simbolo];
+    return t >= 0 ? t : calcular_paso(re, d, simbolo);
+}
+
+int expresion_coincide(Expresion *re, const char *linea, size_t n) {
+    if (re->len_literal > 0 &&
+        buscar_subcadena(linea, n, re->literal, re->len_literal) == NULL) {
+        return 0;
+    }
+    if (re->solo_literal) {
+        return 1;
+    }
+    if (n == 0) {
+        return re->acepta_vacia;   /* Inicio y fin a la vez */
+    }
+
+    int d = estado_inicial(re);
+    const unsigned char *p = (const unsigned char *)linea;
+    for (size_t i = 0; i < n && d >= 0; i++) {
+        if (re->dfa[d].acepta) return 1;
+        d = paso(re, d, re->clase[p[i]]);
+    }
+    if (d < 0) return 0;    /* Sin memoria */
+    if (re->dfa[d].acepta) return 1;
+    d = paso(re, d, re->simb_fin);
+    return d >= 0 && re->dfa[d].acepta;
+}
+
+const char *expresion_literal(const Expresion *re, size_t *len) {
+    *len = re->len_literal;
+    return re->len_literal > 0 ? re->literal : NULL;
+}
+
+Expresion *expresion_compilar(const char *patron, char *error, size_t tam_error) {
+    Parser ps = { patron, NULL, NULL, 0, 0, 0 };
+    int raiz = parsear_alternativa(&ps);
+    if (raiz >= 0 && *ps.p == ')') {
+        ps.error = "')' sin '(' correspondiente";
+        raiz = -1;
+    }
+    if (raiz < 0) {
+        snprintf(error, tam_error, "%s", ps.error ? ps.error : "patrón inválido");
+        free(ps.nodos);
+        return NULL;
+    }
+
+    Expresion *re = calloc(1, sizeof(Expresion));
+    if (re == NULL || (re->patron = strdup(patron)) == NULL) {
+        snprintf(error, tam_error, "sin memoria");
+        free(re);
+        free(ps.nodos);
+        return NULL;
+    }
+    re->inicial = -1;
+    int acepta = nuevo_estado(re, E_ACEPTA, -1, -1);
+    re->inicio = acepta < 0 ? -1 : compilar(re, ps.nodos, raiz, acepta);
+
+    Literales l;
+    l.len_actual = l.len_mejor = 0;
+    l.solo_literal = 1;
+    buscar_literales(ps.nodos, raiz, &l);
+    cerrar_tramo(&l);
+    free(ps.nodos);
+
+    if (re->inicio < 0) {
+        snprintf(error, tam_error, "patrón demasiado grande");
+        expresion_liberar(re);
+        return NULL;
+    }
+    memcpy(re->literal, l.mejor, l.len_mejor);
+    re->len_literal = l.len_mejor;
+    /* Solo es literal puro si todo el patrón es un único tramo de bytes */
+    re->solo_literal = l.solo_literal && l.len_mejor > 0 && l.len_mejor < MAX_LITERAL;
+
+    calcular_clases(re);
+    re->pila = malloc(((size_t)re->n_nfa * 2 + 1) * sizeof(int));
+    re->conjunto = malloc(((size_t)re->n_nfa + 1) * sizeof(int));
+    re->marca = calloc((size_t)re->n_nfa + 1, sizeof(uint32_t));
+    if (re->pila == NULL || re->conjunto == NULL || re->marca == NULL) {
+        snprintf(error, tam_error, "sin memoria");
+        expresion_liberar(re);
+        return NULL;
+    }
+    nueva_generacion(re);
+    agregar_cierre(re, re->inicio, EN_INICIO | EN_FIN);
+    for (int i = 0; i < re->n_conjunto; i++) {
+        if (re->nfa[re->conjunto[i]].tipo == E_ACEPTA) re->acepta_vacia = 1;
+    }
+    return re;
+}
+
+void expresion_liberar(Expresion *re) {
+    if (re == NULL) return;
+    vaciar_dfa(re);
+    free(re->dfa);
+    free(re->tabla);
+    free(re->nfa);
+    free(re->pila);
+    free(re->conjunto);
+    free(re->marca);
+    free(re->patron);
+    free(re);
+}
+
+/* =============================================================================
+ * Caché por sesión
+ * ========================================================================== */
+
+struct CacheExpresiones {
+    Expresion *entradas[TAM_CACHE_EXPRESIONES];
+    unsigned long uso[TAM_CACHE_EXPRESIONES];  /**< Último uso (para reemplazar el más antiguo) */
+    unsigned long reloj;
+};
+
+Expresion *expresion_de_cache(CacheExpresiones **cache, const char *patron,
+                              char *error, size_t tam_error) {
+    if (*cache == NULL) {
+        *cache = calloc(1, sizeof(CacheExpresiones));
+        if (*cache == NULL) {
+            snprintf(error, tam_error, "sin memoria");
+            return NULL;
+        }
+    }
+    CacheExpresiones *c = *cache;
+    int libre = 0;
+    for (int i = 0; i < TAM_CACHE_EXPRESIONES; i++) {
+        if (c->entradas[i] != NULL && strcmp(c->entradas[i]->patron, patron) == 0) {
+            c->uso[i] = ++c->reloj;
+            return c->entradas[i];
+        }
+        if (c->uso[i] < c->uso[libre]) libre = i;
+    }
+
+    Expresion *re = expresion_compilar(patron, error, tam_error);
+    if (re == NULL) {
+        return NULL;
+    }
+    expresion_liberar(c->entradas[libre]);
+    c->entradas[libre] = re;
+    c->uso[libre] = ++c->reloj;
+    return re;
+}
+
+void expresion_cache_liberar(CacheExpresiones *cache) {
+    if (cache == NULL) return;
+    for (int i = 0; i < TAM_CACHE_EXPRESIONES; i++) {
+        expresion_liberar(cache->entradas[i]);
+    }
+    free(cache);
+}
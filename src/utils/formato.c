@@ -0,0 +1,427 @@
+/**
+ * @file formato.c
+ * @brief Serializador de registros JSON / TSV (ver formato.h).
+ *
+ * El estado es por hilo: cada hilo que ejecuta comandos (el de la shell,
+ * los trabajadores del servidor o de `paralelo`) arma sus registros en sus
+ * propios buffers, así que no hace falta ningún candado.
+ */
+
+#define _GNU_SOURCE   /* fopencookie */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "formato.h"
+#include "shell.h"
+#include "colors.h"
+
+/** @brief Buffer de bytes que crece según haga falta. */
+typedef struct {
+    char *datos;
+    size_t len, cap;
+} Buffer;
+
+/** @brief Flujo que convierte el texto de un comando en registros. */
+typedef struct {
+    FILE *flujo;      /**< El FILE* de fopencookie (la salida de la sesión) */
+    FILE *destino;    /**< Adónde van los registros */
+    FILE *anterior;   /**< sesion_actual->salida antes del comando */
+    FILE *errores_anterior; /**< sesion_actual->errores antes del comando */
+    Buffer linea;     /**< Línea de texto incompleta */
+} FlujoMensajes;
+
+/** @brief Estado del serializador en este hilo. */
+typedef struct {
+    FlujoMensajes *mensajes; /**< Flujo del comando en curso, o NULL */
+    FlujoMensajes *errores;  /**< Flujo de sus errores si van a otro stream, o NULL */
+    Buffer registro;         /**< JSON: el objeto; TSV: los valores */
+    Buffer claves;           /**< TSV: nombres de los campos */
+    char *cabecera;          /**< TSV: última línea de nombres escrita */
+    int campos;              /**< Campos del registro en construcción */
+    int repetir_cabecera;    /**< TSV: cabecera antes de cada registro */
+} EstadoFormato;
+
+static _Thread_local EstadoFormato estado;
+
+static FormatoSalida formato_inicial = FORMATO_TEXTO;
+
+static void agregar(Buffer *b, const char *s, size_t n) {
+    if (b->len + n + 1 > b->cap) {
+        size_t cap = b->cap ? b->cap : 256;
+        while (cap < b->len + n + 1) cap *= 2;
+        char *nuevo = realloc(b->datos, cap);
+        if (nuevo == NULL) return;   /* Se pierde el campo, no el registro */
+        b->datos = nuevo;
+        b->cap = cap;
+    }
+    memcpy(b->datos + b->len, s, n);
+    b->len += n;
+    b->datos[b->len] = '\0';
+}
+
+static void agregar_c(Buffer *b, char c) {
+    agregar(b, &c, 1);
+}
+
+static void liberar(Buffer *b) {
+    free(b->datos);
+    memset(b, 0, sizeof(*b));
+}
+
+static int es_tsv(void) {
+    return sesion_actual->formato == FORMATO_TSV;
+}
+
+int formato_desde_nombre(const char *nombre) {
+    if (strcmp(nombre, "texto") == 0) return FORMATO_TEXTO;
+    if (strcmp(nombre, "json") == 0) return FORMATO_JSON;
+    if (strcmp(nombre, "tsv") == 0) return FORMATO_TSV;
+    return -1;
+}
+
+void formato_establecer_global(FormatoSalida f) {
+    formato_inicial = f;
+    sesion_actual->formato = f;
+}
+
+FormatoSalida formato_global(void) {
+    return formato_inicial;
+}
+
+int formato_estructurado(void) {
+    return sesion_actual->formato != FORMATO_TEXTO;
+}
+
+int formato_separar_opcion(char **args) {
+    int formato = -1;
+    int j = 0;
+    for (int i = 0; args[i] != NULL; i++) {
+        const char *valor;
+        if (strcmp(args[i], "--formato") == 0) {
+            valor = args[i + 1];
+            if (valor != NULL) i++;
+        } else if (strncmp(args[i], "--formato=", 10) == 0) {
+            valor = args[i] + 10;
+        } else {
+            args[j++] = args[i];
+            continue;
+        }
+        if (valor == NULL || (formato = formato_desde_nombre(valor)) < 0) {
+            imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET
+                           " '--formato' espera texto, json o tsv.\n");
+            return -2;
+        }
+    }
+    args[j] = NULL;
+    return formato;
+}
+
+/* =============================================================================
+ * Registros
+ * ========================================================================== */
+
+/** @brief Escribe un valor escapado según el formato. */
+static void agregar_escapado(Buffer *b, const char *s, size_t n) {
+    int tsv = es_tsv();
+    size_t ini = 0;
+    for (size_t i = 0; i < n; i++) {
+        unsigned char c = (unsigned char)s[i];
+        const char *esc = NULL;
+        char hex[8];
+        if (c == '\\') esc = "\\\\";
+        else if (c == '\t') esc = "\\t";
+        else if (c == '\n') esc = "\\n";
+        else if (c == '\r') esc = "\\r";
+        else if (c == '"' && !tsv) esc = "\\\"";
+        else if (c < 0x20 && !tsv) {
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            esc = hex;
+        }
+        if (esc != NULL) {
+            agregar(b, s + ini, i - ini);
+            agregar(b, esc, strlen(esc));
+            ini = i + 1;
+        }
+    }
+    agregar(b, s + ini, n - ini);
+}
+
+/** @brief Separador y nombre del campo siguiente. */
+static void abrir_campo(const char *clave) {
+    if (es_tsv()) {
+        if (estado.campos > 0) {
+            agregar_c(&estado.registro, '\t');
+            agregar_c(&estado.claves, '\t');
+        }
+        agregar_escapado(&estado.claves, clave, strlen(clave));
+    } else {
+        if (estado.campos > 0) agregar_c(&estado.registro, ',');
+        agregar_c(&estado.registro, '"');
+        agregar_escapado(&estado.registro, clave, strlen(clave));
+        agregar(&estado.registro, "\":", 2);
+    }
+    estado.campos++;
+}
+
+FILE *formato_destino(void) {
+    return (estado.mensajes != NULL) ? estado.mensajes->destino : salida_sesion();
+}
+
+void registro_abrir(void) {
+    estado.registro.len = 0;
+    estado.claves.len = 0;
+    estado.campos = 0;
+    if (!es_tsv()) agregar_c(&estado.registro, '{');
+}
+
+void registro_texto_n(const char *clave, const char *valor, size_t len) {
+    abrir_campo(clave);
+    if (!es_tsv()) agregar_c(&estado.registro, '"');
+    agregar_escapado(&estado.registro, valor, len);
+    if (!es_tsv()) agregar_c(&estado.registro, '"');
+}
+
+void registro_texto(const char *clave, const char *valor) {
+    registro_texto_n(clave, valor, strlen(valor));
+}
+
+void registro_entero(const char *clave, long long valor) {
+    char num[32];
+    int n = snprintf(num, sizeof(num), "%lld", valor);
+    abrir_campo(clave);
+    agregar(&estado.registro, num, (size_t)n);
+}
+
+void registro_real(const char *clave, double valor) {
+    char num[32];
+    int n;
+    if (isfinite(valor)) {
+        n = snprintf(num, sizeof(num), "%.15g", valor);
+    } else {
+        n = snprintf(num, sizeof(num), "%s", es_tsv() ? "" : "null");
+    }
+    abrir_campo(clave);
+    agregar(&estado.registro, num, (size_t)n);
+}
+
+/**
+ * @brief Termina el registro en construcción y lo escribe en 'destino'.
+ * @param repetir TSV: escribir la cabecera aunque no haya cambiado.
+ */
+static void escribir_registro(FILE *destino, int repetir) {
+    if (es_tsv()) {
+        /* Cabecera antes del primer registro y cada vez que cambian las claves */
+        const char *claves = estado.claves.datos ? estado.claves.datos : "";
+        if (repetir) {
+            fprintf(destino, "%s\n", claves);
+        } else if (estado.cabecera == NULL || strcmp(estado.cabecera, claves) != 0) {
+            free(estado.cabecera);
+            estado.cabecera = strdup(claves);
+            fprintf(destino, "%s\n", claves);
+        }
+    } else {
+        agregar_c(&estado.registro, '}');
+    }
+    agregar_c(&estado.registro, '\n');
+    fwrite(estado.registro.datos, 1, estado.registro.len, destino);
+}
+
+void registro_cerrar(void) {
+    escribir_registro(formato_destino(), estado.repetir_cabecera);
+}
+
+void formato_cabeceras_repetidas(int activar) {
+    estado.repetir_cabecera = activar;
+}
+
+void formato_reenviar(const char *datos, size_t len) {
+    FILE *destino = formato_destino();
+    if (!es_tsv()) {
+        fwrite(datos, 1, len, destino);
+        return;
+    }
+    /* Pares cabecera/valores: la cabecera solo se escribe si cambió */
+    const char *p = datos, *fin = datos + len;
+    while (p < fin) {
+        const char *nl = memchr(p, '\n', (size_t)(fin - p));
+        const char *valores = nl ? nl + 1 : fin;
+        const char *nl2 = (valores < fin) ? memchr(valores, '\n', (size_t)(fin - valores)) : NULL;
+        const char *siguiente = nl2 ? nl2 + 1 : fin;
+        size_t lc = (size_t)((nl ? nl : fin) - p);
+        if (estado.cabecera == NULL || strlen(estado.cabecera) != lc ||
+            memcmp(estado.cabecera, p, lc) != 0) {
+            free(estado.cabecera);
+            estado.cabecera = strndup(p, lc);
+            fprintf(destino, "%.*s\n", (int)lc, p);
+        }
+        fwrite(valores, 1, (size_t)(siguiente - valores), destino);
+        p = siguiente;
+    }
+}
+
+/* =============================================================================
+ * Conversión de texto a registros
+ * ========================================================================== */
+
+/** @brief 1 si el código es un icono o un carácter de dibujo (se descarta). */
+static int es_decoracion(unsigned cp) {
+    return (cp >= 0x2190 && cp <= 0x21FF)     /* Flechas */
+        || (cp >= 0x2500 && cp <= 0x259F)     /* Cajas y bloques */
+        || (cp >= 0x2600 && cp <= 0x27BF)     /* Símbolos y dingbats */
+        || (cp >= 0x1F000 && cp <= 0x1FFFF)   /* Emoji */
+        || cp == 0xFE0F || cp == 0x200D;      /* Selector de variante, ZWJ */
+}
+
+/**
+ * @brief Quita secuencias ANSI y decoración de una línea, en el lugar.
+ * @return Nueva longitud.
+ */
+static size_t limpiar_linea(char *s, size_t n) {
+    size_t j = 0;
+    for (size_t i = 0; i < n;) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == 0x1B) {
+            /* ESC [ parámetros... letra final (0x40-0x7E) */
+            i++;
+            if (i < n && s[i] == '[') {
+                i++;
+                while (i < n && ((unsigned char)s[i] < 0x40 || (unsigned char)s[i] > 0x7E)) i++;
+            }
+            i++;
+            continue;
+        }
+        size_t largo = (c < 0x80) ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 1;
+        if (i + largo > n) largo = n - i;
+        unsigned cp = c;
+        if (largo == 2) cp = ((c & 0x1Fu) << 6) | (s[i + 1] & 0x3Fu);
+        else if (largo == 3) cp = ((c & 0x0Fu) << 12) | ((s[i + 1] & 0x3Fu) << 6) | (s[i + 2] & 0x3Fu);
+        else if (largo == 4) cp = ((c & 0x07u) << 18) | ((s[i + 1] & 0x3Fu) << 12)
+                                | ((s[i + 2] & 0x3Fu) << 6) | (s[i + 3] & 0x3Fu);
+        if (c == '\r' || (largo > 1 && es_decoracion(cp))) {
+            i += largo;
+            continue;
+        }
+        memmove(s + j, s + i, largo);
+        j += largo;
+        i += largo;
+    }
+    return j;
+}
+
+/** @brief Convierte una línea de texto en un registro (las vacías se descartan). */
+static void emitir_linea(FlujoMensajes *f) {
+    Buffer *l = &f->linea;
+    size_t n = (l->len > 0) ? limpiar_linea(l->datos, l->len) : 0;
+    char *s = l->datos;
+    l->len = 0;
+
+    static const struct { const char *etiqueta; const char *clave; } etiquetas[] = {
+        { "[ERROR]", "error" }, { "[AVISO]", "aviso" }, { "[INFO]", "mensaje" },
+        { "[OK]", "mensaje" },  { "Uso:", "uso" },
+    };
+    const char *clave = "mensaje";
+    for (int pasada = 0; pasada < 2; pasada++) {
+        while (n > 0 && (*s == ' ' || *s == '\t')) { s++; n--; }
+        while (n > 0 && (s[n - 1] == ' ' || s[n - 1] == '\t')) n--;
+        if (pasada == 1) break;
+        for (size_t e = 0; e < sizeof(etiquetas) / sizeof(etiquetas[0]); e++) {
+            size_t le = strlen(etiquetas[e].etiqueta);
+            if (n >= le && memcmp(s, etiquetas[e].etiqueta, le) == 0) {
+                clave = etiquetas[e].clave;
+                s += le;
+                n -= le;
+                break;
+            }
+        }
+    }
+    if (n == 0) return;
+    registro_abrir();
+    registro_texto_n(clave, s, n);
+    /* En el stream de errores cada registro lleva su cabecera: la última
+     * escrita es la de la salida */
+    escribir_registro(f->destino, estado.repetir_cabecera || f == estado.errores);
+}
+
+static ssize_t escribir_mensajes(void *cookie, const char *buf, size_t n) {
+    FlujoMensajes *f = cookie;
+    size_t ini = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (buf[i] == '\n') {
+            agregar(&f->linea, buf + ini, i - ini);
+            emitir_linea(f);
+            ini = i + 1;
+        }
+    }
+    agregar(&f->linea, buf + ini, n - ini);
+    return (ssize_t)n;
+}
+
+static int cerrar_mensajes(void *cookie) {
+    FlujoMensajes *f = cookie;
+    if (f->linea.len > 0) {
+        emitir_linea(f);
+    }
+    return 0;
+}
+
+/** @brief Crea un flujo que convierte en registros lo que se escribe en él. */
+static FlujoMensajes *crear_flujo(FILE *destino) {
+    FlujoMensajes *f = calloc(1, sizeof(*f));
+    if (f == NULL) return NULL;
+    cookie_io_functions_t funciones = { .write = escribir_mensajes, .close = cerrar_mensajes };
+    f->flujo = fopencookie(f, "w", funciones);
+    if (f->flujo == NULL) {
+        free(f);
+        return NULL;
+    }
+    /* Sin buffer: cada imprimir() se convierte antes del registro siguiente */
+    setvbuf(f->flujo, NULL, _IONBF, 0);
+    f->destino = destino;
+    return f;
+}
+
+FILE *formato_comenzar_comando(void) {
+    if (estado.mensajes != NULL && salida_sesion() == estado.mensajes->flujo) {
+        return NULL;   /* Un comando dentro de otro: ya se está convirtiendo */
+    }
+    FlujoMensajes *f = crear_flujo(salida_sesion());
+    if (f == NULL) return NULL;
+    f->anterior = sesion_actual->salida;
+    f->errores_anterior = sesion_actual->errores;
+    /* Los errores también se convierten: en el mismo flujo si comparten
+     * stream con la salida (&>, el servidor), si no en uno propio */
+    if (errores_sesion() == f->destino) {
+        sesion_actual->errores = f->flujo;
+    } else if ((estado.errores = crear_flujo(errores_sesion())) != NULL) {
+        sesion_actual->errores = estado.errores->flujo;
+    }
+    sesion_actual->salida = f->flujo;
+    estado.mensajes = f;
+    free(estado.cabecera);
+    estado.cabecera = NULL;
+    return f->flujo;
+}
+
+void formato_terminar_comando(FILE *mensajes) {
+    FlujoMensajes *f = estado.mensajes;
+    if (mensajes == NULL || f == NULL || f->flujo != mensajes) {
+        return;
+    }
+    fclose(mensajes);   /* Emite la última línea si quedó sin '\n' */
+    if (estado.errores != NULL) {
+        fclose(estado.errores->flujo);
+        liberar(&estado.errores->linea);
+        free(estado.errores);
+        estado.errores = NULL;
+    }
+    sesion_actual->salida = f->anterior;
+    sesion_actual->errores = f->errores_anterior;
+    estado.mensajes = NULL;
+    liberar(&f->linea);
+    free(f);
+    liberar(&estado.registro);
+    liberar(&estado.claves);
+    free(estado.cabecera);
+    estado.cabecera = NULL;
+}
@@ -0,0 +1,330 @@
+/**
+ * @file hash.c
+ * @brief CRC32C (SSE4.2 o tabla) y XXH64.
+ *
+ * CRC32C por hardware: la instrucción crc32 procesa 8 bytes por ciclo pero
+ * tiene una latencia de 3 ciclos, así que un solo flujo dejaría la unidad
+ * ociosa 2 de cada 3 ciclos. Por eso se calculan tres CRC independientes
+ * sobre tres bloques consecutivos y luego se unen desplazando los dos
+ * primeros con tablas precalculadas (4 consultas por unión).
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include "hash.h"
+
+#if defined(__x86_64__)
+#  include <immintrin.h>
+#  define HAY_CRC_HW 1
+#endif
+
+/* =============================================================================
+ * CRC32C
+ * ========================================================================== */
+
+/** @brief Polinomio de Castagnoli, en forma reflejada. */
+#define POLI_CRC32C 0x82F63B78u
+
+/** @brief Tamaño de cada uno de los tres bloques intercalados por hardware. */
+#define BLOQUE_INTERCALADO 8192
+
+/** @brief Tablas slicing-by-8 (respaldo por software). */
+static uint32_t tabla_crc[8][256];
+
+/** @brief Desplaza un registro CRC BLOQUE_INTERCALADO bytes (un byte por tabla). */
+static uint32_t tabla_desplazar[4][256];
+
+static pthread_once_t tablas_listas = PTHREAD_ONCE_INIT;
+
+/** @brief Multiplica una matriz 32x32 sobre GF(2) por un vector. */
+static uint32_t gf2_por_vector(const uint32_t *matriz, uint32_t v) {
+    uint32_t suma = 0;
+    for (; v != 0; v >>= 1, matriz++) {
+        if (v & 1) suma ^= *matriz;
+    }
+    return suma;
+}
+
+/** @brief cuadrado = matriz * matriz. */
+static void gf2_cuadrado(uint32_t *cuadrado, const uint32_t *matriz) {
+    for (int i = 0; i < 32; i++) {
+        cuadrado[i] = gf2_por_vector(matriz, matriz[i]);
+    }
+}
+
+uint32_t crc32c_combinar(uint32_t crc_a, uint32_t crc_b, uint64_t long_b) {
+    if (long_b == 0) {
+        return crc_a;
+    }
+    uint32_t par[32], impar[32];
+
+    /* Operador para un bit cero; luego se eleva al cuadrado: 2, 4, 8... bits */
+    impar[0] = POLI_CRC32C;
+    for (int i = 1; i < 32; i++) {
+        impar[i] = 1u << (i - 1);
+    }
+    gf2_cuadrado(par, impar);   /* 2 bits */
+    gf2_cuadrado(impar, par);   /* 4 bits */
+
+    /* Cada iteración duplica el desplazamiento: el primero es de un byte */
+    do {
+        gf2_cuadrado(par, impar);
+        if (long_b & 1) crc_a = gf2_por_vector(par, crc_a);
+        long_b >>= 1;
+        if (long_b == 0) break;
+        gf2_cuadrado(impar, par);
+        if (long_b & 1) crc_a = gf2_por_vector(impar, crc_a);
+        long_b >>= 1;
+    } while (long_b != 0);
+
+    return crc_a ^ crc_b;
+}
+
+/**
+ * @brief Construye las tablas de software y de desplazamiento (una vez).
+ */
+static void construir_tablas(void) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t c = b;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ POLI_CRC32C : c >> 1;
+        }
+        tabla_crc[0][b] = c;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t c = tabla_crc[t - 1][b];
+            tabla_crc[t][b] = (c >> 8) ^ tabla_crc[0][c & 0xff];
+        }
+    }
+
+    /* Columna j del operador = desplazar el vector con solo el bit j */
+    uint32_t columna[32];
+    for (int j = 0; j < 32; j++) {
+        columna[j] = crc32c_combinar(1u << j, 0, BLOQUE_INTERCALADO);
+    }
+    for (int t = 0; t < 4; t++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            tabla_desplazar[t][b] = gf2_por_vector(columna + 8 * t, b);
+        }
+    }
+}
+
+/** @brief Aplica el desplazamiento de BLOQUE_INTERCALADO bytes a un registro. */
+static inline uint32_t desplazar(uint32_t c) {
+    return tabla_desplazar[0][c & 0xff] ^ tabla_desplazar[1][(c >> 8) & 0xff] ^
+           tabla_desplazar[2][(c >> 16) & 0xff] ^ tabla_desplazar[3][c >> 24];
+}
+
+/** @brief Lee 8 bytes little-endian sin requisitos de alineación. */
+static inline uint64_t leer64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+/** @brief Lee 4 bytes little-endian sin requisitos de alineación. */
+static inline uint32_t leer32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+/**
+ * @brief CRC32C por software (slicing-by-8) sobre el registro sin invertir.
+ */
+static uint32_t crc32c_software(uint32_t c, const unsigned char *p, size_t n) {
+    for (; n >= 8; p += 8, n -= 8) {
+        uint64_t v = leer64(p) ^ c;
+        c = tabla_crc[7][v & 0xff] ^ tabla_crc[6][(v >> 8) & 0xff] ^
+            tabla_crc[5][(v >> 16) & 0xff] ^ tabla_crc[4][(v >> 24) & 0xff] ^
+            tabla_crc[3][(v >> 32) & 0xff] ^ tabla_crc[2][(v >> 40) & 0xff] ^
+            tabla_crc[1][(v >> 48) & 0xff] ^ tabla_crc[0][v >> 56];
+    }
+    while (n--) {
+        c = (c >> 8) ^ tabla_crc[0][(c ^ *p++) & 0xff];
+    }
+    return c;
+}
+
+#ifdef HAY_CRC_HW
+
+/**
+ * @brief CRC32C con la instrucción crc32 (SSE4.2), tres flujos intercalados.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hardware(uint32_t c, const unsigned char *p, size_t n) {
+    while (n >= 3 * BLOQUE_INTERCALADO) {
+        uint64_t c0 = c, c1 = 0, c2 = 0;
+        const unsigned char *fin = p + BLOQUE_INTERCALADO;
+        for (; p < fin; p += 8) {
+            c0 = _mm_crc32_u64(c0, leer64(p));
+            c1 = _mm_crc32_u64(c1, leer64(p + BLOQUE_INTERCALADO));
+            c2 = _mm_crc32_u64(c2, leer64(p + 2 * BLOQUE_INTERCALADO));
+        }
+        c = desplazar(desplazar((uint32_t)c0) ^ (uint32_t)c1) ^ (uint32_t)c2;
+        p += 2 * BLOQUE_INTERCALADO;
+        n -= 3 * BLOQUE_INTERCALADO;
+    }
+
+    uint64_t c64 = c;
+    for (; n >= 8; p += 8, n -= 8) {
+        c64 = _mm_crc32_u64(c64, leer64(p));
+    }
+    c = (uint32_t)c64;
+    while (n--) {
+        c = _mm_crc32_u8(c, *p++);
+    }
+    return c;
+}
+
+#endif /* HAY_CRC_HW */
+
+int crc32c_usa_hardware(void) {
+#ifdef HAY_CRC_HW
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+uint32_t crc32c(uint32_t crc, const void *datos, size_t n) {
+    static int usa_hw = -1;
+    pthread_once(&tablas_listas, construir_tablas);
+
+    int hw = __atomic_load_n(&usa_hw, __ATOMIC_RELAXED);
+    if (hw < 0) {
+        hw = crc32c_usa_hardware();
+        __atomic_store_n(&usa_hw, hw, __ATOMIC_RELAXED);
+    }
+
+    /* El registro interno va invertido: CRC32C usa valor inicial y final ~0 */
+    uint32_t c = ~crc;
+#ifdef HAY_CRC_HW
+    if (hw) {
+        return ~crc32c_hardware(c, datos, n);
+    }
+#endif
+    return ~crc32c_software(c, datos, n);
+}
+
+/* =============================================================================
+ * XXH64
+ * ========================================================================== */
+
+static const uint64_t P1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t P3 = 0x165667B19E3779F9ULL;
+static const uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_ronda(uint64_t acc, uint64_t entrada) {
+    acc += entrada * P2;
+    acc = rotl64(acc, 31);
+    return acc * P1;
+}
+
+static inline uint64_t xxh_mezclar(uint64_t acc, uint64_t v) {
+    acc ^= xxh_ronda(0, v);
+    return acc * P1 + P4;
+}
+
+void xxh64_iniciar(EstadoXXH64 *e, uint64_t semilla) {
+    memset(e, 0, sizeof(*e));
+    e->semilla = semilla;
+    e->v[0] = semilla + P1 + P2;
+    e->v[1] = semilla + P2;
+    e->v[2] = semilla;
+    e->v[3] = semilla - P1;
+}
+
+void xxh64_actualizar(EstadoXXH64 *e, const void *datos, size_t n) {
+    const unsigned char *p = datos;
+    e->total += n;
+
+    /* Completar el bloque de 32 bytes que quedó a medias */
+    if (e->n_resto > 0) {
+        size_t falta = 32 - e->n_resto;
+        if (n < falta) {
+            memcpy(e->resto + e->n_resto, p, n);
+            e->n_resto += n;
+            return;
+        }
+        memcpy(e->resto + e->n_resto, p, falta);
+        for (int i = 0; i < 4; i++) {
+            e->v[i] = xxh_ronda(e->v[i], leer64(e->resto + 8 * i));
+        }
+        p += falta;
+        n -= falta;
+        e->n_resto = 0;
+    }
+
+    /* Bucle principal: 4 acumuladores independientes de 8 bytes */
+    uint64_t v0 = e->v[0], v1 = e->v[1], v2 = e->v[2], v3 = e->v[3];
+    for (; n >= 32; p += 32, n -= 32) {
+        v0 = xxh_ronda(v0, leer64(p));
+        v1 = xxh_ronda(v1, leer64(p + 8));
+        v2 = xxh_ronda(v2, leer64(p + 16));
+        v3 = xxh_ronda(v3, leer64(p + 24));
+    }
+    e->v[0] = v0; e->v[1] = v1; e->v[2] = v2; e->v[3] = v3;
+
+    memcpy(e->resto, p, n);
+    e->n_resto = n;
+}
+
+uint64_t xxh64_final(const EstadoXXH64 *e) {
+    uint64_t h;
+    if (e->total >= 32) {
+        h = rotl64(e->v[0], 1) + rotl64(e->v[1], 7) + rotl64(e->v[2], 12) + rotl64(e->v[3], 18);
+        for (int i = 0; i < 4; i++) {
+            h = xxh_mezclar(h, e->v[i]);
+        }
+    } else {
+        h = e->semilla + P5;
+    }
+    h += e->total;
+
+    const unsigned char *p = e->resto;
+    size_t n = e->n_resto;
+    for (; n >= 8; p += 8, n -= 8) {
+        h ^= xxh_ronda(0, leer64(p));
+        h = rotl64(h, 27) * P1 + P4;
+    }
+    if (n >= 4) {
+        h ^= (uint64_t)leer32(p) * P1;
+        h = rotl64(h, 23) * P2 + P3;
+        p += 4;
+        n -= 4;
+    }
+    while (n--) {
+        h ^= (*p++) * P5;
+        h = rotl64(h, 11) * P1;
+    }
+
+    /* Avalancha final */
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64(const void *datos, size_t n, uint64_t semilla) {
+    EstadoXXH64 e;
+    xxh64_iniciar(&e, semilla);
+    xxh64_actualizar(&e, datos, n);
+    return xxh64_final(&e);
+}
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "help.h"
+#include "shell.h"    /* imprimir(), sesion_actual */
 #include "colors.h"
 
 /**
@@ -20,17 +21,17 @@
 CommandHelp tabla_ayuda[] = {
     {
         "listar",
-        "Lista todos los archivos y directorios del directorio actual.",
-        "listar",
-        "listar",
-        "Equivalente a 'ls' en Unix. No acepta argumentos adicionales por ahora."
+        "Lista todos los archivos y directorios del directorio actual (o del indicado).",
+        "listar [directorio]",
+        "listar\nlistar src",
+        "Equivalente a 'ls' en Unix. Las rutas relativas parten del directorio de la sesión (ver cd)."
     },
     {
         "leer",
-        "Muestra el contenido completo de un archivo de texto en pantalla.",
-        "leer <nombre_archivo>",
-        "leer README.md",
-        "El archivo debe existir y ser legible. Similar al comando 'cat' de Unix."
+        "Muestra el contenido completo de uno o varios archivos de texto en pantalla, o solo sus primeras o últimas líneas.",
+        "leer [-n N | -t N | -p] [-f] <nombre_archivo> [archivo...]",
+        "leer README.md\nleer a.txt b.txt c.txt\nleer -t 100 app.log\nleer -f app.log\nleer -p enorme.log",
+        "El archivo debe existir y ser legible. Similar al comando 'cat' de Unix.\nCon varios archivos, las lecturas se agrupan en lotes (io_uring si está disponible).\n-n N: primeras N líneas (como head). -t N: últimas N líneas (como tail); el archivo se lee hacia atrás desde el final, así que en archivos enormes solo se leen unos KB.\n-f: sigue mostrando lo que se añada a un archivo (últimas 10 líneas si no se da -t) hasta Ctrl+C; espera con inotify, sin sondeo.\n-p: paginador. Espacio/b: página siguiente/anterior, j/k o flechas: línea, g/G: inicio/final, :N o :N%: ir a una línea o a un porcentaje, /texto y ?texto: buscar hacia adelante/atrás, n/N: repetir, q: salir. Abre al instante archivos de cualquier tamaño."
     },
     {
         "tiempo",
@@ -62,10 +63,10 @@ CommandHelp tabla_ayuda[] = {
     },
     {
         "buscar",
-        "Busca una cadena de texto dentro de un archivo línea por línea.",
-        "buscar <texto> <nombre_archivo>",
-        "buscar hola notas.txt",
-        "Muestra el número de línea y el contenido donde se encontró el texto.\nLa búsqueda es sensible a mayúsculas/minúsculas."
+        "Busca una cadena de texto (o una expresión regular con -e) línea por línea dentro de archivos o directorios.",
+        "buscar [-e] <texto|patrón> <archivo|directorio> [...]\nbuscar [-e] <texto|patrón> < archivo",
+        "buscar hola notas.txt\nbuscar error logs/\nbuscar -e ^(GET|POST)\\s/api/v[0-9]+ logs/",
+        "Muestra el número de línea y el contenido donde se encontró el texto.\nLos directorios se recorren recursivamente; con varios archivos se indica el archivo de cada coincidencia.\nLa búsqueda es sensible a mayúsculas/minúsculas.\n-e admite . [...] [^...] * + ? {m,n} | (...) ^ $ y \\d \\w \\s (\\s en lugar de espacios). El tiempo es siempre lineal en el tamaño de los archivos."
     },
     {
         "limpiar",
@@ -94,12 +95,172 @@ CommandHelp tabla_ayuda[] = {
         "salir",
         "salir",
         "Devuelve el código de salida 0 al sistema operativo (EXIT_SUCCESS)."
+    },
+    {
+        "contar",
+        "Cuenta líneas, palabras y bytes de uno o varios archivos, como wc en Unix.",
+        "contar [-l] [-w] [-c] <archivo> [archivo...]\ncontar [-l] [-w] [-c] < archivo",
+        "contar app.log\ncontar -l *.log",
+        "-l: solo líneas, -w: solo palabras, -c: solo bytes (por defecto, las tres).\nLos archivos se mapean en memoria y se cuentan en trozos paralelos con SIMD (SSE2/AVX2).\nCon varios archivos se muestra además el total."
+    },
+    {
+        "checksum",
+        "Calcula sumas de verificación de archivos o directorios completos (recursivamente) en paralelo, y verifica un directorio contra un manifiesto guardado.",
+        "checksum [-a crc32c|xxh64] [-o manifiesto] <ruta...>\nchecksum --verificar <manifiesto> [directorio...]",
+        "checksum -o datos.sum datos/\nchecksum --verificar datos.sum datos/",
+        "CRC32C (por defecto) usa la instrucción crc32 de SSE4.2 si existe; XXH64 es un hash de 64 bits.\nLos archivos de más de 8 MB se parten en trozos que se suman en paralelo: el CRC32C es el mismo que el de todo el archivo; el XXH64 es un hash en árbol (XXH64 de las sumas de los trozos).\n--verificar informa FALLO, FALTA y, si se dan directorios, NUEVO (archivos que no están en el manifiesto)."
+    },
+    {
+        "uso",
+        "Mide en paralelo el espacio que ocupan uno o varios árboles de directorios y muestra los directorios más grandes, ordenados por tamaño.",
+        "uso [-b] [-n N] [ruta...]",
+        "uso\nuso -n 5 /var/log",
+        "Sin rutas mide el directorio actual. -b: tamaño aparente en bytes (por defecto, espacio en disco). -n N: cuántos directorios mostrar (20 por defecto).\nLos archivos con varios enlaces duros se cuentan una sola vez. Los enlaces simbólicos no se siguen."
+    },
+    {
+        "vigilar",
+        "Espera cambios en un archivo o directorio y los muestra, o vuelve a ejecutar un comando cada vez que ocurren.",
+        "vigilar [-r] [-d ms] [-n N] <ruta> [comando...]",
+        "vigilar notas.txt\nvigilar -r src contar -l src/main.c",
+        "-r: incluye los subdirectorios (fanotify si hay privilegios; si no, inotify por directorio). -d: ms sin cambios antes de reaccionar (200 por defecto). -n: termina tras N reacciones.\nNo consulta el disco periódicamente: se bloquea hasta que el kernel notifica un cambio. Los eventos seguidos se agrupan en una sola reacción.\nCtrl+C termina la vigilancia sin salir de la shell."
+    },
+    {
+        "indexar",
+        "Crea o actualiza el índice de trigramas de un directorio. Después, buscar en ese directorio solo lee los archivos que pueden contener el texto.",
+        "indexar <directorio>",
+        "indexar logs\nbuscar \"timeout\" logs",
+        "El índice se guarda en <directorio>/.eafitos_indice. Reindexar solo vuelve a leer los archivos nuevos o modificados.\nLos archivos que cambiaron después de indexar se revisan siempre, así que buscar nunca pierde resultados; solo deja de ahorrar. Textos de menos de 3 caracteres no usan el índice."
+    },
+    {
+        "ordenar",
+        "Ordena las líneas de uno o varios archivos. Lo que no cabe en la memoria permitida se ordena por partes en archivos temporales y se mezcla al final, así que sirve para archivos más grandes que la RAM.",
+        "ordenar [-n] [-r] [-u] [-k campo] [-m MB] [-o salida] <archivo...>\nordenar [opciones] < archivo",
+        "ordenar nombres.txt\nordenar -n -r -k 3 ventas.csv\nordenar -u -m 512 -o limpio.log enorme.log",
+        "-n: orden numérico. -r: descendente. -u: una línea por clave. -k N: la clave empieza en el campo N (separados por espacios). -m: memoria máxima en MB (64 por defecto). -o: escribe en un archivo (puede ser el de entrada).\nLas partes se ordenan en paralelo y se mezclan con un árbol de perdedores. Los temporales van a $TMPDIR (o /tmp) y se borran solos."
+    },
+    {
+        "paralelo",
+        "Ejecuta en paralelo una lista de líneas de comando (una por línea, de un archivo o de la entrada) y muestra la salida de cada una completa y en el orden de la lista.",
+        "paralelo [-j N] [archivo_de_comandos]",
+        "paralelo -j 8 lote.txt\nparalelo",
+        "-j N: cuántas líneas a la vez (por defecto, una por núcleo). Sin archivo, lee líneas hasta Ctrl+D. Se ignoran las líneas vacías y las que empiezan con #.\nLos comandos de la shell corren en hilos, cada uno con su propia sesión (mismo directorio y prompt); cualquier otro nombre se ejecuta como programa externo. La salida de cada línea se guarda aparte y se muestra en cuanto esa línea y todas las anteriores terminaron.\nLos programas que terminan con un código distinto de 0 se indican al final de su salida."
+    },
+    {
+        "medir",
+        "Ejecuta un comando de la shell o un programa externo y muestra el tiempo real, el tiempo de CPU, la memoria máxima, los fallos de página y los cambios de contexto; si el sistema lo permite, también ciclos, instrucciones y fallos de caché.",
+        "medir [-r N] <comando> [argumentos...]",
+        "medir contar grande.log\nmedir -r 10 buscar TODO src\nmedir --formato json ls -l",
+        "-r N: repite el comando N veces y muestra el mínimo, la mediana y la desviación estándar del tiempo real (los demás valores son promedios). La salida del comando solo se muestra la primera vez.\nLos contadores de hardware se leen con perf_event_open, solo en espacio de usuario (basta con kernel.perf_event_paranoid <= 2) e incluyen los hilos y procesos que cree el comando. En los comandos de la shell el tiempo de CPU y los fallos son los de todo el proceso durante la medición y la memoria máxima es la del proceso. La de un programa externo aparece como 'no disponible' si no supera la de la shell (el kernel no permite separarlas)."
+    },
+    {
+        "limite",
+        "Ejecuta un comando de la shell o un programa externo con un tiempo máximo y/o un tope de memoria; si los supera, lo detiene y avisa.",
+        "limite [-t segundos] [-m MB] <comando> [argumentos...]",
+        "limite -t 5 buscar TODO /srv/logs\nlimite -m 256 ordenar enorme.csv\nlimite -t 0.5 -m 100 ./programa entrada.txt",
+        "-t: segundos (admite decimales). -m: megabytes. Hace falta al menos uno de los dos.\nProgramas externos: el tope de memoria es su espacio de direcciones (RLIMIT_AS); al vencer el plazo reciben SIGTERM y, 2 s después, SIGKILL.\nComandos de la shell: se detienen como con Ctrl+C; del tope se descuentan los buffers que crecen con la entrada (el bloque de ordenar, las líneas largas de buscar).\nEl límite vale para el hilo que ejecuta el comando y sus trabajadores: dentro de paralelo solo detiene su propia línea."
+    },
+    {
+        "memoria",
+        "Muestra el rastreo de memoria de las macros MEM_*: asignaciones, liberaciones, bytes vivos y pico, y los sitios de llamada (archivo:línea) con más memoria viva.",
+        "memoria [-v] [N]",
+        "memoria\nmemoria 25\nmemoria -v\nmemoria --formato json",
+        "N: número de sitios a listar (10 por defecto). -v: lista también los bloques vivos (dirección, tamaño y sitio).\nEl rastreo solo existe si la shell se compiló con make RASTREO_MEMORIA=1; si no, las macros son malloc/free y el comando solo lo avisa. Con el rastreo activo, al salir se listan los bloques que no se liberaron."
+    },
+    {
+        "cd",
+        "Cambia el directorio de trabajo de la sesión. Los comandos de archivos resuelven las rutas relativas contra él.",
+        "cd [ruta | -]",
+        "cd src\ncd ..\ncd -\ncd",
+        "Sin argumentos va a $HOME; con - vuelve al directorio anterior y lo muestra.\nSolo cambia el directorio de la sesión (un descriptor abierto), no el del proceso: en modo servidor cada cliente tiene el suyo y los programas externos se lanzan en él."
+    },
+    {
+        "pwd",
+        "Muestra la ruta canónica del directorio de trabajo de la sesión.",
+        "pwd",
+        "pwd\npwd --formato json",
+        "La ruta se calcula al cambiar de directorio y se guarda en la sesión: pwd no llama a getcwd()."
+    },
+    {
+        "pushd",
+        "Guarda el directorio actual en la pila de directorios y cambia a la ruta indicada; sin argumentos intercambia el directorio actual con la cima de la pila.",
+        "pushd [ruta]",
+        "pushd /var/log\npushd",
+        "Muestra la pila después del cambio (ver dirs). Vuelve con popd."
+    },
+    {
+        "popd",
+        "Saca el último directorio guardado con pushd y cambia a él.",
+        "popd",
+        "pushd /tmp\npopd",
+        "Si la pila está vacía solo avisa. Si el directorio ya no existe, se queda en la pila."
+    },
+    {
+        "dirs",
+        "Muestra el directorio actual (0) y la pila de pushd, de la cima al fondo.",
+        "dirs",
+        "dirs\ndirs --formato json",
+        "pushd y popd muestran la misma lista después de cambiar de directorio."
+    },
+    {
+        "alias",
+        "Sin argumentos lista los alias (los de ~/.eafitosrc y los definidos en la sesión). Con nombre=comando [args] define uno para el resto de la sesión; los argumentos que se escriban después del alias se añaden al final. La expansión es de un solo nivel.",
+        "alias [nombre | nombre=comando [argumentos...]]",
+        "alias ll=listar -l\nalias",
+        "Los alias del rc se leen de una instantánea binaria (~/.eafitosrc.cache) que se regenera sola cuando el rc cambia."
+    },
+    {
+        "export",
+        "Sin argumentos lista las variables (las de ~/.eafitosrc y las definidas en la sesión). Con NOMBRE=valor define una solo para esta sesión: otras sesiones del mismo proceso (clientes del servidor, trabajos de paralelo ya lanzados) no la ven.",
+        "export [NOMBRE=valor]",
+        "export TMPDIR=/scratch\nexport",
+        "Las variables de la sesión tapan a las del rc y a las del entorno. Las usan cd (HOME), ordenar (TMPDIR) y los programas externos que lanzan paralelo, medir y limite."
+    },
+    {
+        "comparar",
+        "Muestra las líneas que cambian de <a> a <b> en formato unificado: bloques @@ con las líneas borradas (-), agregadas (+) y N líneas de contexto. Si los archivos son iguales no escribe nada (en la terminal lo indica).",
+        "comparar [-U N] <archivo_a> <archivo_b>",
+        "comparar viejo.conf nuevo.conf\ncomparar -U 0 app.log app.log.1\ncomparar a.txt b.txt > cambios.patch",
+        "Los archivos se mapean con mmap(); el prefijo y el sufijo comunes se descartan comparando bytes, y solo las líneas intermedias se hashean (XXH64) y se comparan con el algoritmo de Myers en espacio lineal. Dos archivos enormes casi iguales cuestan poco más que leerlos. Con --formato json/tsv devuelve un resumen (líneas borradas y agregadas, bloques). Se puede cancelar con Ctrl+C."
+    },
+    {
+        "reemplazar",
+        "Reemplaza todas las apariciones del texto <buscar> por <reemplazo> en los archivos indicados (los directorios se recorren). Los archivos sin apariciones no se modifican.",
+        "reemplazar <buscar> <reemplazo> <archivo|directorio> [...]",
+        "reemplazar localhost 127.0.0.1 config/\nreemplazar v1.2 v1.3 app.conf cron.conf",
+        "Cada archivo se escribe en un temporal del mismo directorio y se sustituye con rename(): nunca queda un archivo a medio escribir, ni siquiera con Ctrl+C. Los archivos se procesan en paralelo y la búsqueda usa el mismo motor SIMD que buscar. Con --formato json/tsv se emite un registro por archivo."
     }
 };
 
 /** @brief Número de comandos en la tabla (calculado automáticamente). */
 int num_ayudas = sizeof(tabla_ayuda) / sizeof(CommandHelp);
 
+/**
+ * @brief Imprime una entrada de ayuda con formato colorizado.
+ *
+ * La usan tanto los comandos integrados como los plugins (ver plugins.c).
+ *
+ * @param h Entrada de ayuda a mostrar.
+ */
+void imprimir_ayuda(const CommandHelp *h) {
+    imprimir("\n");
+    imprimir(COLOR_CYAN COLOR_BOLD "═══════════════════════════════════════\n" COLOR_RESET);
+    imprimir(COLOR_BOLD " Comando: " COLOR_CYAN "%s\n" COLOR_RESET, h->nombre);
+    imprimir(COLOR_CYAN "═══════════════════════════════════════\n" COLOR_RESET);
+
+    imprimir(COLOR_YELLOW " Descripción:\n" COLOR_RESET);
+    imprimir("   %s\n\n", h->descripcion);
+
+    imprimir(COLOR_YELLOW " Uso:\n" COLOR_RESET);
+    imprimir("   " COLOR_GREEN "%s\n" COLOR_RESET "\n", h->uso);
+
+    imprimir(COLOR_YELLOW " Ejemplo(s):\n" COLOR_RESET);
+    imprimir("   " COLOR_GREEN_N "%s\n" COLOR_RESET "\n", h->ejemplo);
+
+    imprimir(COLOR_YELLOW " Notas:\n" COLOR_RESET);
+    imprimir("   " COLOR_DIM "%s\n" COLOR_RESET, h->notas);
+    imprimir("\n");
+}
+
 /**
  * @brief Busca y muestra la ayuda detallada de un comando específico.
  *
@@ -112,23 +273,7 @@ int num_ayudas = sizeof(tabla_ayuda) / sizeof(CommandHelp);
 int mostrar_ayuda_comando(const char *nombre) {
     for (int i = 0; i < num_ayudas; i++) {
         if (strcmp(nombre, tabla_ayuda[i].nombre) == 0) {
-            printf("\n");
-            printf(COLOR_CYAN COLOR_BOLD "═══════════════════════════════════════\n" COLOR_RESET);
-            printf(COLOR_BOLD " Comando: " COLOR_CYAN "%s\n" COLOR_RESET, tabla_ayuda[i].nombre);
-            printf(COLOR_CYAN "═══════════════════════════════════════\n" COLOR_RESET);
-
-            printf(COLOR_YELLOW " Descripción:\n" COLOR_RESET);
-            printf("   %s\n\n", tabla_ayuda[i].descripcion);
-
-            printf(COLOR_YELLOW " Uso:\n" COLOR_RESET);
-            printf("   " COLOR_GREEN "%s\n" COLOR_RESET "\n", tabla_ayuda[i].uso);
-
-            printf(COLOR_YELLOW " Ejemplo(s):\n" COLOR_RESET);
-            printf("   " COLOR_GREEN_N "%s\n" COLOR_RESET "\n", tabla_ayuda[i].ejemplo);
-
-            printf(COLOR_YELLOW " Notas:\n" COLOR_RESET);
-            printf("   " COLOR_DIM "%s\n" COLOR_RESET, tabla_ayuda[i].notas);
-            printf("\n");
+            imprimir_ayuda(&tabla_ayuda[i]);
             return 1;
         }
     }
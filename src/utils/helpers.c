@@ -1,2 +1,132 @@
-// Placeholders for helper functions
+/**
+ * @file helpers.c
+ * @brief Funciones auxiliares compartidas por varios comandos.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "utils.h"
+#include "cancelacion.h"
+#include "shell.h"   /* errores_sesion */
+#include "colors.h"
+
+int lista_rutas_agregar(ListaRutas *lista, const char *ruta) {
+    if (lista->n == lista->capacidad) {
+        size_t nueva = lista->capacidad ? lista->capacidad * 2 : 64;
+        char **tmp = realloc(lista->rutas, nueva * sizeof(char *));
+        if (tmp == NULL) {
+            return -1;
+        }
+        lista->rutas = tmp;
+        lista->capacidad = nueva;
+    }
+    char *copia = strdup(ruta);
+    if (copia == NULL) {
+        return -1;
+    }
+    lista->rutas[lista->n++] = copia;
+    return 0;
+}
+
+void lista_rutas_liberar(ListaRutas *lista) {
+    for (size_t i = 0; i < lista->n; i++) {
+        free(lista->rutas[i]);
+    }
+    free(lista->rutas);
+    lista->rutas = NULL;
+    lista->n = lista->capacidad = 0;
+}
+
+/**
+ * @brief Lee un directorio: agrega sus archivos y apila sus subdirectorios.
+ *
+ * El directorio se cierra antes de bajar a los hijos, así que el recorrido
+ * mantiene un solo descriptor abierto sea cual sea la profundidad.
+ *
+ * @param prefijo Ruta del directorio (relativa a dir_fd), base de las rutas hijas.
+ * @param pendientes Pila de subdirectorios que falta recorrer.
+ * @return 0, o -1 si no se pudo abrir.
+ */
+static int leer_directorio(int dir_fd, const char *prefijo, ListaRutas *lista,
+                            ListaRutas *pendientes) {
+    int fd = openat(dir_fd, prefijo, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    DIR *d = fdopendir(fd);
+    if (d == NULL) {
+        close(fd);
+        return -1;
+    }
+
+    struct dirent *e;
+    char ruta[PATH_MAX];
+    while (!cancelacion_solicitada() && (e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) {
+            continue;
+        }
+        int largo = snprintf(ruta, sizeof(ruta), "%s/%s", prefijo, e->d_name);
+        if (largo < 0 || (size_t)largo >= sizeof(ruta)) {
+            /* Truncada apuntaría a otro archivo: mejor omitirla y avisar */
+            fprintf(errores_sesion(), MSG_WARN("'%s/%s': ruta demasiado larga, se omite.") "\n",
+                    prefijo, e->d_name);
+            continue;
+        }
+
+        /* d_type evita un stat() por entrada en la mayoría de sistemas de archivos */
+        unsigned char tipo = e->d_type;
+        if (tipo == DT_UNKNOWN) {
+            struct stat st;
+            if (fstatat(dirfd(d), e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            tipo = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (tipo == DT_DIR) {
+            lista_rutas_agregar(pendientes, ruta);
+        } else if (tipo == DT_REG) {
+            lista_rutas_agregar(lista, ruta);
+        }
+    }
+    closedir(d);
+    return 0;
+}
+
+int recolectar_archivos(int dir_fd, const char *ruta, ListaRutas *lista) {
+    struct stat st;
+    if (fstatat(dir_fd, ruta, &st, 0) != 0) {
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return lista_rutas_agregar(lista, ruta);
+    }
+
+    /* Quitamos la '/' final para no generar rutas como "dir//archivo" */
+    char prefijo[PATH_MAX];
+    snprintf(prefijo, sizeof(prefijo), "%s", ruta);
+    size_t len = strlen(prefijo);
+    while (len > 1 && prefijo[len - 1] == '/') {
+        prefijo[--len] = '\0';
+    }
+
+    /* Recorrido con pila propia en vez de recursión (ni pila ni descriptores por nivel) */
+    ListaRutas pendientes = {0};
+    if (leer_directorio(dir_fd, prefijo, lista, &pendientes) != 0) {
+        return -1;
+    }
+    while (pendientes.n > 0) {
+        char *dir = pendientes.rutas[--pendientes.n];
+        if (!cancelacion_solicitada()) {
+            leer_directorio(dir_fd, dir, lista, &pendientes);
+        }
+        free(dir);
+    }
+    lista_rutas_liberar(&pendientes);
+    return 0;
+}
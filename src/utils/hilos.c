@@ -0,0 +1,287 @@
+/**
+ * @file hilos.c
+ * @brief Reparto de tareas entre hilos con un contador atómico.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>      /* clock_gettime */
+#include <unistd.h>    /* sysconf */
+#include <pthread.h>
+#include "hilos.h"
+#include "cancelacion.h"
+#include "configuracion.h" /* variable_obtener (EAFITOS_HILOS) */
+
+/** @brief Estado compartido por los hilos de una llamada. */
+typedef struct {
+    size_t siguiente;  /**< Próxima tarea libre (se incrementa atómicamente) */
+    size_t n_tareas;
+    FuncionTarea fn;
+    void *datos;
+    LimiteComando *limite;   /**< Límite del hilo que reparte (los trabajadores lo heredan) */
+} Reparto;
+
+int hilos_disponibles(void) {
+    const char *env = variable_obtener("EAFITOS_HILOS");
+    if (env != NULL && atoi(env) > 0) {
+        return atoi(env);
+    }
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+/**
+ * @brief Bucle de cada hilo: toma tareas hasta que no quede ninguna.
+ */
+static void *trabajador(void *arg) {
+    Reparto *r = arg;
+    limite_heredar(r->limite);
+    for (;;) {
+        size_t i = __atomic_fetch_add(&r->siguiente, 1, __ATOMIC_RELAXED);
+        if (i >= r->n_tareas) {
+            break;
+        }
+        r->fn(i, r->datos);
+    }
+    return NULL;
+}
+
+void ejecutar_en_paralelo(size_t n_tareas, int max_hilos, FuncionTarea fn, void *datos) {
+    if (n_tareas == 0) {
+        return;
+    }
+    if (max_hilos <= 0) {
+        max_hilos = hilos_disponibles();
+    }
+    size_t n_hilos = (size_t)max_hilos < n_tareas ? (size_t)max_hilos : n_tareas;
+
+    Reparto r = { 0, n_tareas, fn, datos, limite_actual() };
+    pthread_t *hilos = (n_hilos > 1) ? malloc((n_hilos - 1) * sizeof(pthread_t)) : NULL;
+    size_t lanzados = 0;
+
+    /* Lanzamos n_hilos-1 hilos extra: el hilo actual es el n-ésimo */
+    for (size_t i = 0; hilos != NULL && i < n_hilos - 1; i++) {
+        if (pthread_create(&hilos[i], NULL, trabajador, &r) != 0) {
+            break; /* Con menos hilos también se terminan todas las tareas */
+        }
+        lanzados++;
+    }
+
+    trabajador(&r);
+
+    for (size_t i = 0; i < lanzados; i++) {
+        pthread_join(hilos[i], NULL);
+    }
+    free(hilos);
+}
+
+/* =============================================================================
+ * Grupo con robo de trabajo
+ * ========================================================================== */
+
+/**
+ * @brief Cola doble de un hilo.
+ *
+ * El dueño empuja y saca por el final; los ladrones sacan por el inicio.
+ * Un mutex por cola basta: casi siempre solo la usa su dueño, así que el
+ * bloqueo no tiene contención.
+ */
+typedef struct {
+    pthread_mutex_t m;
+    void **tareas;
+    size_t inicio, fin, capacidad;  /**< Elementos válidos: [inicio, fin) */
+} ColaRobo;
+
+struct GrupoRobo {
+    ColaRobo *colas;
+    size_t n_hilos;
+    size_t pendientes;        /**< Encoladas y aún no terminadas (atómico) */
+    int dormidos;             /**< Hilos esperando trabajo (atómico) */
+    pthread_mutex_t m;
+    pthread_cond_t hay_trabajo;
+    FuncionRobo fn;
+    void *datos;
+    LimiteComando *limite;    /**< Límite del hilo que creó el grupo */
+};
+
+/** @brief Contexto de cada hilo del grupo. */
+typedef struct {
+    GrupoRobo *grupo;
+    size_t indice;
+} HiloRobo;
+
+/** @brief Cola del hilo actual (NULL fuera de un grupo). */
+static _Thread_local ColaRobo *cola_propia = NULL;
+
+static int cola_empujar(ColaRobo *c, void *tarea) {
+    pthread_mutex_lock(&c->m);
+    if (c->fin == c->capacidad) {
+        if (c->inicio > 0) {
+            /* Hay hueco al inicio por los robos: compactamos */
+            memmove(c->tareas, c->tareas + c->inicio, (c->fin - c->inicio) * sizeof(void *));
+            c->fin -= c->inicio;
+            c->inicio = 0;
+        } else {
+            size_t nueva = c->capacidad ? c->capacidad * 2 : 256;
+            void **tmp = realloc(c->tareas, nueva * sizeof(void *));
+            if (tmp == NULL) {
+                pthread_mutex_unlock(&c->m);
+                return -1;
+            }
+            c->tareas = tmp;
+            c->capacidad = nueva;
+        }
+    }
+    c->tareas[c->fin++] = tarea;
+    pthread_mutex_unlock(&c->m);
+    return 0;
+}
+
+/** @brief Saca una tarea: del final (dueño) o del inicio (ladrón). */
+static void *cola_sacar(ColaRobo *c, int del_final) {
+    void *t = NULL;
+    pthread_mutex_lock(&c->m);
+    if (c->inicio < c->fin) {
+        t = del_final ? c->tareas[--c->fin] : c->tareas[c->inicio++];
+        if (c->inicio == c->fin) {
+            c->inicio = c->fin = 0;
+        }
+    }
+    pthread_mutex_unlock(&c->m);
+    return t;
+}
+
+int grupo_encolar(GrupoRobo *g, void *tarea) {
+    ColaRobo *c = (cola_propia != NULL) ? cola_propia : &g->colas[0];
+    __atomic_add_fetch(&g->pendientes, 1, __ATOMIC_RELAXED);
+    if (cola_empujar(c, tarea) != 0) {
+        __atomic_sub_fetch(&g->pendientes, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    if (__atomic_load_n(&g->dormidos, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&g->m);
+        pthread_cond_signal(&g->hay_trabajo);
+        pthread_mutex_unlock(&g->m);
+    }
+    return 0;
+}
+
+/**
+ * @brief Bucle de cada hilo: su cola primero, luego robar, luego esperar.
+ */
+static void *trabajador_robo(void *arg) {
+    HiloRobo *h = arg;
+    GrupoRobo *g = h->grupo;
+    cola_propia = &g->colas[h->indice];
+    limite_heredar(g->limite);
+
+    for (;;) {
+        void *t = cola_sacar(cola_propia, 1);
+        for (size_t k = 1; t == NULL && k < g->n_hilos; k++) {
+            t = cola_sacar(&g->colas[(h->indice + k) % g->n_hilos], 0);
+        }
+
+        if (t != NULL) {
+            g->fn(t, g, g->datos);
+            if (__atomic_sub_fetch(&g->pendientes, 1, __ATOMIC_ACQ_REL) == 0) {
+                pthread_mutex_lock(&g->m);
+                pthread_cond_broadcast(&g->hay_trabajo);
+                pthread_mutex_unlock(&g->m);
+            }
+            continue;
+        }
+
+        /* Nada que robar: si aún hay tareas en curso, pueden generar más */
+        pthread_mutex_lock(&g->m);
+        if (__atomic_load_n(&g->pendientes, __ATOMIC_ACQUIRE) == 0) {
+            pthread_mutex_unlock(&g->m);
+            break;
+        }
+        /* La espera tiene límite: un aviso perdido cuesta como mucho 1 ms */
+        struct timespec limite;
+        clock_gettime(CLOCK_REALTIME, &limite);
+        limite.tv_nsec += 1000000;
+        if (limite.tv_nsec >= 1000000000) {
+            limite.tv_sec++;
+            limite.tv_nsec -= 1000000000;
+        }
+        __atomic_add_fetch(&g->dormidos, 1, __ATOMIC_RELAXED);
+        pthread_cond_timedwait(&g->hay_trabajo, &g->m, &limite);
+        __atomic_sub_fetch(&g->dormidos, 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&g->m);
+    }
+
+    cola_propia = NULL;
+    return NULL;
+}
+
+void ejecutar_con_robo(void *const *iniciales, size_t n, int max_hilos,
+                       FuncionRobo fn, void *datos) {
+    if (n == 0) {
+        return;
+    }
+    if (max_hilos <= 0) {
+        max_hilos = hilos_disponibles();
+    }
+
+    GrupoRobo g;
+    memset(&g, 0, sizeof(g));
+    g.n_hilos = (size_t)max_hilos;
+    g.fn = fn;
+    g.datos = datos;
+    g.limite = limite_actual();
+    pthread_mutex_init(&g.m, NULL);
+    pthread_cond_init(&g.hay_trabajo, NULL);
+
+    ColaRobo unica;
+    g.colas = calloc(g.n_hilos, sizeof(ColaRobo));
+    HiloRobo *hilos = calloc(g.n_hilos, sizeof(HiloRobo));
+    pthread_t *ids = calloc(g.n_hilos, sizeof(pthread_t));
+    int sin_memoria = (g.colas == NULL || hilos == NULL || ids == NULL);
+    if (sin_memoria) {
+        /* Sin memoria para el grupo: un solo hilo con una sola cola */
+        free(g.colas);
+        memset(&unica, 0, sizeof(unica));
+        g.colas = &unica;
+        g.n_hilos = 1;
+    }
+    for (size_t i = 0; i < g.n_hilos; i++) {
+        pthread_mutex_init(&g.colas[i].m, NULL);
+    }
+
+    /* Las iniciales se reparten en turno rotatorio entre las colas */
+    for (size_t i = 0; i < n; i++) {
+        g.pendientes++;
+        if (cola_empujar(&g.colas[i % g.n_hilos], iniciales[i]) != 0) {
+            g.pendientes--;
+        }
+    }
+
+    size_t lanzados = 0;
+    for (size_t i = 1; !sin_memoria && i < g.n_hilos; i++) {
+        hilos[i] = (HiloRobo){ &g, i };
+        if (pthread_create(&ids[i], NULL, trabajador_robo, &hilos[i]) != 0) {
+            break; /* Las colas de los hilos no lanzados se vacían por robo */
+        }
+        lanzados = i;
+    }
+
+    HiloRobo propio = { &g, 0 };
+    trabajador_robo(&propio);
+
+    for (size_t i = 1; i <= lanzados; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    for (size_t i = 0; i < g.n_hilos; i++) {
+        pthread_mutex_destroy(&g.colas[i].m);
+        free(g.colas[i].tareas);
+    }
+    if (!sin_memoria) {
+        free(g.colas);
+    }
+    free(hilos);
+    free(ids);
+    pthread_cond_destroy(&g.hay_trabajo);
+    pthread_mutex_destroy(&g.m);
+}
@@ -0,0 +1,819 @@
+/**
+ * @file indice.c
+ * @brief Construcción y consulta del índice de trigramas (ver indice.h).
+ *
+ * Construcción:
+ *  1. Se recolectan los archivos del árbol y se ordenan por nombre; el
+ *     orden define el número de cada archivo.
+ *  2. Los archivos sin cambios (mismo tamaño y mtime) recuperan su conjunto
+ *     de trigramas invirtiendo las listas del índice anterior; el resto se
+ *     lee en paralelo.
+ *  3. Se cuentan los archivos por trigrama en una tabla hash, se reparten
+ *     los números de archivo (recorriendo los archivos en orden, cada lista
+ *     queda ordenada) y se codifican como diferencias varint.
+ *  4. Se escribe en un temporal y se renombra, para que un `buscar`
+ *     concurrente nunca vea un índice a medio escribir.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "indice.h"
+#include "hilos.h"
+#include "utils.h"
+#include "cancelacion.h"
+
+#define INDICE_TEMPORAL INDICE_NOMBRE ".tmp"
+#define INDICE_VERSION  1
+
+/** @brief Archivos hasta este tamaño se procesan ordenando sus trigramas. */
+#define LIMITE_ORDENAR (64 * 1024)
+
+/** @brief Trigramas posibles (3 bytes). */
+#define TOTAL_TRIGRAMAS (1u << 24)
+
+static const char MAGIA[8] = {'E', 'A', 'F', 'I', 'D', 'X', '1', '\n'};
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t n_archivos;
+    uint32_t n_trigramas;
+    uint32_t reservado;
+    uint64_t off_archivos;
+    uint64_t off_trigramas;
+    uint64_t off_listas;
+    uint64_t off_nombres;
+    uint64_t tam_total;
+} Cabecera;
+
+/** @brief mtime de un archivo que no se pudo leer: nunca está vigente. */
+#define MTIME_SIN_LEER INT64_MIN
+
+typedef struct {
+    uint64_t tam;
+    int64_t mtime_ns;      /**< MTIME_SIN_LEER si no se pudo leer al indexar */
+    uint32_t off_nombre;   /**< Relativo a off_nombres */
+    uint32_t largo_nombre;
+} EntradaArchivo;
+
+typedef struct {
+    uint32_t trigrama;
+    uint32_t n_archivos;
+    uint64_t off_lista;    /**< Relativo a off_listas */
+} EntradaTrigrama;
+
+struct Indice {
+    const unsigned char *base;
+    size_t tam;
+    const Cabecera *cab;
+    const EntradaArchivo *archivos;
+    const EntradaTrigrama *trigramas;
+    const unsigned char *listas;
+    size_t tam_listas;
+    const char *nombres;
+};
+
+/** @brief Conjunto ordenado de trigramas de un archivo. */
+typedef struct {
+    uint32_t *v;
+    size_t n;
+} Trigramas;
+
+static inline uint32_t trigrama_en(const unsigned char *p) {
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+static int64_t mtime_ns(const struct stat *st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+/** @brief Longitud de la ruta del directorio sin las '/' finales. */
+static size_t largo_prefijo(const char *dir) {
+    size_t len = strlen(dir);
+    while (len > 1 && dir[len - 1] == '/') {
+        len--;
+    }
+    return len;
+}
+
+/* =============================================================================
+ * Varint
+ * ========================================================================== */
+
+static size_t varint_escribir(unsigned char *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+/** @return Bytes consumidos, o 0 si la entrada está truncada o dañada. */
+static size_t varint_leer(const unsigned char *p, const unsigned char *fin, uint32_t *v) {
+    uint32_t r = 0;
+    for (size_t i = 0; i < 5 && p + i < fin; i++) {
+        r |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *v = r;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Decodifica la lista de un trigrama.
+ * @param salida Arreglo de al menos e->n_archivos posiciones.
+ * @return 0, o -1 si la lista está dañada.
+ */
+static int decodificar_lista(const Indice *ix, const EntradaTrigrama *e, uint32_t *salida) {
+    if (e->off_lista > ix->tam_listas) return -1;
+    const unsigned char *p = ix->listas + e->off_lista;
+    const unsigned char *fin = ix->listas + ix->tam_listas;
+    uint32_t actual = 0;
+    for (uint32_t i = 0; i < e->n_archivos; i++) {
+        uint32_t delta;
+        size_t n = varint_leer(p, fin, &delta);
+        if (n == 0) return -1;
+        p += n;
+        actual += delta;
+        if (actual >= ix->cab->n_archivos) return -1;
+        salida[i] = actual;
+    }
+    return 0;
+}
+
+/* =============================================================================
+ * Lectura del índice
+ * ========================================================================== */
+
+Indice *indice_abrir(int dir_fd, const char *dir) {
+    char ruta[4096];
+    snprintf(ruta, sizeof(ruta), "%.*s/%s", (int)largo_prefijo(dir), dir, INDICE_NOMBRE);
+    int fd = openat(dir_fd, ruta, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Cabecera)) {
+        close(fd);
+        return NULL;
+    }
+    void *mapa = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) {
+        return NULL;
+    }
+
+    /* Validamos la cabecera y que cada sección quepa en el archivo */
+    size_t tam = (size_t)st.st_size;
+    const Cabecera *c = mapa;
+    int valido = memcmp(c->magia, MAGIA, sizeof(MAGIA)) == 0 &&
+                 c->version == INDICE_VERSION && c->tam_total == tam &&
+                 c->off_archivos + (uint64_t)c->n_archivos * sizeof(EntradaArchivo) <= c->off_trigramas &&
+                 c->off_trigramas + (uint64_t)c->n_trigramas * sizeof(EntradaTrigrama) <= c->off_listas &&
+                 c->off_listas <= c->off_nombres && c->off_nombres <= tam;
+    Indice *ix = valido ? malloc(sizeof(Indice)) : NULL;
+    if (ix == NULL) {
+        munmap(mapa, tam);
+        return NULL;
+    }
+    ix->base = mapa;
+    ix->tam = tam;
+    ix->cab = c;
+    ix->archivos = (const EntradaArchivo *)(ix->base + c->off_archivos);
+    ix->trigramas = (const EntradaTrigrama *)(ix->base + c->off_trigramas);
+    ix->listas = ix->base + c->off_listas;
+    ix->tam_listas = c->off_nombres - c->off_listas;
+    ix->nombres = (const char *)(ix->base + c->off_nombres);
+
+    size_t tam_nombres = tam - c->off_nombres;
+    for (uint32_t i = 0; i < c->n_archivos; i++) {
+        const EntradaArchivo *a = &ix->archivos[i];
+        if ((uint64_t)a->off_nombre + a->largo_nombre >= tam_nombres ||
+            ix->nombres[a->off_nombre + a->largo_nombre] != '\0') {
+            indice_cerrar(ix);
+            return NULL;
+        }
+    }
+    return ix;
+}
+
+void indice_cerrar(Indice *ix) {
+    if (ix == NULL) return;
+    munmap((void *)ix->base, ix->tam);
+    free(ix);
+}
+
+size_t indice_n_archivos(const Indice *ix) {
+    return ix->cab->n_archivos;
+}
+
+long indice_buscar_archivo(const Indice *ix, const char *relativa) {
+    size_t lo = 0, hi = ix->cab->n_archivos;
+    while (lo < hi) {
+        size_t medio = lo + (hi - lo) / 2;
+        int cmp = strcmp(ix->nombres + ix->archivos[medio].off_nombre, relativa);
+        if (cmp == 0) return (long)medio;
+        if (cmp < 0) lo = medio + 1;
+        else hi = medio;
+    }
+    return -1;
+}
+
+int indice_vigente(const Indice *ix, long archivo, uint64_t tam, int64_t mtime) {
+    const EntradaArchivo *a = &ix->archivos[archivo];
+    return a->mtime_ns != MTIME_SIN_LEER && a->tam == tam && a->mtime_ns == mtime;
+}
+
+static const EntradaTrigrama *buscar_trigrama(const Indice *ix, uint32_t t) {
+    size_t lo = 0, hi = ix->cab->n_trigramas;
+    while (lo < hi) {
+        size_t medio = lo + (hi - lo) / 2;
+        uint32_t v = ix->trigramas[medio].trigrama;
+        if (v == t) return &ix->trigramas[medio];
+        if (v < t) lo = medio + 1;
+        else hi = medio;
+    }
+    return NULL;
+}
+
+static int comparar_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int comparar_por_frecuencia(const void *a, const void *b) {
+    const EntradaTrigrama *x = *(const EntradaTrigrama *const *)a;
+    const EntradaTrigrama *y = *(const EntradaTrigrama *const *)b;
+    return (x->n_archivos > y->n_archivos) - (x->n_archivos < y->n_archivos);
+}
+
+int indice_candidatos(const Indice *ix, const char *texto, size_t len, unsigned char *marcas) {
+    if (len < 3) {
+        return -1;
+    }
+    size_t n_archivos = ix->cab->n_archivos;
+    memset(marcas, 0, n_archivos);
+
+    size_t n = len - 2;
+    const EntradaTrigrama **listas = malloc(n * sizeof(*listas));
+    if (listas == NULL) {
+        return -1;
+    }
+    size_t distintas = 0;
+    for (size_t i = 0; i < n; i++) {
+        const EntradaTrigrama *e = buscar_trigrama(ix, trigrama_en((const unsigned char *)texto + i));
+        if (e == NULL) {
+            free(listas);           /* Ningún archivo indexado lo contiene */
+            return 0;
+        }
+        int repetida = 0;
+        for (size_t j = 0; j < distintas && !repetida; j++) {
+            repetida = listas[j] == e;
+        }
+        if (!repetida) listas[distintas++] = e;
+    }
+
+    /* Intersecamos empezando por la lista más corta: el resultado nunca crece */
+    qsort(listas, distintas, sizeof(*listas), comparar_por_frecuencia);
+    uint32_t *actual = malloc(((size_t)listas[0]->n_archivos + 1) * sizeof(uint32_t));
+    uint32_t *otra = malloc(((size_t)listas[0]->n_archivos + 1) * sizeof(uint32_t));
+    uint32_t *tmp = NULL;
+    if (actual == NULL || otra == NULL || decodificar_lista(ix, listas[0], actual) != 0) {
+        goto sin_filtro;
+    }
+    size_t n_actual = listas[0]->n_archivos;
+    for (size_t k = 1; k < distintas && n_actual > 0; k++) {
+        /* Decodificamos en un búfer propio y mezclamos con el resultado */
+        tmp = realloc(tmp, ((size_t)listas[k]->n_archivos + 1) * sizeof(uint32_t));
+        if (tmp == NULL || decodificar_lista(ix, listas[k], tmp) != 0) {
+            goto sin_filtro;
+        }
+        size_t i = 0, j = 0, m = 0;
+        while (i < n_actual && j < listas[k]->n_archivos) {
+            if (actual[i] < tmp[j]) i++;
+            else if (actual[i] > tmp[j]) j++;
+            else { otra[m++] = actual[i]; i++; j++; }
+        }
+        uint32_t *cambio = actual;
+        actual = otra;
+        otra = cambio;
+        n_actual = m;
+    }
+    for (size_t i = 0; i < n_actual; i++) {
+        marcas[actual[i]] = 1;
+    }
+    free(tmp);
+    free(actual);
+    free(otra);
+    free(listas);
+    return 0;
+
+sin_filtro:
+    /* Sin memoria o índice dañado: mejor leer todo que perder resultados */
+    free(tmp);
+    free(actual);
+    free(otra);
+    free(listas);
+    memset(marcas, 1, n_archivos);
+    return -1;
+}
+
+/* =============================================================================
+ * Construcción
+ * ========================================================================== */
+
+typedef struct {
+    char *relativa;
+    uint64_t tam;
+    int64_t mtime_ns;
+    long anterior;      /**< Número en el índice anterior si no cambió, o -1 */
+    Trigramas tri;
+} ArchivoNuevo;
+
+typedef struct {
+    int dir_fd;
+    ArchivoNuevo *archivos;
+    size_t *pendientes;  /**< Índices de los archivos que hay que leer */
+} DatosEscaneo;
+
+/** @brief Extrae los trigramas distintos de un bloque de memoria. */
+static int extraer_trigramas(const unsigned char *p, size_t n, Trigramas *t) {
+    t->v = NULL;
+    t->n = 0;
+    if (n < 3) return 0;
+    size_t total = n - 2;
+
+    if (n <= LIMITE_ORDENAR) {
+        /* Archivos pequeños: ordenar y quitar duplicados */
+        t->v = malloc(total * sizeof(uint32_t));
+        if (t->v == NULL) return -1;
+        for (size_t i = 0; i < total; i++) t->v[i] = trigrama_en(p + i);
+        qsort(t->v, total, sizeof(uint32_t), comparar_u32);
+        size_t m = 1;
+        for (size_t i = 1; i < total; i++) {
+            if (t->v[i] != t->v[m - 1]) t->v[m++] = t->v[i];
+        }
+        t->n = m;
+        return 0;
+    }
+
+    /* Archivos grandes: mapa de bits de 2 MiB; anotamos qué palabras se
+     * tocaron para no recorrer los 2^24 bits al final */
+    uint64_t *bits = calloc(TOTAL_TRIGRAMAS / 64, sizeof(uint64_t));
+    uint32_t *tocadas = malloc((TOTAL_TRIGRAMAS / 64) * sizeof(uint32_t));
+    if (bits == NULL || tocadas == NULL) {
+        free(bits);
+        free(tocadas);
+        return -1;
+    }
+    size_t n_tocadas = 0;
+    uint32_t tri = trigrama_en(p);
+    for (size_t i = 0;; i++) {
+        uint32_t w = tri >> 6;
+        if (bits[w] == 0) tocadas[n_tocadas++] = w;
+        bits[w] |= 1ull << (tri & 63);
+        if (i + 1 >= total) break;
+        tri = ((tri << 8) | p[i + 3]) & (TOTAL_TRIGRAMAS - 1);
+    }
+    qsort(tocadas, n_tocadas, sizeof(uint32_t), comparar_u32);
+
+    size_t cuantos = 0;
+    for (size_t i = 0; i < n_tocadas; i++) {
+        cuantos += (size_t)__builtin_popcountll(bits[tocadas[i]]);
+    }
+    t->v = malloc(cuantos * sizeof(uint32_t));
+    if (t->v != NULL) {
+        for (size_t i = 0; i < n_tocadas; i++) {
+            uint64_t palabra = bits[tocadas[i]];
+            while (palabra) {
+                t->v[t->n++] = (tocadas[i] << 6) | (uint32_t)__builtin_ctzll(palabra);
+                palabra &= palabra - 1;
+            }
+        }
+    }
+    free(bits);
+    free(tocadas);
+    return t->v != NULL ? 0 : -1;
+}
+
+/**
+ * @brief Tarea: extrae los trigramas de un archivo.
+ *
+ * Si no se puede leer, su conjunto vacío no es fiable: se marca con
+ * MTIME_SIN_LEER para que `buscar` lo lea siempre y el próximo `indexar`
+ * lo vuelva a intentar, en vez de descartarlo como si no tuviera el texto.
+ */
+static void tarea_escanear(size_t i, void *datos) {
+    DatosEscaneo *d = datos;
+    ArchivoNuevo *a = &d->archivos[d->pendientes[i]];
+    if (cancelacion_solicitada()) {
+        a->mtime_ns = MTIME_SIN_LEER;
+        return;
+    }
+    int fd = openat(d->dir_fd, a->relativa, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        a->mtime_ns = MTIME_SIN_LEER;
+        return;
+    }
+    if (a->tam >= 3) {
+        void *mapa = mmap(NULL, (size_t)a->tam, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapa == MAP_FAILED) {
+            a->mtime_ns = MTIME_SIN_LEER;
+        } else {
+            madvise(mapa, (size_t)a->tam, MADV_SEQUENTIAL);
+            if (extraer_trigramas(mapa, (size_t)a->tam, &a->tri) != 0) {
+                a->mtime_ns = MTIME_SIN_LEER;
+            }
+            munmap(mapa, (size_t)a->tam);
+        }
+    }
+    close(fd);
+}
+
+static int comparar_trigramas(const void *a, const void *b) {
+    uint32_t x = ((const EntradaTrigrama *)a)->trigrama, y = ((const EntradaTrigrama *)b)->trigrama;
+    return (x > y) - (x < y);
+}
+
+static int comparar_archivos(const void *a, const void *b) {
+    return strcmp(((const ArchivoNuevo *)a)->relativa, ((const ArchivoNuevo *)b)->relativa);
+}
+
+/**
+ * @brief Recupera del índice anterior los trigramas de los archivos sin cambios.
+ *
+ * Recorre las listas una sola vez; como los trigramas están ordenados, el
+ * conjunto de cada archivo también queda ordenado.
+ */
+static int recuperar_trigramas(const Indice *viejo, ArchivoNuevo *archivos, size_t n) {
+    size_t n_viejo = viejo->cab->n_archivos;
+    long *destino = malloc(n_viejo * sizeof(long));
+    size_t *cuenta = calloc(n_viejo, sizeof(size_t));
+    uint32_t *lista = NULL;
+    int resultado = -1;
+    if (destino == NULL || cuenta == NULL) goto salir;
+    for (size_t i = 0; i < n_viejo; i++) destino[i] = -1;
+    for (size_t i = 0; i < n; i++) {
+        if (archivos[i].anterior >= 0) destino[archivos[i].anterior] = (long)i;
+    }
+
+    uint32_t mayor = 0;
+    for (uint32_t k = 0; k < viejo->cab->n_trigramas; k++) {
+        if (viejo->trigramas[k].n_archivos > mayor) mayor = viejo->trigramas[k].n_archivos;
+    }
+    lista = malloc(((size_t)mayor + 1) * sizeof(uint32_t));
+    if (lista == NULL) goto salir;
+
+    /* Primera pasada: cuántos trigramas tiene cada archivo */
+    for (uint32_t k = 0; k < viejo->cab->n_trigramas; k++) {
+        if (decodificar_lista(viejo, &viejo->trigramas[k], lista) != 0) goto salir;
+        for (uint32_t j = 0; j < viejo->trigramas[k].n_archivos; j++) cuenta[lista[j]]++;
+    }
+    for (size_t i = 0; i < n_viejo; i++) {
+        if (destino[i] < 0 || cuenta[i] == 0) continue;
+        Trigramas *t = &archivos[destino[i]].tri;
+        t->v = malloc(cuenta[i] * sizeof(uint32_t));
+        if (t->v == NULL) goto salir;
+    }
+    /* Segunda pasada: repartir */
+    for (uint32_t k = 0; k < viejo->cab->n_trigramas; k++) {
+        decodificar_lista(viejo, &viejo->trigramas[k], lista);
+        for (uint32_t j = 0; j < viejo->trigramas[k].n_archivos; j++) {
+            long d = destino[lista[j]];
+            if (d >= 0) {
+                Trigramas *t = &archivos[d].tri;
+                t->v[t->n++] = viejo->trigramas[k].trigrama;
+            }
+        }
+    }
+    resultado = 0;
+salir:
+    free(destino);
+    free(cuenta);
+    free(lista);
+    return resultado;
+}
+
+/** @brief Tabla hash trigrama -> contador (direccionamiento abierto). */
+typedef struct {
+    uint32_t *claves;   /**< trigrama + 1; 0 = vacía */
+    uint32_t *valores;
+    size_t capacidad;   /**< Potencia de 2 */
+    size_t n;
+} TablaConteo;
+
+static size_t tabla_posicion(const TablaConteo *t, uint32_t clave) {
+    size_t h = (clave * 0x9E3779B1u) & (t->capacidad - 1);
+    while (t->claves[h] != 0 && t->claves[h] != clave) {
+        h = (h + 1) & (t->capacidad - 1);
+    }
+    return h;
+}
+
+static int tabla_crecer(TablaConteo *t) {
+    TablaConteo nueva = {NULL, NULL, t->capacidad ? t->capacidad * 2 : 4096, t->n};
+    nueva.claves = calloc(nueva.capacidad, sizeof(uint32_t));
+    nueva.valores = malloc(nueva.capacidad * sizeof(uint32_t));
+    if (nueva.claves == NULL || nueva.valores == NULL) {
+        free(nueva.claves);
+        free(nueva.valores);
+        return -1;
+    }
+    for (size_t i = 0; i < t->capacidad; i++) {
+        if (t->claves[i] == 0) continue;
+        size_t h = tabla_posicion(&nueva, t->claves[i]);
+        nueva.claves[h] = t->claves[i];
+        nueva.valores[h] = t->valores[i];
+    }
+    free(t->claves);
+    free(t->valores);
+    *t = nueva;
+    return 0;
+}
+
+/** @brief Suma 1 al contador del trigrama. */
+static int tabla_contar(TablaConteo *t, uint32_t trigrama) {
+    if ((t->n + 1) * 2 > t->capacidad && tabla_crecer(t) != 0) {
+        return -1;
+    }
+    size_t h = tabla_posicion(t, trigrama + 1);
+    if (t->claves[h] == 0) {
+        t->claves[h] = trigrama + 1;
+        t->valores[h] = 0;
+        t->n++;
+    }
+    t->valores[h]++;
+    return 0;
+}
+
+static int escribir_todo(int fd, const void *datos, size_t n) {
+    const char *p = datos;
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/**
+ * @brief Genera las listas y escribe el archivo de índice.
+ * @return 0, o -1 con errno.
+ */
+static int escribir_indice(int dir_fd, const char *dir, ArchivoNuevo *archivos, size_t n,
+                           ResumenIndice *resumen) {
+    TablaConteo tabla = {0};
+    EntradaTrigrama *entradas = NULL;
+    uint32_t *posiciones = NULL;
+    uint32_t *miembros = NULL;
+    unsigned char *listas = NULL;
+    EntradaArchivo *tabla_archivos = NULL;
+    int fd = -1, resultado = -1, error = ENOMEM;
+
+    /* Conteo de archivos por trigrama */
+    size_t pares = 0;
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < archivos[i].tri.n; j++) {
+            if (tabla_contar(&tabla, archivos[i].tri.v[j]) != 0) goto salir;
+        }
+        pares += archivos[i].tri.n;
+    }
+
+    /* Trigramas ordenados y posición de inicio de cada lista */
+    size_t m = tabla.n;
+    entradas = malloc((m + 1) * sizeof(EntradaTrigrama));
+    posiciones = malloc((m + 1) * sizeof(uint32_t));
+    miembros = malloc((pares + 1) * sizeof(uint32_t));
+    if (entradas == NULL || posiciones == NULL || miembros == NULL) goto salir;
+    size_t k = 0;
+    for (size_t i = 0; i < tabla.capacidad; i++) {
+        if (tabla.claves[i] != 0) {
+            entradas[k].trigrama = tabla.claves[i] - 1;
+            entradas[k].n_archivos = tabla.valores[i];
+            k++;
+        }
+    }
+    qsort(entradas, m, sizeof(EntradaTrigrama), comparar_trigramas);
+    size_t acumulado = 0;
+    for (size_t i = 0; i < m; i++) {
+        posiciones[i] = (uint32_t)acumulado;
+        acumulado += entradas[i].n_archivos;
+        /* La tabla pasa a guardar el número de trigrama en el orden final */
+        tabla.valores[tabla_posicion(&tabla, entradas[i].trigrama + 1)] = (uint32_t)i;
+    }
+
+    /* Reparto: recorrer los archivos en orden deja cada lista ordenada */
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < archivos[i].tri.n; j++) {
+            uint32_t t = tabla.valores[tabla_posicion(&tabla, archivos[i].tri.v[j] + 1)];
+            miembros[posiciones[t]++] = (uint32_t)i;
+        }
+    }
+
+    /* Codificación: diferencias en varint (máximo 5 bytes por número) */
+    listas = malloc(pares * 5 + 1);
+    if (listas == NULL) goto salir;
+    size_t tam_listas = 0, inicio = 0;
+    for (size_t i = 0; i < m; i++) {
+        entradas[i].off_lista = tam_listas;
+        uint32_t previo = 0;
+        for (uint32_t j = 0; j < entradas[i].n_archivos; j++) {
+            uint32_t v = miembros[inicio + j];
+            tam_listas += varint_escribir(listas + tam_listas, v - previo);
+            previo = v;
+        }
+        inicio += entradas[i].n_archivos;
+    }
+
+    /* Tabla de archivos y nombres */
+    tabla_archivos = calloc(n + 1, sizeof(EntradaArchivo));
+    if (tabla_archivos == NULL) goto salir;
+    size_t tam_nombres = 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t largo = strlen(archivos[i].relativa);
+        tabla_archivos[i].tam = archivos[i].tam;
+        tabla_archivos[i].mtime_ns = archivos[i].mtime_ns;
+        tabla_archivos[i].off_nombre = (uint32_t)tam_nombres;
+        tabla_archivos[i].largo_nombre = (uint32_t)largo;
+        tam_nombres += largo + 1;
+    }
+
+    Cabecera cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magia, MAGIA, sizeof(MAGIA));
+    cab.version = INDICE_VERSION;
+    cab.n_archivos = (uint32_t)n;
+    cab.n_trigramas = (uint32_t)m;
+    cab.off_archivos = sizeof(Cabecera);
+    cab.off_trigramas = cab.off_archivos + n * sizeof(EntradaArchivo);
+    cab.off_listas = cab.off_trigramas + m * sizeof(EntradaTrigrama);
+    cab.off_nombres = cab.off_listas + tam_listas;
+    cab.tam_total = cab.off_nombres + tam_nombres;
+
+    char temporal[4096], final[4096];
+    size_t largo_dir = largo_prefijo(dir);
+    snprintf(temporal, sizeof(temporal), "%.*s/%s", (int)largo_dir, dir, INDICE_TEMPORAL);
+    snprintf(final, sizeof(final), "%.*s/%s", (int)largo_dir, dir, INDICE_NOMBRE);
+    fd = openat(dir_fd, temporal, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = errno;
+        goto salir;
+    }
+    int fallo = escribir_todo(fd, &cab, sizeof(cab)) ||
+                escribir_todo(fd, tabla_archivos, n * sizeof(EntradaArchivo)) ||
+                escribir_todo(fd, entradas, m * sizeof(EntradaTrigrama)) ||
+                escribir_todo(fd, listas, tam_listas);
+    for (size_t i = 0; i < n && !fallo; i++) {
+        fallo = escribir_todo(fd, archivos[i].relativa, tabla_archivos[i].largo_nombre + 1);
+    }
+    if (fallo) {
+        error = errno;
+        unlinkat(dir_fd, temporal, 0);
+        goto salir;
+    }
+    if (renameat(dir_fd, temporal, dir_fd, final) != 0) {
+        error = errno;
+        unlinkat(dir_fd, temporal, 0);
+        goto salir;
+    }
+
+    if (resumen != NULL) {
+        resumen->trigramas = m;
+        resumen->bytes = cab.tam_total;
+    }
+    resultado = 0;
+
+salir:
+    if (fd >= 0) close(fd);
+    free(tabla.claves);
+    free(tabla.valores);
+    free(entradas);
+    free(posiciones);
+    free(miembros);
+    free(listas);
+    free(tabla_archivos);
+    if (resultado != 0) errno = error;
+    return resultado;
+}
+
+int indice_construir(int dir_fd, const char *dir, ResumenIndice *resumen) {
+    struct stat st_dir;
+    if (fstatat(dir_fd, dir, &st_dir, 0) != 0) {
+        return -1;
+    }
+    if (!S_ISDIR(st_dir.st_mode)) {
+        errno = ENOTDIR;
+        return -1;
+    }
+    ListaRutas lista = {0};
+    if (recolectar_archivos(dir_fd, dir, &lista) != 0) {
+        return -1;
+    }
+    size_t largo_dir = largo_prefijo(dir);
+    ArchivoNuevo *archivos = calloc(lista.n + 1, sizeof(ArchivoNuevo));
+    size_t *pendientes = malloc((lista.n + 1) * sizeof(size_t));
+    Indice *viejo = NULL;
+    int resultado = -1;
+    if (archivos == NULL || pendientes == NULL) {
+        errno = ENOMEM;
+        goto salir;
+    }
+
+    /* Rutas relativas a dir (sin el propio índice) con su tamaño y mtime */
+    size_t n = 0;
+    for (size_t i = 0; i < lista.n; i++) {
+        const char *relativa = lista.rutas[i] + largo_dir + 1;
+        if (strcmp(relativa, INDICE_NOMBRE) == 0 || strcmp(relativa, INDICE_TEMPORAL) == 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dir_fd, lista.rutas[i], &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        archivos[n].relativa = lista.rutas[i];   /* Ruta completa por ahora */
+        archivos[n].tam = (uint64_t)st.st_size;
+        archivos[n].mtime_ns = mtime_ns(&st);
+        archivos[n].anterior = -1;
+        n++;
+    }
+    qsort(archivos, n, sizeof(ArchivoNuevo), comparar_archivos);
+
+    /* Archivos sin cambios desde el índice anterior */
+    viejo = indice_abrir(dir_fd, dir);
+    size_t reutilizados = 0;
+    for (size_t i = 0; i < n && viejo != NULL; i++) {
+        long previo = indice_buscar_archivo(viejo, archivos[i].relativa + largo_dir + 1);
+        if (previo >= 0 && indice_vigente(viejo, previo, archivos[i].tam, archivos[i].mtime_ns)) {
+            archivos[i].anterior = previo;
+            reutilizados++;
+        }
+    }
+    if (reutilizados > 0 && recuperar_trigramas(viejo, archivos, n) != 0) {
+        /* Índice anterior inservible: se reconstruye todo */
+        for (size_t i = 0; i < n; i++) {
+            free(archivos[i].tri.v);
+            archivos[i].tri.v = NULL;
+            archivos[i].tri.n = 0;
+            archivos[i].anterior = -1;
+        }
+        reutilizados = 0;
+    }
+
+    size_t n_pendientes = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (archivos[i].anterior < 0) pendientes[n_pendientes++] = i;
+    }
+    DatosEscaneo datos = {dir_fd, archivos, pendientes};
+    ejecutar_en_paralelo(n_pendientes, hilos_disponibles(), tarea_escanear, &datos);
+    if (cancelacion_solicitada()) {
+        /* Un índice con archivos sin escanear descartaría coincidencias:
+         * se conserva el anterior */
+        errno = ECANCELED;
+        goto salir;
+    }
+
+    /* En el índice se guardan rutas relativas a dir */
+    for (size_t i = 0; i < n; i++) {
+        archivos[i].relativa += largo_dir + 1;
+    }
+
+    if (resumen != NULL) {
+        memset(resumen, 0, sizeof(*resumen));
+        resumen->archivos = n;
+        resumen->reutilizados = reutilizados;
+        resumen->escaneados = n_pendientes;
+        resumen->eliminados = viejo ? viejo->cab->n_archivos - reutilizados : 0;
+        /* Los modificados estaban antes y no cuentan como eliminados */
+        for (size_t i = 0; i < n && viejo != NULL; i++) {
+            if (archivos[i].anterior < 0 && indice_buscar_archivo(viejo, archivos[i].relativa) >= 0) {
+                resumen->eliminados--;
+            }
+        }
+    }
+    resultado = escribir_indice(dir_fd, dir, archivos, n, resumen);
+
+salir:
+    indice_cerrar(viejo);
+    for (size_t i = 0; archivos != NULL && i < lista.n; i++) {
+        free(archivos[i].tri.v);
+    }
+    free(archivos);
+    free(pendientes);
+    lista_rutas_liberar(&lista);
+    return resultado;
+}
@@ -0,0 +1,545 @@
+/**
+ * @file lectura_lotes.c
+ * @brief Lectura de archivos por lotes con io_uring (y respaldo POSIX).
+ *
+ * No depende de liburing: habla directamente con el kernel mediante las
+ * llamadas io_uring_setup, io_uring_register e io_uring_enter y los
+ * anillos compartidos que se mapean con mmap().
+ *
+ * Cada lote de hasta LOTE_MAX_ARCHIVOS archivos se procesa en tres fases,
+ * cada una con una llamada a io_uring_enter() por ronda:
+ *   1. OPENAT de todos los archivos.
+ *   2. READ_FIXED del primer bloque de cada uno, sobre buffers registrados.
+ *      Un archivo solo termina cuando una lectura devuelve 0, así que los
+ *      que devolvieron menos se vuelven a pedir en otra ronda (dos rondas
+ *      para archivos regulares pequeños).
+ *   3. CLOSE de todos los descriptores.
+ * Los archivos que no caben en su buffer se terminan de leer con read()
+ * normal: para archivos grandes manda el ancho de banda, no las syscalls.
+ *
+ * Cada hilo crea su anillo (y registra sus buffers) la primera vez y lo
+ * reutiliza en las llamadas siguientes; se destruye cuando el hilo termina.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>       /* struct iovec */
+#include <sys/syscall.h>
+#include "lectura_lotes.h"
+#include "cancelacion.h"
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    define HAY_IO_URING 1
+#  endif
+#endif
+
+/* ============================================================================
+ * Respaldo POSIX: openat + read + close por archivo
+ * ========================================================================== */
+
+/**
+ * @brief Entrega un bloque al callback, salvo que se haya pedido cancelar
+ *        (Ctrl+C): entonces el recorrido se detiene como si fn devolviera 1.
+ */
+static inline int entregar(FuncionBloque fn, BloqueArchivo *b, void *usuario) {
+    return cancelacion_solicitada() ? 1 : fn(b, usuario);
+}
+
+/**
+ * @brief Termina de leer un archivo ya abierto, entregando bloques.
+ *
+ * @param buffer Buffer de trabajo de LOTE_TAM_BUFFER bytes.
+ * @param b Bloque con indice/ruta ya rellenos.
+ * @return Lo que devuelva el callback (distinto de 0 = detener).
+ */
+static int leer_resto(int fd, char *buffer, BloqueArchivo *b,
+                      FuncionBloque fn, void *usuario) {
+    for (;;) {
+        ssize_t r = read(fd, buffer, LOTE_TAM_BUFFER);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        b->datos = buffer;
+        b->longitud = (r > 0) ? (size_t)r : 0;
+        b->error = (r < 0) ? errno : 0;
+        b->fin = (r <= 0);
+        if (entregar(fn, b, usuario) != 0) {
+            return 1;
+        }
+        if (b->fin) {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Implementación sin io_uring, con la misma semántica.
+ *
+ * @param desde Primer índice a procesar (para continuar un recorrido).
+ */
+static int leer_con_posix(int dir_fd, const char *const *rutas, size_t desde, size_t n,
+                          FuncionBloque fn, void *usuario) {
+    char *buffer = malloc(LOTE_TAM_BUFFER);
+    if (buffer == NULL) {
+        return 1;
+    }
+
+    int detenido = 0;
+    for (size_t i = desde; i < n && !detenido; i++) {
+        BloqueArchivo b = { i, rutas[i], NULL, 0, 0, 0 };
+        int fd = openat(dir_fd, rutas[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            b.error = errno;
+            b.fin = 1;
+            detenido = entregar(fn, &b, usuario);
+            continue;
+        }
+        detenido = leer_resto(fd, buffer, &b, fn, usuario);
+        close(fd);
+    }
+
+    free(buffer);
+    return detenido;
+}
+
+#ifdef HAY_IO_URING
+
+/* ============================================================================
+ * Backend io_uring
+ * ========================================================================== */
+
+/** @brief Punteros a los anillos compartidos con el kernel. */
+typedef struct {
+    int fd;
+    /* Anillo de envío (SQ) */
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    struct io_uring_sqe *sqes;
+    /* Anillo de completado (CQ) */
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    /* Regiones mapeadas (para munmap) */
+    void *sq_ptr, *cq_ptr;
+    size_t sq_tam, cq_tam, sqes_tam;
+    /* Buffers registrados: LOTE_MAX_ARCHIVOS x LOTE_TAM_BUFFER */
+    char *buffers;
+} Anillo;
+
+static int sys_io_uring_setup(unsigned entradas, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entradas, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned enviar, unsigned esperar, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, enviar, esperar, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned op, void *arg, unsigned n) {
+    return (int)syscall(__NR_io_uring_register, fd, op, arg, n);
+}
+
+/**
+ * @brief Libera todo lo que anillo_crear() haya alcanzado a reservar.
+ */
+static void anillo_destruir(Anillo *a) {
+    if (a->sqes != NULL && a->sqes != MAP_FAILED) munmap(a->sqes, a->sqes_tam);
+    if (a->cq_ptr != NULL && a->cq_ptr != MAP_FAILED && a->cq_ptr != a->sq_ptr) {
+        munmap(a->cq_ptr, a->cq_tam);
+    }
+    if (a->sq_ptr != NULL && a->sq_ptr != MAP_FAILED) munmap(a->sq_ptr, a->sq_tam);
+    if (a->fd >= 0) close(a->fd);
+    free(a->buffers);
+    memset(a, 0, sizeof(*a));
+    a->fd = -1;
+}
+
+/**
+ * @brief Comprueba que el kernel soporte las operaciones que usamos.
+ */
+static int anillo_soporta_operaciones(Anillo *a) {
+    size_t tam = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, tam);
+    if (probe == NULL) return 0;
+
+    int ok = sys_io_uring_register(a->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    const int ops[] = { IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_CLOSE };
+    for (size_t i = 0; ok && i < sizeof(ops) / sizeof(ops[0]); i++) {
+        ok = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+/**
+ * @brief Crea el anillo, mapea sus regiones y registra los buffers.
+ * @return 0 si todo salió bien, -1 si hay que usar el respaldo POSIX.
+ */
+static int anillo_crear(Anillo *a) {
+    memset(a, 0, sizeof(*a));
+    a->fd = -1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    a->fd = sys_io_uring_setup(LOTE_MAX_ARCHIVOS, &p);
+    if (a->fd < 0) {
+        return -1;
+    }
+
+    a->sq_tam = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    a->cq_tam = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        /* Kernel >= 5.4: ambos anillos comparten un único mapeo */
+        if (a->cq_tam > a->sq_tam) a->sq_tam = a->cq_tam;
+    }
+
+    a->sq_ptr = mmap(NULL, a->sq_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     a->fd, IORING_OFF_SQ_RING);
+    if (a->sq_ptr == MAP_FAILED) goto error;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        a->cq_ptr = a->sq_ptr;
+    } else {
+        a->cq_ptr = mmap(NULL, a->cq_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         a->fd, IORING_OFF_CQ_RING);
+        if (a->cq_ptr == MAP_FAILED) goto error;
+    }
+
+    a->sqes_tam = p.sq_entries * sizeof(struct io_uring_sqe);
+    a->sqes = mmap(NULL, a->sqes_tam, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   a->fd, IORING_OFF_SQES);
+    if (a->sqes == MAP_FAILED) goto error;
+
+    char *sq = a->sq_ptr, *cq = a->cq_ptr;
+    a->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    a->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    a->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    a->sq_array = (unsigned *)(sq + p.sq_off.array);
+    a->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    a->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    a->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    a->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    if (!anillo_soporta_operaciones(a)) goto error;
+
+    /* Buffers registrados: el kernel los fija una vez y READ_FIXED evita
+     * mapear las páginas del usuario en cada lectura. */
+    a->buffers = aligned_alloc(4096, (size_t)LOTE_MAX_ARCHIVOS * LOTE_TAM_BUFFER);
+    if (a->buffers == NULL) goto error;
+    struct iovec iov[LOTE_MAX_ARCHIVOS];
+    for (int i = 0; i < LOTE_MAX_ARCHIVOS; i++) {
+        iov[i].iov_base = a->buffers + (size_t)i * LOTE_TAM_BUFFER;
+        iov[i].iov_len = LOTE_TAM_BUFFER;
+    }
+    if (sys_io_uring_register(a->fd, IORING_REGISTER_BUFFERS, iov, LOTE_MAX_ARCHIVOS) != 0) {
+        goto error;
+    }
+    return 0;
+
+error:
+    anillo_destruir(a);
+    return -1;
+}
+
+/**
+ * @brief Reserva la siguiente entrada libre del anillo de envío.
+ */
+static struct io_uring_sqe *anillo_siguiente_sqe(Anillo *a) {
+    unsigned tail = *a->sq_tail;
+    unsigned idx = tail & *a->sq_mask;
+    struct io_uring_sqe *sqe = &a->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    a->sq_array[idx] = idx;
+    /* Release: el kernel debe ver la SQE completa antes que el nuevo tail */
+    __atomic_store_n(a->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+/**
+ * @brief Envía las SQEs pendientes y espera todas sus respuestas.
+ *
+ * @param resultados resultados[user_data] recibe el res de cada CQE.
+ * @return 0 si todo salió bien, -1 si io_uring_enter falló.
+ */
+static int anillo_enviar_y_esperar(Anillo *a, unsigned n, int *resultados) {
+    unsigned recibidas = 0;
+    unsigned por_enviar = n;
+    while (recibidas < n) {
+        int r = sys_io_uring_enter(a->fd, por_enviar, n - recibidas, IORING_ENTER_GETEVENTS);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        por_enviar -= (unsigned)r < por_enviar ? (unsigned)r : por_enviar;
+
+        /* Acquire: leemos las CQE solo después de ver el tail publicado */
+        unsigned head = *a->cq_head;
+        unsigned tail = __atomic_load_n(a->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &a->cqes[head & *a->cq_mask];
+            resultados[cqe->user_data] = cqe->res;
+            head++;
+            recibidas++;
+        }
+        __atomic_store_n(a->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/** @brief Estado de la lectura del primer buffer de cada archivo del lote. */
+enum {
+    LECTURA_PENDIENTE = 0,  /**< Falta pedir más datos al kernel */
+    LECTURA_FIN,            /**< Un READ devolvió 0: fin de archivo */
+    LECTURA_LLENO,          /**< El buffer se llenó: sigue con read() */
+    LECTURA_ERROR           /**< Un READ falló (errno en errores[]) */
+};
+
+/**
+ * @brief Procesa todos los archivos en lotes usando el anillo.
+ *
+ * @param roto Se pone a 1 si el anillo quedó en un estado desconocido y
+ *        hay que descartarlo (aunque el recorrido haya terminado).
+ * @return 0/1 como leer_archivos_en_lote(), o -1 si el anillo falló a
+ *         mitad y hay que continuar con el respaldo desde *procesados.
+ */
+static int leer_con_io_uring(Anillo *a, int dir_fd, const char *const *rutas, size_t n,
+                             FuncionBloque fn, void *usuario, size_t *procesados, int *roto) {
+    int fds[LOTE_MAX_ARCHIVOS];
+    int leidos[LOTE_MAX_ARCHIVOS];
+    int estado[LOTE_MAX_ARCHIVOS];
+    int errores[LOTE_MAX_ARCHIVOS];
+    int respuestas[LOTE_MAX_ARCHIVOS];
+
+    for (size_t base = 0; base < n; base += LOTE_MAX_ARCHIVOS) {
+        unsigned lote = (n - base < LOTE_MAX_ARCHIVOS) ? (unsigned)(n - base) : LOTE_MAX_ARCHIVOS;
+        *procesados = base;
+
+        /* --- Fase 1: abrir todos los archivos del lote --- */
+        for (unsigned i = 0; i < lote; i++) {
+            fds[i] = -1;   /* Si el envío falla, solo se cierran los que llegaron */
+        }
+        for (unsigned i = 0; i < lote; i++) {
+            struct io_uring_sqe *sqe = anillo_siguiente_sqe(a);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = dir_fd;
+            sqe->addr = (unsigned long)rutas[base + i];
+            sqe->open_flags = O_RDONLY | O_CLOEXEC;
+            sqe->user_data = i;
+        }
+        if (anillo_enviar_y_esperar(a, lote, fds) != 0) {
+            for (unsigned i = 0; i < lote; i++) if (fds[i] >= 0) close(fds[i]);
+            *roto = 1;
+            return -1;
+        }
+
+        /* --- Fase 2: llenar el buffer de cada archivo o llegar a su fin ---
+         * Solo un READ que devuelve 0 marca el fin: una lectura corta (FIFO,
+         * /proc, archivo que crece) se repite en la ronda siguiente. Para
+         * archivos regulares pequeños son dos rondas por lote, no por archivo.
+         * off = -1 usa (y avanza) la posición del descriptor, así que read()
+         * continúa donde se quedó el anillo, también en descriptores sin lseek. */
+        for (unsigned i = 0; i < lote; i++) {
+            leidos[i] = 0;
+            estado[i] = LECTURA_PENDIENTE;
+        }
+        for (;;) {
+            unsigned n_lecturas = 0;
+            for (unsigned i = 0; i < lote; i++) {
+                if (fds[i] < 0 || estado[i] != LECTURA_PENDIENTE) continue;
+                struct io_uring_sqe *sqe = anillo_siguiente_sqe(a);
+                sqe->opcode = IORING_OP_READ_FIXED;
+                sqe->fd = fds[i];
+                sqe->addr = (unsigned long)(a->buffers + (size_t)i * LOTE_TAM_BUFFER + leidos[i]);
+                sqe->len = LOTE_TAM_BUFFER - (unsigned)leidos[i];
+                sqe->off = (__u64)-1;
+                sqe->buf_index = (unsigned short)i;
+                sqe->user_data = i;
+                n_lecturas++;
+            }
+            if (n_lecturas == 0) break;
+            if (anillo_enviar_y_esperar(a, n_lecturas, respuestas) != 0) {
+                for (unsigned i = 0; i < lote; i++) if (fds[i] >= 0) close(fds[i]);
+                *roto = 1;
+                return -1;
+            }
+            for (unsigned i = 0; i < lote; i++) {
+                if (fds[i] < 0 || estado[i] != LECTURA_PENDIENTE) continue;
+                int r = respuestas[i];
+                if (r == -EINTR || r == -EAGAIN) continue;
+                if (r < 0) {
+                    estado[i] = LECTURA_ERROR;
+                    errores[i] = -r;
+                } else if (r == 0) {
+                    estado[i] = LECTURA_FIN;
+                } else if ((leidos[i] += r) == LOTE_TAM_BUFFER) {
+                    estado[i] = LECTURA_LLENO;
+                }
+            }
+        }
+
+        /* --- Entrega en orden (los archivos grandes se terminan con read) --- */
+        int detenido = 0;
+        for (unsigned i = 0; i < lote && !detenido; i++) {
+            BloqueArchivo b = { base + i, rutas[base + i], NULL, 0, 0, 1 };
+            if (fds[i] < 0) {
+                b.error = -fds[i];
+                detenido = entregar(fn, &b, usuario);
+                continue;
+            }
+            char *buffer = a->buffers + (size_t)i * LOTE_TAM_BUFFER;
+            if (leidos[i] > 0 || estado[i] == LECTURA_FIN) {
+                b.datos = buffer;
+                b.longitud = (size_t)leidos[i];
+                b.fin = (estado[i] == LECTURA_FIN);
+                detenido = entregar(fn, &b, usuario);
+            }
+            if (detenido || b.fin) continue;
+            if (estado[i] == LECTURA_LLENO) {
+                /* El archivo llenó el buffer: puede haber más */
+                detenido = leer_resto(fds[i], buffer, &b, fn, usuario);
+            } else {
+                b.datos = NULL;
+                b.longitud = 0;
+                b.error = errores[i];
+                b.fin = 1;
+                detenido = entregar(fn, &b, usuario);
+            }
+        }
+
+        /* --- Fase 3: cerrar todos los descriptores del lote --- */
+        unsigned n_cierres = 0;
+        unsigned head_inicial = __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE);
+        for (unsigned i = 0; i < lote; i++) {
+            if (fds[i] < 0) continue;
+            struct io_uring_sqe *sqe = anillo_siguiente_sqe(a);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->fd = fds[i];
+            sqe->user_data = i;
+            n_cierres++;
+        }
+        if (n_cierres > 0 && anillo_enviar_y_esperar(a, n_cierres, respuestas) != 0) {
+            /* El kernel consume las SQE en orden: las que ya tomó cierran su
+             * descriptor (y ese número puede haberse reutilizado en otro hilo),
+             * así que solo se cierran aquí las que no llegó a tomar. */
+            unsigned tomadas = __atomic_load_n(a->sq_head, __ATOMIC_ACQUIRE) - head_inicial;
+            unsigned k = 0;
+            for (unsigned i = 0; i < lote; i++) {
+                if (fds[i] < 0) continue;
+                if (k++ >= tomadas) close(fds[i]);
+            }
+            *roto = 1;
+            if (!detenido) {
+                *procesados = base + lote;
+                return -1;
+            }
+        }
+
+        if (detenido) return 1;
+    }
+    *procesados = n;
+    return 0;
+}
+
+#endif /* HAY_IO_URING */
+
+/* ============================================================================
+ * Detección del backend (una sola vez por proceso) y anillo de cada hilo
+ * ========================================================================== */
+
+static int io_uring_disponible = 0;
+static pthread_once_t deteccion = PTHREAD_ONCE_INIT;
+
+#ifdef HAY_IO_URING
+/** @brief Anillo de cada hilo (NULL hasta su primer uso). */
+static pthread_key_t clave_anillo;
+
+/** @brief 1 si el anillo de este hilo no se pudo crear: no se reintenta. */
+static __thread int anillo_fallido = 0;
+
+/** @brief 1 mientras este hilo está dentro de leer_con_io_uring(). */
+static __thread int anillo_ocupado = 0;
+
+/** @brief Destructor de clave_anillo: se llama al terminar cada hilo. */
+static void liberar_anillo(void *p) {
+    anillo_destruir(p);
+    free(p);
+}
+
+/**
+ * @brief Anillo del hilo actual, creado en su primer uso.
+ * @return El anillo, o NULL si este hilo debe usar el respaldo POSIX.
+ */
+static Anillo *anillo_del_hilo(void) {
+    Anillo *a = pthread_getspecific(clave_anillo);
+    if (a != NULL || anillo_fallido) {
+        return a;
+    }
+    a = malloc(sizeof(*a));
+    if (a == NULL || anillo_crear(a) != 0 || pthread_setspecific(clave_anillo, a) != 0) {
+        if (a != NULL && a->fd >= 0) anillo_destruir(a);
+        free(a);
+        anillo_fallido = 1;   /* p. ej. RLIMIT_MEMLOCK agotado por otros hilos */
+        return NULL;
+    }
+    return a;
+}
+
+/** @brief Destruye el anillo del hilo (quedó a medias tras un error). */
+static void descartar_anillo(Anillo *a) {
+    pthread_setspecific(clave_anillo, NULL);
+    liberar_anillo(a);
+}
+#endif
+
+static void detectar_io_uring(void) {
+#ifdef HAY_IO_URING
+    const char *desactivar = getenv("EAFITOS_SIN_IO_URING");
+    if (desactivar != NULL && desactivar[0] != '\0') {
+        return;
+    }
+    if (pthread_key_create(&clave_anillo, liberar_anillo) != 0) {
+        return;
+    }
+    /* El anillo de prueba queda como el de este hilo */
+    io_uring_disponible = anillo_del_hilo() != NULL;
+#endif
+}
+
+int lectura_lotes_usa_io_uring(void) {
+    pthread_once(&deteccion, detectar_io_uring);
+    return io_uring_disponible;
+}
+
+int leer_archivos_en_lote(int dir_fd, const char *const *rutas, size_t n,
+                          FuncionBloque fn, void *usuario) {
+#ifdef HAY_IO_URING
+    /* Para uno o dos archivos, tres io_uring_enter() no ahorran nada frente a
+     * open/read/close. Si el callback vuelve a llamar aquí, los buffers del
+     * anillo están en uso: esa llamada anidada va por el respaldo. */
+    Anillo *a = (n > 2 && !anillo_ocupado && lectura_lotes_usa_io_uring()) ? anillo_del_hilo() : NULL;
+    if (a != NULL) {
+        size_t procesados = 0;
+        int roto = 0;
+        anillo_ocupado = 1;
+        int r = leer_con_io_uring(a, dir_fd, rutas, n, fn, usuario, &procesados, &roto);
+        anillo_ocupado = 0;
+        if (roto) {
+            /* Estado desconocido: el próximo uso en este hilo crea otro */
+            descartar_anillo(a);
+        }
+        if (r >= 0) {
+            return r;
+        }
+        /* El anillo falló a mitad: seguimos con el respaldo desde el
+         * primer archivo que no se entregó */
+        return leer_con_posix(dir_fd, rutas, procesados, n, fn, usuario);
+    }
+#endif
+    return leer_con_posix(dir_fd, rutas, 0, n, fn, usuario);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file lineas.c
+ * @brief Primeras y últimas líneas de un archivo sin leerlo completo.
+ *
+ * lineas_desde_final() retrocede desde el final con pread() y memrchr()
+ * contando saltos de línea; lineas_copiar_primeras() avanza con memchr()
+ * hasta el n-ésimo. Ninguna de las dos carga más de un bloque a la vez.
+ * Entre bloque y bloque se consulta cancelacion_solicitada(): con Ctrl+C
+ * terminan con -1 y errno = ECANCELED.
+ */
+
+#define _GNU_SOURCE   /* memrchr */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lineas.h"
+#include "cancelacion.h"
+
+off_t lineas_desde_final(int fd, off_t tam, uint64_t n) {
+    if (n == 0 || tam <= 0) {
+        return (tam > 0) ? tam : 0;
+    }
+    char *buf = malloc(LINEAS_BLOQUE);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    off_t fin = tam;
+    int primero = 1;
+    uint64_t vistos = 0;
+    while (fin > 0) {
+        if (cancelacion_solicitada()) {
+            free(buf);
+            errno = ECANCELED;
+            return -1;
+        }
+        off_t ini = (fin > LINEAS_BLOQUE) ? fin - LINEAS_BLOQUE : 0;
+        size_t largo = (size_t)(fin - ini), leidos = 0;
+        while (leidos < largo) {
+            ssize_t r = pread(fd, buf + leidos, largo - leidos, ini + (off_t)leidos);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) {
+                /* El archivo se acortó mientras lo leíamos */
+                if (r == 0) errno = EIO;
+                free(buf);
+                return -1;
+            }
+            leidos += (size_t)r;
+        }
+
+        size_t p = largo;
+        if (primero && buf[largo - 1] == '\n') {
+            p--;   /* El '\n' final termina la última línea, no abre otra */
+        }
+        primero = 0;
+        const char *q;
+        while (p > 0 && (q = memrchr(buf, '\n', p)) != NULL) {
+            if (++vistos == n) {
+                off_t inicio = ini + (q - buf) + 1;
+                free(buf);
+                return inicio;
+            }
+            p = (size_t)(q - buf);
+        }
+        fin = ini;
+    }
+    free(buf);
+    return 0;
+}
+
+int lineas_copiar_primeras(int fd, uint64_t n, FILE *salida) {
+    if (n == 0) {
+        return 0;
+    }
+    char *buf = malloc(LINEAS_BLOQUE);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    uint64_t vistos = 0;
+    for (;;) {
+        if (cancelacion_solicitada()) {
+            free(buf);
+            errno = ECANCELED;
+            return -1;
+        }
+        ssize_t r = read(fd, buf, LINEAS_BLOQUE);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            free(buf);
+            return -1;
+        }
+        if (r == 0) break;
+
+        const char *p = buf, *fin = buf + r, *q;
+        while (p < fin && (q = memchr(p, '\n', (size_t)(fin - p))) != NULL) {
+            p = q + 1;
+            if (++vistos == n) {
+                fwrite(buf, 1, (size_t)(p - buf), salida);
+                free(buf);
+                return 0;
+            }
+        }
+        fwrite(buf, 1, (size_t)r, salida);
+    }
+    free(buf);
+    return 0;
+}
+
+off_t lineas_copiar_desde(int fd, off_t desde, FILE *salida) {
+    char *buf = malloc(LINEAS_BLOQUE);
+    if (buf == NULL) {
+        return -1;
+    }
+    for (;;) {
+        if (cancelacion_solicitada()) {
+            free(buf);
+            errno = ECANCELED;
+            return -1;
+        }
+        ssize_t r = pread(fd, buf, LINEAS_BLOQUE, desde);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) {
+            free(buf);
+            return -1;
+        }
+        if (r == 0) break;
+        fwrite(buf, 1, (size_t)r, salida);
+        desde += r;
+    }
+    free(buf);
+    return desde;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file medicion.c
+ * @brief Reloj, getrusage() y perf_event_open (ver medicion.h).
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "medicion.h"
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/perf_event.h>)
+#    include <linux/perf_event.h>
+#    define HAY_PERF 1
+#  endif
+#endif
+
+#ifdef HAY_PERF
+static const uint64_t eventos[MEDICION_CONTADORES] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+/** @brief Abre un contador desactivado del hilo actual y sus descendientes. */
+static int abrir_contador(uint64_t evento) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = evento;
+    a.disabled = 1;
+    a.inherit = 1;          /* Hilos y procesos creados durante la medición */
+    a.exclude_kernel = 1;   /* Permitido sin privilegios con paranoid 2 */
+    a.exclude_hv = 1;
+    /* Si hay más contadores que registros, el kernel los turna: se escala */
+    a.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/** @brief Lee un contador escalado por el tiempo que estuvo activo. */
+static int leer_contador(int fd, uint64_t *valor) {
+    uint64_t datos[3];   /* valor, tiempo activado, tiempo contando */
+    if (read(fd, datos, sizeof(datos)) != (ssize_t)sizeof(datos) || datos[2] == 0) {
+        return -1;
+    }
+    *valor = (datos[2] < datos[1])
+           ? (uint64_t)((double)datos[0] * (double)datos[1] / (double)datos[2])
+           : datos[0];
+    return 0;
+}
+#endif
+
+static double segundos(struct timeval t) {
+    return (double)t.tv_sec + (double)t.tv_usec / 1e6;
+}
+
+void medicion_comenzar(Cronometro *c) {
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        c->fds[i] = -1;
+    }
+#ifdef HAY_PERF
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        c->fds[i] = abrir_contador(eventos[i]);
+    }
+#endif
+    getrusage(RUSAGE_SELF, &c->uso);
+    clock_gettime(CLOCK_MONOTONIC, &c->inicio);
+#ifdef HAY_PERF
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        if (c->fds[i] >= 0) ioctl(c->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+void medicion_terminar(Cronometro *c, const struct rusage *hijo, Medicion *m) {
+#ifdef HAY_PERF
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        if (c->fds[i] >= 0) ioctl(c->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+#endif
+    struct timespec fin;
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    memset(m, 0, sizeof(*m));
+    m->real = (double)(fin.tv_sec - c->inicio.tv_sec) + (double)(fin.tv_nsec - c->inicio.tv_nsec) / 1e9;
+
+    if (hijo != NULL) {
+        m->usuario = segundos(hijo->ru_utime);
+        m->sistema = segundos(hijo->ru_stime);
+        m->rss_max_kb = hijo->ru_maxrss;
+        m->fallos_menores = hijo->ru_minflt;
+        m->fallos_mayores = hijo->ru_majflt;
+        m->cambios_voluntarios = hijo->ru_nvcsw;
+        m->cambios_involuntarios = hijo->ru_nivcsw;
+    } else {
+        struct rusage u;
+        getrusage(RUSAGE_SELF, &u);
+        m->usuario = segundos(u.ru_utime) - segundos(c->uso.ru_utime);
+        m->sistema = segundos(u.ru_stime) - segundos(c->uso.ru_stime);
+        m->rss_max_kb = u.ru_maxrss;   /* Pico de toda la shell, no del comando */
+        m->memoria_del_proceso = 1;
+        m->fallos_menores = u.ru_minflt - c->uso.ru_minflt;
+        m->fallos_mayores = u.ru_majflt - c->uso.ru_majflt;
+        m->cambios_voluntarios = u.ru_nvcsw - c->uso.ru_nvcsw;
+        m->cambios_involuntarios = u.ru_nivcsw - c->uso.ru_nivcsw;
+    }
+
+    int validos = 0;
+#ifdef HAY_PERF
+    uint64_t *destinos[MEDICION_CONTADORES] = { &m->ciclos, &m->instrucciones, &m->fallos_cache };
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        if (c->fds[i] >= 0 && leer_contador(c->fds[i], destinos[i]) == 0) {
+            validos++;
+        }
+    }
+#endif
+    m->hay_contadores = (validos == MEDICION_CONTADORES);
+    for (int i = 0; i < MEDICION_CONTADORES; i++) {
+        if (c->fds[i] >= 0) close(c->fds[i]);
+        c->fds[i] = -1;
+    }
+}
@@ -1,4 +1,241 @@
-// Placeholders for utilities to match structure
+/**
+ * @file memory_manager.c
+ * @brief Rastreo opcional de asignaciones (ver las macros MEM_* en utils.h).
+ *
+ * Cada bloque rastreado lleva delante una cabecera que lo enlaza en la
+ * lista de bloques vivos y apunta a su sitio de llamada. Los sitios están
+ * en una tabla de direccionamiento abierto indexada por (archivo, línea);
+ * como __FILE__ es un literal, basta comparar punteros. Todo se protege con
+ * un mutex: es una herramienta de depuración, no un asignador rápido.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
 #include "utils.h"
 
-// Future memory management functions
+/** @brief Capacidad de la tabla de sitios (potencia de 2). */
+#define MAX_SITIOS 1024
+
+/** @brief Marca de un bloque vivo; se borra al liberarlo. */
+#define MARCA_VIVO 0x4541464d454d4f52ULL
+
+/** @brief Cabecera de un bloque; la unión la alinea como malloc(). */
+typedef union Cabecera {
+    struct {
+        union Cabecera *anterior;
+        union Cabecera *siguiente;
+        size_t tam;
+        SitioMemoria *sitio;
+        uint64_t marca;
+    } c;
+    max_align_t alineacion;
+} Cabecera;
+
+static pthread_mutex_t candado = PTHREAD_MUTEX_INITIALIZER;
+static Cabecera *vivos = NULL;
+static SitioMemoria sitios[MAX_SITIOS];
+/** @brief Sitios que ya no caben en la tabla. */
+static SitioMemoria otros = { "(otros sitios)", 0, { 0, 0, 0, 0, 0, 0 } };
+static EstadisticasMemoria totales;
+static int volcado_registrado = 0;
+
+static SitioMemoria *buscar_sitio(const char *archivo, int linea) {
+    size_t h = (((uintptr_t)archivo >> 3) * 31 + (size_t)linea) & (MAX_SITIOS - 1);
+    for (size_t i = 0; i < MAX_SITIOS; i++) {
+        SitioMemoria *s = &sitios[(h + i) & (MAX_SITIOS - 1)];
+        if (s->archivo == NULL) {
+            s->archivo = archivo;
+            s->linea = linea;
+            return s;
+        }
+        if (s->archivo == archivo && s->linea == linea) {
+            return s;
+        }
+    }
+    return &otros;
+}
+
+static void sumar(EstadisticasMemoria *e, size_t n) {
+    e->asignaciones++;
+    e->bytes_totales += n;
+    e->bloques_vivos++;
+    e->bytes_vivos += n;
+    if (e->bytes_vivos > e->pico_bytes) e->pico_bytes = e->bytes_vivos;
+}
+
+static void restar(EstadisticasMemoria *e, size_t n) {
+    e->liberaciones++;
+    e->bloques_vivos--;
+    e->bytes_vivos -= n;
+}
+
+/** @brief Al salir: lista lo que no se liberó (en stderr). */
+static void volcar_al_salir(void) {
+    EstadisticasMemoria e;
+    memoria_estadisticas(&e);
+    if (e.bloques_vivos == 0) {
+        return;
+    }
+    fprintf(stderr, "[memoria] %zu bloque(s) sin liberar (%zu bytes):\n",
+            e.bloques_vivos, e.bytes_vivos);
+    SitioMemoria s[16];
+    size_t n = memoria_sitios(s, 16);
+    for (size_t i = 0; i < n && i < 16 && s[i].e.bloques_vivos > 0; i++) {
+        fprintf(stderr, "  %s:%d: %zu bloque(s), %zu bytes\n",
+                s[i].archivo, s[i].linea, s[i].e.bloques_vivos, s[i].e.bytes_vivos);
+    }
+    memoria_volcar_vivos(stderr, 32);
+}
+
+/** @brief Enlaza un bloque recién reservado y lo anota en su sitio. */
+static void *alta(Cabecera *h, size_t n, const char *archivo, int linea) {
+    pthread_mutex_lock(&candado);
+    h->c.anterior = NULL;
+    h->c.siguiente = vivos;
+    if (vivos != NULL) vivos->c.anterior = h;
+    vivos = h;
+    h->c.tam = n;
+    h->c.sitio = buscar_sitio(archivo, linea);
+    h->c.marca = MARCA_VIVO;
+    sumar(&h->c.sitio->e, n);
+    sumar(&totales, n);
+    if (!volcado_registrado) {
+        volcado_registrado = 1;
+        atexit(volcar_al_salir);
+    }
+    pthread_mutex_unlock(&candado);
+    return h + 1;
+}
+
+/** @brief Cabecera de un bloque, o NULL (con aviso) si no es uno vivo. */
+static Cabecera *cabecera(void *p, const char *operacion) {
+    Cabecera *h = (Cabecera *)p - 1;
+    if (h->c.marca != MARCA_VIVO) {
+        fprintf(stderr, "[memoria] %s de %p: no es un bloque vivo de MEM_* "
+                "(¿liberado dos veces o reservado con malloc?)\n", operacion, p);
+        return NULL;
+    }
+    return h;
+}
+
+void *mem_malloc_rastreado(size_t n, const char *archivo, int linea) {
+    if (n > SIZE_MAX - sizeof(Cabecera)) {
+        return NULL;
+    }
+    Cabecera *h = malloc(sizeof(Cabecera) + n);
+    return (h != NULL) ? alta(h, n, archivo, linea) : NULL;
+}
+
+void *mem_calloc_rastreado(size_t n, size_t tam, const char *archivo, int linea) {
+    if (tam != 0 && n > (SIZE_MAX - sizeof(Cabecera)) / tam) {
+        return NULL;
+    }
+    void *p = mem_malloc_rastreado(n * tam, archivo, linea);
+    if (p != NULL) memset(p, 0, n * tam);
+    return p;
+}
+
+char *mem_strdup_rastreado(const char *s, const char *archivo, int linea) {
+    size_t n = strlen(s) + 1;
+    char *p = mem_malloc_rastreado(n, archivo, linea);
+    if (p != NULL) memcpy(p, s, n);
+    return p;
+}
+
+void *mem_realloc_rastreado(void *p, size_t n, const char *archivo, int linea) {
+    if (p == NULL) {
+        return mem_malloc_rastreado(n, archivo, linea);
+    }
+    Cabecera *h = cabecera(p, "MEM_REALLOC");
+    if (h == NULL || n > SIZE_MAX - sizeof(Cabecera)) {
+        return NULL;
+    }
+    /* Con el candado tomado nadie recorre la lista mientras el bloque se mueve */
+    pthread_mutex_lock(&candado);
+    Cabecera *nuevo = realloc(h, sizeof(Cabecera) + n);
+    if (nuevo == NULL) {
+        pthread_mutex_unlock(&candado);
+        return NULL;
+    }
+    if (nuevo->c.anterior != NULL) nuevo->c.anterior->c.siguiente = nuevo;
+    else vivos = nuevo;
+    if (nuevo->c.siguiente != NULL) nuevo->c.siguiente->c.anterior = nuevo;
+
+    /* El bloque pasa a ser del sitio que lo redimensionó */
+    restar(&nuevo->c.sitio->e, nuevo->c.tam);
+    restar(&totales, nuevo->c.tam);
+    nuevo->c.sitio = buscar_sitio(archivo, linea);
+    nuevo->c.tam = n;
+    sumar(&nuevo->c.sitio->e, n);
+    sumar(&totales, n);
+    pthread_mutex_unlock(&candado);
+    return nuevo + 1;
+}
+
+void mem_free_rastreado(void *p) {
+    if (p == NULL) {
+        return;
+    }
+    Cabecera *h = cabecera(p, "MEM_FREE");
+    if (h == NULL) {
+        return;   /* Mejor una fuga que romper el heap */
+    }
+    pthread_mutex_lock(&candado);
+    if (h->c.anterior != NULL) h->c.anterior->c.siguiente = h->c.siguiente;
+    else vivos = h->c.siguiente;
+    if (h->c.siguiente != NULL) h->c.siguiente->c.anterior = h->c.anterior;
+    restar(&h->c.sitio->e, h->c.tam);
+    restar(&totales, h->c.tam);
+    h->c.marca = 0;
+    pthread_mutex_unlock(&candado);
+    free(h);
+}
+
+void memoria_estadisticas(EstadisticasMemoria *e) {
+    pthread_mutex_lock(&candado);
+    *e = totales;
+    pthread_mutex_unlock(&candado);
+}
+
+static int comparar_sitios(const void *a, const void *b) {
+    const SitioMemoria *x = a, *y = b;
+    if (x->e.bytes_vivos != y->e.bytes_vivos) {
+        return (x->e.bytes_vivos < y->e.bytes_vivos) ? 1 : -1;
+    }
+    if (x->e.bytes_totales != y->e.bytes_totales) {
+        return (x->e.bytes_totales < y->e.bytes_totales) ? 1 : -1;
+    }
+    return 0;
+}
+
+size_t memoria_sitios(SitioMemoria *salida, size_t max) {
+    static SitioMemoria orden[MAX_SITIOS + 1];
+    pthread_mutex_lock(&candado);
+    size_t n = 0;
+    for (size_t i = 0; i < MAX_SITIOS; i++) {
+        if (sitios[i].archivo != NULL) orden[n++] = sitios[i];
+    }
+    if (otros.e.asignaciones > 0) orden[n++] = otros;
+    if (salida != NULL && max > 0) {
+        qsort(orden, n, sizeof(orden[0]), comparar_sitios);
+        memcpy(salida, orden, (n < max ? n : max) * sizeof(orden[0]));
+    }
+    pthread_mutex_unlock(&candado);
+    return n;
+}
+
+size_t memoria_volcar_vivos(FILE *f, size_t max) {
+    pthread_mutex_lock(&candado);
+    size_t n = 0;
+    for (Cabecera *h = vivos; h != NULL; h = h->c.siguiente, n++) {
+        if (n < max) {
+            fprintf(f, "  %p  %8zu bytes  %s:%d\n", (void *)(h + 1), h->c.tam,
+                    h->c.sitio->archivo, h->c.sitio->linea);
+        }
+    }
+    if (n > max) {
+        fprintf(f, "  ... y %zu bloque(s) más\n", n - max);
+    }
+    pthread_mutex_unlock(&candado);
+    return n;
+}
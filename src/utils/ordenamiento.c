@@ -0,0 +1,597 @@
+/**
+ * @file ordenamiento.c
+ * @brief Ordenamiento externo: corridas en paralelo + árbol de perdedores.
+ *
+ * Bloque de memoria durante la lectura:
+ *
+ *   [ líneas leídas ...→ |  libre  | ←... registros (uno por línea) ]
+ *
+ * Las líneas se leen directamente en la parte baja y los registros crecen
+ * desde la parte alta; cuando se encontrarían, el bloque se ordena y se
+ * vuelca. Así el presupuesto se respeta con una sola reserva.
+ *
+ * Para ordenar un bloque, cada hilo ordena un trozo de los registros con
+ * qsort_r() y los trozos se mezclan con el mismo árbol de perdedores que
+ * las corridas de disco mientras se escriben: no hace falta un arreglo
+ * auxiliar del tamaño de los registros.
+ */
+
+#define _GNU_SOURCE   /* qsort_r */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ordenamiento.h"
+#include "hilos.h"
+#include "cancelacion.h"
+#include "configuracion.h" /* variable_obtener (TMPDIR) */
+
+/** @brief Cada cuántas líneas escritas la mezcla mira si se pidió cancelar. */
+#define REVISAR_CANCELACION 4096
+
+/** @brief Corridas que se mezclan a la vez (las demás esperan otra pasada). */
+#define MAX_MEZCLA 64
+
+/** @brief Lectura mínima antes de volcar el bloque. */
+#define LECTURA_MINIMA 4096
+
+/** @brief Menos registros que esto se ordenan en un solo hilo. */
+#define MIN_PARALELO 65536
+
+/** @brief Una línea con su clave ya localizada. */
+typedef struct {
+    const char *linea;
+    size_t len;      /**< Sin el '\n' */
+    size_t clave;    /**< Desplazamiento de la clave dentro de la línea */
+    double num;      /**< Valor numérico de la clave (con -n) */
+} Registro;
+
+static inline int es_blanco(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/** @brief Localiza la clave (campo op->campo) y su valor numérico. */
+static void preparar_registro(const OpcionesOrden *op, Registro *r) {
+    size_t i = 0;
+    for (int campo = 1; campo < op->campo && i < r->len; campo++) {
+        while (i < r->len && es_blanco(r->linea[i])) i++;
+        while (i < r->len && !es_blanco(r->linea[i])) i++;
+    }
+    if (op->campo > 1 || op->numerico) {
+        while (i < r->len && es_blanco(r->linea[i])) i++;
+    }
+    r->clave = i;
+    r->num = 0;
+    if (!op->numerico) return;
+
+    /* [-]dígitos[.dígitos]; lo que no es número vale 0, como en sort -n */
+    const char *p = r->linea + i, *fin = r->linea + r->len;
+    int negativo = 0;
+    if (p < fin && (*p == '-' || *p == '+')) negativo = *p++ == '-';
+    double v = 0, escala = 1;
+    while (p < fin && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+    if (p < fin && *p == '.') {
+        for (p++; p < fin && *p >= '0' && *p <= '9'; p++) {
+            escala /= 10;
+            v += (*p - '0') * escala;
+        }
+    }
+    r->num = negativo ? -v : v;
+}
+
+static int comparar_bytes(const char *a, size_t la, const char *b, size_t lb) {
+    int r = memcmp(a, b, la < lb ? la : lb);
+    return r != 0 ? r : (la > lb) - (la < lb);
+}
+
+/** @brief Compara solo las claves (sin -r ni desempate). */
+static int comparar_claves(const OpcionesOrden *op, const Registro *a, const Registro *b) {
+    if (op->numerico) {
+        return (a->num > b->num) - (a->num < b->num);
+    }
+    return comparar_bytes(a->linea + a->clave, a->len - a->clave,
+                          b->linea + b->clave, b->len - b->clave);
+}
+
+/**
+ * @brief Orden total: clave y, si empatan, la línea completa (salvo con -u,
+ *        donde las claves iguales son la misma línea).
+ */
+static int comparar_registros(const void *x, const void *y, void *datos) {
+    const OpcionesOrden *op = datos;
+    const Registro *a = x, *b = y;
+    int r = comparar_claves(op, a, b);
+    if (r == 0 && !op->unico) {
+        r = comparar_bytes(a->linea, a->len, b->linea, b->len);
+    }
+    return op->inverso ? -r : r;
+}
+
+/* =============================================================================
+ * Fuentes y árbol de perdedores
+ * ========================================================================== */
+
+/** @brief Origen de líneas ordenadas: un trozo en memoria o una corrida en disco. */
+typedef struct {
+    Registro actual;
+    int agotada;
+    const Registro *sig, *fin;   /**< En memoria */
+    FILE *f;                     /**< En disco */
+    char *buf;
+    size_t cap;
+} Fuente;
+
+static void fuente_avanzar(Fuente *f, const OpcionesOrden *op) {
+    if (f->f == NULL) {
+        if (f->sig == f->fin) {
+            f->agotada = 1;
+        } else {
+            f->actual = *f->sig++;
+        }
+        return;
+    }
+    ssize_t n = getline(&f->buf, &f->cap, f->f);
+    if (n <= 0) {
+        f->agotada = 1;
+        return;
+    }
+    if (f->buf[n - 1] == '\n') n--;
+    f->actual.linea = f->buf;
+    f->actual.len = (size_t)n;
+    preparar_registro(op, &f->actual);
+}
+
+typedef struct {
+    Fuente *fuentes;
+    int k;
+    int *perdedor;   /**< perdedor[1..k-1]: nodos internos; perdedor[0]: ganador */
+    const OpcionesOrden *op;
+} ArbolPerdedores;
+
+/** @brief ¿La fuente a va antes que b? Las agotadas van al final. */
+static int va_antes(const ArbolPerdedores *t, int a, int b) {
+    const Fuente *fa = &t->fuentes[a], *fb = &t->fuentes[b];
+    if (fa->agotada || fb->agotada) {
+        return fb->agotada && (!fa->agotada || a < b);
+    }
+    int r = comparar_registros(&fa->actual, &fb->actual, (void *)t->op);
+    return r < 0 || (r == 0 && a < b);
+}
+
+static int arbol_construir(ArbolPerdedores *t) {
+    int k = t->k;
+    int *ganador = malloc(2 * (size_t)k * sizeof(int));
+    t->perdedor = malloc((size_t)k * sizeof(int));
+    if (ganador == NULL || t->perdedor == NULL) {
+        free(ganador);
+        free(t->perdedor);
+        return -1;
+    }
+    for (int i = 0; i < k; i++) ganador[k + i] = i;
+    for (int i = k - 1; i >= 1; i--) {
+        int a = ganador[2 * i], b = ganador[2 * i + 1];
+        int gana = va_antes(t, a, b) ? a : b;
+        ganador[i] = gana;
+        t->perdedor[i] = gana == a ? b : a;
+    }
+    t->perdedor[0] = k == 1 ? 0 : ganador[1];
+    free(ganador);
+    return 0;
+}
+
+/** @brief Tras avanzar la fuente ganadora, rehace su camino hasta la raíz. */
+static void arbol_rehacer(ArbolPerdedores *t) {
+    int w = t->perdedor[0];
+    for (int nodo = (w + t->k) / 2; nodo >= 1; nodo /= 2) {
+        if (va_antes(t, t->perdedor[nodo], w)) {
+            int tmp = t->perdedor[nodo];
+            t->perdedor[nodo] = w;
+            w = tmp;
+        }
+    }
+    t->perdedor[0] = w;
+}
+
+/** @brief Copia de la última línea escrita (para -u). */
+typedef struct {
+    Registro r;
+    char *datos;
+    size_t cap;
+} Ultima;
+
+/**
+ * @brief Mezcla k fuentes ya posicionadas en su primera línea.
+ * @return 0, o -1 con errno.
+ */
+static int mezclar(Fuente *fuentes, int k, const OpcionesOrden *op, FILE *salida) {
+    ArbolPerdedores t = { fuentes, k, NULL, op };
+    if (arbol_construir(&t) != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    Ultima ultima = { {0}, NULL, 0 };
+    int hay_ultima = 0, resultado = 0;
+    size_t vueltas = 0;
+
+    while (!fuentes[t.perdedor[0]].agotada) {
+        if (++vueltas % REVISAR_CANCELACION == 0 && cancelacion_solicitada()) {
+            errno = ECANCELED;
+            resultado = -1;
+            break;
+        }
+        Fuente *f = &fuentes[t.perdedor[0]];
+        if (!op->unico || !hay_ultima || comparar_claves(op, &ultima.r, &f->actual) != 0) {
+            if (fwrite(f->actual.linea, 1, f->actual.len, salida) != f->actual.len ||
+                putc('\n', salida) == EOF) {
+                resultado = -1;
+                break;
+            }
+            if (op->unico) {
+                /* La línea de una corrida en disco se sobrescribe al avanzar */
+                if (f->actual.len > ultima.cap) {
+                    char *tmp = realloc(ultima.datos, f->actual.len * 2);
+                    if (tmp == NULL) {
+                        errno = ENOMEM;
+                        resultado = -1;
+                        break;
+                    }
+                    ultima.datos = tmp;
+                    ultima.cap = f->actual.len * 2;
+                }
+                memcpy(ultima.datos, f->actual.linea, f->actual.len);
+                ultima.r = f->actual;
+                ultima.r.linea = ultima.datos;
+                hay_ultima = 1;
+            }
+        }
+        fuente_avanzar(f, op);
+        arbol_rehacer(&t);
+    }
+    free(ultima.datos);
+    free(t.perdedor);
+    return resultado;
+}
+
+/* =============================================================================
+ * Corridas
+ * ========================================================================== */
+
+typedef struct {
+    const OpcionesOrden *op;
+    char *mem;            /**< Bloque de memoria (presupuesto) */
+    size_t tam;           /**< Tamaño útil del bloque (múltiplo de sizeof(Registro)) */
+    size_t usado;         /**< Bytes de líneas en la parte baja */
+    size_t pendiente;     /**< Inicio de la línea aún incompleta */
+    size_t n;             /**< Registros en la parte alta */
+    int *corridas;        /**< Descriptores de las corridas (-1 = ya cerrada) */
+    size_t n_corridas, cap_corridas;
+    char *buf_escritura;  /**< Buffer del stream que escribe cada corrida */
+    size_t tam_buf;
+} Ordenador;
+
+static inline Registro *registros(Ordenador *o) {
+    return (Registro *)(o->mem + o->tam) - o->n;
+}
+
+typedef struct {
+    Registro *regs;
+    size_t n;
+    size_t trozos;
+    const OpcionesOrden *op;
+} DatosOrdenar;
+
+static void tarea_ordenar(size_t i, void *datos) {
+    DatosOrdenar *d = datos;
+    size_t desde = d->n * i / d->trozos, hasta = d->n * (i + 1) / d->trozos;
+    qsort_r(d->regs + desde, hasta - desde, sizeof(Registro), comparar_registros, (void *)d->op);
+}
+
+/**
+ * @brief Ordena los registros del bloque y los escribe mezclando los trozos.
+ */
+static int escribir_bloque(Ordenador *o, FILE *salida) {
+    Registro *regs = registros(o);
+    int hilos = hilos_disponibles();
+    size_t trozos = o->n >= MIN_PARALELO ? (size_t)hilos : 1;
+    if (trozos > MAX_MEZCLA) trozos = MAX_MEZCLA;
+    if (trozos > o->n) trozos = o->n ? o->n : 1;
+
+    DatosOrdenar d = { regs, o->n, trozos, o->op };
+    ejecutar_en_paralelo(trozos, hilos, tarea_ordenar, &d);
+
+    Fuente fuentes[MAX_MEZCLA];
+    memset(fuentes, 0, sizeof(fuentes));
+    for (size_t i = 0; i < trozos; i++) {
+        fuentes[i].sig = regs + o->n * i / trozos;
+        fuentes[i].fin = regs + o->n * (i + 1) / trozos;
+        fuente_avanzar(&fuentes[i], o->op);
+    }
+    return mezclar(fuentes, (int)trozos, o->op, salida);
+}
+
+/**
+ * @brief Crea un archivo temporal anónimo (ya borrado del directorio), así
+ *        que nunca quedan corridas huérfanas aunque el proceso muera.
+ */
+static int temporal_anonimo(void) {
+    const char *dir = variable_obtener("TMPDIR");
+    char ruta[4096];
+    snprintf(ruta, sizeof(ruta), "%s/eafitos_orden_XXXXXX", dir && *dir ? dir : "/tmp");
+    int fd = mkostemp(ruta, O_CLOEXEC);
+    if (fd >= 0) unlink(ruta);
+    return fd;
+}
+
+/**
+ * @brief Abre un stream sobre una copia del descriptor con el buffer dado
+ *        (fclose() cierra la copia y el descriptor sigue abierto).
+ */
+static FILE *stream_con_buffer(int fd, const char *modo, char *buf, size_t tam) {
+    int copia = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    FILE *f = copia < 0 ? NULL : fdopen(copia, modo);
+    if (f == NULL) {
+        if (copia >= 0) close(copia);
+        return NULL;
+    }
+    setvbuf(f, buf, _IOFBF, tam);
+    return f;
+}
+
+static int agregar_corrida(Ordenador *o, int fd) {
+    if (o->n_corridas == o->cap_corridas) {
+        size_t nueva = o->cap_corridas ? o->cap_corridas * 2 : 16;
+        int *tmp = realloc(o->corridas, nueva * sizeof(int));
+        if (tmp == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        o->corridas = tmp;
+        o->cap_corridas = nueva;
+    }
+    o->corridas[o->n_corridas++] = fd;
+    return 0;
+}
+
+/** @brief Escribe el bloque como corrida y deja solo la línea incompleta. */
+static int volcar(Ordenador *o) {
+    int fd = temporal_anonimo();
+    FILE *f = fd < 0 ? NULL : stream_con_buffer(fd, "w", o->buf_escritura, o->tam_buf);
+    if (f == NULL) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    int r = escribir_bloque(o, f);
+    if (fclose(f) != 0) r = -1;
+    if (r != 0 || agregar_corrida(o, fd) != 0) {
+        close(fd);
+        return -1;
+    }
+    memmove(o->mem, o->mem + o->pendiente, o->usado - o->pendiente);
+    o->usado -= o->pendiente;
+    o->pendiente = 0;
+    o->n = 0;
+    return 0;
+}
+
+/** @brief Registra la línea [pendiente, fin) que ya está completa. */
+static void agregar_registro(Ordenador *o, size_t fin, size_t siguiente) {
+    o->n++;
+    Registro *r = registros(o);
+    r->linea = o->mem + o->pendiente;
+    r->len = fin - o->pendiente;
+    preparar_registro(o->op, r);
+    o->pendiente = siguiente;
+}
+
+/** @brief Lee un archivo completo hacia el bloque, volcando cuando se llena. */
+static int leer_entrada(Ordenador *o, int fd, uint64_t *lineas) {
+    for (;;) {
+        if (cancelacion_solicitada()) {
+            errno = ECANCELED;
+            return -1;
+        }
+        /* Cada byte leído puede ser una línea entera ("\n"): reservamos su registro */
+        size_t libre = o->tam - o->n * sizeof(Registro) - o->usado;
+        size_t a_leer = libre / (1 + sizeof(Registro));
+        if (a_leer < LECTURA_MINIMA) {
+            if (o->n == 0) {
+                errno = E2BIG;    /* Una sola línea llena el presupuesto */
+                return -1;
+            }
+            if (volcar(o) != 0) return -1;
+            continue;
+        }
+        ssize_t leidos = read(fd, o->mem + o->usado, a_leer);
+        if (leidos < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (leidos == 0) break;
+        size_t desde = o->usado;
+        o->usado += (size_t)leidos;
+        const char *p;
+        while ((p = memchr(o->mem + desde, '\n', o->usado - desde)) != NULL) {
+            size_t fin = (size_t)(p - o->mem);
+            agregar_registro(o, fin, fin + 1);
+            desde = fin + 1;
+            (*lineas)++;
+        }
+    }
+    if (o->pendiente < o->usado) {
+        /* Última línea sin '\n' */
+        agregar_registro(o, o->usado, o->usado);
+        (*lineas)++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Mezcla corridas de disco; la última pasada escribe en 'salida'.
+ */
+static int mezclar_corridas(Ordenador *o, FILE *salida, int *pasadas) {
+    size_t primera = 0;
+    while (o->n_corridas - primera > 0) {
+        size_t k = o->n_corridas - primera;
+        int final = k <= MAX_MEZCLA;
+        if (!final) k = MAX_MEZCLA;
+
+        /* Sin el bloque de lectura, el presupuesto se reparte entre los buffers */
+        size_t por_fuente = o->op->memoria / (k + 1);
+        if (por_fuente < 65536) por_fuente = 65536;
+
+        Fuente fuentes[MAX_MEZCLA];
+        char *buffers[MAX_MEZCLA + 1];
+        memset(fuentes, 0, sizeof(fuentes));
+        memset(buffers, 0, sizeof(buffers));
+        int r = 0;
+        for (size_t i = 0; i < k && r == 0; i++) {
+            buffers[i] = malloc(por_fuente);
+            lseek(o->corridas[primera + i], 0, SEEK_SET);
+            fuentes[i].f = buffers[i] == NULL ? NULL
+                         : stream_con_buffer(o->corridas[primera + i], "r", buffers[i], por_fuente);
+            if (fuentes[i].f == NULL) r = -1;
+            else fuente_avanzar(&fuentes[i], o->op);
+        }
+
+        int fd_destino = -1;
+        FILE *destino = salida;
+        if (r == 0 && !final) {
+            buffers[k] = malloc(por_fuente);
+            fd_destino = buffers[k] == NULL ? -1 : temporal_anonimo();
+            destino = fd_destino < 0 ? NULL
+                    : stream_con_buffer(fd_destino, "w", buffers[k], por_fuente);
+            if (destino == NULL) r = -1;
+        }
+        if (r == 0) r = mezclar(fuentes, (int)k, o->op, destino);
+        int error = errno;
+
+        if (destino != NULL && destino != salida && fclose(destino) != 0 && r == 0) {
+            error = errno;
+            r = -1;
+        }
+        for (size_t i = 0; i < k; i++) {
+            if (fuentes[i].f != NULL) fclose(fuentes[i].f);
+            free(fuentes[i].buf);
+            close(o->corridas[primera + i]);
+            o->corridas[primera + i] = -1;
+        }
+        for (size_t i = 0; i <= k; i++) free(buffers[i]);
+        primera += k;
+        (*pasadas)++;
+        if (r == 0 && !final && agregar_corrida(o, fd_destino) != 0) {
+            error = errno;
+            r = -1;
+        }
+        if (r != 0) {
+            if (fd_destino >= 0 && (o->n_corridas == 0 || o->corridas[o->n_corridas - 1] != fd_destino)) {
+                close(fd_destino);
+            }
+            errno = error ? error : ENOMEM;
+            return -1;
+        }
+        if (final) break;
+    }
+    return 0;
+}
+
+int ordenar_archivos(int dir_fd, const char *const *rutas, size_t n, int entrada,
+                     const OpcionesOrden *op, const char *ruta_salida, FILE *salida,
+                     ResumenOrden *resumen, const char **ruta_error) {
+    /* Dentro de `limite -m`, el bloque no pasa de lo que queda del presupuesto */
+    OpcionesOrden acotadas = *op;
+    size_t libre = limite_memoria_libre();
+    if (acotadas.memoria > libre) acotadas.memoria = libre;
+    int cargada = (limite_cargar(acotadas.memoria) == 0);
+
+    Ordenador o;
+    memset(&o, 0, sizeof(o));
+    o.op = &acotadas;
+    /* Un 1/16 del presupuesto es el buffer de escritura de las corridas */
+    o.tam_buf = acotadas.memoria / 16;
+    o.tam = (acotadas.memoria - o.tam_buf) / sizeof(Registro) * sizeof(Registro);
+    o.mem = malloc(o.tam);
+    o.buf_escritura = malloc(o.tam_buf);
+    ResumenOrden res = {0, 0, 0};
+    int resultado = -1, error = 0;
+    FILE *destino = NULL;
+    if (!cargada || o.mem == NULL || o.buf_escritura == NULL) {
+        error = ENOMEM;
+        goto salir;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        int fd = openat(dir_fd, rutas[i], O_RDONLY | O_CLOEXEC);
+        int r = fd < 0 ? -1 : leer_entrada(&o, fd, &res.lineas);
+        error = errno;
+        if (fd >= 0) close(fd);
+        if (r != 0) {
+            if (ruta_error != NULL) *ruta_error = rutas[i];
+            goto salir;
+        }
+        /* La línea final sin '\n' de un archivo no se une con el siguiente */
+        o.pendiente = o.usado;
+    }
+    if (n == 0 && leer_entrada(&o, entrada, &res.lineas) != 0) {
+        error = errno;
+        goto salir;
+    }
+
+    /* La salida se abre ahora: puede ser uno de los archivos de entrada */
+    destino = salida;
+    if (ruta_salida != NULL) {
+        int fd = openat(dir_fd, ruta_salida, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        destino = fd < 0 ? NULL : fdopen(fd, "w");
+        if (destino == NULL) {
+            error = errno;
+            if (fd >= 0) close(fd);
+            if (ruta_error != NULL) *ruta_error = ruta_salida;
+            goto salir;
+        }
+    }
+
+    if (o.n_corridas == 0) {
+        /* Todo cupo en memoria: se ordena y se escribe directamente */
+        if (escribir_bloque(&o, destino) != 0) {
+            error = errno;
+            goto salir;
+        }
+    } else {
+        if (o.n > 0 && volcar(&o) != 0) {
+            error = errno;
+            goto salir;
+        }
+        res.corridas = o.n_corridas;
+        /* El bloque ya no hace falta: su memoria pasa a los buffers de mezcla */
+        free(o.mem);
+        o.mem = NULL;
+        free(o.buf_escritura);
+        o.buf_escritura = NULL;
+        if (mezclar_corridas(&o, destino, &res.pasadas) != 0) {
+            error = errno;
+            goto salir;
+        }
+    }
+    if (fflush(destino) != 0) {
+        error = errno;
+        goto salir;
+    }
+    resultado = 0;
+
+salir:
+    if (destino != NULL && destino != salida && fclose(destino) != 0 && resultado == 0) {
+        error = errno;
+        resultado = -1;
+    }
+    for (size_t i = 0; i < o.n_corridas; i++) {
+        if (o.corridas[i] >= 0) close(o.corridas[i]);
+    }
+    free(o.corridas);
+    free(o.mem);
+    free(o.buf_escritura);
+    if (cargada) limite_descargar(acotadas.memoria);
+    if (resumen != NULL) *resumen = res;
+    if (resultado != 0) errno = error;
+    return resultado;
+}
@@ -0,0 +1,237 @@
+/**
+ * @file reemplazo.c
+ * @brief Reemplazo de cadenas con temporal y rename() (ver reemplazo.h).
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "reemplazo.h"
+#include "subcadena.h"
+#include "cancelacion.h"
+
+/** @brief Tramos que se acumulan antes de cada writev(). */
+#define REEMPLAZO_TRAMOS 1024
+
+/** @brief Bytes que se examinan entre dos consultas de Ctrl+C al buscar. */
+#define REEMPLAZO_VENTANA (64u * 1024 * 1024)
+
+/** @brief Distingue los temporales de varios hilos del mismo proceso. */
+static atomic_uint contador_temporales;
+
+/**
+ * @brief Siguiente aparición de la aguja en [p, fin), por ventanas para
+ *        poder atender Ctrl+C en archivos enormes sin coincidencias.
+ * @return La aparición, o NULL si no hay más (o se pidió cancelar).
+ */
+static const char *siguiente(const char *p, const char *fin, const char *aguja, size_t m) {
+    while ((size_t)(fin - p) >= m) {
+        size_t n = (size_t)(fin - p);
+        if (n > REEMPLAZO_VENTANA + m - 1) n = REEMPLAZO_VENTANA + m - 1;
+        const char *e = buscar_subcadena(p, n, aguja, m);
+        if (e != NULL) return e;
+        p += n - (m - 1);   /* La ventana siguiente repite los últimos m-1 bytes */
+        if (cancelacion_solicitada()) return NULL;
+    }
+    return NULL;
+}
+
+/** @brief Acumulador de tramos para writev(). */
+typedef struct {
+    int fd;
+    struct iovec tramos[REEMPLAZO_TRAMOS];
+    int n;
+} Escritor;
+
+/** @brief Escribe los tramos acumulados, reintentando las escrituras parciales. */
+static int vaciar(Escritor *w) {
+    struct iovec *v = w->tramos;
+    int n = w->n;
+    while (n > 0) {
+        ssize_t escritos = writev(w->fd, v, n);
+        if (escritos < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (n > 0 && (size_t)escritos >= v->iov_len) {
+            escritos -= (ssize_t)v->iov_len;
+            v++;
+            n--;
+        }
+        if (n > 0) {
+            v->iov_base = (char *)v->iov_base + escritos;
+            v->iov_len -= (size_t)escritos;
+        }
+    }
+    w->n = 0;
+    if (cancelacion_solicitada()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    return 0;
+}
+
+static int agregar(Escritor *w, const void *datos, size_t n) {
+    if (n == 0) return 0;
+    if (w->n == REEMPLAZO_TRAMOS && vaciar(w) != 0) return -1;
+    w->tramos[w->n].iov_base = (void *)datos;
+    w->tramos[w->n].iov_len = n;
+    w->n++;
+    return 0;
+}
+
+/**
+ * @brief Crea un temporal vacío en el directorio de 'ruta'.
+ * @param nombre Recibe la ruta del temporal (relativa a dir_fd).
+ * @return Descriptor abierto para escribir, o -1 con errno.
+ */
+static int crear_temporal(int dir_fd, const char *ruta, char *nombre, size_t cap) {
+    const char *barra = strrchr(ruta, '/');
+    int largo_dir = barra ? (int)(barra - ruta + 1) : 0;
+    for (int intento = 0; intento < 100; intento++) {
+        int cabe = snprintf(nombre, cap, "%.*s" REEMPLAZO_PREFIJO_TEMPORAL "%ld-%u",
+                            largo_dir, ruta, (long)getpid(),
+                            atomic_fetch_add(&contador_temporales, 1));
+        if (cabe < 0 || (size_t)cabe >= cap) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        int fd = openat(dir_fd, nombre, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd >= 0 || errno != EEXIST) return fd;
+    }
+    return -1;
+}
+
+/**
+ * @brief Escribe el texto con los reemplazos en 'fd' a partir de la primera
+ *        aparición ya encontrada.
+ */
+static int escribir_reemplazado(int fd, const char *texto, size_t n, const char *primera,
+                                const char *buscar, size_t m,
+                                const char *reemplazo, size_t r, uint64_t *cuenta) {
+    static __thread Escritor w;   /* 16 KB: mejor fuera de la pila de los hilos */
+    w.fd = fd;
+    w.n = 0;
+    const char *fin = texto + n;
+    const char *p = texto;
+    for (const char *e = primera; e != NULL; e = siguiente(p, fin, buscar, m)) {
+        if (agregar(&w, p, (size_t)(e - p)) != 0 || agregar(&w, reemplazo, r) != 0) {
+            return -1;
+        }
+        (*cuenta)++;
+        p = e + m;
+    }
+    if (cancelacion_solicitada()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    if (agregar(&w, p, (size_t)(fin - p)) != 0) return -1;
+    return vaciar(&w);
+}
+
+int reemplazar_en_archivo(int dir_fd, const char *ruta,
+                          const char *buscar, size_t m,
+                          const char *reemplazo, size_t r,
+                          ResultadoReemplazo *res) {
+    res->reemplazos = 0;
+    res->reescrito = 0;
+
+    /* rename() sustituiría el enlace por un archivo: se rechaza */
+    struct stat st;
+    if (fstatat(dir_fd, ruta, &st, AT_SYMLINK_NOFOLLOW) != 0) return -1;
+    if (S_ISLNK(st.st_mode)) {
+        errno = ELOOP;
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        errno = EISDIR;
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = openat(dir_fd, ruta, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        int e = errno;
+        if (fd >= 0) close(fd);
+        errno = e;
+        return -1;
+    }
+    if ((size_t)st.st_size < m) {
+        close(fd);
+        return 0;   /* Vacío o más corto que lo buscado: nada que hacer */
+    }
+    size_t n = (size_t)st.st_size;
+    const char *texto = mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (texto == MAP_FAILED) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    madvise((void *)texto, n, MADV_SEQUENTIAL);
+
+    int resultado = 0;
+    const char *primera = siguiente(texto, texto + n, buscar, m);
+    if (cancelacion_solicitada()) {
+        errno = ECANCELED;
+        resultado = -1;
+    } else if (primera == NULL) {
+        /* Sin apariciones: el archivo no se reescribe */
+    } else if (m == r && memcmp(buscar, reemplazo, m) == 0) {
+        /* El resultado sería idéntico: solo se cuentan */
+        for (const char *e = primera; e != NULL; e = siguiente(e + m, texto + n, buscar, m)) {
+            res->reemplazos++;
+        }
+    } else {
+        char temporal[PATH_MAX];
+        int tmp = crear_temporal(dir_fd, ruta, temporal, sizeof(temporal));
+        if (tmp < 0) {
+            resultado = -1;
+        } else {
+            /* Los permisos primero: el temporal nunca es más visible que el original */
+            if (fchmod(tmp, st.st_mode & 07777) != 0 ||
+                escribir_reemplazado(tmp, texto, n, primera, buscar, m,
+                                     reemplazo, r, &res->reemplazos) != 0 ||
+                fdatasync(tmp) != 0) {
+                resultado = -1;
+            }
+            if (resultado == 0) {
+                /* Sin privilegios falla y el dueño pasa a ser quien reemplaza */
+                int ignorado = fchown(tmp, st.st_uid, st.st_gid);
+                (void)ignorado;
+            }
+            int e = errno;
+            if (close(tmp) != 0 && resultado == 0) {
+                e = errno;
+                resultado = -1;
+            }
+            if (resultado == 0 && renameat(dir_fd, temporal, dir_fd, ruta) != 0) {
+                e = errno;
+                resultado = -1;
+            }
+            if (resultado != 0) {
+                unlinkat(dir_fd, temporal, 0);
+                res->reemplazos = 0;
+                errno = e;
+            } else {
+                res->reescrito = 1;
+            }
+        }
+    }
+
+    int e = errno;
+    munmap((void *)texto, n);
+    close(fd);
+    errno = e;
+    return resultado;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file subcadena.c
+ * @brief Búsqueda de subcadenas con filtro SIMD por primer y último byte.
+ *
+ * Para cada bloque de posiciones i..i+15 se cargan dos vectores: uno desde
+ * i (comparado con aguja[0]) y otro desde i+m-1 (comparado con
+ * aguja[m-1]). El AND de ambas comparaciones deja como candidatas solo las
+ * posiciones donde la aguja puede empezar; el resto del texto no se toca
+ * byte a byte. El final del texto que no llena un vector se resuelve con
+ * memmem().
+ */
+
+#define _GNU_SOURCE   /* memmem */
+#include <stdint.h>
+#include <string.h>
+#include "subcadena.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#  define HAY_X86_SIMD 1
+#endif
+
+typedef const char *(*FuncionSubcadena)(const char *texto, size_t n, const char *aguja, size_t m);
+
+static const char *subcadena_escalar(const char *texto, size_t n, const char *aguja, size_t m) {
+    return memmem(texto, n, aguja, m);
+}
+
+#ifdef HAY_X86_SIMD
+
+/**
+ * @brief Versión SSE2 (presente en toda CPU x86-64): 16 posiciones por vuelta.
+ */
+__attribute__((target("sse2")))
+static const char *subcadena_sse2(const char *texto, size_t n, const char *aguja, size_t m) {
+    const __m128i primero = _mm_set1_epi8(aguja[0]);
+    const __m128i ultimo = _mm_set1_epi8(aguja[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(texto + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(texto + i + m - 1));
+        unsigned mascara = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, primero), _mm_cmpeq_epi8(b, ultimo)));
+        while (mascara != 0) {
+            unsigned bit = (unsigned)__builtin_ctz(mascara);
+            if (memcmp(texto + i + bit + 1, aguja + 1, m - 2) == 0) {
+                return texto + i + bit;
+            }
+            mascara &= mascara - 1;
+        }
+    }
+    return memmem(texto + i, n - i, aguja, m);
+}
+
+/**
+ * @brief Versión AVX2: 32 posiciones por vuelta.
+ */
+__attribute__((target("avx2")))
+static const char *subcadena_avx2(const char *texto, size_t n, const char *aguja, size_t m) {
+    const __m256i primero = _mm256_set1_epi8(aguja[0]);
+    const __m256i ultimo = _mm256_set1_epi8(aguja[m - 1]);
+    size_t i = 0;
+    for (; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(texto + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(texto + i + m - 1));
+        uint32_t mascara = (uint32_t)_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, primero), _mm256_cmpeq_epi8(b, ultimo)));
+        while (mascara != 0) {
+            unsigned bit = (unsigned)__builtin_ctz(mascara);
+            if (memcmp(texto + i + bit + 1, aguja + 1, m - 2) == 0) {
+                return texto + i + bit;
+            }
+            mascara &= mascara - 1;
+        }
+    }
+    return memmem(texto + i, n - i, aguja, m);
+}
+
+#endif /* HAY_X86_SIMD */
+
+/**
+ * @brief Elige la mejor implementación para esta CPU (una sola vez).
+ */
+static FuncionSubcadena elegir_subcadena(void) {
+#ifdef HAY_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return subcadena_avx2;
+    if (__builtin_cpu_supports("sse2")) return subcadena_sse2;
+#endif
+    return subcadena_escalar;
+}
+
+const char *buscar_subcadena(const char *texto, size_t n, const char *aguja, size_t m) {
+    if (m == 0) return texto;
+    if (m > n) return NULL;
+    if (m == 1) return memchr(texto, aguja[0], n);
+
+    /* Igual que en conteo.c: si dos hilos eligen a la vez, eligen lo mismo */
+    static FuncionSubcadena elegida = NULL;
+    FuncionSubcadena fn = __atomic_load_n(&elegida, __ATOMIC_RELAXED);
+    if (fn == NULL) {
+        fn = elegir_subcadena();
+        __atomic_store_n(&elegida, fn, __ATOMIC_RELAXED);
+    }
+    return fn(texto, n, aguja, m);
+}
@@ -0,0 +1,368 @@
+/**
+ * @file trabajos.c
+ * @brief Ejecución de una línea con la salida capturada (ver trabajos.h).
+ */
+
+#define _GNU_SOURCE   /* memfd_create, posix_spawn_file_actions_addfchdir_np */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>   /* wait4, getrusage, setrlimit */
+#include <sys/stat.h>
+#include <sys/syscall.h>    /* pidfd_open */
+#include <sys/wait.h>
+#include "trabajos.h"
+#include "colors.h"
+#include "formato.h"
+#include "cancelacion.h"
+#include "utils.h"    /* MEM_STRDUP, MEM_FREE */
+#include "configuracion.h" /* alias_copiar, variables_copiar, variables_entorno */
+
+/** @brief Entrada de los comandos de la shell: siempre da EOF. */
+static FILE *entrada_vacia = NULL;
+
+static pthread_once_t inicializado = PTHREAD_ONCE_INIT;
+
+static void abrir_entrada_vacia(void) {
+    entrada_vacia = fopen("/dev/null", "r");
+}
+
+/**
+ * @brief Copia lo que escribió el programa (en el memfd) a la salida de la sesión.
+ */
+static void volcar_memfd(int fd) {
+    char buf[65536];
+    off_t pos = 0;
+    ssize_t n;
+    while ((n = pread(fd, buf, sizeof(buf), pos)) > 0) {
+        fwrite(buf, 1, (size_t)n, salida_sesion());
+        pos += n;
+    }
+}
+
+/** @brief Gracia entre SIGTERM y SIGKILL al detener un programa (ms). */
+#define GRACIA_TERMINAR_MS 2000
+
+/**
+ * @brief Espera a que el hijo termine, sin recogerlo.
+ *
+ * Duerme en poll() sobre un pidfd del hijo, el pipe de Ctrl+C y el timerfd
+ * del límite del hilo: sin hilos auxiliares ni sondeo. Si se cancela o
+ * vence el plazo, envía SIGTERM y, si sigue vivo tras la gracia, SIGKILL.
+ * Sin pidfd (kernel < 5.3) revisa el hijo cada 10 ms.
+ */
+static void esperar_hijo(pid_t pid) {
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    int terminando = 0, tics = 0;
+    for (;;) {
+        siginfo_t info;
+        info.si_pid = 0;
+        if (waitid(P_PID, (id_t)pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid) {
+            break;
+        }
+        if (!terminando && cancelacion_solicitada()) {
+            kill(pid, SIGTERM);
+            terminando = 1;
+        }
+        /* Tras el SIGTERM solo importa el hijo: el pipe y el timerfd
+         * seguirían legibles y poll() no dormiría */
+        struct pollfd pfd[3] = {
+            { pidfd, POLLIN, 0 },
+            { terminando ? -1 : cancelacion_fd(), POLLIN, 0 },
+            { terminando ? -1 : limite_fd(), POLLIN, 0 },
+        };
+        int espera = (pidfd < 0) ? 10 : terminando ? GRACIA_TERMINAR_MS : -1;
+        if (poll(pfd, 3, espera) == 0 && terminando == 1 &&
+            (pidfd >= 0 || ++tics * 10 >= GRACIA_TERMINAR_MS)) {
+            kill(pid, SIGKILL);
+            terminando = 2;
+        }
+    }
+    if (pidfd >= 0) close(pidfd);
+}
+
+/**
+ * @brief Lanza el programa con posix_spawnp(), aplicando las redirecciones
+ *        en el proceso nuevo después de cambiar al directorio de la sesión.
+ * @return 0, o el errno del fallo.
+ */
+static int lanzar_con_spawn(char **args, char **entorno, const Redirecciones *r, int fd,
+                            int fd_errores, pid_t *pid) {
+    posix_spawn_file_actions_t acciones;
+    posix_spawn_file_actions_init(&acciones);
+    if (sesion_actual->dir_fd >= 0) {
+        posix_spawn_file_actions_addfchdir_np(&acciones, sesion_actual->dir_fd);
+    }
+    posix_spawn_file_actions_addopen(&acciones, STDIN_FILENO,
+                                     r->entrada ? r->entrada : "/dev/null", O_RDONLY, 0);
+    if (r->salida != NULL) {
+        posix_spawn_file_actions_addopen(&acciones, STDOUT_FILENO, r->salida,
+                                         O_WRONLY | O_CREAT | (r->anexar_salida ? O_APPEND : O_TRUNC), 0666);
+    } else {
+        posix_spawn_file_actions_adddup2(&acciones, fd, STDOUT_FILENO);
+    }
+    if (r->errores != NULL && r->errores == r->salida) {
+        posix_spawn_file_actions_adddup2(&acciones, STDOUT_FILENO, STDERR_FILENO);
+    } else if (r->errores != NULL) {
+        posix_spawn_file_actions_addopen(&acciones, STDERR_FILENO, r->errores,
+                                         O_WRONLY | O_CREAT | (r->anexar_errores ? O_APPEND : O_TRUNC), 0666);
+    } else {
+        posix_spawn_file_actions_adddup2(&acciones, fd_errores, STDERR_FILENO);
+    }
+
+    /* El hilo que lanza puede tener señales bloqueadas o ignoradas:
+     * el programa empieza con la máscara vacía y SIGINT por defecto */
+    posix_spawnattr_t atributos;
+    posix_spawnattr_init(&atributos);
+    sigset_t vacio, por_defecto;
+    sigemptyset(&vacio);
+    sigemptyset(&por_defecto);
+    sigaddset(&por_defecto, SIGINT);
+    sigaddset(&por_defecto, SIGTSTP);
+    posix_spawnattr_setsigmask(&atributos, &vacio);
+    posix_spawnattr_setsigdefault(&atributos, &por_defecto);
+    posix_spawnattr_setflags(&atributos, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    int err = posix_spawnp(pid, args[0], &acciones, &atributos, args, entorno);
+    posix_spawn_file_actions_destroy(&acciones);
+    posix_spawnattr_destroy(&atributos);
+    return err;
+}
+
+/**
+ * @brief Abre 'ruta' (relativa al directorio actual del hijo) sobre 'destino'.
+ * @return 0, o -1 con errno.
+ */
+static int abrir_en(const char *ruta, int flags, int destino) {
+    int f = open(ruta, flags | O_CLOEXEC, 0666);
+    if (f < 0) return -1;
+    int ok = dup2(f, destino);   /* La copia no hereda O_CLOEXEC */
+    close(f);
+    return ok < 0 ? -1 : 0;
+}
+
+/**
+ * @brief Lanza el programa con fork() para fijarle RLIMIT_AS antes del exec.
+ *
+ * posix_spawn no fija rlimits, y aplicarlos con prlimit() una vez lanzado
+ * deja al programa correr sin tope hasta entonces (lo que reserve al
+ * arrancar escaparía al límite). Tras fork() en un proceso con hilos el
+ * hijo solo usa llamadas seguras; si algo falla antes del exec, manda su
+ * errno por un pipe con O_CLOEXEC, que el exec cierra si funciona.
+ *
+ * @return 0, o el errno del fallo (como posix_spawnp()).
+ */
+static int lanzar_con_limite(char **args, char **entorno, const Redirecciones *r, int fd,
+                             int fd_errores, size_t limite, pid_t *pid) {
+    int aviso[2];
+    if (pipe2(aviso, O_CLOEXEC) != 0) return errno;
+    int dir_fd = sesion_actual->dir_fd;
+
+    /* Con todo bloqueado, los manejadores de la shell no corren en el hijo */
+    sigset_t todas, anterior;
+    sigfillset(&todas);
+    pthread_sigmask(SIG_SETMASK, &todas, &anterior);
+    *pid = fork();
+    if (*pid == 0) {
+        struct sigaction por_defecto;
+        memset(&por_defecto, 0, sizeof(por_defecto));
+        por_defecto.sa_handler = SIG_DFL;
+        sigaction(SIGINT, &por_defecto, NULL);
+        sigaction(SIGTSTP, &por_defecto, NULL);
+        sigaction(SIGTERM, &por_defecto, NULL);
+
+        /* Mismo orden que las acciones de lanzar_con_spawn() */
+        struct rlimit rl = { limite, limite };
+        int ok = (dir_fd < 0 || fchdir(dir_fd) == 0) &&
+                 abrir_en(r->entrada ? r->entrada : "/dev/null", O_RDONLY, STDIN_FILENO) == 0;
+        if (ok && r->salida != NULL) {
+            ok = abrir_en(r->salida, O_WRONLY | O_CREAT | (r->anexar_salida ? O_APPEND : O_TRUNC),
+                          STDOUT_FILENO) == 0;
+        } else if (ok) {
+            ok = dup2(fd, STDOUT_FILENO) >= 0;
+        }
+        if (ok && r->errores != NULL && r->errores == r->salida) {
+            ok = dup2(STDOUT_FILENO, STDERR_FILENO) >= 0;
+        } else if (ok && r->errores != NULL) {
+            ok = abrir_en(r->errores, O_WRONLY | O_CREAT | (r->anexar_errores ? O_APPEND : O_TRUNC),
+                          STDERR_FILENO) == 0;
+        } else if (ok) {
+            ok = dup2(fd_errores, STDERR_FILENO) >= 0;
+        }
+        if (ok && setrlimit(RLIMIT_AS, &rl) == 0) {
+            sigset_t vacio;
+            sigemptyset(&vacio);
+            sigprocmask(SIG_SETMASK, &vacio, NULL);
+            execvpe(args[0], args, entorno);
+        }
+        int e = errno;
+        ssize_t escritos = write(aviso[1], &e, sizeof(e));
+        (void)escritos;
+        _exit(TRABAJO_NO_ENCONTRADO);
+    }
+    int err = (*pid < 0) ? errno : 0;
+    pthread_sigmask(SIG_SETMASK, &anterior, NULL);
+    close(aviso[1]);
+
+    /* EOF: el exec cerró el pipe. Un errno: el hijo ya terminó */
+    ssize_t n;
+    int e = 0;
+    while ((n = read(aviso[0], &e, sizeof(e))) < 0 && errno == EINTR) {
+    }
+    close(aviso[0]);
+    if (err == 0 && n == (ssize_t)sizeof(e)) {
+        while (waitpid(*pid, NULL, 0) < 0 && errno == EINTR) {
+        }
+        err = e;
+    }
+    return err;
+}
+
+/**
+ * @brief Descriptor para el stderr del programa cuando la línea no lo redirige.
+ *
+ * Si la sesión tiene su propio stream de errores con descriptor (un `2>`
+ * del comando que lanza el programa, como `limite ... 2> err.txt`), los
+ * errores van directo allí; si no, al memfd junto con la salida.
+ */
+static int errores_del_programa(int fd) {
+    FILE *errores = sesion_actual->errores;
+    if (errores == NULL || errores == salida_sesion() || fileno(errores) < 0) {
+        return fd;
+    }
+    fflush(errores);   /* Lo que ya escribió la shell va antes */
+    return fileno(errores);
+}
+
+/**
+ * @brief Lanza el programa y espera a que termine.
+ *
+ * stdout y stderr van al mismo memfd (salvo que se redirijan o que la
+ * sesión tenga su propio stream de errores), así que quedan intercalados
+ * en el orden en que el programa los escribió. Las
+ * redirecciones se aplican en el proceso nuevo, después de cambiar al
+ * directorio de la sesión. Sin `limite -m` se usa posix_spawnp(); con él,
+ * fork() para fijar el tope antes del exec.
+ */
+int trabajo_externo(char **args, struct rusage *uso) {
+    Redirecciones red;
+    if (separar_redirecciones(args, &red) != 0) {
+        return 2;
+    }
+    if (args[0] == NULL) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " Falta el comando antes de la redirección.\n");
+        return 2;
+    }
+    int fd = memfd_create("paralelo", MFD_CLOEXEC);
+    if (fd < 0) {
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo ejecutar '%s': %s\n", args[0], strerror(errno));
+        return TRABAJO_NO_ENCONTRADO;
+    }
+
+    /* limite -m: el presupuesto que queda es el espacio de direcciones del
+     * programa, y debe valer desde su primera instrucción */
+    size_t libre = limite_memoria_libre();
+    int fd_errores = errores_del_programa(fd);
+    /* Con las variables de la sesión (`export`), no solo las del proceso */
+    char **entorno = variables_entorno();
+    pid_t pid;
+    int err = (entorno == NULL) ? ENOMEM
+            : (libre != SIZE_MAX) ? lanzar_con_limite(args, entorno, &red, fd, fd_errores, libre, &pid)
+                                  : lanzar_con_spawn(args, entorno, &red, fd, fd_errores, &pid);
+    free(entorno);
+    if (err != 0) {
+        close(fd);
+        imprimir_error(COLOR_RED "[ERROR]" COLOR_RESET " No se pudo ejecutar '%s'%s: %s\n", args[0],
+                       (red.entrada || red.salida || red.errores) ? " (o abrir sus redirecciones)" : "",
+                       strerror(err));
+        return TRABAJO_NO_ENCONTRADO;
+    }
+
+    esperar_hijo(pid);
+    int estado = 0;
+    while (wait4(pid, &estado, 0, uso) < 0 && errno == EINTR) {
+    }
+    if (uso != NULL) {
+        /* El ru_maxrss del hijo es el máximo entre su memoria y la del
+         * proceso del que salió (el kernel lo anota al hacer exec), y
+         * después de que el hijo terminó /proc ya no la muestra. Solo es
+         * del programa si supera el pico de la shell; si no, se desconoce */
+        struct rusage propio;
+        if (getrusage(RUSAGE_SELF, &propio) != 0 || uso->ru_maxrss <= propio.ru_maxrss) {
+            uso->ru_maxrss = -1;
+        }
+    }
+    volcar_memfd(fd);
+    close(fd);
+    return WIFEXITED(estado) ? WEXITSTATUS(estado)
+         : WIFSIGNALED(estado) ? 128 + WTERMSIG(estado) : 1;
+}
+
+int trabajo_ejecutar(const char *linea, const ContextoSesion *origen, ResultadoTrabajo *r) {
+    memset(r, 0, sizeof(*r));
+    pthread_once(&inicializado, abrir_entrada_vacia);
+
+    /* Copia modificable: el parser escribe '\0' entre los tokens */
+    char *copia = MEM_STRDUP(linea);
+    char **args = (copia != NULL) ? parsear_linea(copia) : NULL;
+    if (args == NULL) {
+        MEM_FREE(copia);
+        return -1;
+    }
+
+    /* Sesión propia: copia del prompt, del directorio, de los alias y de las variables,
+     * salida a memoria */
+    ContextoSesion sesion;
+    sesion_iniciar(&sesion);
+    memcpy(sesion.prompt, origen->prompt, sizeof(sesion.prompt));
+    sesion.formato = origen->formato;
+    if (origen->dir_fd >= 0) {
+        /* sesion_cerrar() cierra el suyo: le damos una copia */
+        sesion.dir_fd = fcntl(origen->dir_fd, F_DUPFD_CLOEXEC, 0);
+    }
+    if (origen->directorio != NULL) {
+        sesion.directorio = strdup(origen->directorio);   /* pwd sin getcwd() */
+    }
+    sesion.entrada = entrada_vacia;
+    sesion.salida = open_memstream(&r->salida, &r->len);
+    sesion.errores = sesion.salida;   /* Como stdout y stderr del programa en el memfd */
+    if (sesion.salida == NULL || alias_copiar(&sesion, origen) != 0 ||
+        variables_copiar(&sesion, origen) != 0) {
+        if (sesion.salida != NULL) {
+            fclose(sesion.salida);
+            free(r->salida);
+            r->salida = NULL;
+        }
+        sesion_cerrar(&sesion);
+        MEM_FREE(args);
+        MEM_FREE(copia);
+        return -1;
+    }
+
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &sesion;
+    if (args[0] != NULL && comando_registrado(args[0])) {
+        formato_cabeceras_repetidas(1);   /* paralelo los reenvía con formato_reenviar() */
+        ejecutar(args);
+        formato_cabeceras_repetidas(0);
+    } else if (args[0] != NULL) {
+        r->externo = 1;
+        r->codigo = trabajo_externo(args, NULL);
+    }
+    sesion_actual = anterior;
+
+    fclose(sesion.salida);
+    sesion.salida = sesion.errores = NULL;
+    sesion_cerrar(&sesion);
+    MEM_FREE(args);
+    MEM_FREE(copia);
+    return 0;
+}
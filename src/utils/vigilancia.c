@@ -0,0 +1,365 @@
+/**
+ * @file vigilancia.c
+ * @brief Vigilancia de archivos con inotify, o fanotify para árboles enteros.
+ */
+
+#define _GNU_SOURCE   /* open_by_handle_at, struct file_handle */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>   /* PATH_MAX */
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+#include "vigilancia.h"
+
+/** @brief Eventos de inotify que interesan. */
+#define MASCARA_INOTIFY (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | \
+                         IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/** @brief Eventos de fanotify que interesan (con FAN_REPORT_DFID_NAME). */
+#define MASCARA_FANOTIFY (FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_MOVED_FROM | \
+                          FAN_MOVED_TO | FAN_ONDIR)
+
+/** @brief Buffer de lectura de eventos. */
+#define TAM_EVENTOS (64 * 1024)
+
+struct Vigilancia {
+    int fd;                 /**< inotify o fanotify */
+    int es_fanotify;
+    int recursiva;
+    char *base_kernel;      /**< Ruta utilizable por el kernel (absoluta o /proc/self/fd/N/...) */
+    char *base_mostrar;     /**< Ruta tal como la escribió el usuario */
+
+    /* inotify: sufijo relativo a la base de cada descriptor de vigilancia */
+    char **sufijos;
+    int n_sufijos;
+
+    /* fanotify: raíz absoluta y caché del último directorio resuelto */
+    int fd_raiz;
+    char *raiz_abs;
+    unsigned char ultimo_handle[MAX_HANDLE_SZ];
+    unsigned int ultimo_largo;
+    char ultimo_dir[PATH_MAX];
+};
+
+/* =============================================================================
+ * inotify
+ * ========================================================================== */
+
+/** @brief Añade una vigilancia y recuerda su sufijo. */
+static int inotify_agregar(Vigilancia *v, const char *sufijo) {
+    char ruta[PATH_MAX];
+    snprintf(ruta, sizeof(ruta), "%s%s%s", v->base_kernel, *sufijo ? "/" : "", sufijo);
+    int wd = inotify_add_watch(v->fd, ruta, MASCARA_INOTIFY);
+    if (wd < 0) {
+        return -1;
+    }
+    if (wd >= v->n_sufijos) {
+        int nuevo = wd * 2 + 16;
+        char **tmp = realloc(v->sufijos, (size_t)nuevo * sizeof(char *));
+        if (tmp == NULL) {
+            inotify_rm_watch(v->fd, wd);
+            return -1;
+        }
+        memset(tmp + v->n_sufijos, 0, (size_t)(nuevo - v->n_sufijos) * sizeof(char *));
+        v->sufijos = tmp;
+        v->n_sufijos = nuevo;
+    }
+    free(v->sufijos[wd]);
+    v->sufijos[wd] = strdup(sufijo);
+    return wd;
+}
+
+/**
+ * @brief Vigila recursivamente los subdirectorios de 'sufijo'.
+ *
+ * Si 'fn' no es NULL, informa como creado cada archivo encontrado: sirve
+ * para no perder lo que se escribió en un directorio nuevo antes de que
+ * llegara su vigilancia.
+ */
+static void inotify_agregar_arbol(Vigilancia *v, const char *sufijo, FuncionEvento fn, void *usuario) {
+    char ruta[PATH_MAX];
+    snprintf(ruta, sizeof(ruta), "%s%s%s", v->base_kernel, *sufijo ? "/" : "", sufijo);
+    DIR *d = opendir(ruta);
+    if (d == NULL) {
+        return;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+        char hijo[PATH_MAX];
+        snprintf(hijo, sizeof(hijo), "%s%s%s", sufijo, *sufijo ? "/" : "", e->d_name);
+        if (e->d_type == DT_DIR) {
+            if (inotify_agregar(v, hijo) >= 0) {
+                inotify_agregar_arbol(v, hijo, fn, usuario);
+            }
+        } else if (fn != NULL) {
+            char mostrar[2 * PATH_MAX];
+            snprintf(mostrar, sizeof(mostrar), "%s/%s", v->base_mostrar, hijo);
+            fn(mostrar, EVENTO_CREADO, usuario);
+        }
+    }
+    closedir(d);
+}
+
+static int inotify_leer(Vigilancia *v, FuncionEvento fn, void *usuario) {
+    char buffer[TAM_EVENTOS] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int entregados = 0;
+
+    for (;;) {
+        ssize_t n = read(v->fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN) ? entregados : -1;
+        }
+        for (char *p = buffer; p < buffer + n;) {
+            struct inotify_event *e = (struct inotify_event *)p;
+            p += sizeof(struct inotify_event) + e->len;
+
+            if (e->mask & IN_Q_OVERFLOW) {
+                fn(v->base_mostrar, EVENTO_MODIFICADO, usuario); /* Se perdieron eventos */
+                entregados++;
+                continue;
+            }
+            if (e->wd < 0 || e->wd >= v->n_sufijos || v->sufijos[e->wd] == NULL) continue;
+            const char *sufijo = v->sufijos[e->wd];
+            if (e->mask & IN_IGNORED) {
+                free(v->sufijos[e->wd]);
+                v->sufijos[e->wd] = NULL;
+                continue;
+            }
+
+            char rel[PATH_MAX], mostrar[2 * PATH_MAX];
+            snprintf(rel, sizeof(rel), "%s%s%s", sufijo, (*sufijo && e->len) ? "/" : "",
+                     e->len ? e->name : "");
+            snprintf(mostrar, sizeof(mostrar), "%s%s%s", v->base_mostrar, *rel ? "/" : "", rel);
+
+            int tipo = (e->mask & IN_CREATE) ? EVENTO_CREADO
+                     : (e->mask & (IN_DELETE | IN_DELETE_SELF)) ? EVENTO_ELIMINADO
+                     : (e->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF)) ? EVENTO_MOVIDO
+                     : EVENTO_MODIFICADO;
+            fn(mostrar, tipo, usuario);
+            entregados++;
+
+            /* Directorio nuevo dentro del árbol: también hay que vigilarlo */
+            if (v->recursiva && (e->mask & IN_ISDIR) && (e->mask & (IN_CREATE | IN_MOVED_TO))) {
+                if (inotify_agregar(v, rel) >= 0) {
+                    inotify_agregar_arbol(v, rel, fn, usuario);
+                }
+            }
+        }
+    }
+}
+
+/* =============================================================================
+ * fanotify
+ * ========================================================================== */
+
+/** @brief Ruta absoluta de un descriptor (vía /proc/self/fd). */
+static int ruta_de_fd(int fd, char *buf, size_t tam) {
+    char enlace[64];
+    snprintf(enlace, sizeof(enlace), "/proc/self/fd/%d", fd);
+    ssize_t n = readlink(enlace, buf, tam - 1);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+/** @brief Resuelve el handle de un directorio a su ruta absoluta (con caché). */
+static const char *resolver_handle(Vigilancia *v, struct file_handle *fh) {
+    unsigned int largo = fh->handle_bytes;
+    if (largo == v->ultimo_largo && largo <= MAX_HANDLE_SZ &&
+        memcmp(v->ultimo_handle, fh->f_handle, largo) == 0) {
+        return v->ultimo_dir;
+    }
+    int fd = open_by_handle_at(v->fd_raiz, fh, O_PATH | O_CLOEXEC);
+    if (fd < 0) return NULL; /* Directorio ya borrado, u otro montaje */
+    int r = ruta_de_fd(fd, v->ultimo_dir, sizeof(v->ultimo_dir));
+    close(fd);
+    if (r != 0 || largo > MAX_HANDLE_SZ) {
+        v->ultimo_largo = 0;
+        return (r == 0) ? v->ultimo_dir : NULL;
+    }
+    memcpy(v->ultimo_handle, fh->f_handle, largo);
+    v->ultimo_largo = largo;
+    return v->ultimo_dir;
+}
+
+static int fanotify_leer(Vigilancia *v, FuncionEvento fn, void *usuario) {
+    char buffer[TAM_EVENTOS] __attribute__((aligned(__alignof__(struct fanotify_event_metadata))));
+    int entregados = 0;
+    size_t largo_raiz = strlen(v->raiz_abs);
+
+    for (;;) {
+        ssize_t n = read(v->fd, buffer, sizeof(buffer));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return (errno == EAGAIN) ? entregados : -1;
+        }
+        struct fanotify_event_metadata *md = (struct fanotify_event_metadata *)buffer;
+        for (; FAN_EVENT_OK(md, n); md = FAN_EVENT_NEXT(md, n)) {
+            if (md->vers != FANOTIFY_METADATA_VERSION) return -1;
+            if (md->mask & FAN_Q_OVERFLOW) {
+                fn(v->base_mostrar, EVENTO_MODIFICADO, usuario);
+                entregados++;
+                continue;
+            }
+            struct fanotify_event_info_fid *info = (struct fanotify_event_info_fid *)(md + 1);
+            if ((char *)info >= (char *)md + md->event_len ||
+                info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                continue;
+            }
+            struct file_handle *fh = (struct file_handle *)info->handle;
+            const char *nombre = (const char *)(fh->f_handle + fh->handle_bytes);
+            const char *dir = resolver_handle(v, fh);
+
+            /* La marca cubre todo el sistema de archivos: filtramos el árbol */
+            if (dir == NULL || strncmp(dir, v->raiz_abs, largo_raiz) != 0 ||
+                (dir[largo_raiz] != '/' && dir[largo_raiz] != '\0')) {
+                continue;
+            }
+            const char *resto = dir + largo_raiz;
+
+            char mostrar[2 * PATH_MAX];
+            int es_punto = (strcmp(nombre, ".") == 0);
+            snprintf(mostrar, sizeof(mostrar), "%s%s%s%s",
+                     strcmp(v->base_mostrar, "/") == 0 ? "" : v->base_mostrar, resto,
+                     es_punto ? "" : "/", es_punto ? "" : nombre);
+
+            int tipo = (md->mask & FAN_CREATE) ? EVENTO_CREADO
+                     : (md->mask & FAN_DELETE) ? EVENTO_ELIMINADO
+                     : (md->mask & (FAN_MOVED_FROM | FAN_MOVED_TO)) ? EVENTO_MOVIDO
+                     : EVENTO_MODIFICADO;
+            fn(mostrar, tipo, usuario);
+            entregados++;
+        }
+    }
+}
+
+/**
+ * @brief Intenta vigilar el árbol con una sola marca de fanotify.
+ * @return 0 si se pudo; -1 si no (sin privilegios, kernel antiguo, ...).
+ */
+static int iniciar_fanotify(Vigilancia *v) {
+    v->fd_raiz = open(v->base_kernel, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (v->fd_raiz < 0) return -1;
+
+    char abs[PATH_MAX];
+    if (ruta_de_fd(v->fd_raiz, abs, sizeof(abs)) != 0) return -1;
+    /* Para "/" guardamos "": así toda ruta hija empieza por raiz_abs + '/' */
+    v->raiz_abs = strdup(strcmp(abs, "/") == 0 ? "" : abs);
+
+    v->fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK,
+                          O_RDONLY | O_CLOEXEC);
+    if (v->raiz_abs == NULL || v->fd < 0) return -1;
+    if (fanotify_mark(v->fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, MASCARA_FANOTIFY,
+                      AT_FDCWD, v->base_kernel) != 0) {
+        return -1;
+    }
+
+    /* Resolver handles requiere CAP_DAC_READ_SEARCH: lo comprobamos ya */
+    struct {
+        struct file_handle fh;
+        unsigned char datos[MAX_HANDLE_SZ];
+    } h;
+    int id_montaje;
+    h.fh.handle_bytes = MAX_HANDLE_SZ;
+    if (name_to_handle_at(v->fd_raiz, "", &h.fh, &id_montaje, AT_EMPTY_PATH) != 0) return -1;
+    int prueba = open_by_handle_at(v->fd_raiz, &h.fh, O_PATH | O_CLOEXEC);
+    if (prueba < 0) return -1;
+    close(prueba);
+
+    v->es_fanotify = 1;
+    return 0;
+}
+
+/* =============================================================================
+ * Interfaz pública
+ * ========================================================================== */
+
+Vigilancia *vigilancia_crear(int dir_fd, const char *ruta, int recursiva) {
+    Vigilancia *v = calloc(1, sizeof(Vigilancia));
+    if (v == NULL) {
+        return NULL;
+    }
+    v->fd = -1;
+    v->fd_raiz = -1;
+    v->recursiva = recursiva;
+
+    /* inotify y fanotify no aceptan un directorio base: usamos /proc */
+    char kernel[PATH_MAX];
+    if (ruta[0] == '/' || dir_fd == AT_FDCWD) {
+        snprintf(kernel, sizeof(kernel), "%s", ruta);
+    } else {
+        snprintf(kernel, sizeof(kernel), "/proc/self/fd/%d/%s", dir_fd, ruta);
+    }
+    /* Sin '/' finales, para componer rutas hijas limpias */
+    size_t l = strlen(kernel);
+    while (l > 1 && kernel[l - 1] == '/') kernel[--l] = '\0';
+    v->base_kernel = strdup(kernel);
+    v->base_mostrar = strdup(ruta);
+    l = v->base_mostrar ? strlen(v->base_mostrar) : 0;
+    while (l > 1 && v->base_mostrar[l - 1] == '/') v->base_mostrar[--l] = '\0';
+
+    struct stat st;
+    if (v->base_kernel == NULL || v->base_mostrar == NULL || stat(v->base_kernel, &st) != 0) {
+        vigilancia_destruir(v);
+        return NULL;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        v->recursiva = 0;
+    }
+
+    if (v->recursiva && iniciar_fanotify(v) == 0) {
+        return v;
+    }
+    /* Sin fanotify: limpiar lo que se haya abierto e ir a inotify */
+    if (v->fd >= 0) close(v->fd);
+    if (v->fd_raiz >= 0) close(v->fd_raiz);
+    v->fd = v->fd_raiz = -1;
+
+    v->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (v->fd < 0 || inotify_agregar(v, "") < 0) {
+        int e = errno;
+        vigilancia_destruir(v);
+        errno = e;
+        return NULL;
+    }
+    if (v->recursiva) {
+        inotify_agregar_arbol(v, "", NULL, NULL);
+    }
+    return v;
+}
+
+int vigilancia_fd(const Vigilancia *v) {
+    return v->fd;
+}
+
+const char *vigilancia_mecanismo(const Vigilancia *v) {
+    return v->es_fanotify ? "fanotify" : "inotify";
+}
+
+int vigilancia_leer(Vigilancia *v, FuncionEvento fn, void *usuario) {
+    return v->es_fanotify ? fanotify_leer(v, fn, usuario) : inotify_leer(v, fn, usuario);
+}
+
+void vigilancia_destruir(Vigilancia *v) {
+    if (v == NULL) {
+        return;
+    }
+    if (v->fd >= 0) close(v->fd);
+    if (v->fd_raiz >= 0) close(v->fd_raiz);
+    for (int i = 0; i < v->n_sufijos; i++) {
+        free(v->sufijos[i]);
+    }
+    free(v->sufijos);
+    free(v->raiz_abs);
+    free(v->base_kernel);
+    free(v->base_mostrar);
+    free(v);
+}
@@ -0,0 +1,376 @@
+/**
+ * @file visor.c
+ * @brief Ventana mapeada e índice disperso de líneas para `leer -p`.
+ *
+ * Todas las lecturas del hilo principal pasan por una única ventana de
+ * mmap() de VISOR_VENTANA bytes. Al avanzar se remapea cuando quedan
+ * menos de media ventana por delante; al retroceder, cuando queda menos
+ * de media por detrás. Así cada función puede recorrer la ventana con
+ * memchr()/memrchr() sin preocuparse de dónde termina.
+ *
+ * El hilo de indexado lee con pread() en su propio buffer y solo comparte
+ * el índice (protegido por un mutex).
+ */
+
+#define _GNU_SOURCE   /* memrchr */
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "visor.h"
+#include "subcadena.h"
+
+/** @brief Bytes que lee el hilo de indexado en cada pread(). */
+#define VISOR_BLOQUE_INDICE (1u << 20)
+
+/** @brief Líneas entre marcas al empezar (se duplica al compactar). */
+#define VISOR_PASO_INICIAL 256
+
+struct Visor {
+    int fd;
+    off_t tam;
+    off_t pagina;
+
+    /* Ventana mapeada */
+    char *mapa;
+    off_t mapa_ini;
+    size_t mapa_len;
+
+    /* Índice disperso: marcas[i] es el comienzo de la línea i*paso (desde 0) */
+    pthread_mutex_t mutex;
+    off_t *marcas;
+    size_t n_marcas;
+    uint64_t paso;
+    off_t indexado;         /**< Bytes ya recorridos por el hilo */
+    uint64_t lineas;        /**< '\n' vistos en [0, indexado) */
+    int completo;
+    int parar;              /**< Se accede con __atomic_* */
+    pthread_t hilo;
+    int con_hilo;
+};
+
+/* ============================================================
+ * Índice disperso (hilo en segundo plano)
+ * ============================================================ */
+
+/** @brief Añade la marca de la línea 'linea' (con el mutex tomado). */
+static void agregar_marca(Visor *v, uint64_t linea, off_t inicio) {
+    if (linea != v->n_marcas * v->paso) {
+        return;
+    }
+    if (v->n_marcas == VISOR_MAX_MARCAS) {
+        /* Índice lleno: una marca de cada dos y el doble de paso */
+        for (size_t i = 0; i < VISOR_MAX_MARCAS / 2; i++) {
+            v->marcas[i] = v->marcas[2 * i];
+        }
+        v->n_marcas = VISOR_MAX_MARCAS / 2;
+        v->paso *= 2;
+        if (linea != v->n_marcas * v->paso) {
+            return;
+        }
+    }
+    v->marcas[v->n_marcas++] = inicio;
+}
+
+/** @brief Cuerpo del hilo de indexado. */
+static void *indexar(void *arg) {
+    Visor *v = arg;
+    char *buf = malloc(VISOR_BLOQUE_INDICE);
+    off_t pos = 0;
+    uint64_t lineas = 0;
+
+    while (buf != NULL && pos < v->tam && !__atomic_load_n(&v->parar, __ATOMIC_RELAXED)) {
+        ssize_t r = pread(v->fd, buf, VISOR_BLOQUE_INDICE, pos);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        if (pos + r > v->tam) r = (ssize_t)(v->tam - pos);
+
+        pthread_mutex_lock(&v->mutex);
+        const char *p = buf, *fin = buf + r, *q;
+        while (p < fin && (q = memchr(p, '\n', (size_t)(fin - p))) != NULL) {
+            lineas++;
+            agregar_marca(v, lineas, pos + (q - buf) + 1);
+            p = q + 1;
+        }
+        pos += r;
+        v->indexado = pos;
+        v->lineas = lineas;
+        pthread_mutex_unlock(&v->mutex);
+    }
+
+    pthread_mutex_lock(&v->mutex);
+    v->completo = (pos >= v->tam);
+    pthread_mutex_unlock(&v->mutex);
+    free(buf);
+    return NULL;
+}
+
+/* ============================================================
+ * Ventana mapeada
+ * ============================================================ */
+
+/** @brief Mapea la ventana que empieza en 'ini' (múltiplo de página). */
+static int mapear(Visor *v, off_t ini) {
+    if (v->mapa != NULL) {
+        munmap(v->mapa, v->mapa_len);
+        v->mapa = NULL;
+    }
+    size_t len = (v->tam - ini > (off_t)VISOR_VENTANA) ? VISOR_VENTANA : (size_t)(v->tam - ini);
+    void *m = mmap(NULL, len, PROT_READ, MAP_SHARED, v->fd, ini);
+    if (m == MAP_FAILED) {
+        return -1;
+    }
+    v->mapa = m;
+    v->mapa_ini = ini;
+    v->mapa_len = len;
+    return 0;
+}
+
+/**
+ * @brief Bytes desde 'pos' hacia adelante (al menos media ventana, o
+ *        hasta el final del archivo).
+ */
+static const char *datos_desde(Visor *v, off_t pos, size_t *len) {
+    *len = 0;
+    if (pos >= v->tam) {
+        return NULL;
+    }
+    off_t fin = v->mapa_ini + (off_t)v->mapa_len;
+    if (v->mapa == NULL || pos < v->mapa_ini || pos >= fin ||
+        (fin - pos < (off_t)VISOR_VENTANA / 2 && fin < v->tam)) {
+        if (mapear(v, pos - pos % v->pagina) != 0) {
+            return NULL;
+        }
+        fin = v->mapa_ini + (off_t)v->mapa_len;
+    }
+    *len = (size_t)(fin - pos);
+    return v->mapa + (pos - v->mapa_ini);
+}
+
+/**
+ * @brief Bytes que terminan en 'pos' (al menos media ventana, o desde el
+ *        principio del archivo). Devuelve el comienzo de esos bytes.
+ */
+static const char *datos_antes(Visor *v, off_t pos, size_t *len) {
+    *len = 0;
+    if (pos <= 0) {
+        return NULL;
+    }
+    if (v->mapa == NULL || pos <= v->mapa_ini || pos > v->mapa_ini + (off_t)v->mapa_len ||
+        (pos - v->mapa_ini < (off_t)VISOR_VENTANA / 2 && v->mapa_ini > 0)) {
+        off_t fin = pos + (v->pagina - pos % v->pagina) % v->pagina;
+        off_t ini = (fin > (off_t)VISOR_VENTANA) ? fin - (off_t)VISOR_VENTANA : 0;
+        if (mapear(v, ini) != 0) {
+            return NULL;
+        }
+    }
+    *len = (size_t)(pos - v->mapa_ini);
+    return v->mapa;
+}
+
+/* ============================================================
+ * API pública
+ * ============================================================ */
+
+Visor *visor_abrir(int fd, off_t tam) {
+    Visor *v = calloc(1, sizeof(Visor));
+    if (v == NULL) {
+        return NULL;
+    }
+    v->fd = fd;
+    v->tam = tam;
+    v->pagina = sysconf(_SC_PAGESIZE);
+    v->paso = VISOR_PASO_INICIAL;
+    v->marcas = malloc(VISOR_MAX_MARCAS * sizeof(off_t));
+    if (v->marcas == NULL) {
+        free(v);
+        return NULL;
+    }
+    v->marcas[0] = 0;
+    v->n_marcas = 1;
+    pthread_mutex_init(&v->mutex, NULL);
+    v->con_hilo = (pthread_create(&v->hilo, NULL, indexar, v) == 0);
+    return v;
+}
+
+void visor_cerrar(Visor *v) {
+    if (v == NULL) {
+        return;
+    }
+    if (v->con_hilo) {
+        __atomic_store_n(&v->parar, 1, __ATOMIC_RELAXED);
+        pthread_join(v->hilo, NULL);
+    }
+    if (v->mapa != NULL) {
+        munmap(v->mapa, v->mapa_len);
+    }
+    pthread_mutex_destroy(&v->mutex);
+    free(v->marcas);
+    free(v);
+}
+
+off_t visor_tamano(const Visor *v) {
+    return v->tam;
+}
+
+int64_t visor_total_lineas(Visor *v, off_t *indexado) {
+    pthread_mutex_lock(&v->mutex);
+    int64_t total = -1;
+    if (v->completo) {
+        /* Una última línea sin '\n' también cuenta */
+        total = (int64_t)v->lineas;
+        if (v->tam > 0) {
+            char c;
+            if (pread(v->fd, &c, 1, v->tam - 1) == 1 && c != '\n') total++;
+        }
+    }
+    if (indexado != NULL) *indexado = v->indexado;
+    pthread_mutex_unlock(&v->mutex);
+    return total;
+}
+
+off_t visor_inicio_linea(Visor *v, off_t pos) {
+    while (pos > 0) {
+        size_t len;
+        const char *d = datos_antes(v, pos, &len);
+        if (d == NULL) break;
+        const char *q = memrchr(d, '\n', len);
+        if (q != NULL) {
+            return pos - (off_t)len + (q - d) + 1;
+        }
+        pos -= (off_t)len;
+    }
+    return 0;
+}
+
+off_t visor_siguiente(Visor *v, off_t pos) {
+    while (pos < v->tam) {
+        size_t len;
+        const char *d = datos_desde(v, pos, &len);
+        if (d == NULL) break;
+        const char *q = memchr(d, '\n', len);
+        if (q != NULL) {
+            off_t sig = pos + (q - d) + 1;
+            return (sig < v->tam) ? sig : -1;
+        }
+        pos += (off_t)len;
+    }
+    return -1;
+}
+
+off_t visor_anterior(Visor *v, off_t pos) {
+    return (pos > 0) ? visor_inicio_linea(v, pos - 1) : 0;
+}
+
+int64_t visor_numero_linea(Visor *v, off_t pos) {
+    pthread_mutex_lock(&v->mutex);
+    if (pos > v->indexado && !v->completo) {
+        pthread_mutex_unlock(&v->mutex);
+        return -1;
+    }
+    /* Última marca <= pos */
+    size_t lo = 0, hi = v->n_marcas;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (v->marcas[mid] <= pos) lo = mid; else hi = mid;
+    }
+    off_t base = v->marcas[lo];
+    int64_t linea = (int64_t)(lo * v->paso);
+    pthread_mutex_unlock(&v->mutex);
+
+    /* Como mucho 'paso' líneas hasta pos */
+    while (base < pos) {
+        size_t len;
+        const char *d = datos_desde(v, base, &len);
+        if (d == NULL) break;
+        if ((off_t)len > pos - base) len = (size_t)(pos - base);
+        const char *p = d, *fin = d + len, *q;
+        while (p < fin && (q = memchr(p, '\n', (size_t)(fin - p))) != NULL) {
+            linea++;
+            p = q + 1;
+        }
+        base += (off_t)len;
+    }
+    return linea + 1;
+}
+
+off_t visor_ir_linea(Visor *v, uint64_t n) {
+    uint64_t objetivo = (n > 0) ? n - 1 : 0;
+    pthread_mutex_lock(&v->mutex);
+    size_t k = objetivo / v->paso;
+    if (k >= v->n_marcas) k = v->n_marcas - 1;
+    off_t pos = v->marcas[k];
+    uint64_t linea = k * v->paso;
+    pthread_mutex_unlock(&v->mutex);
+
+    while (linea < objetivo) {
+        off_t sig = visor_siguiente(v, pos);
+        if (sig < 0) break;
+        pos = sig;
+        linea++;
+    }
+    return pos;
+}
+
+size_t visor_copiar_linea(Visor *v, off_t pos, char *buf, size_t max) {
+    size_t copiado = 0;
+    while (copiado < max && pos < v->tam) {
+        size_t len;
+        const char *d = datos_desde(v, pos, &len);
+        if (d == NULL) break;
+        if (len > max - copiado) len = max - copiado;
+        const char *q = memchr(d, '\n', len);
+        size_t n = (q != NULL) ? (size_t)(q - d) : len;
+        memcpy(buf + copiado, d, n);
+        copiado += n;
+        if (q != NULL) break;
+        pos += (off_t)n;
+    }
+    return copiado;
+}
+
+off_t visor_buscar(Visor *v, off_t desde, const char *texto, size_t len, int atras) {
+    if (len == 0 || (off_t)len > v->tam) {
+        return -1;
+    }
+
+    if (!atras) {
+        off_t pos = desde;
+        while (pos + (off_t)len <= v->tam) {
+            size_t n;
+            const char *d = datos_desde(v, pos, &n);
+            if (d == NULL) break;
+            const char *q = buscar_subcadena(d, n, texto, len);
+            if (q != NULL) {
+                return visor_inicio_linea(v, pos + (q - d));
+            }
+            if (pos + (off_t)n >= v->tam) break;
+            pos += (off_t)(n - (len - 1));   /* Solapa por si cruza la ventana */
+        }
+        return -1;
+    }
+
+    /* Hacia atrás: la última aparición que empieza antes de 'desde' */
+    off_t fin = desde + (off_t)len - 1;
+    if (fin > v->tam) fin = v->tam;
+    while (fin >= (off_t)len) {
+        size_t n;
+        const char *d = datos_antes(v, fin, &n);
+        if (d == NULL) break;
+        off_t ini = fin - (off_t)n;
+        const char *p = d, *ultima = NULL, *q;
+        while ((q = buscar_subcadena(p, (size_t)(d + n - p), texto, len)) != NULL &&
+               ini + (q - d) < desde) {
+            ultima = q;
+            p = q + 1;
+        }
+        if (ultima != NULL) {
+            return visor_inicio_linea(v, ini + (ultima - d));
+        }
+        if (ini == 0) break;
+        fin = ini + (off_t)len - 1;
+    }
+    return -1;
+}
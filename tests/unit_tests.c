@@ -17,10 +17,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <limits.h>
+#include <pthread.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 
 /* Incluimos solo lo que necesitamos del proyecto */
 #include "../include/shell.h"   /* leer_linea, parsear_linea */
 #include "../include/colors.h"  /* Macros de color ANSI */
+#include "../include/eafitos.h" /* API embebible */
+#include "../include/conteo.h"  /* contar_bloque */
+#include "../include/hash.h"    /* crc32c, xxh64 */
+#include "../include/hilos.h"   /* ejecutar_con_robo */
+#include "../include/vigilancia.h" /* vigilancia_crear, vigilancia_leer */
+#include "../include/indice.h"  /* indice_construir, indice_candidatos */
+#include "../include/expresion.h" /* expresion_compilar, expresion_coincide */
+#include "../include/ordenamiento.h" /* ordenar_archivos */
+#include "../include/lineas.h"  /* lineas_desde_final */
+#include "../include/visor.h"   /* visor_abrir, visor_ir_linea */
+#include "../include/trabajos.h" /* trabajo_ejecutar */
+#include "../include/formato.h" /* registro_abrir, FORMATO_JSON */
+#include "../include/cancelacion.h" /* cancelacion_solicitar */
+#include "../include/lectura_lotes.h" /* leer_archivos_en_lote */
+#include "../include/medicion.h" /* medicion_comenzar */
+#include "../include/utils.h"   /* MEM_*, memoria_estadisticas */
+#include "../include/configuracion.h" /* configuracion_cargar, alias_expandir */
+#include "../include/grabacion.h" /* grabacion_iniciar, grabacion_reproducir */
+#include "../include/diferencias.h" /* diferencias_unificadas */
+#include "../include/reemplazo.h" /* reemplazar_en_archivo */
+#include "../include/plugins.h"  /* plugins_inicializar, plugins_existe */
 
 /* ============================================================
  * Framework de Testing Minimalista
@@ -73,7 +109,7 @@ static void test_parsear_linea_entrada_vacia(void) {
     ASSERT(args[0] == NULL,
            "parsear_linea: args[0]==NULL para entrada vacía (solo \\n)");
 
-    free(args);
+    MEM_FREE(args);
 }
 
 /**
@@ -98,7 +134,7 @@ static void test_parsear_linea_calc(void) {
     ASSERT(args[4] == NULL,
            "parsear_linea(calc): args[4] == NULL (terminador)");
 
-    free(args);
+    MEM_FREE(args);
 }
 
 /**
@@ -117,7 +153,7 @@ static void test_parsear_linea_espacios_multiples(void) {
     ASSERT(args[2] == NULL,
            "parsear_linea(espacios): solo 2 tokens a pesar de espacios extra");
 
-    free(args);
+    MEM_FREE(args);
 }
 
 /**
@@ -132,7 +168,7 @@ static void test_parsear_linea_sin_argumentos(void) {
     ASSERT(args[1] == NULL,
            "parsear_linea(sin args): args[1] == NULL");
 
-    free(args);
+    MEM_FREE(args);
 }
 
 
@@ -223,6 +259,1706 @@ static void test_strncpy_limite(void) {
 }
 
 
+/* ============================================================
+ * Suite 4: API embebible (libeafitos)
+ * ============================================================ */
+
+/**
+ * @brief Ejecuta una línea en un contexto y captura su salida en buf.
+ * @return El valor devuelto por eafitos_exec().
+ */
+static int capturar(eafitos_ctx *ctx, const char *linea, char *buf, size_t tam) {
+    FILE *tmp = tmpfile();
+    int r = eafitos_exec(ctx, linea, fileno(tmp));
+    rewind(tmp);
+    size_t n = fread(buf, 1, tam - 1, tmp);
+    buf[n] = '\0';
+    fclose(tmp);
+    return r;
+}
+
+/**
+ * @brief Verifica que la salida llega al fd indicado y que 'salir' no termina el proceso.
+ */
+static void test_eafitos_exec_basico(void) {
+    char buf[512];
+    eafitos_ctx *ctx = eafitos_create();
+    ASSERT(ctx != NULL, "eafitos_create: retorna un contexto válido");
+
+    int r = capturar(ctx, "calc 20 + 22", buf, sizeof(buf));
+    ASSERT(r == 0 && strstr(buf, "42.00") != NULL,
+           "eafitos_exec(calc): la salida llega al fd indicado");
+
+    r = capturar(ctx, "salir", buf, sizeof(buf));
+    ASSERT(r == 1, "eafitos_exec(salir): retorna 1 sin terminar el proceso");
+
+    eafitos_destroy(ctx);
+}
+
+/**
+ * @brief Verifica que dos contextos no comparten el prompt.
+ */
+static void test_eafitos_contextos_independientes(void) {
+    char buf[512];
+    eafitos_ctx *a = eafitos_create();
+    eafitos_ctx *b = eafitos_create();
+
+    capturar(a, "prompt SesionA", buf, sizeof(buf));
+    capturar(b, "prompt", buf, sizeof(buf));
+    ASSERT(strstr(buf, "'" PROMPT_POR_DEFECTO "'") != NULL,
+           "eafitos: cambiar el prompt de un contexto no afecta a otro");
+
+    eafitos_destroy(a);
+    eafitos_destroy(b);
+}
+
+/** @brief Trabajo de cada hilo: crea contextos y verifica su propia salida. */
+static void *hilo_contextos(void *arg) {
+    long id = (long)arg;
+    long errores = 0;
+    char linea[64], esperado[64], buf[512];
+
+    for (int i = 0; i < 50; i++) {
+        eafitos_ctx *ctx = eafitos_create();
+        snprintf(linea, sizeof(linea), "prompt H%ld_%d", id, i);
+        capturar(ctx, linea, buf, sizeof(buf));
+        capturar(ctx, "prompt", buf, sizeof(buf));
+        snprintf(esperado, sizeof(esperado), "'H%ld_%d'", id, i);
+        if (strstr(buf, esperado) == NULL) errores++;
+        eafitos_destroy(ctx);
+    }
+    return (void *)errores;
+}
+
+/**
+ * @brief Verifica que varios hilos pueden usar contextos distintos a la vez.
+ */
+static void test_eafitos_multihilo(void) {
+    pthread_t hilos[8];
+    long errores = 0;
+    for (long i = 0; i < 8; i++) {
+        pthread_create(&hilos[i], NULL, hilo_contextos, (void *)i);
+    }
+    for (int i = 0; i < 8; i++) {
+        void *r;
+        pthread_join(hilos[i], &r);
+        errores += (long)r;
+    }
+    ASSERT(errores == 0, "eafitos: 8 hilos x 50 contextos sin mezclar estado");
+}
+
+
+/* ============================================================
+ * Suite 5: contar_bloque() (conteo SIMD)
+ * ============================================================ */
+
+/** @brief Conteo de referencia, byte a byte. */
+static Conteo contar_ingenuo(const unsigned char *d, size_t n) {
+    Conteo c = {0, 0, n};
+    int previo = 1;
+    for (size_t i = 0; i < n; i++) {
+        if (d[i] == '\n') c.lineas++;
+        if (!es_espacio(d[i]) && previo) c.palabras++;
+        previo = es_espacio(d[i]);
+    }
+    return c;
+}
+
+/**
+ * @brief Verifica un texto corto conocido (menos de un bloque de 64 bytes).
+ */
+static void test_contar_texto_corto(void) {
+    const char *txt = "hola mundo\n  dos\tpalabras \n\nfin";
+    Conteo c = {0, 0, 0};
+    contar_bloque((const unsigned char *)txt, strlen(txt), 1, &c);
+    ASSERT(c.lineas == 3 && c.palabras == 5 && c.bytes == strlen(txt),
+           "contar_bloque: 3 líneas, 5 palabras en texto corto");
+}
+
+/**
+ * @brief Compara contra el conteo ingenuo con datos aleatorios de varios tamaños.
+ */
+static void test_contar_aleatorio(void) {
+    static const char alfabeto[] = "ab \n\t\r\v\fxyz\xff\x80";
+    unsigned char datos[5000];
+    unsigned semilla = 12345;
+    int ok = 1;
+
+    for (size_t n = 0; n <= sizeof(datos) && ok; n += 97) {
+        for (size_t i = 0; i < n; i++) {
+            semilla = semilla * 1103515245u + 12345u;
+            datos[i] = (unsigned char)alfabeto[(semilla >> 16) % (sizeof(alfabeto) - 1)];
+        }
+        Conteo c = {0, 0, 0};
+        contar_bloque(datos, n, 1, &c);
+        Conteo r = contar_ingenuo(datos, n);
+        ok = (c.lineas == r.lineas && c.palabras == r.palabras && c.bytes == r.bytes);
+    }
+    ASSERT(ok, "contar_bloque: coincide con el conteo byte a byte");
+}
+
+/**
+ * @brief Verifica que partir en trozos (como hacen los hilos) no cambia el resultado.
+ */
+static void test_contar_por_trozos(void) {
+    const char *txt = "palabra_larga_que_cruza_el_limite_de_un_bloque_de_sesenta_y_cuatro_bytes otra\n";
+    size_t n = strlen(txt);
+    int ok = 1;
+    for (size_t corte = 0; corte <= n && ok; corte++) {
+        Conteo c = {0, 0, 0};
+        int previo = contar_bloque((const unsigned char *)txt, corte, 1, &c);
+        contar_bloque((const unsigned char *)txt + corte, n - corte, previo, &c);
+        ok = (c.palabras == 2 && c.lineas == 1 && c.bytes == n);
+    }
+    ASSERT(ok, "contar_bloque: una palabra partida entre trozos se cuenta una vez");
+}
+
+
+/* ============================================================
+ * Suite 6: Sumas de verificación (CRC32C / XXH64)
+ * ============================================================ */
+
+/**
+ * @brief Verifica los vectores de prueba publicados de cada algoritmo.
+ */
+static void test_hash_vectores(void) {
+    ASSERT(crc32c(0, "123456789", 9) == 0xE3069283u,
+           "crc32c(\"123456789\") == e3069283");
+    ASSERT(xxh64("", 0, 0) == 0xEF46DB3751D8E999ULL,
+           "xxh64(\"\") == ef46db3751d8e999");
+    ASSERT(xxh64("abc", 3, 0) == 0x44BC2CF5AD770999ULL,
+           "xxh64(\"abc\") == 44bc2cf5ad770999");
+}
+
+/**
+ * @brief Verifica que sumar por partes (como hacen los hilos) da lo mismo.
+ */
+static void test_hash_por_partes(void) {
+    static unsigned char datos[100000];
+    for (size_t i = 0; i < sizeof(datos); i++) {
+        datos[i] = (unsigned char)(i * 2654435761u >> 13);
+    }
+    uint32_t completo = crc32c(0, datos, sizeof(datos));
+    uint32_t a = crc32c(0, datos, 30000);
+    uint32_t b = crc32c(0, datos + 30000, sizeof(datos) - 30000);
+    ASSERT(crc32c_combinar(a, b, sizeof(datos) - 30000) == completo,
+           "crc32c_combinar: unir dos trozos da el CRC del bloque completo");
+
+    EstadoXXH64 e;
+    xxh64_iniciar(&e, 0);
+    for (size_t i = 0; i < sizeof(datos); i += 1000) {
+        xxh64_actualizar(&e, datos + i, 1000);
+    }
+    ASSERT(xxh64_final(&e) == xxh64(datos, sizeof(datos), 0),
+           "xxh64: el estado incremental coincide con la llamada única");
+}
+
+
+/* ============================================================
+ * Suite 7: Grupo de hilos con robo de trabajo
+ * ============================================================ */
+
+/** @brief Nodo de un árbol sintético: cada tarea genera 'hijos' subtareas. */
+typedef struct {
+    int nivel;
+} TareaArbol;
+
+/** @brief Genera un árbol completo de 4 hijos por nodo y 6 niveles. */
+static void tarea_arbol(void *tarea, GrupoRobo *grupo, void *datos) {
+    TareaArbol *t = tarea;
+    __atomic_add_fetch((long *)datos, 1, __ATOMIC_RELAXED);
+    for (int i = 0; t->nivel < 6 && i < 4; i++) {
+        TareaArbol *hijo = malloc(sizeof(TareaArbol));
+        hijo->nivel = t->nivel + 1;
+        grupo_encolar(grupo, hijo);
+    }
+    free(t);
+}
+
+/**
+ * @brief Verifica que se ejecutan todas las subtareas generadas dinámicamente.
+ */
+static void test_robo_arbol_completo(void) {
+    long ejecutadas = 0;
+    TareaArbol *raiz = malloc(sizeof(TareaArbol));
+    raiz->nivel = 0;
+    void *iniciales[] = { raiz };
+    ejecutar_con_robo(iniciales, 1, 4, tarea_arbol, &ejecutadas);
+    /* 1 + 4 + 16 + ... + 4^6 = (4^7 - 1) / 3 */
+    ASSERT(ejecutadas == 5461, "ejecutar_con_robo: 5461 tareas de un árbol 4-ario");
+}
+
+
+/* ============================================================
+ * Suite 8: Vigilancia de archivos
+ * ============================================================ */
+
+/** @brief Guarda el último evento recibido. */
+static void registrar_evento(const char *ruta, int tipo, void *usuario) {
+    if (strstr(ruta, "vigilado.txt") != NULL) {
+        *(int *)usuario |= tipo;
+    }
+}
+
+/**
+ * @brief Verifica que crear un archivo en un directorio vigilado genera un evento.
+ */
+static void test_vigilancia_evento_creado(void) {
+    char dir[] = "/tmp/eafitos_vigilar_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL, "vigilancia: directorio temporal creado");
+
+    Vigilancia *v = vigilancia_crear(AT_FDCWD, dir, 0);
+    ASSERT(v != NULL, "vigilancia_crear: vigila un directorio existente");
+    if (v == NULL) return;
+
+    char ruta[128];
+    snprintf(ruta, sizeof(ruta), "%s/vigilado.txt", dir);
+    FILE *f = fopen(ruta, "w");
+    fputs("hola\n", f);
+    fclose(f);
+
+    int tipos = 0;
+    struct pollfd pfd = { vigilancia_fd(v), POLLIN, 0 };
+    if (poll(&pfd, 1, 2000) == 1) {
+        vigilancia_leer(v, registrar_evento, &tipos);
+    }
+    ASSERT(tipos & EVENTO_CREADO, "vigilancia_leer: informa el archivo creado sin sondear");
+
+    vigilancia_destruir(v);
+    unlink(ruta);
+    rmdir(dir);
+}
+
+
+/* ============================================================
+ * Suite 9: Índice de trigramas
+ * ============================================================ */
+
+/** @brief Escribe 'n' bytes de relleno y, al final, 'texto'. */
+static void escribir_con_relleno(const char *dir, const char *nombre, size_t n,
+                                 const char *texto) {
+    char ruta[256];
+    snprintf(ruta, sizeof(ruta), "%s/%s", dir, nombre);
+    FILE *f = fopen(ruta, "w");
+    for (size_t i = 0; i < n; i++) fputc('a' + (int)(i % 7), f);
+    fputs(texto, f);
+    fclose(f);
+}
+
+/**
+ * @brief Verifica los candidatos del índice (archivo pequeño y grande) y
+ *        que reindexar reutiliza los archivos sin cambios.
+ */
+static void test_indice_candidatos(void) {
+    char dir[] = "/tmp/eafitos_indice_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL, "indice: directorio temporal creado");
+    escribir_con_relleno(dir, "chico.txt", 10, "zorro\n");
+    escribir_con_relleno(dir, "grande.txt", 200000, "lince\n");   /* Mapa de bits */
+    escribir_con_relleno(dir, "otro.txt", 10, "perro\n");
+
+    ResumenIndice r;
+    ASSERT(indice_construir(AT_FDCWD, dir, &r) == 0 && r.archivos == 3,
+           "indice_construir: indexa los 3 archivos");
+
+    Indice *ix = indice_abrir(AT_FDCWD, dir);
+    ASSERT(ix != NULL, "indice_abrir: abre el índice recién escrito");
+    if (ix != NULL) {
+        unsigned char marcas[3];
+        long grande = indice_buscar_archivo(ix, "grande.txt");
+        long chico = indice_buscar_archivo(ix, "chico.txt");
+        indice_candidatos(ix, "lince", 5, marcas);
+        int ok = grande >= 0 && marcas[grande] && marcas[0] + marcas[1] + marcas[2] == 1;
+        indice_candidatos(ix, "orro", 4, marcas);
+        ok = ok && chico >= 0 && marcas[chico] && marcas[0] + marcas[1] + marcas[2] == 1;
+        indice_candidatos(ix, "gato", 4, marcas);
+        ok = ok && marcas[0] + marcas[1] + marcas[2] == 0;
+        ASSERT(ok, "indice_candidatos: solo los archivos con todos los trigramas");
+        ASSERT(indice_candidatos(ix, "ab", 2, marcas) == -1,
+               "indice_candidatos: textos de menos de 3 bytes no filtran");
+        indice_cerrar(ix);
+    }
+
+    escribir_con_relleno(dir, "otro.txt", 10, "gato\n");
+    ASSERT(indice_construir(AT_FDCWD, dir, &r) == 0 && r.reutilizados == 2 && r.escaneados == 1,
+           "indice_construir: solo vuelve a leer el archivo modificado");
+    ix = indice_abrir(AT_FDCWD, dir);
+    if (ix != NULL) {
+        unsigned char marcas[3];
+        indice_candidatos(ix, "lince", 5, marcas);
+        long grande = indice_buscar_archivo(ix, "grande.txt");
+        ASSERT(grande >= 0 && marcas[grande], "indice_construir: conserva los trigramas reutilizados");
+        indice_cerrar(ix);
+    }
+
+    const char *nombres[] = { "chico.txt", "grande.txt", "otro.txt", INDICE_NOMBRE };
+    for (size_t i = 0; i < 4; i++) {
+        char ruta[256];
+        snprintf(ruta, sizeof(ruta), "%s/%s", dir, nombres[i]);
+        unlink(ruta);
+    }
+    rmdir(dir);
+}
+
+
+/** @brief Borra un árbol con rutas relativas (sirve aunque supere PATH_MAX). */
+static void borrar_arbol(int dir_fd, const char *nombre) {
+    int fd = openat(dir_fd, nombre, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR *d = fd >= 0 ? fdopendir(fd) : NULL;
+    if (d == NULL) {
+        if (fd >= 0) close(fd);
+        unlinkat(dir_fd, nombre, 0);
+        return;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            borrar_arbol(dirfd(d), e->d_name);
+        }
+    }
+    closedir(d);
+    unlinkat(dir_fd, nombre, AT_REMOVEDIR);
+}
+
+/**
+ * @brief recolectar_archivos en árboles profundos: no se queda sin
+ *        descriptores y omite (con aviso) las rutas que no caben.
+ */
+static void test_recolectar_profundo(void) {
+    char dir[] = "/tmp/eafitos_arbol_XXXXXX";
+    ASSERT(mkdtemp(dir) != NULL, "recolectar_archivos: directorio temporal creado");
+
+    /* 300 niveles "d/d/.../hoja.txt" y una rama de nombres largos que pasa de PATH_MAX */
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for (int i = 0; fd >= 0 && i < 300; i++) {
+        mkdirat(fd, "d", 0700);
+        int hijo = openat(fd, "d", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        close(fd);
+        fd = hijo;
+    }
+    if (fd >= 0) close(openat(fd, "hoja.txt", O_WRONLY | O_CREAT | O_CLOEXEC, 0600));
+    if (fd >= 0) close(fd);
+    char largo[201];
+    memset(largo, 'x', 200);
+    largo[200] = '\0';
+    fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    for (int i = 0; fd >= 0 && i < 25; i++) {
+        mkdirat(fd, largo, 0700);
+        int hijo = openat(fd, largo, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        close(fd);
+        fd = hijo;
+    }
+    if (fd >= 0) close(openat(fd, "perdido.txt", O_WRONLY | O_CREAT | O_CLOEXEC, 0600));
+    if (fd >= 0) close(fd);
+
+    /* Con 256 descriptores, un descriptor abierto por nivel no alcanzaría */
+    struct rlimit original, reducido;
+    getrlimit(RLIMIT_NOFILE, &original);
+    reducido = original;
+    if (reducido.rlim_cur > 256) reducido.rlim_cur = 256;
+    setrlimit(RLIMIT_NOFILE, &reducido);
+    char *avisos = NULL;
+    size_t len = 0;
+    FILE *errores_anterior = sesion_actual->errores;
+    sesion_actual->errores = open_memstream(&avisos, &len);
+    ListaRutas lista = {0};
+    int r = recolectar_archivos(AT_FDCWD, dir, &lista);
+    fclose(sesion_actual->errores);
+    sesion_actual->errores = errores_anterior;
+    setrlimit(RLIMIT_NOFILE, &original);
+
+    int hoja = 0, validas = 1;
+    for (size_t i = 0; i < lista.n; i++) {
+        struct stat st;
+        const char *fin = strrchr(lista.rutas[i], '/');
+        hoja += fin != NULL && strcmp(fin, "/hoja.txt") == 0;
+        validas = validas && stat(lista.rutas[i], &st) == 0;
+    }
+    ASSERT(r == 0 && hoja == 1 && validas,
+           "recolectar_archivos: 300 niveles con un solo descriptor abierto a la vez");
+    ASSERT(lista.n == 1 && avisos != NULL && strstr(avisos, "ruta demasiado larga") != NULL,
+           "recolectar_archivos: omite y avisa las rutas que no caben en PATH_MAX");
+    lista_rutas_liberar(&lista);
+    free(avisos);
+    borrar_arbol(AT_FDCWD, dir);
+}
+
+
+/* ============================================================
+ * Suite 10: Expresiones regulares (DFA perezoso)
+ * ============================================================ */
+
+/** @brief Atajo: ¿'patron' coincide con 'linea'? (-1 si no compila) */
+static int coincide(const char *patron, const char *linea) {
+    char error[128];
+    Expresion *re = expresion_compilar(patron, error, sizeof(error));
+    if (re == NULL) return -1;
+    int r = expresion_coincide(re, linea, strlen(linea));
+    expresion_liberar(re);
+    return r;
+}
+
+/**
+ * @brief Verifica la sintaxis soportada: clases, repeticiones, alternativas y anclas.
+ */
+static void test_expresion_sintaxis(void) {
+    int ok = coincide("er+or [0-9]{3}", "GET /x error 500") == 1 &&
+             coincide("^(GET|POST) /api", "POST /api/v1") == 1 &&
+             coincide("^(GET|POST) /api", "x GET /api") == 0 &&
+             coincide("\\d+ms$", "tardó 35ms") == 1 &&
+             coincide("\\d+ms$", "35ms!") == 0 &&
+             coincide("[^a-z]x?y", "ay") == 0 &&
+             coincide("^$", "") == 1;
+    ASSERT(ok, "expresion_coincide: clases, repeticiones, alternativas y anclas");
+
+    char error[128];
+    ASSERT(expresion_compilar("(ab", error, sizeof(error)) == NULL &&
+           expresion_compilar("a{3,1}", error, sizeof(error)) == NULL,
+           "expresion_compilar: rechaza patrones inválidos con un mensaje");
+}
+
+/**
+ * @brief El límite de estados del NFA se aplica al número exacto de estados.
+ */
+static void test_expresion_limite_estados(void) {
+    char error[128];
+    /* 100 * 190 = 19000 estados de bytes: cabe; 100 * 210 = 21000 no */
+    Expresion *re = expresion_compilar("(a{100}){190}", error, sizeof(error));
+    int ok = re != NULL;
+    expresion_liberar(re);
+    ok = ok && expresion_compilar("(a{100}){210}", error, sizeof(error)) == NULL &&
+         strstr(error, "demasiado grande") != NULL;
+    ASSERT(ok, "expresion_compilar: rechaza patrones con más de 20000 estados");
+}
+
+/**
+ * @brief Un patrón que con retroceso es exponencial debe resolverse al instante.
+ */
+static void test_expresion_sin_retroceso(void) {
+    char linea[61];
+    memset(linea, 'a', 60);
+    linea[60] = '\0';
+    /* (a?){30}a{30} contra 30 'a' cuesta 2^30 pasos con retroceso */
+    ASSERT(coincide("(a?){30}a{30}", linea + 30) == 1 &&
+           coincide("(a?){30}a{31}", linea + 30) == 0,
+           "expresion_coincide: tiempo lineal en patrones patológicos");
+}
+
+/**
+ * @brief La caché de la sesión devuelve la misma expresión compilada.
+ */
+static void test_expresion_cache(void) {
+    CacheExpresiones *cache = NULL;
+    char error[128];
+    Expresion *a = expresion_de_cache(&cache, "time(out)?", error, sizeof(error));
+    Expresion *b = expresion_de_cache(&cache, "time(out)?", error, sizeof(error));
+    size_t len;
+    const char *lit = expresion_literal(a, &len);
+    ASSERT(a != NULL && a == b, "expresion_de_cache: reutiliza el patrón compilado");
+    ASSERT(lit != NULL && len == 4 && memcmp(lit, "time", 4) == 0,
+           "expresion_literal: extrae el literal obligatorio para el prefiltro");
+    expresion_cache_liberar(cache);
+}
+
+
+/* ============================================================
+ * Suite 11: Ordenamiento externo
+ * ============================================================ */
+
+/**
+ * @brief Con 1 MB de memoria, 200000 números se ordenan por corridas en
+ *        disco y la mezcla produce la salida completa y en orden.
+ */
+static void test_ordenar_con_corridas(void) {
+    char entrada[] = "/tmp/eafitos_orden_XXXXXX";
+    int fd = mkstemp(entrada);
+    ASSERT(fd >= 0, "ordenar: archivo temporal creado");
+    if (fd < 0) return;
+    FILE *f = fdopen(fd, "w");
+    unsigned int semilla = 7;
+    for (int i = 0; i < 200000; i++) fprintf(f, "%d\n", (int)(rand_r(&semilla) % 1000000) - 500000);
+    fclose(f);
+
+    OpcionesOrden op = { 1, 0, 0, 1, 1024 * 1024 };
+    ResumenOrden r;
+    const char *rutas[] = { entrada };
+    const char *ruta_error = NULL;
+    FILE *salida = tmpfile();
+    int res = ordenar_archivos(AT_FDCWD, rutas, 1, -1, &op, NULL, salida, &r, &ruta_error);
+    ASSERT(res == 0 && r.lineas == 200000 && r.corridas > 1,
+           "ordenar_archivos: reparte la entrada en varias corridas");
+
+    rewind(salida);
+    long previo = -1000000, n = 0;
+    int en_orden = 1;
+    char linea[32];
+    while (fgets(linea, sizeof(linea), salida) != NULL) {
+        long v = strtol(linea, NULL, 10);
+        if (v < previo) en_orden = 0;
+        previo = v;
+        n++;
+    }
+    ASSERT(en_orden && n == 200000, "ordenar_archivos: la mezcla sale completa y en orden numérico");
+    fclose(salida);
+    unlink(entrada);
+}
+
+/**
+ * @brief -u con -k: una línea por clave; -r invierte el orden.
+ */
+static void test_ordenar_unico_por_campo(void) {
+    char entrada[] = "/tmp/eafitos_orden_XXXXXX";
+    int fd = mkstemp(entrada);
+    if (fd < 0) return;
+    const char *datos = "b 2\na 1\nb 2\nd 3\n";
+    ssize_t w = write(fd, datos, strlen(datos));
+    close(fd);
+
+    OpcionesOrden op = { 0, 1, 1, 2, 1024 * 1024 };
+    const char *rutas[] = { entrada };
+    const char *ruta_error = NULL;
+    FILE *salida = tmpfile();
+    int res = ordenar_archivos(AT_FDCWD, rutas, 1, -1, &op, NULL, salida, NULL, &ruta_error);
+    rewind(salida);
+    char buf[64] = {0};
+    size_t n = fread(buf, 1, sizeof(buf) - 1, salida);
+    buf[n] = '\0';
+    ASSERT(w > 0 && res == 0 && strcmp(buf, "d 3\nb 2\na 1\n") == 0,
+           "ordenar_archivos: -u -r -k 2 quita repetidos y ordena descendente");
+    fclose(salida);
+    unlink(entrada);
+}
+
+
+/* ============================================================
+ * Suite 12: Primeras y últimas líneas
+ * ============================================================ */
+
+/**
+ * @brief Las últimas líneas se encuentran aunque crucen varios bloques de
+ *        lectura, con y sin '\n' final; las primeras se cortan a tiempo.
+ */
+static void test_lineas_extremos(void) {
+    char ruta[] = "/tmp/eafitos_lineas_XXXXXX";
+    int fd = mkstemp(ruta);
+    ASSERT(fd >= 0, "lineas: archivo temporal creado");
+    if (fd < 0) return;
+
+    /* "corta\n" + una línea de 3 bloques + "fin" (sin '\n' final) */
+    size_t largo = 3 * LINEAS_BLOQUE;
+    char *larga = malloc(largo + 1);
+    memset(larga, 'x', largo);
+    larga[largo] = '\n';
+    ssize_t w = write(fd, "corta\n", 6);
+    w += write(fd, larga, largo + 1);
+    w += write(fd, "fin", 3);
+    free(larga);
+    off_t tam = (off_t)(6 + largo + 1 + 3);
+
+    ASSERT(w == tam && lineas_desde_final(fd, tam, 1) == tam - 3 &&
+           lineas_desde_final(fd, tam, 2) == 6 &&
+           lineas_desde_final(fd, tam, 3) == 0 &&
+           lineas_desde_final(fd, tam, 50) == 0,
+           "lineas_desde_final: cuenta hacia atrás a través de varios bloques");
+
+    (void)!write(fd, "\n", 1);
+    ASSERT(lineas_desde_final(fd, tam + 1, 1) == tam - 3,
+           "lineas_desde_final: el '\\n' final no abre una línea vacía");
+
+    FILE *salida = tmpfile();
+    lseek(fd, 0, SEEK_SET);
+    int r = lineas_copiar_primeras(fd, 1, salida);
+    ASSERT(r == 0 && ftell(salida) == 6, "lineas_copiar_primeras: se detiene en el n-ésimo '\\n'");
+    fclose(salida);
+    close(fd);
+    unlink(ruta);
+}
+
+
+/* ============================================================
+ * Suite 13: Visor (leer -p)
+ * ============================================================ */
+
+/**
+ * @brief 20 MiB de líneas vacías obligan a compactar el índice disperso;
+ *        saltos, números de línea y búsquedas deben seguir siendo exactos.
+ */
+static void test_visor_indice(void) {
+    char ruta[] = "/tmp/eafitos_visor_XXXXXX";
+    int fd = mkstemp(ruta);
+    ASSERT(fd >= 0, "visor: archivo temporal creado");
+    if (fd < 0) return;
+    const off_t mb = 1 << 20, vacias = 20 * mb;
+    char *bloque = malloc((size_t)mb);
+    memset(bloque, '\n', (size_t)mb);
+    for (int i = 0; i < 20; i++) (void)!write(fd, bloque, (size_t)mb);
+    (void)!write(fd, "marca final\n", 12);
+    free(bloque);
+
+    Visor *v = visor_abrir(fd, vacias + 12);
+    int64_t total = -1;
+    for (int i = 0; i < 10000 && (total = visor_total_lineas(v, NULL)) < 0; i++) usleep(1000);
+    ASSERT(total == vacias + 1, "visor_total_lineas: el hilo cuenta todas las líneas");
+    ASSERT(visor_ir_linea(v, 5000001) == 5000000 && visor_numero_linea(v, 12345678) == 12345679,
+           "visor_ir_linea / visor_numero_linea: exactos tras compactar el índice");
+
+    char linea[32];
+    size_t n = visor_copiar_linea(v, vacias, linea, sizeof(linea));
+    ASSERT(visor_buscar(v, 0, "marca", 5, 0) == vacias &&
+           visor_buscar(v, vacias + 12, "marca", 5, 1) == vacias &&
+           visor_buscar(v, vacias, "marca", 5, 1) == -1 &&
+           n == 11 && memcmp(linea, "marca final", 11) == 0,
+           "visor_buscar: encuentra el texto en ambas direcciones a través de ventanas");
+    visor_cerrar(v);
+    close(fd);
+    unlink(ruta);
+}
+
+
+/* ============================================================
+ * Suite 14: Trabajos (paralelo)
+ * ============================================================ */
+
+/**
+ * @brief Comandos de la shell y programas externos devuelven su salida
+ *        capturada y su código de salida.
+ */
+static void test_trabajo_ejecutar(void) {
+    ContextoSesion origen;
+    sesion_iniciar(&origen);
+    ResultadoTrabajo r;
+
+    int ok = trabajo_ejecutar("calc 2 + 3", &origen, &r) == 0 && !r.externo &&
+             r.codigo == 0 && r.salida != NULL && strstr(r.salida, "5") != NULL;
+    free(r.salida);
+    ASSERT(ok, "trabajo_ejecutar: comando de la shell con salida propia");
+
+    ok = trabajo_ejecutar("echo hola mundo", &origen, &r) == 0 && r.externo &&
+         r.codigo == 0 && r.len == 11 && memcmp(r.salida, "hola mundo\n", 11) == 0;
+    free(r.salida);
+    ASSERT(ok, "trabajo_ejecutar: programa externo con la salida capturada");
+
+    ok = trabajo_ejecutar("false", &origen, &r) == 0 && r.codigo == 1;
+    free(r.salida);
+    ok = ok && trabajo_ejecutar("programa_que_no_existe_xyz", &origen, &r) == 0 &&
+         r.codigo == TRABAJO_NO_ENCONTRADO && r.len > 0;
+    free(r.salida);
+    ASSERT(ok, "trabajo_ejecutar: códigos de salida y programas inexistentes (127)");
+    sesion_cerrar(&origen);
+}
+
+/* ============================================================
+ * Suite 15: Redirecciones
+ * ============================================================ */
+
+static void test_separar_redirecciones(void) {
+    char linea[] = "buscar x a.txt >out.txt 2>> err.txt";
+    char **args = parsear_linea(linea);
+    Redirecciones r;
+    int ok = args != NULL && separar_redirecciones(args, &r) == 0 &&
+             strcmp(args[0], "buscar") == 0 && strcmp(args[2], "a.txt") == 0 &&
+             args[3] == NULL && r.entrada == NULL &&
+             strcmp(r.salida, "out.txt") == 0 && !r.anexar_salida &&
+             strcmp(r.errores, "err.txt") == 0 && r.anexar_errores;
+    MEM_FREE(args);
+    ASSERT(ok, "separar_redirecciones: quita > y 2>> (pegados o separados)");
+
+    char faltante[] = "listar >";
+    args = parsear_linea(faltante);
+    ok = args != NULL && separar_redirecciones(args, &r) == -1;
+    MEM_FREE(args);
+    ASSERT(ok, "separar_redirecciones: error si falta el archivo");
+
+    char literales[] = "buscar <div> \\>x f.html";
+    args = parsear_linea(literales);
+    ok = args != NULL && separar_redirecciones(args, &r) == 0 &&
+         strcmp(args[1], "<div>") == 0 && strcmp(args[2], ">x") == 0 &&
+         strcmp(args[3], "f.html") == 0 && r.entrada == NULL && r.salida == NULL;
+    MEM_FREE(args);
+    ASSERT(ok, "separar_redirecciones: <div> y \\>x son texto, no redirecciones");
+}
+
+static void test_redireccion_a_archivo(void) {
+    char ruta[] = "/tmp/eafitos_red_XXXXXX";
+    int fd = mkstemp(ruta);
+    if (fd >= 0) close(fd);
+
+    ContextoSesion origen;
+    sesion_iniciar(&origen);
+    ResultadoTrabajo r;
+    char linea[128];
+    snprintf(linea, sizeof(linea), "calc 2 + 3 > %s", ruta);
+    int ok = fd >= 0 && trabajo_ejecutar(linea, &origen, &r) == 0 && r.len == 0;
+    free(r.salida);
+    snprintf(linea, sizeof(linea), "echo fin >> %s", ruta);
+    ok = ok && trabajo_ejecutar(linea, &origen, &r) == 0 && r.codigo == 0 && r.len == 0;
+    free(r.salida);
+    sesion_cerrar(&origen);
+
+    char buf[256] = {0};
+    FILE *f = fopen(ruta, "r");
+    size_t n = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+    if (f) fclose(f);
+    ok = ok && n > 4 && strstr(buf, "5") != NULL && strcmp(buf + n - 4, "fin\n") == 0;
+    unlink(ruta);
+    ASSERT(ok, "redirecciones: > de un comando y >> de un programa externo");
+
+    /* 2> cambia los errores de la sesión, no el descriptor 2 del proceso */
+    char ruta_err[] = "/tmp/eafitos_red_err_XXXXXX";
+    fd = mkstemp(ruta_err);
+    if (fd >= 0) close(fd);
+    sesion_iniciar(&origen);
+    memset(&r, 0, sizeof(r));
+    snprintf(linea, sizeof(linea), "limite -t 5 ls /no/existe/eafitos 2> %s", ruta_err);
+    struct stat antes, despues;
+    ok = fd >= 0 && fstat(STDERR_FILENO, &antes) == 0 &&
+         trabajo_ejecutar(linea, &origen, &r) == 0 &&
+         (r.salida == NULL || strstr(r.salida, "/no/existe/eafitos") == NULL) &&
+         fstat(STDERR_FILENO, &despues) == 0 && antes.st_ino == despues.st_ino;
+    free(r.salida);
+    sesion_cerrar(&origen);
+    f = fopen(ruta_err, "r");
+    memset(buf, 0, sizeof(buf));
+    n = f ? fread(buf, 1, sizeof(buf) - 1, f) : 0;
+    if (f) fclose(f);
+    unlink(ruta_err);
+    ASSERT(ok && strstr(buf, "/no/existe/eafitos") != NULL,
+           "redirecciones: 2> va al stream de errores de la sesión");
+}
+
+/** @brief Ejecuta una línea con salida y errores separados; devuelve la salida. */
+static char *salida_y_errores(const char *linea_original, char **errores) {
+    ContextoSesion sesion;
+    sesion_iniciar(&sesion);
+    char *texto = NULL;
+    size_t len = 0, len_errores = 0;
+    sesion.salida = open_memstream(&texto, &len);
+    sesion.errores = open_memstream(errores, &len_errores);
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &sesion;
+
+    char *linea = strdup(linea_original);
+    char **args = parsear_linea(linea);
+    ejecutar(args);
+    MEM_FREE(args);
+    free(linea);
+
+    sesion_actual = anterior;
+    fclose(sesion.salida);
+    fclose(sesion.errores);
+    sesion.salida = sesion.errores = NULL;
+    sesion_cerrar(&sesion);
+    return texto;
+}
+
+static void test_redireccion_de_comandos(void) {
+    char datos[] = "/tmp/eafitos_red_datos_XXXXXX";
+    char ruta_err[] = "/tmp/eafitos_red_err_XXXXXX";
+    int fd = mkstemp(datos);
+    int ok = fd >= 0 && write(fd, "pera\nmanzana\nuva\n", 17) == 17;
+    if (fd >= 0) close(fd);
+    fd = mkstemp(ruta_err);
+    if (fd >= 0) close(fd);
+    ok = ok && fd >= 0;
+
+    /* Los [ERROR] de los comandos van a 2>, no a la salida */
+    char linea[160], *errores = NULL;
+    snprintf(linea, sizeof(linea), "contar /no/existe/eafitos 2> %s", ruta_err);
+    char *texto = salida_y_errores(linea, &errores);
+    char buf[256] = {0};
+    FILE *f = fopen(ruta_err, "r");
+    if (f) {
+        if (fread(buf, 1, sizeof(buf) - 1, f) == 0) buf[0] = '\0';
+        fclose(f);
+    }
+    ASSERT(ok && texto != NULL && texto[0] == '\0' && errores != NULL && errores[0] == '\0' &&
+           strstr(buf, "[ERROR]") != NULL && strstr(buf, "/no/existe/eafitos") != NULL,
+           "redirecciones: 2> recoge los errores de un comando de la shell");
+    free(texto);
+    free(errores);
+    unlink(ruta_err);
+
+    /* contar, ordenar y buscar sin archivos leen de `<` */
+    snprintf(linea, sizeof(linea), "contar -l < %s --formato tsv", datos);
+    texto = salida_y_errores(linea, &errores);
+    ok = ok && texto != NULL && strcmp(texto, "archivo\tlineas\n-\t3\n") == 0 &&
+         errores != NULL && errores[0] == '\0';
+    free(texto);
+    free(errores);
+    snprintf(linea, sizeof(linea), "ordenar < %s", datos);
+    texto = salida_y_errores(linea, &errores);
+    ok = ok && texto != NULL && strcmp(texto, "manzana\npera\nuva\n") == 0;
+    free(texto);
+    free(errores);
+    snprintf(linea, sizeof(linea), "buscar -e an < %s --formato tsv", datos);
+    texto = salida_y_errores(linea, &errores);
+    ok = ok && texto != NULL && strstr(texto, "manzana") != NULL && strstr(texto, "pera") == NULL;
+    free(texto);
+    free(errores);
+    unlink(datos);
+    ASSERT(ok, "redirecciones: contar, ordenar y buscar leen de < sin archivos");
+
+    /* Sin `<` no leen la entrada de la sesión: piden un archivo */
+    texto = salida_y_errores("contar", &errores);
+    ASSERT(texto != NULL && texto[0] == '\0' && errores != NULL && strstr(errores, "Uso:") != NULL,
+           "redirecciones: sin < ni archivos, contar muestra el uso");
+    free(texto);
+    free(errores);
+}
+
+/* ============================================================
+ * Suite 16: Salida estructurada
+ * ============================================================ */
+
+/** @brief Ejecuta una línea en una sesión propia y devuelve su salida (con los errores). */
+static char *salida_de(const char *linea_original, int formato) {
+    ContextoSesion sesion;
+    sesion_iniciar(&sesion);
+    sesion.formato = formato;
+    char *texto = NULL;
+    size_t len = 0;
+    sesion.salida = open_memstream(&texto, &len);
+    sesion.errores = sesion.salida;
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &sesion;
+
+    char *linea = strdup(linea_original);
+    char **args = parsear_linea(linea);
+    ejecutar(args);
+    MEM_FREE(args);
+    free(linea);
+
+    sesion_actual = anterior;
+    fclose(sesion.salida);
+    sesion.salida = sesion.errores = NULL;
+    sesion_cerrar(&sesion);
+    return texto;
+}
+
+static void test_formato_registros(void) {
+    ContextoSesion sesion;
+    sesion_iniciar(&sesion);
+    char *texto = NULL;
+    size_t len = 0;
+    sesion.salida = open_memstream(&texto, &len);
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &sesion;
+
+    sesion.formato = FORMATO_JSON;
+    registro_abrir();
+    registro_texto("t", "a\"b\tc");
+    registro_entero("n", -3);
+    registro_cerrar();
+    sesion.formato = FORMATO_TSV;
+    for (int i = 0; i < 2; i++) {
+        registro_abrir();
+        registro_texto("t", "x\ty");
+        registro_real("r", 0.5);
+        registro_cerrar();
+    }
+    registro_abrir();
+    registro_entero("otro", 1);
+    registro_cerrar();
+
+    sesion_actual = anterior;
+    fclose(sesion.salida);
+    sesion.salida = NULL;
+    sesion_cerrar(&sesion);
+    int ok = texto != NULL && strcmp(texto,
+        "{\"t\":\"a\\\"b\\tc\",\"n\":-3}\n"
+        "t\tr\nx\\ty\t0.5\nx\\ty\t0.5\n"
+        "otro\n1\n") == 0;
+    free(texto);
+    ASSERT(ok, "registros: JSON escapado y TSV con cabecera solo al cambiar");
+}
+
+static void test_formato_comandos(void) {
+    char *calc = salida_de("calc 7 / 2 --formato json", FORMATO_TEXTO);
+    char *error = salida_de("calc 1 / 0", FORMATO_JSON);
+    char *texto = salida_de("calc 1 + 1", FORMATO_TEXTO);
+    int ok = calc != NULL && strcmp(calc, "{\"resultado\":3.5}\n") == 0 &&
+             error != NULL && strcmp(error, "{\"error\":\"División por cero no permitida.\"}\n") == 0 &&
+             texto != NULL && strstr(texto, "\033[") != NULL;
+    free(calc);
+    free(error);
+    free(texto);
+    ASSERT(ok, "--formato: registros propios y mensajes sin colores, solo para ese comando");
+}
+
+
+/* ============================================================
+ * Suite 17: Cancelación (Ctrl+C)
+ * ============================================================ */
+
+static int contar_bloques(const BloqueArchivo *b, void *usuario) {
+    (void)b;
+    (*(int *)usuario)++;
+    return 0;
+}
+
+/** @brief Texto acumulado de uno de los archivos de un lote. */
+typedef struct {
+    size_t indice;
+    char texto[64];
+} Texto;
+
+static int juntar_bloques(const BloqueArchivo *b, void *usuario) {
+    Texto *t = usuario;
+    size_t len = strlen(t->texto);
+    if (b->indice == t->indice && len + b->longitud < sizeof(t->texto)) {
+        memcpy(t->texto + len, b->datos, b->longitud);
+        t->texto[len + b->longitud] = '\0';
+    }
+    return 0;
+}
+
+/**
+ * @brief Con la cancelación pedida los recorridos se detienen antes del
+ *        primer bloque y el self-pipe despierta a poll(); reiniciar lo
+ *        deja todo como antes.
+ */
+static void test_cancelacion(void) {
+    const char *rutas[] = { "Makefile" };
+    int bloques = 0;
+
+    cancelacion_solicitar();
+    struct pollfd pfd = { cancelacion_fd(), POLLIN, 0 };
+    ASSERT(cancelacion_solicitada() && poll(&pfd, 1, 0) == 1,
+           "cancelacion: la bandera se activa y el descriptor queda legible");
+
+    int r = leer_archivos_en_lote(AT_FDCWD, rutas, 1, contar_bloques, &bloques);
+    int fd = open("Makefile", O_RDONLY);
+    FILE *salida = tmpfile();
+    errno = 0;
+    int r_lineas = lineas_copiar_primeras(fd, 1, salida);
+    int error = errno;
+    fclose(salida);
+    close(fd);
+    ASSERT(r == 1 && bloques == 0 && r_lineas == -1 && error == ECANCELED,
+           "cancelacion: lectura por lotes y por líneas se detienen (ECANCELED)");
+
+    cancelacion_reiniciar();
+    r = leer_archivos_en_lote(AT_FDCWD, rutas, 1, contar_bloques, &bloques);
+    ASSERT(!cancelacion_solicitada() && poll(&pfd, 1, 0) == 0 && r == 0 && bloques > 0,
+           "cancelacion: reiniciar vacía el pipe y los recorridos vuelven a funcionar");
+}
+
+/** @brief Descriptores abiertos del proceso; 'anillos' recibe los de io_uring. */
+static int contar_descriptores(int *anillos) {
+    DIR *d = opendir("/proc/self/fd");
+    int n = 0;
+    *anillos = 0;
+    struct dirent *e;
+    while (d != NULL && (e = readdir(d)) != NULL) {
+        char ruta[300], destino[64];
+        snprintf(ruta, sizeof(ruta), "/proc/self/fd/%s", e->d_name);
+        ssize_t largo = readlink(ruta, destino, sizeof(destino) - 1);
+        if (largo <= 0) continue;
+        destino[largo] = '\0';
+        n++;
+        *anillos += strstr(destino, "io_uring") != NULL;
+    }
+    if (d != NULL) closedir(d);
+    return n;
+}
+
+/** @brief Lecturas repetidas reutilizan el anillo del hilo y no dejan descriptores. */
+static void test_lectura_lotes(void) {
+    const char *rutas[] = { "Makefile", "README.md", "no_existe.eafitos", "CHANGELOG.md" };
+    int bloques = 0, anillos_antes, anillos_despues;
+    int r = leer_archivos_en_lote(AT_FDCWD, rutas, 4, contar_bloques, &bloques);
+    int antes = contar_descriptores(&anillos_antes);
+    for (int i = 0; i < 50 && r == 0; i++) {
+        r = leer_archivos_en_lote(AT_FDCWD, rutas, 4, contar_bloques, &bloques);
+    }
+    int despues = contar_descriptores(&anillos_despues);
+    ASSERT(r == 0 && bloques >= 4 * 51 && antes == despues,
+           "leer_archivos_en_lote: las llamadas repetidas no dejan descriptores abiertos");
+    ASSERT(!lectura_lotes_usa_io_uring() || (anillos_antes == 1 && anillos_despues == 1),
+           "leer_archivos_en_lote: un solo anillo por hilo, reutilizado en cada llamada");
+
+    /* Una FIFO entrega datos en lecturas cortas: el fin es cuando devuelve 0 */
+    char fifo[] = "/tmp/eafitos_fifo_XXXXXX";
+    int tmp = mkstemp(fifo);
+    if (tmp >= 0) {
+        close(tmp);
+        unlink(fifo);
+    }
+    ASSERT(tmp >= 0 && mkfifo(fifo, 0600) == 0, "leer_archivos_en_lote: FIFO creada");
+    pid_t escritor = fork();
+    if (escritor == 0) {
+        int fd = open(fifo, O_WRONLY);
+        if (write(fd, "hola ", 5) != 5) _exit(1);
+        usleep(100000);
+        if (write(fd, "mundo", 5) != 5) _exit(1);
+        _exit(0);
+    }
+    const char *con_fifo[] = { "Makefile", fifo, "README.md" };
+    Texto leido = { 1, "" };
+    r = leer_archivos_en_lote(AT_FDCWD, con_fifo, 3, juntar_bloques, &leido);
+    waitpid(escritor, NULL, 0);
+    unlink(fifo);
+    ASSERT(r == 0 && strcmp(leido.texto, "hola mundo") == 0,
+           "leer_archivos_en_lote: una lectura corta no corta el archivo");
+}
+
+
+/* ============================================================
+ * Suite 18: Medición (medir)
+ * ============================================================ */
+
+/**
+ * @brief Un programa externo se mide con sus propios recursos (wait4), y
+ *        un trabajo en la shell con la diferencia de getrusage.
+ */
+static void test_medicion(void) {
+    /* La shell toca 200 MB: el pico de un programa pequeño no puede ser ese */
+    size_t grande = 200u * 1024 * 1024;
+    char *bloque = mmap(NULL, grande, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bloque != MAP_FAILED) {
+        memset(bloque, 1, grande);
+        munmap(bloque, grande);
+    }
+    char *args_false[] = { "false", NULL };
+    struct rusage uso;
+    memset(&uso, 0, sizeof(uso));
+    Cronometro c;
+    Medicion m;
+    medicion_comenzar(&c);
+    int codigo = trabajo_externo(args_false, &uso);
+    medicion_terminar(&c, &uso, &m);
+    ASSERT(codigo == 1 && m.real > 0 && bloque != MAP_FAILED &&
+           m.rss_max_kb < 100 * 1024 && !m.memoria_del_proceso,
+           "medicion: la memoria máxima de un programa no es la de la shell");
+
+    medicion_comenzar(&c);
+    volatile unsigned long x = 0;
+    for (unsigned long k = 0; k < 20000000UL; k++) x += k;
+    medicion_terminar(&c, NULL, &m);
+    ASSERT(m.real > 0 && m.usuario + m.sistema > 0 && m.fallos_menores >= 0 &&
+           (!m.hay_contadores || m.instrucciones > 20000000ULL) && m.memoria_del_proceso,
+           "medicion: tiempo de CPU (y contadores, si hay) de un bucle en la shell");
+}
+
+
+/* ============================================================
+ * Suite 19: limite (tiempo y memoria por comando)
+ * ============================================================ */
+
+static void test_limite(void) {
+    LimiteComando l;
+    limite_comenzar(&l, 50, 1 << 20);
+    int antes = cancelacion_solicitada();
+    int cargada = limite_cargar(512 * 1024);
+    int excedida = limite_cargar(1024 * 1024);
+    struct pollfd pfd = { limite_fd(), POLLIN, 0 };
+    int desperto = poll(&pfd, 1, 2000);
+    int cancelado = cancelacion_solicitada();
+    MotivoLimite motivo = limite_motivo(&l);
+    limite_terminar(&l);
+    ASSERT(antes == 0 && desperto == 1 && cancelado == 1 && motivo == LIMITE_MEMORIA &&
+           cargada == 0 && excedida == -1 && !cancelacion_solicitada(),
+           "limite: el tope de memoria detiene el comando y el timerfd despierta poll()");
+
+    char *args_sleep[] = { "sleep", "5", NULL };
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    limite_comenzar(&l, 100, 0);
+    int codigo = trabajo_externo(args_sleep, NULL);
+    motivo = limite_motivo(&l);
+    limite_terminar(&l);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double s = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9;
+    ASSERT(codigo == 128 + 15 && motivo == LIMITE_TIEMPO && s < 2.0,
+           "limite: un programa externo recibe SIGTERM al vencer el plazo");
+
+    /* El tope de memoria ya rige cuando el programa arranca */
+    char *args_limites[] = { "cat", "/proc/self/limits", NULL };
+    char *texto = NULL;
+    size_t len = 0;
+    FILE *salida_anterior = sesion_actual->salida;
+    sesion_actual->salida = open_memstream(&texto, &len);
+    limite_comenzar(&l, 0, 64u << 20);
+    codigo = trabajo_externo(args_limites, NULL);
+    limite_terminar(&l);
+    fclose(sesion_actual->salida);
+    sesion_actual->salida = salida_anterior;
+    const char *as = (texto != NULL) ? strstr(texto, "Max address space") : NULL;
+    unsigned long long blando = 0;
+    int ok = codigo == 0 && as != NULL &&
+             sscanf(as, "Max address space %llu", &blando) == 1 &&
+             blando > 0 && blando <= (64ull << 20);
+    free(texto);
+    ASSERT(ok, "limite: RLIMIT_AS se fija en el hijo antes del exec");
+}
+
+
+/* ============================================================
+ * Suite 20: Rastreo de memoria (memoria) y bucle sin asignaciones
+ * ============================================================ */
+
+static void test_rastreo_memoria(void) {
+    static const char sitio[] = "prueba_memoria.c";
+    EstadisticasMemoria antes, durante, despues;
+    memoria_estadisticas(&antes);
+    char *a = mem_malloc_rastreado(100, sitio, 1);
+    char *b = mem_strdup_rastreado("hola", sitio, 2);
+    a = mem_realloc_rastreado(a, 1000, sitio, 3);
+    memset(a, 'x', 1000);
+    memoria_estadisticas(&durante);
+
+    SitioMemoria s[64];
+    size_t n = memoria_sitios(s, 64);
+    int encontrado = 0;
+    for (size_t i = 0; i < n && i < 64; i++) {
+        if (s[i].archivo == sitio && s[i].linea == 3) {
+            encontrado = (s[i].e.bloques_vivos == 1 && s[i].e.bytes_vivos == 1000);
+        }
+    }
+    mem_free_rastreado(a);
+    mem_free_rastreado(b);
+    memoria_estadisticas(&despues);
+    ASSERT(a != NULL && ((uintptr_t)a % _Alignof(max_align_t)) == 0 && encontrado &&
+           durante.asignaciones == antes.asignaciones + 3 &&
+           durante.bloques_vivos == antes.bloques_vivos + 2 &&
+           durante.bytes_vivos == antes.bytes_vivos + 1005 &&
+           durante.pico_bytes >= durante.bytes_vivos &&
+           despues.bloques_vivos == antes.bloques_vivos && despues.bytes_vivos == antes.bytes_vivos,
+           "memoria: cuenta por sitio, mueve el bloque con realloc y lo descuenta al liberar");
+}
+
+static void test_parsear_linea_reutiliza(void) {
+    char **tokens = NULL;
+    size_t cap = 0;
+    char l1[] = "buscar x a.txt\n";
+    char **r1 = parsear_linea_en(l1, &tokens, &cap);
+    char **primero = tokens;
+    size_t cap1 = cap;
+    char l2[] = "listar\n";
+    char **r2 = parsear_linea_en(l2, &tokens, &cap);
+    int reutiliza = (r1 == primero && r2 == primero && cap == cap1 &&
+                     strcmp(r2[0], "listar") == 0 && r2[1] == NULL);
+
+    char larga[400];
+    size_t len = 0;
+    for (int i = 0; i < 100; i++) len += (size_t)snprintf(larga + len, sizeof(larga) - len, "t ");
+    char **r3 = parsear_linea_en(larga, &tokens, &cap);
+    int crece = (r3 != NULL && cap >= 101 && r3[99] != NULL && r3[100] == NULL);
+    MEM_FREE(tokens);
+    ASSERT(reutiliza && crece,
+           "parsear_linea_en: reutiliza el arreglo y solo crece si no caben los tokens");
+}
+
+/* ============================================================
+ * Suite 21: Directorio de la sesión (cd, pushd, popd)
+ * ============================================================ */
+
+static void test_directorio_sesion(void) {
+    char dir[] = "/tmp/eafitos_cd_XXXXXX";
+    char sub[64], real[4096];
+    int ok = mkdtemp(dir) != NULL && realpath(dir, real) != NULL;
+    snprintf(sub, sizeof(sub), "%s/sub", dir);
+    ok = ok && mkdir(sub, 0755) == 0;
+
+    ContextoSesion s;
+    sesion_iniciar(&s);
+    ok = ok && sesion_cambiar_directorio(&s, dir) == 0 &&
+         strcmp(sesion_directorio(&s), real) == 0;
+    /* Relativa al directorio de la sesión, no al del proceso */
+    ok = ok && sesion_cambiar_directorio(&s, "sub") == 0 &&
+         strncmp(sesion_directorio(&s), real, strlen(real)) == 0 &&
+         strcmp(sesion_directorio(&s) + strlen(real), "/sub") == 0 &&
+         strcmp(s.directorio_anterior, real) == 0;
+    int fd = openat(s.dir_fd, "creado.txt", O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd >= 0) close(fd);
+    char creado[96];
+    snprintf(creado, sizeof(creado), "%s/creado.txt", sub);
+    ok = ok && fd >= 0 && access(creado, F_OK) == 0;
+    int fallo = sesion_cambiar_directorio(&s, "no_existe");
+    ok = ok && fallo == -1 && strcmp(s.directorio_anterior, real) == 0;
+    sesion_cerrar(&s);
+    ASSERT(ok, "sesion_cambiar_directorio: rutas relativas al fd de la sesión y ruta canónica en caché");
+
+    char *texto = salida_de("pushd ..", FORMATO_JSON);
+    ok = texto != NULL && strstr(texto, "\"indice\":1") != NULL;
+    free(texto);
+    unlink(creado);
+    rmdir(sub);
+    rmdir(dir);
+    ASSERT(ok, "pushd: guarda el directorio anterior en la pila");
+}
+
+/* ============================================================
+ * Suite 22: Archivo de inicio ~/.eafitosrc e instantánea
+ * ============================================================ */
+
+static int escribir_rc(const char *ruta, const char *texto) {
+    FILE *f = fopen(ruta, "w");
+    if (f == NULL) return 0;
+    fputs(texto, f);
+    return fclose(f) == 0;
+}
+
+static void test_configuracion_rc(void) {
+    char dir[] = "/tmp/eafitos_rc_XXXXXX";
+    char rc[64], cache[80];
+    int ok = mkdtemp(dir) != NULL;
+    snprintf(rc, sizeof(rc), "%s/rc", dir);
+    snprintf(cache, sizeof(cache), "%s/rc" RC_SUFIJO_INSTANTANEA, dir);
+    ok = ok && escribir_rc(rc, "# prueba\nprompt mi shell\n"
+                               "alias ll=listar -l\nalias zz=pwd\nalias ll=listar -a\n"
+                               "export EAFITOS_PRUEBA_RC=hola mundo\n");
+
+    ContextoSesion s;
+    sesion_iniciar(&s);
+    OrigenConfiguracion primera = configuracion_cargar(rc, &s);
+    OrigenConfiguracion segunda = configuracion_cargar(rc, &s);
+    const char *var = variable_obtener("EAFITOS_PRUEBA_RC");
+    ok = ok && primera == RC_PARSEADO && segunda == RC_DESDE_INSTANTANEA &&
+         access(cache, F_OK) == 0 && strcmp(s.prompt, "mi shell") == 0 &&
+         var != NULL && strcmp(var, "hola mundo") == 0;
+    ASSERT(ok, "configuracion_cargar: parsea el rc una vez y luego usa la instantánea");
+    ASSERT(getenv("EAFITOS_PRUEBA_RC") == NULL,
+           "configuracion_cargar: las variables del rc no tocan el entorno del proceso");
+
+    /* `export` en una sesión tapa al rc solo en esa sesión */
+    ContextoSesion *previa = sesion_actual;
+    sesion_actual = &s;
+    ok = variable_definir("EAFITOS_PRUEBA_RC", "de la sesión") == 0 &&
+         variable_definir("EAFITOS_PRUEBA_SESION", "x") == 0 &&
+         variable_definir("1MAL", "x") == -1 && errno == EINVAL;
+    char **entorno = variables_entorno();
+    int en_entorno = 0, repetidas = 0;
+    for (size_t i = 0; entorno != NULL && entorno[i] != NULL; i++) {
+        en_entorno += strcmp(entorno[i], "EAFITOS_PRUEBA_RC=de la sesión") == 0;
+        repetidas += strncmp(entorno[i], "EAFITOS_PRUEBA_RC=", 18) == 0;
+    }
+    free(entorno);
+    ok = ok && strcmp(variable_obtener("EAFITOS_PRUEBA_RC"), "de la sesión") == 0 &&
+         en_entorno == 1 && repetidas == 1;
+    ContextoSesion otra_sesion;
+    sesion_iniciar(&otra_sesion);
+    ContextoSesion copia;
+    sesion_iniciar(&copia);
+    ok = ok && variables_copiar(&copia, &s) == 0;
+    sesion_actual = &otra_sesion;
+    var = variable_obtener("EAFITOS_PRUEBA_RC");
+    ok = ok && var != NULL && strcmp(var, "hola mundo") == 0 &&
+         variable_obtener("EAFITOS_PRUEBA_SESION") == NULL;
+    sesion_actual = &copia;
+    var = variable_obtener("EAFITOS_PRUEBA_SESION");
+    ok = ok && var != NULL && strcmp(var, "x") == 0;
+    sesion_actual = previa;
+    sesion_cerrar(&otra_sesion);
+    sesion_cerrar(&copia);
+    variables_liberar(&s);
+    ASSERT(ok, "variable_definir: cada sesión tiene sus variables (y las copia paralelo)");
+
+    char *args[] = { "ll", "src", NULL };
+    char **e = alias_expandir(args);
+    ok = e != NULL && strcmp(e[0], "listar") == 0 && strcmp(e[1], "-a") == 0 &&
+         strcmp(e[2], "src") == 0 && e[3] == NULL && alias_existe("zz") && !alias_existe("l");
+    free(e);
+    ASSERT(ok, "alias_expandir: la última definición gana y se añaden los argumentos");
+
+    /* Cambiar el rc invalida la instantánea (que sigue en disco, ya vieja) */
+    char *args_ll[] = { "ll", NULL };
+    ok = access(cache, F_OK) == 0 && escribir_rc(rc, "alias ll=leer -x\n") &&
+         configuracion_cargar(rc, &s) == RC_PARSEADO;
+    e = alias_expandir(args_ll);
+    ok = ok && e != NULL && strcmp(e[0], "leer") == 0 && strcmp(e[1], "-x") == 0 &&
+         !alias_existe("zz") && configuracion_cargar(rc, &s) == RC_DESDE_INSTANTANEA;
+    free(e);
+    ASSERT(ok, "configuracion_cargar: un rc modificado se vuelve a parsear");
+
+    /* Un rc con errores no guarda instantánea: se parsea en cada arranque */
+    ok = escribir_rc(rc, "alias ll=leer\nnada aqui\n") &&
+         configuracion_cargar(rc, &s) == RC_PARSEADO &&
+         configuracion_cargar(rc, &s) == RC_PARSEADO;
+    sesion_cerrar(&s);
+    unlink(cache);
+    unlink(rc);
+    rmdir(dir);
+    ASSERT(ok, "configuracion_cargar: sin instantánea si el rc tiene avisos");
+
+    /* Los alias de `alias` son de cada sesión */
+    ContextoSesion otra;
+    sesion_iniciar(&otra);
+    char *tokens[] = { "pwd", NULL };
+    ok = alias_definir("solo_aqui", tokens) == 0 && alias_existe("solo_aqui");
+    ContextoSesion *anterior = sesion_actual;
+    sesion_actual = &otra;
+    ok = ok && !alias_existe("solo_aqui");
+    sesion_actual = anterior;
+    sesion_cerrar(&otra);
+    ASSERT(ok, "alias_definir: el alias no se ve desde otra sesión");
+}
+
+/* ============================================================
+ * Suite 23: Grabación y reproducción de sesiones
+ * ============================================================ */
+
+/** @brief Ejecuta 'linea' como lo hace loop_shell() mientras se graba. */
+static void ejecutar_grabando(const char *linea) {
+    char copia[128];
+    snprintf(copia, sizeof(copia), "%s", linea);
+    grabacion_comenzar_linea(copia);
+    char **args = parsear_linea(copia);
+    if (args != NULL) ejecutar(args);
+    grabacion_terminar_linea();
+    MEM_FREE(args);
+}
+
+static void test_grabacion(void) {
+    char ruta[] = "/tmp/eafitos_grabacion_XXXXXX";
+    int fd = mkstemp(ruta);
+    if (fd >= 0) close(fd);
+
+    /* La salida grabada también llega a la sesión (aquí, a memoria) */
+    char *texto = NULL;
+    size_t len = 0;
+    FILE *salida_anterior = sesion_actual->salida;
+    sesion_actual->salida = open_memstream(&texto, &len);
+    int ok = fd >= 0 && grabacion_iniciar(ruta) == 0;
+    ejecutar_grabando("calc 2 + 3");
+    ejecutar_grabando("calc 10 / 4");
+    grabacion_cerrar();
+    fclose(sesion_actual->salida);
+    sesion_actual->salida = salida_anterior;
+    ok = ok && texto != NULL && strstr(texto, "5") != NULL;
+    free(texto);
+    ASSERT(ok, "--grabar: la salida se sigue mostrando mientras se graba");
+
+    ok = grabacion_reproducir(ruta, 0) == 0;
+    ASSERT(ok, "--reproducir: las salidas coinciden con lo grabado");
+
+    /* Otra salida para la misma línea: se detecta la diferencia */
+    FILE *f = fopen(ruta, "a");
+    if (f != NULL) {
+        fprintf(f, "0\t0\t0000000000000000\t3\tcalc 1 + 1\t\n");
+        fclose(f);
+    }
+    ok = f != NULL && grabacion_reproducir(ruta, 0) == 1;
+    unlink(ruta);
+    ASSERT(ok, "--reproducir: informa las salidas distintas");
+}
+
+/* ============================================================
+ * Suite 24: Diferencias en formato unificado (comparar)
+ * ============================================================ */
+
+static void test_diferencias(void) {
+    const char *a = "uno\ndos\ntres\ncuatro\ncinco\nseis\nsiete\nocho\n";
+    const char *b = "uno\ndos\ntres\nCUATRO\ncinco\nseis\nsiete\nocho\nnueve\n";
+    char *texto = NULL;
+    size_t len = 0;
+    FILE *salida = open_memstream(&texto, &len);
+    ResumenDiferencias r;
+    int res = diferencias_unificadas((const unsigned char *)a, strlen(a), "a",
+                                     (const unsigned char *)b, strlen(b), "b",
+                                     1, salida, 0, &r);
+    fclose(salida);
+    int ok = res == 1 && texto != NULL &&
+             strstr(texto, "--- a\n+++ b\n@@ -3,3 +3,3 @@\n tres\n-cuatro\n+CUATRO\n cinco\n") != NULL;
+    ASSERT(ok, "comparar: bloque @@ con una línea de contexto y el cambio");
+
+    ok = texto != NULL && strstr(texto, "@@ -8 +8,2 @@\n ocho\n+nueve\n") != NULL &&
+         r.borradas == 1 && r.agregadas == 2 && r.bloques == 2;
+    free(texto);
+    ASSERT(ok, "comparar: línea agregada al final y totales del resumen");
+
+    res = diferencias_unificadas((const unsigned char *)a, strlen(a), "a",
+                                 (const unsigned char *)a, strlen(a), "a",
+                                 DIFERENCIAS_CONTEXTO, NULL, 0, &r);
+    ASSERT(res == 0 && r.bloques == 0, "comparar: textos iguales no producen bloques");
+
+    /* Distintos solo en la primera y la última línea: la memoria no depende
+     * de las 400 mil líneas de en medio */
+    enum { LINEAS = 400000, INSERTADAS = 20000 };
+    char *ta = malloc(LINEAS * 16), *tb = malloc((LINEAS + INSERTADAS) * 16);
+    size_t na = 0, nb = 0;
+    for (int i = 0; ta != NULL && tb != NULL && i < LINEAS; i++) {
+        na += (size_t)sprintf(ta + na, "linea %07d\n", i);
+        nb += (size_t)sprintf(tb + nb, (i == 0 || i == LINEAS - 1) ? "LINEA %07d\n" : "linea %07d\n", i);
+    }
+    LimiteComando l;
+    limite_comenzar(&l, 0, 16u << 20);
+    res = (ta != NULL && tb != NULL)
+        ? diferencias_unificadas((const unsigned char *)ta, na, "a", (const unsigned char *)tb, nb, "b",
+                                 DIFERENCIAS_CONTEXTO, NULL, 0, &r)
+        : -1;
+    limite_terminar(&l);
+    ok = res == 1 && r.borradas == 2 && r.agregadas == 2 && r.bloques == 2;
+    ASSERT(ok, "comparar: cambios en los extremos de un texto grande con 16 MB");
+
+    /* Un bloque insertado más largo que la ventana sigue siendo un solo cambio */
+    nb = 0;
+    for (int i = 0; ta != NULL && tb != NULL && i < LINEAS; i++) {
+        if (i == LINEAS / 2) {
+            for (int j = 0; j < INSERTADAS; j++) nb += (size_t)sprintf(tb + nb, "nueva %07d\n", j);
+        }
+        nb += (size_t)sprintf(tb + nb, "linea %07d\n", i);
+    }
+    res = (ta != NULL && tb != NULL)
+        ? diferencias_unificadas((const unsigned char *)ta, na, "a", (const unsigned char *)tb, nb, "b",
+                                 DIFERENCIAS_CONTEXTO, NULL, 0, &r)
+        : -1;
+    free(ta);
+    free(tb);
+    ok = res == 1 && r.borradas == 0 && r.agregadas == INSERTADAS && r.bloques == 1;
+    ASSERT(ok, "comparar: inserción mayor que la ventana en un solo bloque");
+}
+
+/* ============================================================
+ * Suite 25: Reemplazo atómico en archivos (reemplazar)
+ * ============================================================ */
+
+static void test_reemplazo(void) {
+    char ruta[] = "/tmp/eafitos_reemplazo_XXXXXX";
+    int fd = mkstemp(ruta);
+    const char *texto = "uno dos uno\ntres uno\n";
+    int ok = fd >= 0 && write(fd, texto, strlen(texto)) == (ssize_t)strlen(texto);
+    if (fd >= 0) close(fd);
+
+    ResultadoReemplazo r;
+    ok = ok && reemplazar_en_archivo(AT_FDCWD, ruta, "uno", 3, "1", 1, &r) == 0 &&
+         r.reemplazos == 3 && r.reescrito == 1;
+    char leido[64] = {0};
+    FILE *f = fopen(ruta, "r");
+    if (f != NULL) {
+        size_t n = fread(leido, 1, sizeof(leido) - 1, f);
+        leido[n] = '\0';
+        fclose(f);
+    }
+    ok = ok && strcmp(leido, "1 dos 1\ntres 1\n") == 0;
+    ASSERT(ok, "reemplazar: todas las apariciones, escritas con rename()");
+
+    /* Sin apariciones: el archivo no se reescribe (mismo inodo) */
+    struct stat antes, despues;
+    ok = stat(ruta, &antes) == 0 &&
+         reemplazar_en_archivo(AT_FDCWD, ruta, "cuatro", 6, "4", 1, &r) == 0 &&
+         stat(ruta, &despues) == 0 &&
+         r.reemplazos == 0 && r.reescrito == 0 && antes.st_ino == despues.st_ino;
+    ASSERT(ok, "reemplazar: los archivos sin cambios no se reescriben");
+
+    errno = 0;
+    ok = reemplazar_en_archivo(AT_FDCWD, "/tmp", "a", 1, "b", 1, &r) == -1 && errno == EISDIR;
+    unlink(ruta);
+    ASSERT(ok, "reemplazar: un directorio se rechaza sin tocar nada");
+
+    /* Los hilos de trabajo usan el directorio de la sesión, no el del proceso */
+    char dir[] = "/tmp/eafitos_reemplazo_dir_XXXXXX";
+    char linea[PATH_MAX + 16], archivo[PATH_MAX], buf[512];
+    ok = mkdtemp(dir) != NULL;
+    for (int i = 0; ok && i < 8; i++) {
+        snprintf(archivo, sizeof(archivo), "%s/rz%d.txt", dir, i);
+        f = fopen(archivo, "w");
+        ok = f != NULL && fputs("hola\n", f) >= 0;
+        if (f != NULL) fclose(f);
+    }
+    setenv("EAFITOS_HILOS", "8", 1);
+    eafitos_ctx *ctx = eafitos_create();
+    snprintf(linea, sizeof(linea), "cd %s", dir);
+    capturar(ctx, linea, buf, sizeof(buf));
+    capturar(ctx, "reemplazar hola adios rz0.txt rz1.txt rz2.txt rz3.txt "
+                  "rz4.txt rz5.txt rz6.txt rz7.txt", buf, sizeof(buf));
+    eafitos_destroy(ctx);
+    unsetenv("EAFITOS_HILOS");
+    for (int i = 0; i < 8; i++) {
+        snprintf(archivo, sizeof(archivo), "%s/rz%d.txt", dir, i);
+        f = fopen(archivo, "r");
+        leido[0] = '\0';
+        if (f == NULL || fgets(leido, sizeof(leido), f) == NULL) ok = 0;
+        if (f != NULL) fclose(f);
+        ok = ok && strcmp(leido, "adios\n") == 0;
+        unlink(archivo);
+    }
+    rmdir(dir);
+    ASSERT(ok, "reemplazar: en paralelo, los archivos del directorio de la sesión");
+}
+
+/* ============================================================
+ * Suite 26: Modo servidor (sesiones de varios clientes)
+ * ============================================================ */
+
+/** @brief Conecta al socket del servidor, reintentando mientras arranca. */
+static int conectar_servidor(const char *ruta) {
+    struct sockaddr_un dir;
+    memset(&dir, 0, sizeof(dir));
+    dir.sun_family = AF_UNIX;
+    snprintf(dir.sun_path, sizeof(dir.sun_path), "%s", ruta);
+    for (int intento = 0; intento < 100; intento++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&dir, sizeof(dir)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) close(fd);
+        usleep(20000);
+    }
+    return -1;
+}
+
+static int enviar_linea(int fd, const char *linea) {
+    size_t n = strlen(linea);
+    return fd >= 0 && send(fd, linea, n, MSG_NOSIGNAL) == (ssize_t)n;
+}
+
+/** @brief Lee del cliente hasta ver 'texto' o agotar 'ms' milisegundos. */
+static int esperar_texto(int fd, const char *texto, int ms) {
+    static char recibido[1 << 16];
+    size_t usado = 0;
+    while (fd >= 0) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, ms) <= 0) return 0;
+        if (usado == sizeof(recibido) - 1) {
+            memmove(recibido, recibido + usado / 2, usado - usado / 2);
+            usado -= usado / 2;
+        }
+        ssize_t n = read(fd, recibido + usado, sizeof(recibido) - 1 - usado);
+        if (n <= 0) return 0;
+        usado += (size_t)n;
+        recibido[usado] = '\0';
+        if (strstr(recibido, texto) != NULL) return 1;
+    }
+    return 0;
+}
+
+static void test_servidor(void) {
+    char dir[] = "/tmp/eafitos_srv_XXXXXX";
+    char real[PATH_MAX], cwd[PATH_MAX], sock[96], grande[96], linea[PATH_MAX + 64];
+    int ok = mkdtemp(dir) != NULL && realpath(dir, real) != NULL && getcwd(cwd, sizeof(cwd)) != NULL;
+    snprintf(sock, sizeof(sock), "%s/s.sock", dir);
+    snprintf(grande, sizeof(grande), "%s/grande.txt", dir);
+    FILE *f = fopen(grande, "w");
+    for (int i = 0; f != NULL && i < 400000; i++) fprintf(f, "linea de relleno %d\n", i);
+    ok = ok && f != NULL && fclose(f) == 0;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int nulo = open("/dev/null", O_WRONLY);
+        if (nulo >= 0) dup2(nulo, STDOUT_FILENO);
+        _exit(servidor_ejecutar(sock, 1));   /* Un trabajador: los dos clientes comparten proceso */
+    }
+
+    /* Cliente 1: cambia de directorio y define un alias */
+    int c1 = (pid > 0) ? conectar_servidor(sock) : -1;
+    snprintf(linea, sizeof(linea), "cd %s\nalias zz=pwd\nzz\n", real);
+    ok = ok && enviar_linea(c1, linea) && esperar_texto(c1, real, 5000);
+
+    /* Cada sesión tiene sus variables, aunque compartan proceso */
+    int c_var = conectar_servidor(sock);
+    int variables = enviar_linea(c1, "export EAFITOS_SRV=valor_c1\n") &&
+                    enviar_linea(c_var, "export EAFITOS_SRV=valor_c2\n"
+                                        "limite -t 5 printenv EAFITOS_SRV\n") &&
+                    esperar_texto(c_var, "valor_c2", 5000) &&
+                    enviar_linea(c1, "limite -t 5 printenv EAFITOS_SRV\n") &&
+                    esperar_texto(c1, "valor_c1", 5000);
+    if (c_var >= 0) close(c_var);
+
+    /* ... y lanza un comando con mucha salida que nunca lee */
+    snprintf(linea, sizeof(linea), "leer %s\n", grande);
+    ok = ok && enviar_linea(c1, linea);
+    usleep(200000);
+
+    /* Cliente 2, en el mismo trabajador: responde y no ve lo del cliente 1 */
+    int c2 = conectar_servidor(sock);
+    int responde = enviar_linea(c2, "pwd\n") && esperar_texto(c2, cwd, 5000);
+    int aislado = enviar_linea(c2, "zz\n") && esperar_texto(c2, "desconocido", 5000);
+
+    /* Con todos los hilos ocupados, un cliente más espera su turno (sin
+     * ejecutarse en el bucle) y avanza cuando se libera uno */
+    int ocupados[SERVIDOR_HILOS];
+    ocupados[0] = c1;
+    for (int i = 1; i < SERVIDOR_HILOS; i++) {
+        ocupados[i] = conectar_servidor(sock);
+        ok = ok && enviar_linea(ocupados[i], linea);
+    }
+    usleep(300000);
+    int c3 = conectar_servidor(sock);
+    int espera = enviar_linea(c3, "pwd\n") && !esperar_texto(c3, cwd, 500);
+    close(c1);
+    espera = espera && esperar_texto(c3, cwd, 5000);
+
+    for (int i = 1; i < SERVIDOR_HILOS; i++) {
+        if (ocupados[i] >= 0) close(ocupados[i]);
+    }
+    if (c3 >= 0) close(c3);
+    if (c2 >= 0) close(c2);
+    if (pid > 0) {
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+    }
+    unlink(grande);
+    unlink(sock);
+    rmdir(dir);
+    ASSERT(ok && responde, "servidor: un cliente que no lee su salida no detiene a los demás");
+    ASSERT(ok && aislado, "servidor: directorio y alias de cada cliente por separado");
+    ASSERT(ok && variables, "servidor: variables de `export` de cada cliente por separado");
+    ASSERT(ok && espera, "servidor: grupo fijo de hilos; el cliente de más espera su turno");
+}
+
+/* ============================================================
+ * Suite 27: Plugins (índice y carga perezosa)
+ * ============================================================ */
+
+static void test_plugins(void) {
+    /* make test compila el plugin de ejemplo y pasa su directorio */
+    const char *compilados = getenv("EAFITOS_PLUGINS_PRUEBA");
+    char so[PATH_MAX] = "", dir[] = "/tmp/eafitos_plugins_XXXXXX", indice[64];
+    int ok = compilados != NULL && mkdtemp(dir) != NULL;
+    if (ok) {
+        char relativa[PATH_MAX];
+        snprintf(relativa, sizeof(relativa), "%s/saludo.so", compilados);
+        ok = realpath(relativa, so) != NULL;
+    }
+    snprintf(indice, sizeof(indice), "%s/" PLUGINS_INDICE, dir);
+    FILE *f = ok ? fopen(indice, "w") : NULL;
+    if (f != NULL) {
+        fprintf(f, "# comentario\n\n"
+                   "saludo %s plugin_saludo   Saluda desde la prueba\n"
+                   "incompleto solo_archivo.so\n"
+                   "roto no_existe.so plugin_roto Se rompe al cargarse\n", so);
+        ok = fclose(f) == 0;
+    } else {
+        ok = 0;
+    }
+
+    plugins_liberar();
+    int n = ok ? plugins_inicializar(dir) : 0;
+    /* Releer el índice no registra cada comando dos veces */
+    n = ok && n == 2 ? plugins_inicializar(dir) : n;
+    ok = ok && n == 2 && plugins_existe("saludo") && plugins_existe("roto") &&
+         !plugins_existe("incompleto") && !plugins_existe("comentario");
+    char *lista = NULL;
+    size_t len = 0;
+    FILE *salida_anterior = sesion_actual->salida;
+    sesion_actual->salida = open_memstream(&lista, &len);
+    plugins_listar();
+    fclose(sesion_actual->salida);
+    sesion_actual->salida = salida_anterior;
+    ok = ok && lista != NULL && strstr(lista, " Saluda desde la prueba\n") != NULL;
+    free(lista);
+    ASSERT(ok, "plugins_inicializar: lee el índice y salta comentarios y líneas mal formadas");
+
+    /* El .so solo se abre al usar el comando por primera vez */
+    void *h = dlopen(so, RTLD_LAZY | RTLD_NOLOAD);
+    int sin_cargar = h == NULL;
+    if (h != NULL) dlclose(h);
+    char *texto = salida_de("saludo Ana", FORMATO_TEXTO);
+    h = dlopen(so, RTLD_LAZY | RTLD_NOLOAD);
+    ok = ok && sin_cargar && h != NULL && texto != NULL && strstr(texto, "Hola, Ana") != NULL;
+    if (h != NULL) dlclose(h);
+    free(texto);
+    ASSERT(ok, "plugins: dlopen() en el primer uso y la salida va a la sesión");
+
+    texto = salida_de("roto", FORMATO_TEXTO);
+    ok = texto != NULL && strstr(texto, "No se pudo cargar el plugin 'roto'") != NULL;
+    free(texto);
+    plugins_liberar();
+    unlink(indice);
+    rmdir(dir);
+    ASSERT(ok, "plugins: un .so que no carga se informa al usarlo");
+}
+
 /* ============================================================
  * Función Principal del Test Runner
  * ============================================================ */
@@ -256,6 +1992,115 @@ int main(void) {
     test_strcmp_diferente();
     test_strncpy_limite();
 
+    /* Suite 4: libeafitos */
+    TEST_SUITE("API embebible (libeafitos)");
+    test_eafitos_exec_basico();
+    test_eafitos_contextos_independientes();
+    test_eafitos_multihilo();
+
+    /* Suite 5: Conteo SIMD */
+    TEST_SUITE("contar_bloque() — Conteo SIMD");
+    test_contar_texto_corto();
+    test_contar_aleatorio();
+    test_contar_por_trozos();
+
+    /* Suite 6: Sumas de verificación */
+    TEST_SUITE("crc32c() / xxh64() — Sumas de verificación");
+    test_hash_vectores();
+    test_hash_por_partes();
+
+    /* Suite 7: Robo de trabajo */
+    TEST_SUITE("ejecutar_con_robo() — Robo de trabajo");
+    test_robo_arbol_completo();
+
+    /* Suite 8: Vigilancia */
+    TEST_SUITE("vigilancia — inotify/fanotify");
+    test_vigilancia_evento_creado();
+
+    /* Suite 9: Índice de trigramas */
+    TEST_SUITE("indice — Trigramas para buscar");
+    test_indice_candidatos();
+    test_recolectar_profundo();
+
+    /* Suite 10: Expresiones regulares */
+    TEST_SUITE("expresion — DFA perezoso para buscar -e");
+    test_expresion_sintaxis();
+    test_expresion_limite_estados();
+    test_expresion_sin_retroceso();
+    test_expresion_cache();
+
+    /* Suite 11: Ordenamiento externo */
+    TEST_SUITE("ordenar_archivos — Sort externo");
+    test_ordenar_con_corridas();
+    test_ordenar_unico_por_campo();
+
+    /* Suite 12: Primeras y últimas líneas */
+    TEST_SUITE("lineas — leer -n / -t");
+    test_lineas_extremos();
+
+    /* Suite 13: Visor */
+    TEST_SUITE("visor — leer -p");
+    test_visor_indice();
+
+    /* Suite 14: Trabajos */
+    TEST_SUITE("trabajo_ejecutar — paralelo");
+    test_trabajo_ejecutar();
+
+    /* Suite 15: Redirecciones */
+    TEST_SUITE("separar_redirecciones — <, >, >>, 2>, &>");
+    test_separar_redirecciones();
+    test_redireccion_a_archivo();
+    test_redireccion_de_comandos();
+
+    /* Suite 16: Salida estructurada */
+    TEST_SUITE("formato — --formato json|tsv");
+    test_formato_registros();
+    test_formato_comandos();
+
+    TEST_SUITE("cancelacion — Ctrl+C en comandos largos");
+    test_cancelacion();
+    test_lectura_lotes();
+
+    TEST_SUITE("medicion — medir");
+    test_medicion();
+
+    /* Suite 19: limite */
+    TEST_SUITE("limite — tiempo y memoria por comando");
+    test_limite();
+
+    /* Suite 20: Rastreo de memoria */
+    TEST_SUITE("memoria — rastreo de asignaciones");
+    test_rastreo_memoria();
+    test_parsear_linea_reutiliza();
+
+    /* Suite 21: Directorio de la sesión */
+    TEST_SUITE("cd / pushd — directorio de la sesión");
+    test_directorio_sesion();
+
+    /* Suite 22: Archivo de inicio */
+    TEST_SUITE("~/.eafitosrc — alias, variables e instantánea");
+    test_configuracion_rc();
+
+    /* Suite 23: Grabación y reproducción */
+    TEST_SUITE("--grabar / --reproducir — sesiones reproducibles");
+    test_grabacion();
+
+    /* Suite 24: Diferencias */
+    TEST_SUITE("comparar — diferencias en formato unificado");
+    test_diferencias();
+
+    /* Suite 25: Reemplazo atómico */
+    TEST_SUITE("reemplazar — temporal y rename por archivo");
+    test_reemplazo();
+
+    /* Suite 26: Servidor */
+    TEST_SUITE("servidor — varios clientes en un trabajador");
+    test_servidor();
+
+    /* Suite 27: Plugins */
+    TEST_SUITE("plugins — índice y carga perezosa");
+    test_plugins();
+
     /* Resumen final */
     printf("\n" COLOR_CYAN COLOR_BOLD
            "═══════════════════════════════════════\n"